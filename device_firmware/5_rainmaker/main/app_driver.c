@@ -27,6 +27,20 @@
 
 static bool g_output_state = true;
 
+#define LIGHT_PENDING_POWER         (1 << 0)
+#define LIGHT_PENDING_HUE           (1 << 1)
+#define LIGHT_PENDING_SATURATION    (1 << 2)
+#define LIGHT_PENDING_BRIGHTNESS    (1 << 3)
+
+/* Light state staged by the RainMaker handlers, applied at once by app_light_commit() */
+static struct {
+    uint32_t mask;
+    bool power;
+    uint16_t hue;
+    uint8_t saturation;
+    uint8_t brightness;
+} g_light_pending;
+
 static void push_btn_cb(void *arg)
 {
     app_driver_set_state(!g_output_state);
@@ -127,3 +141,66 @@ esp_err_t app_light_set_saturation(uint16_t saturation)
 {
     return light_driver_set_saturation(saturation);
 }
+
+esp_err_t app_light_stage_power(bool power)
+{
+    g_light_pending.power = power;
+    g_light_pending.mask |= LIGHT_PENDING_POWER;
+    return ESP_OK;
+}
+
+esp_err_t app_light_stage_brightness(int brightness)
+{
+    if (brightness < 0 || brightness > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_light_pending.brightness = brightness;
+    g_light_pending.mask |= LIGHT_PENDING_BRIGHTNESS;
+    return ESP_OK;
+}
+
+esp_err_t app_light_stage_hue(int hue)
+{
+    if (hue < 0 || hue > 360) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_light_pending.hue = hue;
+    g_light_pending.mask |= LIGHT_PENDING_HUE;
+    return ESP_OK;
+}
+
+esp_err_t app_light_stage_saturation(int saturation)
+{
+    if (saturation < 0 || saturation > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_light_pending.saturation = saturation;
+    g_light_pending.mask |= LIGHT_PENDING_SATURATION;
+    return ESP_OK;
+}
+
+esp_err_t app_light_commit(void *arg)
+{
+    uint32_t mask = g_light_pending.mask;
+
+    if (!mask) {
+        return ESP_OK;
+    }
+
+    g_light_pending.mask = 0;
+
+    /* What was not staged keeps its current value, a color without power is shown at the next power on */
+    bool power         = (mask & LIGHT_PENDING_POWER) ? g_light_pending.power : light_driver_get_switch();
+    uint16_t hue       = (mask & LIGHT_PENDING_HUE) ? g_light_pending.hue : light_driver_get_hue();
+    uint8_t saturation = (mask & LIGHT_PENDING_SATURATION) ? g_light_pending.saturation : light_driver_get_saturation();
+    uint8_t brightness = (mask & LIGHT_PENDING_BRIGHTNESS) ? g_light_pending.brightness : light_driver_get_value();
+
+    ESP_LOGI(TAG, "Light %s, hue: %d, saturation: %d, brightness: %d", power ? "ON" : "OFF", hue, saturation, brightness);
+    esp_err_t ret = light_driver_set_hsv_switch(power, hue, saturation, brightness);
+
+    g_output_state = power;
+    return ret;
+}
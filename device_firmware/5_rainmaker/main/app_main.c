@@ -32,6 +32,7 @@
 
 #include "app_wifi.h"
 #include "app_storage.h"
+#include "app_param.h"
 #include "app_priv.h"
 
 static const char *TAG = "rainmaker";
@@ -40,37 +41,25 @@ esp_rmaker_device_t *light_device;
 
 extern const char ota_server_cert[] asm("_binary_server_crt_start");
 
-/* Callback to handle commands received from the RainMaker cloud */
-static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-            const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+/* Parameters of the light, commands received from the RainMaker cloud are dispatched
+ * to their handler by app_param_write_cb(), the power param is created with the device.
+ * The handlers only stage the values, the parameters written together are applied
+ * by app_light_commit() as a single change of the light.
+ */
+static const app_param_desc_t light_params[] = {
+    APP_PARAM_BOOL(ESP_RMAKER_DEF_POWER_NAME, NULL, DEFAULT_POWER, app_light_stage_power),
+    APP_PARAM_INT(ESP_RMAKER_DEF_BRIGHTNESS_NAME, esp_rmaker_brightness_param_create, DEFAULT_BRIGHTNESS, app_light_stage_brightness),
+    APP_PARAM_INT(ESP_RMAKER_DEF_HUE_NAME, esp_rmaker_hue_param_create, DEFAULT_HUE, app_light_stage_hue),
+    APP_PARAM_INT(ESP_RMAKER_DEF_SATURATION_NAME, esp_rmaker_saturation_param_create, DEFAULT_SATURATION, app_light_stage_saturation),
+};
+
+#define WIFI_CONNECT_WAIT_MS    10000
+
+static void wifi_state_cb(app_wifi_state_t state, void *arg)
 {
-    if (ctx) {
-        ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
-    }
-    const char *device_name = esp_rmaker_device_get_name(device);
-    const char *param_name = esp_rmaker_param_get_name(param);
-    if (strcmp(param_name, ESP_RMAKER_DEF_POWER_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %s for %s - %s",
-                val.val.b? "true" : "false", device_name, param_name);
-        app_light_set_power(val.val.b);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_BRIGHTNESS_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_brightness(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_HUE_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_hue(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_SATURATION_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_saturation(val.val.i);
-    } else {
-        /* Silently ignoring invalid params */
-        return ESP_OK;
-    }
-    esp_rmaker_param_update_and_report(param, val);
-    return ESP_OK;
+    static const char *state_str[] = {"provisioning", "provisioned", "connected", "disconnected"};
+
+    ESP_LOGI(TAG, "Wi-Fi %s", state_str[state]);
 }
 
 void app_main()
@@ -112,11 +101,9 @@ void app_main()
 
     /* Create a device and add the relevant parameters to it */
     light_device = esp_rmaker_lightbulb_device_create("Light", NULL, DEFAULT_POWER);
-    esp_rmaker_device_add_cb(light_device, write_cb, NULL);
-
-    esp_rmaker_device_add_param(light_device, esp_rmaker_brightness_param_create(ESP_RMAKER_DEF_BRIGHTNESS_NAME, DEFAULT_BRIGHTNESS));
-    esp_rmaker_device_add_param(light_device, esp_rmaker_hue_param_create(ESP_RMAKER_DEF_HUE_NAME, DEFAULT_HUE));
-    esp_rmaker_device_add_param(light_device, esp_rmaker_saturation_param_create(ESP_RMAKER_DEF_SATURATION_NAME, DEFAULT_SATURATION));
+    esp_rmaker_device_add_cb(light_device, app_param_write_cb, NULL);
+    ESP_ERROR_CHECK(app_param_add_table(light_device, light_params, sizeof(light_params) / sizeof(light_params[0]), NULL));
+    ESP_ERROR_CHECK(app_param_set_commit_cb(app_light_commit, NULL));
 
     esp_rmaker_node_add_device(node, light_device);
 
@@ -141,16 +128,24 @@ void app_main()
 
     /* Start the Wi-Fi.
      * If the node is provisioned, it will start connection attempts,
-     * else, it will start Wi-Fi provisioning. The function will return
-     * after a connection has been successfully established
+     * else, it will start Wi-Fi provisioning. The function returns at once,
+     * the connection states are reported through wifi_state_cb()
      */
-    err = app_wifi_start(POP_TYPE_RANDOM);
+    app_wifi_async_config_t wifi_async_config = {
+        .state_cb = wifi_state_cb,
+    };
+    err = app_wifi_start_async(POP_TYPE_RANDOM, &wifi_async_config);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Could not start Wifi. Aborting!!!");
         vTaskDelay(pdMS_TO_TICKS(5000));
         abort();
     }
 
+    /* Local control does not need the network, only wait a while for the connection */
+    if (app_wifi_wait_connected(pdMS_TO_TICKS(WIFI_CONNECT_WAIT_MS)) != ESP_OK) {
+        ESP_LOGW(TAG, "Wi-Fi not connected yet, going on without it");
+    }
+
     while (1) {
         ESP_LOGI(TAG, "[%02d] Hello world!", i++);
         vTaskDelay(pdMS_TO_TICKS(5000));
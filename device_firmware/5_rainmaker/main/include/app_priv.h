@@ -84,4 +84,28 @@ esp_err_t app_light_set_hue(uint16_t hue);
  */
 esp_err_t app_light_set_saturation(uint16_t saturation);
 
+/**
+ * @brief Stage a part of the light state, nothing changes until app_light_commit()
+ *
+ * @note  Handlers of the RainMaker parameters, a value out of range is rejected at once
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t app_light_stage_power(bool power);
+esp_err_t app_light_stage_brightness(int brightness);
+esp_err_t app_light_stage_hue(int hue);
+esp_err_t app_light_stage_saturation(int saturation);
+
+/**
+ * @brief Apply the staged state with a single transaction of the light driver,
+ *        one fade and one write to the flash whatever the number of staged values
+ *
+ * @param arg Unused, commit callback of app_param
+ *
+ * @return esp_err_t
+ */
+esp_err_t app_light_commit(void *arg);
+
 #endif /**< __APP_PRIVATE_H__ */
@@ -8,15 +8,19 @@
 
 #include <stdio.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "iot_button.h"
+#include "button_dimmer.h"
 #include "light_driver.h"
+#include "app_reporter.h"
 
 #include <esp_rmaker_utils.h>
+#include <esp_rmaker_standard_params.h>
 
 #include DEVELOPMENT_BOARD
 #include "app_priv.h"
@@ -24,17 +28,83 @@
 #define TAG "app_driver"
 
 #define REBOOT_DELAY        2
+#define FACTORY_RESET_CLICKS 5
 
 static bool g_output_state = true;
+static app_pm_client_handle_t g_fade_pm_client = NULL;
+
+#define LIGHT_PENDING_POWER         (1 << 0)
+#define LIGHT_PENDING_HUE           (1 << 1)
+#define LIGHT_PENDING_SATURATION    (1 << 2)
+#define LIGHT_PENDING_BRIGHTNESS    (1 << 3)
+
+/* Light state staged by the RainMaker handlers, applied at once by app_light_commit() */
+static struct {
+    uint32_t mask;
+    bool power;
+    uint16_t hue;
+    uint8_t saturation;
+    uint8_t brightness;
+} g_light_pending;
+
+extern esp_rmaker_device_t *light_device;
+
+/* Local changes go through the reporter, a ramp would flood the cloud with intermediate values */
+static void report_param(const char *name, esp_rmaker_param_val_t val)
+{
+    if (light_device) {
+        app_reporter_update(esp_rmaker_device_get_param_by_name(light_device, name), val);
+    }
+}
 
 static void push_btn_cb(void *arg)
 {
+    ESP_LOGD(TAG, "Button event latency: %lld us", esp_timer_get_time() - iot_button_get_event_time(arg));
     app_driver_set_state(!g_output_state);
+    report_param(ESP_RMAKER_DEF_POWER_NAME, esp_rmaker_bool(g_output_state));
 }
 
 static void factory_reset_trigger(void *arg)
 {
-    esp_rmaker_factory_reset(0, REBOOT_DELAY);
+    if (iot_button_get_repeat(arg) >= FACTORY_RESET_CLICKS) {
+        esp_rmaker_factory_reset(0, REBOOT_DELAY);
+    }
+}
+
+static void dimmer_step_cb(uint8_t level, void *arg)
+{
+    /* A ramp from off turns the light on */
+    if (!g_output_state) {
+        g_output_state = true;
+        app_pm_set_profile(APP_PM_PROFILE_BALANCED);
+        report_param(ESP_RMAKER_DEF_POWER_NAME, esp_rmaker_bool(true));
+    }
+
+    report_param(ESP_RMAKER_DEF_BRIGHTNESS_NAME, esp_rmaker_int(level));
+}
+
+static void dimmer_end_cb(uint8_t level, void *arg)
+{
+    ESP_LOGI(TAG, "Brightness set to %d by the button", level);
+
+    g_output_state = light_driver_get_switch();
+    app_pm_set_profile(g_output_state ? APP_PM_PROFILE_BALANCED : APP_PM_PROFILE_MINIMUM);
+    report_param(ESP_RMAKER_DEF_POWER_NAME, esp_rmaker_bool(g_output_state));
+    report_param(ESP_RMAKER_DEF_BRIGHTNESS_NAME, esp_rmaker_int(level));
+
+    /* The final level goes out at once */
+    app_reporter_flush();
+}
+
+/* Called by the light driver when the fade timer starts and, from its ISR, when it stops */
+static void IRAM_ATTR app_driver_fade_pm_acquire(void *arg)
+{
+    app_pm_client_acquire((app_pm_client_handle_t)arg);
+}
+
+static void IRAM_ATTR app_driver_fade_pm_release(void *arg)
+{
+    app_pm_client_release((app_pm_client_handle_t)arg);
 }
 
 void app_driver_init()
@@ -45,14 +115,30 @@ void app_driver_init()
         .gpio_button_config = {
             .gpio_num     = LIGHT_BUTTON_GPIO,
             .active_level = LIGHT_BUTTON_ACTIVE_LEVEL,
+            .enable_power_save = true,
         },
     };
     button_handle_t btn_handle = iot_button_create(&btn_cfg);
     if (btn_handle) {
         /* Register a callback for a button short press event */
         iot_button_register_cb(btn_handle, BUTTON_SINGLE_CLICK, push_btn_cb);
-        /* Register a callback for a button long press event */
-        iot_button_register_cb(btn_handle, BUTTON_LONG_PRESS_START, factory_reset_trigger);
+        /* Register a callback for a multiple click event, the factory reset needs 5 clicks */
+        iot_button_register_cb(btn_handle, BUTTON_MULTIPLE_CLICK, factory_reset_trigger);
+        /* Hold the button to ramp the brightness, each hold reverses the direction */
+        button_dimmer_config_t dimmer_cfg = {
+            .update_period_ms = 50,
+            .ramp_time_ms     = 3000,
+            .acceleration     = 50,
+            .end_cb           = dimmer_end_cb,
+            .step_cb          = dimmer_step_cb,
+        };
+        button_dimmer_create(btn_handle, &dimmer_cfg);
+    }
+
+    /* The APB lock of the fades is listed by app_pm_dump_clients(), set before the first fade */
+    g_fade_pm_client = app_pm_client_register("led_fade", APP_PM_LOCK_APB_FREQ_MAX);
+    if (g_fade_pm_client) {
+        iot_led_set_pm_hooks(app_driver_fade_pm_acquire, app_driver_fade_pm_release, g_fade_pm_client);
     }
 
     /**
@@ -67,7 +153,7 @@ void app_driver_init()
         .fade_period_ms  = LIGHT_FADE_PERIOD_MS,
         .blink_period_ms = LIGHT_BLINK_PERIOD_MS,
         .freq_hz         = LIGHT_FREQ_HZ,
-        .clk_cfg         = LEDC_USE_APB_CLK,
+        .clk_cfg         = LEDC_USE_RTC8M_CLK,
         .duty_resolution = LEDC_TIMER_11_BIT,
     };
     ESP_ERROR_CHECK(light_driver_init(&driver_config));
@@ -78,15 +164,9 @@ int IRAM_ATTR app_driver_set_state(bool state)
 {
     if (g_output_state != state) {
         g_output_state = state;
-        if (g_output_state) {
-            // light on
-            ESP_LOGI(TAG, "Light ON");
-            light_driver_set_switch(true);
-        } else {
-            // light off
-            ESP_LOGI(TAG, "Light OFF");
-            light_driver_set_switch(false);
-        }
+        ESP_LOGI(TAG, "Light %s", g_output_state ? "ON" : "OFF");
+        /* The power profile follows the light */
+        app_light_set_power(g_output_state);
     }
     return ESP_OK;
 }
@@ -98,16 +178,16 @@ bool app_driver_get_state(void)
 
 esp_err_t app_light_set_power(bool power)
 {
+    /* The LEDC clock survives DFS and light sleep, the light driver only locks the APB frequency while fading */
     if (power) {
-        // PM Lock
-        app_pm_lock_acquire();
+        app_pm_set_profile(APP_PM_PROFILE_BALANCED);
         // light on
         light_driver_set_switch(true);
     } else {
         // light off
         light_driver_set_switch(false);
-        // PM UnLock
-        app_pm_lock_release();
+        // Nothing to show, the radio can sleep longer
+        app_pm_set_profile(APP_PM_PROFILE_MINIMUM);
     }
     return ESP_OK;
 }
@@ -131,3 +211,83 @@ esp_err_t app_light_set_saturation(uint16_t saturation)
 {
     return light_driver_set_saturation(saturation);
 }
+
+esp_err_t app_light_stage_power(bool power)
+{
+    g_light_pending.power = power;
+    g_light_pending.mask |= LIGHT_PENDING_POWER;
+    return ESP_OK;
+}
+
+esp_err_t app_light_stage_brightness(int brightness)
+{
+    if (brightness < 0 || brightness > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_light_pending.brightness = brightness;
+    g_light_pending.mask |= LIGHT_PENDING_BRIGHTNESS;
+    return ESP_OK;
+}
+
+esp_err_t app_light_stage_hue(int hue)
+{
+    if (hue < 0 || hue > 360) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_light_pending.hue = hue;
+    g_light_pending.mask |= LIGHT_PENDING_HUE;
+    return ESP_OK;
+}
+
+esp_err_t app_light_stage_saturation(int saturation)
+{
+    if (saturation < 0 || saturation > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_light_pending.saturation = saturation;
+    g_light_pending.mask |= LIGHT_PENDING_SATURATION;
+    return ESP_OK;
+}
+
+esp_err_t app_light_commit(void *arg)
+{
+    uint32_t mask = g_light_pending.mask;
+
+    if (!mask) {
+        return ESP_OK;
+    }
+
+    g_light_pending.mask = 0;
+
+    /* What was not staged keeps its current value, a color without power is shown at the next power on */
+    bool power         = (mask & LIGHT_PENDING_POWER) ? g_light_pending.power : light_driver_get_switch();
+    uint16_t hue       = (mask & LIGHT_PENDING_HUE) ? g_light_pending.hue : light_driver_get_hue();
+    uint8_t saturation = (mask & LIGHT_PENDING_SATURATION) ? g_light_pending.saturation : light_driver_get_saturation();
+    uint8_t brightness = (mask & LIGHT_PENDING_BRIGHTNESS) ? g_light_pending.brightness : light_driver_get_value();
+
+    /* The profile is only changed along with the power */
+    if ((mask & LIGHT_PENDING_POWER) && power) {
+        app_pm_set_profile(APP_PM_PROFILE_BALANCED);
+    }
+
+    esp_err_t ret = ESP_OK;
+
+    /* The power alone keeps the mode of the light and restores a zero brightness at power on */
+    if (mask == LIGHT_PENDING_POWER) {
+        ESP_LOGI(TAG, "Light %s", power ? "ON" : "OFF");
+        ret = light_driver_set_switch(power);
+    } else {
+        ESP_LOGI(TAG, "Light %s, hue: %d, saturation: %d, brightness: %d", power ? "ON" : "OFF", hue, saturation, brightness);
+        ret = light_driver_set_hsv_switch(power, hue, saturation, brightness);
+    }
+
+    if ((mask & LIGHT_PENDING_POWER) && !power) {
+        app_pm_set_profile(APP_PM_PROFILE_MINIMUM);
+    }
+
+    g_output_state = power;
+    return ret;
+}
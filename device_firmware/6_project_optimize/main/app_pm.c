@@ -10,7 +10,10 @@
 
 #include "esp_log.h"
 #include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_freertos_hooks.h"
 
+#include "app_wifi.h"
 #include "app_priv.h"
 
 #if CONFIG_PM_ENABLE
@@ -18,16 +21,74 @@
 #define LIGHT_EXAMPLE_MAX_CPU_FREQ_MHZ (80)
 #define LIGHT_EXAMPLE_MIN_CPU_FREQ_MHZ (10)
 
+#define APP_PM_CLIENT_MAX   (8)
+
 static const char *TAG = "app-pm";
-static bool g_pm_lock_acquired = false;
-static esp_pm_lock_handle_t g_pm_apb_lock = NULL;
 
-esp_err_t app_pm_init()
+/**
+ * @brief A named holder of a PM lock, acquisitions are counted per client
+ */
+struct app_pm_client {
+    const char *name;
+    app_pm_lock_type_t type;
+    esp_pm_lock_handle_t lock;
+    uint32_t count;             /**< nested acquisitions */
+    uint32_t acquired;          /**< 0 -> 1 transitions */
+    int64_t since;              /**< first acquisition of the current hold */
+    int64_t hold_us;            /**< total of the finished holds */
+};
+
+static struct app_pm_client g_pm_clients[APP_PM_CLIENT_MAX];
+static portMUX_TYPE g_pm_client_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Settings applied together by app_pm_set_profile()
+ */
+typedef struct {
+    const char *name;
+    wifi_ps_type_t ps_type;
+    uint16_t listen_interval;   /**< beacon intervals, only used by WIFI_PS_MAX_MODEM */
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} app_pm_profile_config_t;
+
+static const app_pm_profile_config_t g_pm_profiles[APP_PM_PROFILE_MAX] = {
+    [APP_PM_PROFILE_RESPONSIVE] = {"responsive", WIFI_PS_NONE,      0,  160, 80, false},
+    [APP_PM_PROFILE_BALANCED]   = {"balanced",   WIFI_PS_MIN_MODEM, 0,  LIGHT_EXAMPLE_MAX_CPU_FREQ_MHZ, LIGHT_EXAMPLE_MIN_CPU_FREQ_MHZ, true},
+    [APP_PM_PROFILE_MINIMUM]    = {"minimum",    WIFI_PS_MAX_MODEM, 10, LIGHT_EXAMPLE_MAX_CPU_FREQ_MHZ, LIGHT_EXAMPLE_MIN_CPU_FREQ_MHZ, true},
+};
+
+static app_pm_profile_t g_pm_profile = APP_PM_PROFILE_BALANCED;
+static int64_t g_pm_profile_since = 0;
+static app_pm_profile_stats_t g_pm_profile_stats[APP_PM_PROFILE_MAX];
+static portMUX_TYPE g_pm_profile_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Called by the idle task before each wait for an interrupt, so once per wake-up
+ */
+static bool app_pm_idle_hook(void)
 {
-#if CONFIG_PM_ENABLE
-    // Configure dynamic frequency scaling:
-    // maximum and minimum frequencies are set in sdkconfig,
-    // automatic light sleep is enabled if tickless idle support is enabled.
+    g_pm_profile_stats[g_pm_profile].wakeups++;
+    return true;
+}
+
+esp_err_t app_pm_set_profile(app_pm_profile_t profile)
+{
+    if (profile >= APP_PM_PROFILE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const app_pm_profile_config_t *config = &g_pm_profiles[profile];
+
+    /**< Saved by app_wifi until Wi-Fi is initialized, a refused setting keeps the current profile */
+    esp_err_t ret = app_wifi_set_power_save(config->ps_type, config->listen_interval);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Power profile %s refused by Wi-Fi, err: %s", config->name, esp_err_to_name(ret));
+        return ret;
+    }
+
 #if CONFIG_IDF_TARGET_ESP32
     esp_pm_config_esp32_t pm_config = {
 #elif CONFIG_IDF_TARGET_ESP32S2
@@ -35,47 +96,201 @@ esp_err_t app_pm_init()
 #elif CONFIG_IDF_TARGET_ESP32C3
     esp_pm_config_esp32c3_t pm_config = {
 #endif
-            .max_freq_mhz = LIGHT_EXAMPLE_MAX_CPU_FREQ_MHZ,
-            .min_freq_mhz = LIGHT_EXAMPLE_MIN_CPU_FREQ_MHZ,
+            .max_freq_mhz = config->max_freq_mhz,
+            .min_freq_mhz = config->min_freq_mhz,
 #if CONFIG_FREERTOS_USE_TICKLESS_IDLE
-            .light_sleep_enable = true
+            .light_sleep_enable = config->light_sleep_enable,
 #endif
     };
-    ESP_ERROR_CHECK( esp_pm_configure(&pm_config) );
-#endif // CONFIG_PM_ENABLE
 
-    if (g_pm_apb_lock == NULL) {
-        if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "l_apb", &g_pm_apb_lock) != ESP_OK) {
-            ESP_LOGE(TAG, "esp pm lock l_apb create failed");
-        }
+    ret = esp_pm_configure(&pm_config);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure for profile %s, err: %s", config->name, esp_err_to_name(ret));
+        return ret;
     }
 
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_pm_profile_lock);
+    g_pm_profile_stats[g_pm_profile].time_ms += (now - g_pm_profile_since) / 1000;
+    g_pm_profile_since = now;
+    g_pm_profile = profile;
+    portEXIT_CRITICAL(&g_pm_profile_lock);
+
+    ESP_LOGI(TAG, "Power profile %s", config->name);
+
     return ESP_OK;
 }
 
-esp_err_t app_pm_lock_acquire()
+app_pm_profile_t app_pm_get_profile(void)
 {
-    if (!g_pm_lock_acquired) {
-        ESP_ERROR_CHECK(esp_pm_lock_acquire(g_pm_apb_lock));
-        g_pm_lock_acquired = true;
-    } else {
-        ESP_LOGI(TAG, "already acquire");
+    return g_pm_profile;
+}
+
+esp_err_t app_pm_get_profile_stats(app_pm_profile_t profile, app_pm_profile_stats_t *stats)
+{
+    if (profile >= APP_PM_PROFILE_MAX || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_pm_profile_lock);
+    *stats = g_pm_profile_stats[profile];
+
+    if (profile == g_pm_profile) {
+        stats->time_ms += (now - g_pm_profile_since) / 1000;
     }
+    portEXIT_CRITICAL(&g_pm_profile_lock);
+
     return ESP_OK;
 }
 
-esp_err_t app_pm_lock_release()
+void app_pm_dump_profiles(void)
 {
-    if (g_pm_lock_acquired) {
-        ESP_ERROR_CHECK(esp_pm_lock_release(g_pm_apb_lock));
-        g_pm_lock_acquired = false;
-    } else {
-        ESP_LOGI(TAG, "already release");
+    for (int i = 0; i < APP_PM_PROFILE_MAX; i++) {
+        app_pm_profile_stats_t stats = {0};
+        app_pm_get_profile_stats(i, &stats);
+        ESP_LOGI(TAG, "%-10s %c time: %llu ms, wake-ups: %u (%u/s)", g_pm_profiles[i].name,
+                 i == g_pm_profile ? '*' : ' ', stats.time_ms, stats.wakeups,
+                 stats.time_ms ? (uint32_t)(stats.wakeups * 1000ULL / stats.time_ms) : 0);
     }
+}
+
+esp_err_t app_pm_init()
+{
+    // Configure dynamic frequency scaling and light sleep with the default profile,
+    // automatic light sleep is enabled if tickless idle support is enabled.
+    ESP_ERROR_CHECK(app_pm_set_profile(APP_PM_PROFILE_BALANCED));
+    esp_register_freertos_idle_hook_for_cpu(app_pm_idle_hook, 0);
 
     return ESP_OK;
 }
 
+app_pm_client_handle_t app_pm_client_register(const char *name, app_pm_lock_type_t type)
+{
+    static const esp_pm_lock_type_t lock_types[APP_PM_LOCK_TYPE_MAX] = {
+        [APP_PM_LOCK_APB_FREQ_MAX]  = ESP_PM_APB_FREQ_MAX,
+        [APP_PM_LOCK_CPU_FREQ_MAX]  = ESP_PM_CPU_FREQ_MAX,
+        [APP_PM_LOCK_NO_LIGHT_SLEEP] = ESP_PM_NO_LIGHT_SLEEP,
+    };
+
+    if (!name || type >= APP_PM_LOCK_TYPE_MAX) {
+        return NULL;
+    }
+
+    struct app_pm_client *client = NULL;
+
+    /**< The slot is claimed under the lock, the PM lock allocates and is created outside of it */
+    portENTER_CRITICAL(&g_pm_client_lock);
+
+    for (int i = 0; i < APP_PM_CLIENT_MAX; i++) {
+        if (!g_pm_clients[i].name) {
+            client = &g_pm_clients[i];
+            client->name = name;
+            client->type = type;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&g_pm_client_lock);
+
+    if (!client) {
+        ESP_LOGE(TAG, "No free client for %s, APP_PM_CLIENT_MAX: %d", name, APP_PM_CLIENT_MAX);
+        return NULL;
+    }
+
+    esp_pm_lock_handle_t lock = NULL;
+
+    if (esp_pm_lock_create(lock_types[type], 0, name, &lock) != ESP_OK) {
+        ESP_LOGE(TAG, "esp pm lock %s create failed", name);
+
+        portENTER_CRITICAL(&g_pm_client_lock);
+        client->name = NULL;
+        portEXIT_CRITICAL(&g_pm_client_lock);
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&g_pm_client_lock);
+    client->lock = lock;
+    portEXIT_CRITICAL(&g_pm_client_lock);
+
+    return client;
+}
+
+esp_err_t IRAM_ATTR app_pm_client_acquire(app_pm_client_handle_t client)
+{
+    if (!client || !client->lock) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = esp_pm_lock_acquire(client->lock);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    portENTER_CRITICAL_SAFE(&g_pm_client_lock);
+
+    if (client->count++ == 0) {
+        client->since = esp_timer_get_time();
+        client->acquired++;
+    }
+
+    portEXIT_CRITICAL_SAFE(&g_pm_client_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t IRAM_ATTR app_pm_client_release(app_pm_client_handle_t client)
+{
+    if (!client || !client->lock) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /**< A release without an acquisition would undo the acquisition of another client */
+    portENTER_CRITICAL_SAFE(&g_pm_client_lock);
+
+    if (client->count == 0) {
+        portEXIT_CRITICAL_SAFE(&g_pm_client_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (--client->count == 0) {
+        client->hold_us += esp_timer_get_time() - client->since;
+    }
+
+    portEXIT_CRITICAL_SAFE(&g_pm_client_lock);
+
+    return esp_pm_lock_release(client->lock);
+}
+
+void app_pm_dump_clients(void)
+{
+    static const char *type_str[APP_PM_LOCK_TYPE_MAX] = {"APB_MAX", "CPU_MAX", "NO_SLEEP"};
+    int64_t now = esp_timer_get_time();
+
+    for (int i = 0; i < APP_PM_CLIENT_MAX; i++) {
+        struct app_pm_client client;
+
+        portENTER_CRITICAL(&g_pm_client_lock);
+        client = g_pm_clients[i];
+        portEXIT_CRITICAL(&g_pm_client_lock);
+
+        /**< A slot freed after a failed registration leaves a gap */
+        if (!client.name || !client.lock) {
+            continue;
+        }
+
+        int64_t hold_us = client.hold_us + (client.count ? now - client.since : 0);
+
+        ESP_LOGI(TAG, "%-12s %-8s %s count: %u, acquired: %u, held: %lld ms (%lld%%)",
+                 client.name, type_str[client.type], client.count ? "HELD" : "    ",
+                 client.count, client.acquired, hold_us / 1000, now ? hold_us * 100 / now : 0);
+    }
+}
+
 #else
 
 esp_err_t app_pm_init()
@@ -83,14 +298,42 @@ esp_err_t app_pm_init()
     return ESP_FAIL;
 }
 
-esp_err_t app_pm_lock_acquire()
+esp_err_t app_pm_set_profile(app_pm_profile_t profile)
 {
     return ESP_FAIL;
 }
 
-esp_err_t app_pm_lock_release()
+app_pm_profile_t app_pm_get_profile(void)
+{
+    return APP_PM_PROFILE_RESPONSIVE;
+}
+
+esp_err_t app_pm_get_profile_stats(app_pm_profile_t profile, app_pm_profile_stats_t *stats)
 {
     return ESP_FAIL;
 }
 
+void app_pm_dump_profiles(void)
+{
+}
+
+app_pm_client_handle_t app_pm_client_register(const char *name, app_pm_lock_type_t type)
+{
+    return NULL;
+}
+
+esp_err_t app_pm_client_acquire(app_pm_client_handle_t client)
+{
+    return ESP_FAIL;
+}
+
+esp_err_t app_pm_client_release(app_pm_client_handle_t client)
+{
+    return ESP_FAIL;
+}
+
+void app_pm_dump_clients(void)
+{
+}
+
 #endif // CONFIG_PM_ENABLE
@@ -0,0 +1,163 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+
+#include "light_driver.h"
+#include "app_priv.h"
+
+static const char *TAG = "app-energy";
+
+static app_energy_coeff_t g_energy_coeff = {
+    .state_ua = {
+        [APP_ENERGY_STATE_ACTIVE]      = CONFIG_APP_ENERGY_ACTIVE_UA,
+        [APP_ENERGY_STATE_DFS_MIN]     = CONFIG_APP_ENERGY_DFS_MIN_UA,
+        [APP_ENERGY_STATE_LIGHT_SLEEP] = CONFIG_APP_ENERGY_LIGHT_SLEEP_UA,
+        [APP_ENERGY_STATE_RADIO_ON]    = CONFIG_APP_ENERGY_RADIO_ON_UA,
+        [APP_ENERGY_STATE_MODEM_SLEEP] = CONFIG_APP_ENERGY_MODEM_SLEEP_UA,
+    },
+    .led_full_ua = {
+        CONFIG_APP_ENERGY_LED_FULL_UA, CONFIG_APP_ENERGY_LED_FULL_UA, CONFIG_APP_ENERGY_LED_FULL_UA,
+        CONFIG_APP_ENERGY_LED_FULL_UA, CONFIG_APP_ENERGY_LED_FULL_UA,
+    },
+    .supply_mv = CONFIG_APP_ENERGY_SUPPLY_MV,
+};
+
+#if CONFIG_PM_PROFILING
+/**
+ * @brief Read the time spent in each mode of the power management, only
+ *        available in the statistics printed by esp_pm_dump_locks()
+ *
+ * @return true if the mode statistics were found
+ */
+static bool app_energy_read_pm_modes(uint64_t time_ms[APP_ENERGY_STATE_MAX])
+{
+    char *buf = NULL;
+    size_t size = 0;
+    bool found = false;
+    FILE *stream = open_memstream(&buf, &size);
+
+    if (!stream) {
+        return false;
+    }
+
+    esp_pm_dump_locks(stream);
+    fclose(stream);
+
+    /**< "Mode  CPU_freq  Time(us)  Time(%)" lines, e.g. "APB_MIN   10 M       123456  12%" */
+    char *saveptr = NULL;
+
+    for (char *line = strtok_r(buf, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)) {
+        char name[16] = {0};
+        int freq_mhz = 0;
+        long long time_us = 0;
+
+        if (sscanf(line, "%15s %d %*s %lld", name, &freq_mhz, &time_us) != 3) {
+            continue;
+        }
+
+        if (!strcmp(name, "SLEEP")) {
+            time_ms[APP_ENERGY_STATE_LIGHT_SLEEP] = time_us / 1000;
+        } else if (!strcmp(name, "APB_MIN")) {
+            time_ms[APP_ENERGY_STATE_DFS_MIN] = time_us / 1000;
+        } else if (!strcmp(name, "APB_MAX") || !strcmp(name, "CPU_MAX")) {
+            time_ms[APP_ENERGY_STATE_ACTIVE] += time_us / 1000;
+        } else {
+            continue;
+        }
+
+        found = true;
+    }
+
+    free(buf);
+    return found;
+}
+#endif /* CONFIG_PM_PROFILING */
+
+esp_err_t app_energy_set_coeff(const app_energy_coeff_t *coeff)
+{
+    if (!coeff) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_energy_coeff = *coeff;
+    return ESP_OK;
+}
+
+esp_err_t app_energy_get_stats(app_energy_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint64_t now_ms = esp_timer_get_time() / 1000;
+    app_pm_profile_stats_t profile_stats = {0};
+    uint64_t charge = 0;    /**< uA x ms */
+
+    memset(stats, 0, sizeof(app_energy_stats_t));
+    stats->uptime_ms = now_ms;
+
+    /**< CPU: one of active, DFS min and light sleep at any time */
+#if CONFIG_PM_PROFILING
+    stats->cpu_measured = app_energy_read_pm_modes(stats->time_ms);
+#endif
+
+    if (!stats->cpu_measured) {
+        stats->time_ms[APP_ENERGY_STATE_ACTIVE] = now_ms;
+    }
+
+    /**< Radio: modem sleep in every power profile but the responsive one */
+    for (int i = 0; i < APP_PM_PROFILE_MAX; i++) {
+        if (app_pm_get_profile_stats(i, &profile_stats) != ESP_OK) {
+            continue;
+        }
+
+        stats->time_ms[i == APP_PM_PROFILE_RESPONSIVE ? APP_ENERGY_STATE_RADIO_ON : APP_ENERGY_STATE_MODEM_SLEEP] += profile_stats.time_ms;
+    }
+
+    for (int i = 0; i < APP_ENERGY_STATE_MAX; i++) {
+        charge += stats->time_ms[i] * g_energy_coeff.state_ua[i];
+    }
+
+    /**< LEDs: the current at full duty for the time at full duty */
+    if (light_driver_get_duty_ms(stats->duty_ms) == ESP_OK) {
+        for (int i = 0; i < LIGHT_DRIVER_CHANNEL_NUM; i++) {
+            charge += stats->duty_ms[i] * g_energy_coeff.led_full_ua[i];
+        }
+    }
+
+    stats->charge_uah  = charge / 3600000;
+    stats->energy_mj   = charge / 1000 * g_energy_coeff.supply_mv / 1000000;
+    stats->average_ua  = now_ms ? charge / now_ms : 0;
+
+    return ESP_OK;
+}
+
+void app_energy_dump(void)
+{
+    static const char *state_str[APP_ENERGY_STATE_MAX] = {"active", "DFS min", "light sleep", "radio on", "modem sleep"};
+    app_energy_stats_t stats = {0};
+
+    app_energy_get_stats(&stats);
+
+    for (int i = 0; i < APP_ENERGY_STATE_MAX; i++) {
+        ESP_LOGI(TAG, "%-12s %llu ms (%llu%%)%s", state_str[i], stats.time_ms[i],
+                 stats.uptime_ms ? stats.time_ms[i] * 100 / stats.uptime_ms : 0,
+                 (i <= APP_ENERGY_STATE_LIGHT_SLEEP && !stats.cpu_measured) ? ", not measured without CONFIG_PM_PROFILING" : "");
+    }
+
+    ESP_LOGI(TAG, "LED duty: %llu, %llu, %llu, %llu, %llu ms (red, green, blue, warm, cold)",
+             stats.duty_ms[0], stats.duty_ms[1], stats.duty_ms[2], stats.duty_ms[3], stats.duty_ms[4]);
+    ESP_LOGI(TAG, "Estimated: %llu mJ, %llu uAh, average %u uA", stats.energy_mj, stats.charge_uah, stats.average_ua);
+}
@@ -32,8 +32,14 @@
 
 #include "app_wifi.h"
 #include "app_storage.h"
+#include "app_param.h"
+#include "app_reporter.h"
 #include "app_priv.h"
+#include "light_driver.h"
 #include "app_insights.h"
+#ifdef CONFIG_DIAG_ENABLE_METRICS
+#include "esp_diagnostics_metrics.h"
+#endif
 
 static const char *TAG = "rainmaker_insight";
 
@@ -41,37 +47,115 @@ esp_rmaker_device_t *light_device;
 
 extern const char ota_server_cert[] asm("_binary_server_crt_start");
 
-/* Callback to handle commands received from the RainMaker cloud */
-static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-            const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+/* Parameters of the light, commands received from the RainMaker cloud are dispatched
+ * to their handler by app_param_write_cb(), the power param is created with the device.
+ * The handlers only stage the values, the parameters written together are applied
+ * by app_light_commit() as a single change of the light.
+ */
+static const app_param_desc_t light_params[] = {
+    APP_PARAM_BOOL(ESP_RMAKER_DEF_POWER_NAME, NULL, DEFAULT_POWER, app_light_stage_power),
+    APP_PARAM_INT(ESP_RMAKER_DEF_BRIGHTNESS_NAME, esp_rmaker_brightness_param_create, DEFAULT_BRIGHTNESS, app_light_stage_brightness),
+    APP_PARAM_INT(ESP_RMAKER_DEF_HUE_NAME, esp_rmaker_hue_param_create, DEFAULT_HUE, app_light_stage_hue),
+    APP_PARAM_INT(ESP_RMAKER_DEF_SATURATION_NAME, esp_rmaker_saturation_param_create, DEFAULT_SATURATION, app_light_stage_saturation),
+};
+
+#ifdef CONFIG_DIAG_ENABLE_METRICS
+#define WIFI_METRICS_TAG "wifi"
+
+/* Report the reconnection counters of app_wifi to Insights when they changed */
+static void wifi_metrics_report(void)
 {
-    if (ctx) {
-        ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
+    static bool registered = false;
+    static uint32_t last_disconnects = UINT32_MAX;
+    app_wifi_stats_t stats;
+
+    if (!registered) {
+        esp_diag_metrics_register(WIFI_METRICS_TAG, "disconnects", "Wi-Fi disconnections", "wifi", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(WIFI_METRICS_TAG, "reconnects", "Wi-Fi reconnection attempts", "wifi", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(WIFI_METRICS_TAG, "auth_fail", "Wi-Fi authentication failures", "wifi", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(WIFI_METRICS_TAG, "no_ap", "Wi-Fi AP not found", "wifi", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(WIFI_METRICS_TAG, "max_backoff", "Wi-Fi largest reconnection delay (ms)", "wifi", ESP_DIAG_DATA_TYPE_UINT);
+        registered = true;
     }
-    const char *device_name = esp_rmaker_device_get_name(device);
-    const char *param_name = esp_rmaker_param_get_name(param);
-    if (strcmp(param_name, ESP_RMAKER_DEF_POWER_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %s for %s - %s",
-                val.val.b? "true" : "false", device_name, param_name);
-        app_light_set_power(val.val.b);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_BRIGHTNESS_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_brightness(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_HUE_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_hue(val.val.i);
-    } else if (strcmp(param_name, ESP_RMAKER_DEF_SATURATION_NAME) == 0) {
-        ESP_LOGI(TAG, "Received value = %d for %s - %s",
-                val.val.i, device_name, param_name);
-        app_light_set_saturation(val.val.i);
-    } else {
-        /* Silently ignoring invalid params */
-        return ESP_OK;
+
+    if (app_wifi_get_stats(&stats) != ESP_OK || stats.disconnects == last_disconnects) {
+        return;
     }
-    esp_rmaker_param_update_and_report(param, val);
-    return ESP_OK;
+
+    last_disconnects = stats.disconnects;
+    esp_diag_metrics_add_uint("disconnects", stats.disconnects);
+    esp_diag_metrics_add_uint("reconnects", stats.reconnect_attempts);
+    esp_diag_metrics_add_uint("auth_fail", stats.auth_failures);
+    esp_diag_metrics_add_uint("no_ap", stats.ap_not_found);
+    esp_diag_metrics_add_uint("max_backoff", stats.max_backoff_ms);
+}
+
+#define ENERGY_METRICS_TAG "energy"
+
+/* Report the residency and the estimated energy of app_energy to Insights */
+static void energy_metrics_report(void)
+{
+    static bool registered = false;
+    app_energy_stats_t stats;
+
+    if (!registered) {
+        esp_diag_metrics_register(ENERGY_METRICS_TAG, "energy", "Estimated energy since boot (mJ)", "energy", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(ENERGY_METRICS_TAG, "avg_current", "Estimated average current (uA)", "energy", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(ENERGY_METRICS_TAG, "light_sleep", "Time in light sleep (%)", "energy", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(ENERGY_METRICS_TAG, "modem_sleep", "Time in modem sleep (%)", "energy", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(ENERGY_METRICS_TAG, "led_duty", "LED time at full duty, all channels (s)", "energy", ESP_DIAG_DATA_TYPE_UINT);
+        registered = true;
+    }
+
+    if (app_energy_get_stats(&stats) != ESP_OK || !stats.uptime_ms) {
+        return;
+    }
+
+    uint64_t led_duty_ms = 0;
+
+    for (int i = 0; i < LIGHT_DRIVER_CHANNEL_NUM; i++) {
+        led_duty_ms += stats.duty_ms[i];
+    }
+
+    esp_diag_metrics_add_uint("energy", stats.energy_mj);
+    esp_diag_metrics_add_uint("avg_current", stats.average_ua);
+    esp_diag_metrics_add_uint("light_sleep", stats.time_ms[APP_ENERGY_STATE_LIGHT_SLEEP] * 100 / stats.uptime_ms);
+    esp_diag_metrics_add_uint("modem_sleep", stats.time_ms[APP_ENERGY_STATE_MODEM_SLEEP] * 100 / stats.uptime_ms);
+    esp_diag_metrics_add_uint("led_duty", led_duty_ms / 1000);
+}
+
+#define REPORTER_METRICS_TAG "reporter"
+
+/* Report the counters of app_reporter to Insights when they changed */
+static void reporter_metrics_report(void)
+{
+    static bool registered = false;
+    static uint32_t last_updates = UINT32_MAX;
+    app_reporter_stats_t stats;
+
+    if (!registered) {
+        esp_diag_metrics_register(REPORTER_METRICS_TAG, "param_sent", "Parameter values reported", "reporter", ESP_DIAG_DATA_TYPE_UINT);
+        esp_diag_metrics_register(REPORTER_METRICS_TAG, "param_suppressed", "Parameter values coalesced", "reporter", ESP_DIAG_DATA_TYPE_UINT);
+        registered = true;
+    }
+
+    if (app_reporter_get_stats(&stats) != ESP_OK || stats.updates == last_updates) {
+        return;
+    }
+
+    last_updates = stats.updates;
+    esp_diag_metrics_add_uint("param_sent", stats.sent);
+    esp_diag_metrics_add_uint("param_suppressed", stats.suppressed);
+}
+#endif /* CONFIG_DIAG_ENABLE_METRICS */
+
+#define WIFI_CONNECT_WAIT_MS    10000
+
+static void wifi_state_cb(app_wifi_state_t state, void *arg)
+{
+    static const char *state_str[] = {"provisioning", "provisioned", "connected", "disconnected"};
+
+    ESP_LOGI(TAG, "Wi-Fi %s", state_str[state]);
 }
 
 void app_main()
@@ -116,13 +200,14 @@ void app_main()
         abort();
     }
 
+    /* Coalesce the reports of the local changes, e.g. the brightness ramp of the button */
+    ESP_ERROR_CHECK(app_reporter_init(NULL));
+
     /* Create a device and add the relevant parameters to it */
     light_device = esp_rmaker_lightbulb_device_create("Light", NULL, DEFAULT_POWER);
-    esp_rmaker_device_add_cb(light_device, write_cb, NULL);
-
-    esp_rmaker_device_add_param(light_device, esp_rmaker_brightness_param_create(ESP_RMAKER_DEF_BRIGHTNESS_NAME, DEFAULT_BRIGHTNESS));
-    esp_rmaker_device_add_param(light_device, esp_rmaker_hue_param_create(ESP_RMAKER_DEF_HUE_NAME, DEFAULT_HUE));
-    esp_rmaker_device_add_param(light_device, esp_rmaker_saturation_param_create(ESP_RMAKER_DEF_SATURATION_NAME, DEFAULT_SATURATION));
+    esp_rmaker_device_add_cb(light_device, app_param_write_cb, NULL);
+    ESP_ERROR_CHECK(app_param_add_table(light_device, light_params, sizeof(light_params) / sizeof(light_params[0]), NULL));
+    ESP_ERROR_CHECK(app_param_set_commit_cb(app_light_commit, NULL));
 
     esp_rmaker_node_add_device(node, light_device);
 
@@ -150,18 +235,43 @@ void app_main()
 
     /* Start the Wi-Fi.
      * If the node is provisioned, it will start connection attempts,
-     * else, it will start Wi-Fi provisioning. The function will return
-     * after a connection has been successfully established
+     * else, it will start Wi-Fi provisioning. The function returns at once,
+     * the connection states are reported through wifi_state_cb()
      */
-    err = app_wifi_start(POP_TYPE_RANDOM);
+    app_wifi_async_config_t wifi_async_config = {
+        .state_cb = wifi_state_cb,
+    };
+    err = app_wifi_start_async(POP_TYPE_RANDOM, &wifi_async_config);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Could not start Wifi. Aborting!!!");
         vTaskDelay(pdMS_TO_TICKS(5000));
         abort();
     }
 
+    /* Local control does not need the network, only wait a while for the connection */
+    if (app_wifi_wait_connected(pdMS_TO_TICKS(WIFI_CONNECT_WAIT_MS)) != ESP_OK) {
+        ESP_LOGW(TAG, "Wi-Fi not connected yet, going on without it");
+    }
+
     while (1) {
-        ESP_LOGI(TAG, "[%02d] Hello world!", i++);
+        ESP_LOGI(TAG, "[%02d] Hello world!", i);
+
+        if (i++ % 12 == 0) {
+#ifdef CONFIG_APP_STATS_LOG
+            app_pm_dump_profiles();
+            app_pm_dump_clients();
+            iot_led_dump_power_stats();
+            app_energy_dump();
+            app_reporter_dump();
+#endif
+#ifdef CONFIG_DIAG_ENABLE_METRICS
+            energy_metrics_report();
+            reporter_metrics_report();
+#endif
+        }
+#ifdef CONFIG_DIAG_ENABLE_METRICS
+        wifi_metrics_report();
+#endif
         vTaskDelay(pdMS_TO_TICKS(5000));
     }
 }
@@ -15,11 +15,43 @@
 #ifndef __APP_PRIVATE_H__
 #define __APP_PRIVATE_H__
 
+#include "light_driver.h"
+
 #define DEFAULT_POWER       true
 #define DEFAULT_HUE         180
 #define DEFAULT_SATURATION  100
 #define DEFAULT_BRIGHTNESS  25
 
+/**
+ * @brief Power profiles, each one sets the modem sleep, the CPU frequencies and light sleep together
+ */
+typedef enum {
+    APP_PM_PROFILE_RESPONSIVE,  /**< no modem sleep, 80 - 160 MHz, no light sleep */
+    APP_PM_PROFILE_BALANCED,    /**< modem sleep at each DTIM, DFS and light sleep */
+    APP_PM_PROFILE_MINIMUM,     /**< modem sleep every 10 beacons, DFS and light sleep */
+    APP_PM_PROFILE_MAX,
+} app_pm_profile_t;
+
+/**
+ * @brief Locks held by the clients of app_pm
+ */
+typedef enum {
+    APP_PM_LOCK_APB_FREQ_MAX,   /**< APB frequency at its maximum, e.g. LEDC on the APB clock */
+    APP_PM_LOCK_CPU_FREQ_MAX,   /**< CPU frequency at its maximum */
+    APP_PM_LOCK_NO_LIGHT_SLEEP, /**< no automatic light sleep */
+    APP_PM_LOCK_TYPE_MAX,
+} app_pm_lock_type_t;
+
+typedef struct app_pm_client *app_pm_client_handle_t;
+
+/**
+ * @brief Measurements of a power profile since boot
+ */
+typedef struct {
+    uint64_t time_ms;           /**< time spent in the profile */
+    uint32_t wakeups;           /**< wake-ups of the CPU from idle */
+} app_pm_profile_stats_t;
+
 /**
  * @brief 
  * 
@@ -84,6 +116,30 @@ esp_err_t app_light_set_hue(uint16_t hue);
  */
 esp_err_t app_light_set_saturation(uint16_t saturation);
 
+/**
+ * @brief Stage a part of the light state, nothing changes until app_light_commit()
+ *
+ * @note  Handlers of the RainMaker parameters, a value out of range is rejected at once
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t app_light_stage_power(bool power);
+esp_err_t app_light_stage_brightness(int brightness);
+esp_err_t app_light_stage_hue(int hue);
+esp_err_t app_light_stage_saturation(int saturation);
+
+/**
+ * @brief Apply the staged state with a single transaction of the light driver,
+ *        one fade and one write to the flash whatever the number of staged values
+ *
+ * @param arg Unused, commit callback of app_param
+ *
+ * @return esp_err_t
+ */
+esp_err_t app_light_commit(void *arg);
+
 /**
  * @brief 
  * 
@@ -92,17 +148,119 @@ esp_err_t app_light_set_saturation(uint16_t saturation);
 esp_err_t app_pm_init();
 
 /**
- * @brief 
- * 
- * @return esp_err_t 
+ * @brief Switch the power profile, can be called at any time
+ *
+ * @param profile
+ * @return esp_err_t
  */
-esp_err_t app_pm_lock_acquire();
+esp_err_t app_pm_set_profile(app_pm_profile_t profile);
 
 /**
- * @brief 
- * 
- * @return esp_err_t 
+ * @brief
+ *
+ * @return app_pm_profile_t
+ */
+app_pm_profile_t app_pm_get_profile(void);
+
+/**
+ * @brief Get the time and the wake-ups counted in a profile
+ *
+ * @param profile
+ * @param stats
+ * @return esp_err_t
+ */
+esp_err_t app_pm_get_profile_stats(app_pm_profile_t profile, app_pm_profile_stats_t *stats);
+
+/**
+ * @brief Log the measurements of all the profiles
+ */
+void app_pm_dump_profiles(void);
+
+/**
+ * @brief Register a named client of a PM lock, the acquisitions of the clients
+ *        are independent: a release only undoes the acquisitions of its client
+ *
+ * @param name Name shown by app_pm_dump_clients(), must stay valid
+ * @param type
+ * @return app_pm_client_handle_t, NULL if the registry is full or PM is disabled
+ */
+app_pm_client_handle_t app_pm_client_register(const char *name, app_pm_lock_type_t type);
+
+/**
+ * @brief Acquire the lock of a client, acquisitions nest. Can be called from an ISR
+ *
+ * @param client
+ * @return esp_err_t
+ */
+esp_err_t app_pm_client_acquire(app_pm_client_handle_t client);
+
+/**
+ * @brief Release one acquisition of a client. Can be called from an ISR
+ *
+ * @param client
+ * @return esp_err_t ESP_ERR_INVALID_STATE if the client holds nothing
+ */
+esp_err_t app_pm_client_release(app_pm_client_handle_t client);
+
+/**
+ * @brief Log the clients with the time they held their lock, to find what keeps the chip awake
+ */
+void app_pm_dump_clients(void);
+
+/**
+ * @brief States accounted by app_energy, the CPU is in one of the first three
+ *        and the radio in one of the last two at any time
+ */
+typedef enum {
+    APP_ENERGY_STATE_ACTIVE,        /**< CPU_MAX and APB_MAX modes */
+    APP_ENERGY_STATE_DFS_MIN,       /**< APB_MIN mode */
+    APP_ENERGY_STATE_LIGHT_SLEEP,
+    APP_ENERGY_STATE_RADIO_ON,      /**< responsive power profile */
+    APP_ENERGY_STATE_MODEM_SLEEP,   /**< balanced and minimum power profiles */
+    APP_ENERGY_STATE_MAX,
+} app_energy_state_t;
+
+/**
+ * @brief Coefficients of the energy estimation, set from sdkconfig by default
+ */
+typedef struct {
+    uint32_t state_ua[APP_ENERGY_STATE_MAX];            /**< current in each state */
+    uint32_t led_full_ua[LIGHT_DRIVER_CHANNEL_NUM];     /**< current of each channel at full duty */
+    uint32_t supply_mv;
+} app_energy_coeff_t;
+
+/**
+ * @brief Residency and energy since boot
+ */
+typedef struct {
+    uint64_t uptime_ms;
+    uint64_t time_ms[APP_ENERGY_STATE_MAX];             /**< time in each state */
+    uint64_t duty_ms[LIGHT_DRIVER_CHANNEL_NUM];         /**< time at full duty of each channel */
+    bool cpu_measured;                                  /**< false without CONFIG_PM_PROFILING, all the time is active */
+    uint64_t energy_mj;
+    uint64_t charge_uah;
+    uint32_t average_ua;
+} app_energy_stats_t;
+
+/**
+ * @brief Replace the coefficients of the energy estimation
+ *
+ * @param coeff
+ * @return esp_err_t
+ */
+esp_err_t app_energy_set_coeff(const app_energy_coeff_t *coeff);
+
+/**
+ * @brief Get the time in each state, the LED duty and the estimated energy since boot
+ *
+ * @param stats
+ * @return esp_err_t
+ */
+esp_err_t app_energy_get_stats(app_energy_stats_t *stats);
+
+/**
+ * @brief Log the residency and the estimated energy
  */
-esp_err_t app_pm_lock_release();
+void app_energy_dump(void);
 
 #endif /**< __APP_PRIVATE_H__ */
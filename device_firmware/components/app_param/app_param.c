@@ -0,0 +1,377 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "string.h"
+#include "stdlib.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rmaker_core.h"
+#include "esp_rmaker_work_queue.h"
+
+#include "app_param.h"
+
+static const char *TAG = "app_param";
+
+#define APP_PARAM_MAX           CONFIG_APP_PARAM_MAX
+
+/**< Open addressing on the address of the parameter, at most half full */
+#define APP_PARAM_HASH_BITS     (APP_PARAM_MAX <= 8 ? 4 : APP_PARAM_MAX <= 32 ? 6 : APP_PARAM_MAX <= 128 ? 8 : 9)
+#define APP_PARAM_HASH_SIZE     (1 << APP_PARAM_HASH_BITS)
+
+typedef struct {
+    esp_rmaker_param_t *param;
+    const app_param_desc_t *desc;
+    esp_rmaker_param_val_t pending_val;     /**< value to report after the commit, strings are copied */
+    bool pending;
+} app_param_binding_t;
+
+static app_param_binding_t g_param_bindings[APP_PARAM_MAX];
+static uint8_t g_param_hash[APP_PARAM_HASH_SIZE];   /**< identifier + 1, 0 for a free slot */
+static size_t g_param_count = 0;
+
+/**
+ * @brief Parameters written together, committed once the writes stop
+ */
+static struct {
+    app_param_commit_cb_t commit_cb;
+    void *arg;
+    SemaphoreHandle_t mutex;
+    esp_timer_handle_t timer;
+    int src;                                /**< source of the writes, -1 without write context */
+    size_t count;
+    app_param_id_t ids[APP_PARAM_MAX];      /**< in the order of the first write */
+} g_param_batch;
+
+static inline uint32_t app_param_hash(const esp_rmaker_param_t *param)
+{
+    return ((uint32_t)((uintptr_t)param >> 2) * 2654435761U) >> (32 - APP_PARAM_HASH_BITS);
+}
+
+app_param_id_t app_param_find(const esp_rmaker_param_t *param)
+{
+    for (uint32_t i = app_param_hash(param);; i = (i + 1) & (APP_PARAM_HASH_SIZE - 1)) {
+        uint8_t slot = g_param_hash[i];
+
+        if (!slot) {
+            return APP_PARAM_ID_INVALID;
+        }
+
+        if (g_param_bindings[slot - 1].param == param) {
+            return slot - 1;
+        }
+    }
+}
+
+esp_rmaker_param_t *app_param_get(app_param_id_t id)
+{
+    return id < g_param_count ? g_param_bindings[id].param : NULL;
+}
+
+static esp_rmaker_param_t *app_param_create(esp_rmaker_device_t *device, const app_param_desc_t *desc)
+{
+    /**< Created along with the device */
+    if (!desc->create.b) {
+        return esp_rmaker_device_get_param_by_name(device, desc->name);
+    }
+
+    esp_rmaker_param_t *param = NULL;
+
+    switch (desc->type) {
+        case APP_PARAM_TYPE_BOOL:
+            param = desc->create.b(desc->name, desc->def.b);
+            break;
+
+        case APP_PARAM_TYPE_INT:
+            param = desc->create.i(desc->name, desc->def.i);
+            break;
+
+        case APP_PARAM_TYPE_FLOAT:
+            param = desc->create.f(desc->name, desc->def.f);
+            break;
+
+        case APP_PARAM_TYPE_STRING:
+            param = desc->create.s(desc->name, desc->def.s);
+            break;
+    }
+
+    if (param && esp_rmaker_device_add_param(device, param) != ESP_OK) {
+        esp_rmaker_param_delete(param);
+        return NULL;
+    }
+
+    return param;
+}
+
+esp_err_t app_param_add_table(esp_rmaker_device_t *device, const app_param_desc_t *table,
+                              size_t count, app_param_id_t *base)
+{
+    if (!device || !table) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (g_param_count + count > APP_PARAM_MAX) {
+        ESP_LOGE(TAG, "%d parameters bound, %d more exceed CONFIG_APP_PARAM_MAX", (int)g_param_count, (int)count);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (base) {
+        *base = g_param_count;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        esp_rmaker_param_t *param = app_param_create(device, &table[i]);
+
+        if (!param) {
+            ESP_LOGE(TAG, "Parameter %s %s", table[i].name, table[i].create.b ? "create failed" : "not found");
+            return table[i].create.b ? ESP_FAIL : ESP_ERR_NOT_FOUND;
+        }
+
+        if (app_param_find(param) != APP_PARAM_ID_INVALID) {
+            ESP_LOGE(TAG, "Parameter %s already bound", table[i].name);
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        uint32_t slot = app_param_hash(param);
+
+        while (g_param_hash[slot]) {
+            slot = (slot + 1) & (APP_PARAM_HASH_SIZE - 1);
+        }
+
+        g_param_bindings[g_param_count].param = param;
+        g_param_bindings[g_param_count].desc  = &table[i];
+        g_param_hash[slot] = ++g_param_count;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t app_param_dispatch(const app_param_desc_t *desc, const esp_rmaker_param_val_t val)
+{
+    esp_err_t ret = ESP_OK;
+
+    switch (desc->type) {
+        case APP_PARAM_TYPE_BOOL:
+            ESP_LOGI(TAG, "Received value = %s for %s", val.val.b ? "true" : "false", desc->name);
+            ret = desc->handler.b ? desc->handler.b(val.val.b) : ESP_OK;
+            break;
+
+        case APP_PARAM_TYPE_INT:
+            ESP_LOGI(TAG, "Received value = %d for %s", val.val.i, desc->name);
+            ret = desc->handler.i ? desc->handler.i(val.val.i) : ESP_OK;
+            break;
+
+        case APP_PARAM_TYPE_FLOAT:
+            ESP_LOGI(TAG, "Received value = %f for %s", val.val.f, desc->name);
+            ret = desc->handler.f ? desc->handler.f(val.val.f) : ESP_OK;
+            break;
+
+        case APP_PARAM_TYPE_STRING:
+            ESP_LOGI(TAG, "Received value = %s for %s", val.val.s ? val.val.s : "", desc->name);
+            ret = desc->handler.s ? desc->handler.s(val.val.s) : ESP_OK;
+            break;
+    }
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Handler of %s, err: %s", desc->name, esp_err_to_name(ret));
+    }
+
+    return ret;
+}
+
+static void app_param_unstage(app_param_binding_t *binding)
+{
+    if (binding->pending_val.type == RMAKER_VAL_TYPE_STRING) {
+        free(binding->pending_val.val.s);
+    }
+
+    binding->pending = false;
+}
+
+/**
+ * @brief Keep the value to report after the commit, the last write of a parameter wins
+ */
+static esp_err_t app_param_stage(app_param_id_t id, const esp_rmaker_param_val_t val)
+{
+    app_param_binding_t *binding = &g_param_bindings[id];
+    esp_rmaker_param_val_t pending_val = val;
+
+    if (val.type == RMAKER_VAL_TYPE_STRING && val.val.s) {
+        pending_val.val.s = strdup(val.val.s);
+
+        if (!pending_val.val.s) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (binding->pending) {
+        app_param_unstage(binding);
+    } else {
+        g_param_batch.ids[g_param_batch.count++] = id;
+    }
+
+    binding->pending_val = pending_val;
+    binding->pending = true;
+
+    return ESP_OK;
+}
+
+static esp_err_t app_param_commit_locked(void)
+{
+    if (!g_param_batch.count) {
+        return ESP_OK;
+    }
+
+    esp_timer_stop(g_param_batch.timer);
+
+    /**< Staged while the callback was being removed */
+    esp_err_t ret = g_param_batch.commit_cb ? g_param_batch.commit_cb(g_param_batch.arg) : ESP_OK;
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Commit of %d parameters, err: %s", (int)g_param_batch.count, esp_err_to_name(ret));
+    }
+
+    /**< The parameters are updated first, the last update reports all of them in a single message */
+    for (size_t i = 0; i < g_param_batch.count; i++) {
+        app_param_binding_t *binding = &g_param_bindings[g_param_batch.ids[i]];
+
+        if (ret == ESP_OK && i + 1 < g_param_batch.count) {
+            esp_rmaker_param_update(binding->param, binding->pending_val);
+        } else if (ret == ESP_OK) {
+            esp_rmaker_param_update_and_report(binding->param, binding->pending_val);
+        }
+
+        app_param_unstage(binding);
+    }
+
+    g_param_batch.count = 0;
+
+    return ret;
+}
+
+esp_err_t app_param_commit(void)
+{
+    if (!g_param_batch.mutex) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(g_param_batch.mutex, portMAX_DELAY);
+    esp_err_t ret = app_param_commit_locked();
+    xSemaphoreGive(g_param_batch.mutex);
+
+    return ret;
+}
+
+static void app_param_commit_work(void *priv_data)
+{
+    app_param_commit();
+}
+
+static void app_param_batch_timer_cb(void *arg)
+{
+    /**< Not from the timer task, the commit may write the flash and report to the cloud */
+    esp_rmaker_work_queue_add_task(app_param_commit_work, NULL);
+}
+
+esp_err_t app_param_set_commit_cb(app_param_commit_cb_t commit_cb, void *arg)
+{
+    if (!g_param_batch.mutex) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = app_param_batch_timer_cb,
+            .name     = "app_param",
+        };
+
+        g_param_batch.mutex = xSemaphoreCreateMutex();
+
+        if (!g_param_batch.mutex || esp_timer_create(&timer_args, &g_param_batch.timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Batch of parameters create failed");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(g_param_batch.mutex, portMAX_DELAY);
+
+    if (g_param_batch.commit_cb) {
+        app_param_commit_locked();
+    }
+
+    g_param_batch.commit_cb = commit_cb;
+    g_param_batch.arg       = arg;
+    xSemaphoreGive(g_param_batch.mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t app_param_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+                             const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+{
+    static const esp_rmaker_val_type_t val_types[] = {
+        [APP_PARAM_TYPE_BOOL]   = RMAKER_VAL_TYPE_BOOLEAN,
+        [APP_PARAM_TYPE_INT]    = RMAKER_VAL_TYPE_INTEGER,
+        [APP_PARAM_TYPE_FLOAT]  = RMAKER_VAL_TYPE_FLOAT,
+        [APP_PARAM_TYPE_STRING] = RMAKER_VAL_TYPE_STRING,
+    };
+
+    app_param_id_t id = app_param_find(param);
+
+    /* Silently ignoring invalid params */
+    if (id == APP_PARAM_ID_INVALID) {
+        return ESP_OK;
+    }
+
+    const app_param_desc_t *desc = g_param_bindings[id].desc;
+    esp_err_t ret = ESP_OK;
+
+    if (val.type != val_types[desc->type]) {
+        ESP_LOGW(TAG, "Received value of type %d for %s", val.type, desc->name);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (ctx) {
+        ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
+    }
+
+    if (!g_param_batch.commit_cb) {
+        ret = app_param_dispatch(desc, val);
+        return ret == ESP_OK ? esp_rmaker_param_update_and_report(param, val) : ret;
+    }
+
+    int src = ctx ? (int)ctx->src : -1;
+
+    xSemaphoreTake(g_param_batch.mutex, portMAX_DELAY);
+
+    /**< A request from another source starts its own batch */
+    if (g_param_batch.count && src != g_param_batch.src) {
+        app_param_commit_locked();
+    }
+
+    ret = app_param_dispatch(desc, val);
+
+    if (ret == ESP_OK) {
+        ret = app_param_stage(id, val);
+    }
+
+    if (ret == ESP_OK) {
+        g_param_batch.src = src;
+        esp_timer_stop(g_param_batch.timer);
+        esp_timer_start_once(g_param_batch.timer, CONFIG_APP_PARAM_BATCH_WINDOW_MS * 1000);
+    }
+
+    xSemaphoreGive(g_param_batch.mutex);
+
+    return ret;
+}
@@ -0,0 +1,160 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <esp_rmaker_core.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Identifier of a bound parameter, the index of its descriptor in the
+ *        table plus the base returned by app_param_add_table()
+ */
+typedef uint8_t app_param_id_t;
+
+#define APP_PARAM_ID_INVALID    UINT8_MAX
+
+typedef enum {
+    APP_PARAM_TYPE_BOOL,
+    APP_PARAM_TYPE_INT,
+    APP_PARAM_TYPE_FLOAT,
+    APP_PARAM_TYPE_STRING,
+} app_param_type_t;
+
+/**
+ * @brief Declaration of one parameter, how it is created and how its writes are handled
+ *
+ * @note  With a NULL create function, the parameter is looked up by name on the
+ *        device, e.g. the power parameter created by esp_rmaker_lightbulb_device_create()
+ */
+typedef struct {
+    const char *name;
+    app_param_type_t type;
+    union {
+        esp_rmaker_param_t *(*b)(const char *name, bool value);
+        esp_rmaker_param_t *(*i)(const char *name, int value);
+        esp_rmaker_param_t *(*f)(const char *name, float value);
+        esp_rmaker_param_t *(*s)(const char *name, const char *value);
+    } create;
+    union {
+        bool b;
+        int i;
+        float f;
+        const char *s;
+    } def;                      /**< initial value given to create */
+    union {
+        esp_err_t (*b)(bool value);
+        esp_err_t (*i)(int value);
+        esp_err_t (*f)(float value);
+        esp_err_t (*s)(const char *value);
+    } handler;                  /**< NULL to accept writes without any action */
+} app_param_desc_t;
+
+#define APP_PARAM_BOOL(_name, _create, _def, _handler) \
+    { .name = _name, .type = APP_PARAM_TYPE_BOOL, .create.b = _create, .def.b = _def, .handler.b = _handler }
+#define APP_PARAM_INT(_name, _create, _def, _handler) \
+    { .name = _name, .type = APP_PARAM_TYPE_INT, .create.i = _create, .def.i = _def, .handler.i = _handler }
+#define APP_PARAM_FLOAT(_name, _create, _def, _handler) \
+    { .name = _name, .type = APP_PARAM_TYPE_FLOAT, .create.f = _create, .def.f = _def, .handler.f = _handler }
+#define APP_PARAM_STRING(_name, _create, _def, _handler) \
+    { .name = _name, .type = APP_PARAM_TYPE_STRING, .create.s = _create, .def.s = _def, .handler.s = _handler }
+
+/**
+ * @brief  Create the parameters of a table, add them to the device and bind them to their handlers
+ *
+ * The string comparisons are all done here, writes are then dispatched by
+ * app_param_write_cb() on the address of the parameter.
+ *
+ * @param  device Device the parameters are added to
+ * @param  table  Descriptors, must stay valid as long as the device exists
+ * @param  count  Number of descriptors
+ * @param  base   Identifier of the first descriptor, the others follow in order. May be NULL
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NO_MEM      More than CONFIG_APP_PARAM_MAX parameters
+ *     - ESP_ERR_NOT_FOUND   A parameter without create function is not on the device
+ *     - ESP_ERR_INVALID_STATE  A parameter is already bound
+ *     - ESP_FAIL            Parameter creation failed
+ */
+esp_err_t app_param_add_table(esp_rmaker_device_t *device, const app_param_desc_t *table,
+                              size_t count, app_param_id_t *base);
+
+/**
+ * @brief  Write callback of RainMaker dispatching to the handlers of the bound parameters
+ *
+ * Register with esp_rmaker_device_add_cb(device, app_param_write_cb, NULL). The
+ * new value is reported when the handler returns ESP_OK, or after the commit of
+ * the batch with app_param_set_commit_cb(). Writes to parameters without binding
+ * are ignored.
+ */
+esp_err_t app_param_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+                             const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx);
+
+/**
+ * @brief  Callback applying the values staged by the handlers of a batch
+ *
+ * @return ESP_OK to report the values of the batch, any other value drops them
+ */
+typedef esp_err_t (*app_param_commit_cb_t)(void *arg);
+
+/**
+ * @brief  Gather the parameters written together and commit them at once
+ *
+ * The handlers are still called at each write but should only stage the new
+ * value. Once no write came for CONFIG_APP_PARAM_BATCH_WINDOW_MS, or when a
+ * write comes from another source, commit_cb is called from the RainMaker work
+ * queue and the values of the batch are reported one after the other.
+ *
+ * @param  commit_cb Applies the staged values, NULL to go back to handling each write alone
+ * @param  arg       User data passed to commit_cb
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NO_MEM
+ */
+esp_err_t app_param_set_commit_cb(app_param_commit_cb_t commit_cb, void *arg);
+
+/**
+ * @brief  Commit the pending batch now, without waiting for the end of the batch window
+ *
+ * @return
+ *     - ESP_OK  Nothing pending, or committed and reported
+ *     - Others  Error of the commit callback, the batch is dropped
+ */
+esp_err_t app_param_commit(void);
+
+/**
+ * @brief  Identifier of a bound parameter, in constant time
+ *
+ * @return APP_PARAM_ID_INVALID if the parameter is not bound
+ */
+app_param_id_t app_param_find(const esp_rmaker_param_t *param);
+
+/**
+ * @brief  Parameter bound with the identifier, NULL if none
+ */
+esp_rmaker_param_t *app_param_get(app_param_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
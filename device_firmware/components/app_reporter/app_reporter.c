@@ -0,0 +1,244 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "string.h"
+#include "stdlib.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rmaker_core.h"
+#include "esp_rmaker_work_queue.h"
+
+#include "app_reporter.h"
+
+static const char *TAG = "app_reporter";
+
+#define APP_REPORTER_PARAM_MAX  CONFIG_APP_REPORTER_PARAM_MAX
+
+typedef struct {
+    const esp_rmaker_param_t *param;
+    esp_rmaker_param_val_t val;     /**< last value, strings are copied */
+    bool dirty;
+} app_reporter_entry_t;
+
+static struct {
+    SemaphoreHandle_t mutex;
+    esp_timer_handle_t timer;
+    int64_t interval_us;
+    int64_t idle_us;
+    int64_t last_report_us;
+    app_reporter_entry_t entries[APP_REPORTER_PARAM_MAX];
+    size_t count;
+    app_reporter_stats_t stats;
+} g_reporter;
+
+static void app_reporter_val_free(esp_rmaker_param_val_t *val)
+{
+    if (val->type == RMAKER_VAL_TYPE_STRING) {
+        free(val->val.s);
+        val->val.s = NULL;
+    }
+}
+
+static void app_reporter_report_work(void *priv_data)
+{
+    esp_rmaker_param_val_t vals[APP_REPORTER_PARAM_MAX];
+    const esp_rmaker_param_t *params[APP_REPORTER_PARAM_MAX];
+    size_t count = 0;
+    esp_err_t ret = ESP_OK;
+
+    /**< Taken out of the table, the updates go on during the reports */
+    xSemaphoreTake(g_reporter.mutex, portMAX_DELAY);
+
+    for (size_t i = 0; i < g_reporter.count; i++) {
+        app_reporter_entry_t *entry = &g_reporter.entries[i];
+
+        if (entry->dirty) {
+            params[count] = entry->param;
+            vals[count++] = entry->val;
+            entry->val.val.s = NULL;
+            entry->dirty = false;
+        }
+    }
+
+    if (!count) {
+        xSemaphoreGive(g_reporter.mutex);
+        return;
+    }
+
+    g_reporter.last_report_us = esp_timer_get_time();
+    xSemaphoreGive(g_reporter.mutex);
+
+    /**< The values are updated first, the last update reports all of them in a single message */
+    for (size_t i = 0; i < count; i++) {
+        if (ret == ESP_OK) {
+            ret = (i + 1 < count) ? esp_rmaker_param_update(params[i], vals[i])
+                  : esp_rmaker_param_update_and_report(params[i], vals[i]);
+        }
+
+        app_reporter_val_free(&vals[i]);
+    }
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Report of %d values, err: %s", (int)count, esp_err_to_name(ret));
+        return;
+    }
+
+    xSemaphoreTake(g_reporter.mutex, portMAX_DELAY);
+    g_reporter.stats.sent += count;
+    g_reporter.stats.reports++;
+    xSemaphoreGive(g_reporter.mutex);
+}
+
+static void app_reporter_timer_cb(void *arg)
+{
+    if (esp_rmaker_work_queue_add_task(app_reporter_report_work, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "Report postponed, work queue full");
+    }
+}
+
+esp_err_t app_reporter_init(const app_reporter_config_t *config)
+{
+    if (g_reporter.mutex) {
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = app_reporter_timer_cb,
+        .name     = "app_reporter",
+    };
+
+    g_reporter.interval_us = (config && config->interval_ms ? config->interval_ms : CONFIG_APP_REPORTER_INTERVAL_MS) * 1000LL;
+    g_reporter.idle_us     = (config && config->idle_ms ? config->idle_ms : CONFIG_APP_REPORTER_IDLE_MS) * 1000LL;
+    g_reporter.last_report_us = -g_reporter.interval_us;
+
+    if (esp_timer_create(&timer_args, &g_reporter.timer) != ESP_OK) {
+        ESP_LOGE(TAG, "esp_timer_create failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_reporter.mutex = xSemaphoreCreateMutex();
+
+    if (!g_reporter.mutex) {
+        esp_timer_delete(g_reporter.timer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t app_reporter_update(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
+{
+    if (!param) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!g_reporter.mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (val.type == RMAKER_VAL_TYPE_STRING && val.val.s) {
+        val.val.s = strdup(val.val.s);
+
+        if (!val.val.s) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(g_reporter.mutex, portMAX_DELAY);
+
+    app_reporter_entry_t *entry = NULL;
+
+    for (size_t i = 0; i < g_reporter.count; i++) {
+        if (g_reporter.entries[i].param == param) {
+            entry = &g_reporter.entries[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        if (g_reporter.count >= APP_REPORTER_PARAM_MAX) {
+            xSemaphoreGive(g_reporter.mutex);
+            app_reporter_val_free(&val);
+            ESP_LOGE(TAG, "No free entry, CONFIG_APP_REPORTER_PARAM_MAX: %d", APP_REPORTER_PARAM_MAX);
+            return ESP_ERR_NO_MEM;
+        }
+
+        entry = &g_reporter.entries[g_reporter.count++];
+        entry->param = param;
+    }
+
+    if (entry->dirty) {
+        g_reporter.stats.suppressed++;
+    }
+
+    app_reporter_val_free(&entry->val);
+    entry->val = val;
+    entry->dirty = true;
+    g_reporter.stats.updates++;
+
+    /**< At the end of the interval, or earlier when no update comes for idle_us */
+    int64_t now = esp_timer_get_time();
+    int64_t delay_us = g_reporter.last_report_us + g_reporter.interval_us - now;
+
+    delay_us = (delay_us < 0) ? 0 : (delay_us > g_reporter.idle_us) ? g_reporter.idle_us : delay_us;
+
+    esp_timer_stop(g_reporter.timer);
+    esp_timer_start_once(g_reporter.timer, delay_us);
+
+    xSemaphoreGive(g_reporter.mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t app_reporter_flush(void)
+{
+    if (!g_reporter.mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_timer_stop(g_reporter.timer);
+
+    return esp_rmaker_work_queue_add_task(app_reporter_report_work, NULL);
+}
+
+esp_err_t app_reporter_get_stats(app_reporter_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!g_reporter.mutex) {
+        memset(stats, 0, sizeof(app_reporter_stats_t));
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(g_reporter.mutex, portMAX_DELAY);
+    *stats = g_reporter.stats;
+    xSemaphoreGive(g_reporter.mutex);
+
+    return ESP_OK;
+}
+
+void app_reporter_dump(void)
+{
+    app_reporter_stats_t stats;
+
+    app_reporter_get_stats(&stats);
+    ESP_LOGI(TAG, "updates: %u, sent: %u, suppressed: %u, reports: %u",
+             stats.updates, stats.sent, stats.suppressed, stats.reports);
+}
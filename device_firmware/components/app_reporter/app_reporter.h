@@ -0,0 +1,97 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_rmaker_core.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Reporter configuration, a zero field uses the Kconfig default
+ */
+typedef struct {
+    uint32_t interval_ms;   /**< minimum time between two reports, default CONFIG_APP_REPORTER_INTERVAL_MS */
+    uint32_t idle_ms;       /**< time without update reporting the pending values, default CONFIG_APP_REPORTER_IDLE_MS */
+} app_reporter_config_t;
+
+typedef struct {
+    uint32_t updates;       /**< values given to app_reporter_update() */
+    uint32_t sent;          /**< values reported to the cloud */
+    uint32_t suppressed;    /**< values replaced by a newer one before being reported */
+    uint32_t reports;       /**< messages published, each carrying all the pending values */
+} app_reporter_stats_t;
+
+/**
+ * @brief  Initialize the reporter
+ *
+ * @note   Call after esp_rmaker_node_init(), the reports are sent from the RainMaker work queue
+ *
+ * @param  config Configuration, NULL for the defaults
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NO_MEM
+ */
+esp_err_t app_reporter_init(const app_reporter_config_t *config);
+
+/**
+ * @brief  Mark a parameter dirty with a new value, reported later with the other dirty parameters
+ *
+ * The first update after a quiet time is reported at once. The next ones are
+ * coalesced, at most one report is sent per interval with the last value of
+ * each parameter, and the final values are sent when the updates stop for idle_ms.
+ *
+ * @param  param Parameter, its value is only updated when reported
+ * @param  val   New value, strings are copied
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_INVALID_STATE  Reporter not initialized
+ *     - ESP_ERR_NO_MEM         More than CONFIG_APP_REPORTER_PARAM_MAX parameters
+ */
+esp_err_t app_reporter_update(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val);
+
+/**
+ * @brief  Report the dirty parameters now, e.g. at the end of a ramp or an effect
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_STATE  Reporter not initialized
+ */
+esp_err_t app_reporter_flush(void);
+
+/**
+ * @brief  Get the counters of the reporter
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t app_reporter_get_stats(app_reporter_stats_t *stats);
+
+/**
+ * @brief  Print the counters of the reporter
+ */
+void app_reporter_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
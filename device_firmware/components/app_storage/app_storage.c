@@ -18,11 +18,22 @@
 
 #include "nvs.h"
 #include "nvs_flash.h"
+#include "esp_rom_crc.h"
 
 #include "app_storage.h"
 
 static const char *TAG = "app_storage";
 
+#define APP_STORAGE_SNAPSHOT_MAGIC      "ASNP"
+#define APP_STORAGE_SNAPSHOT_VERSION    1
+#define APP_STORAGE_SNAPSHOT_END        0x00
+
+typedef struct {
+    app_storage_write_cb_t write_cb;
+    void *arg;
+    uint32_t crc;
+} storage_export_t;
+
 esp_err_t app_storage_init()
 {
     static bool init_flag = false;
@@ -132,3 +143,415 @@ esp_err_t app_storage_get(const char *key, void *value, size_t length)
 
     return ESP_OK;
 }
+
+static esp_err_t storage_partition_init(const char *part_name)
+{
+    if (!strcmp(part_name, NVS_DEFAULT_PART_NAME)) {
+        return app_storage_init();
+    }
+
+    /**< Returns ESP_OK if the partition is already initialized, e.g. fctry by esp_rmaker_factory_init() */
+    return nvs_flash_init_partition(part_name);
+}
+
+/**
+ * @brief Read any type of item into value, integers are copied in little-endian order
+ */
+static esp_err_t storage_read_item(nvs_handle handle, const nvs_entry_info_t *info, uint8_t *value, size_t *length)
+{
+    esp_err_t ret = ESP_OK;
+    uint64_t number = 0;
+
+    switch (info->type) {
+        case NVS_TYPE_U8:
+            ret = nvs_get_u8(handle, info->key, (uint8_t *)&number);
+            break;
+
+        case NVS_TYPE_I8:
+            ret = nvs_get_i8(handle, info->key, (int8_t *)&number);
+            break;
+
+        case NVS_TYPE_U16:
+            ret = nvs_get_u16(handle, info->key, (uint16_t *)&number);
+            break;
+
+        case NVS_TYPE_I16:
+            ret = nvs_get_i16(handle, info->key, (int16_t *)&number);
+            break;
+
+        case NVS_TYPE_U32:
+            ret = nvs_get_u32(handle, info->key, (uint32_t *)&number);
+            break;
+
+        case NVS_TYPE_I32:
+            ret = nvs_get_i32(handle, info->key, (int32_t *)&number);
+            break;
+
+        case NVS_TYPE_U64:
+            ret = nvs_get_u64(handle, info->key, &number);
+            break;
+
+        case NVS_TYPE_I64:
+            ret = nvs_get_i64(handle, info->key, (int64_t *)&number);
+            break;
+
+        case NVS_TYPE_STR:
+            *length = CONFIG_APP_STORAGE_SNAPSHOT_VALUE_MAX_SIZE;
+            ret = nvs_get_str(handle, info->key, (char *)value, length);
+            return (ret == ESP_ERR_NVS_INVALID_LENGTH) ? ESP_ERR_NVS_VALUE_TOO_LONG : ret;
+
+        case NVS_TYPE_BLOB:
+            *length = CONFIG_APP_STORAGE_SNAPSHOT_VALUE_MAX_SIZE;
+            ret = nvs_get_blob(handle, info->key, value, length);
+            return (ret == ESP_ERR_NVS_INVALID_LENGTH) ? ESP_ERR_NVS_VALUE_TOO_LONG : ret;
+
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /**< The low nibble of the integer types is their size */
+    *length = info->type & 0x0f;
+    memcpy(value, &number, *length);
+
+    return ret;
+}
+
+/**
+ * @brief Write any type of item, the inverse of storage_read_item()
+ */
+static esp_err_t storage_write_item(nvs_handle handle, const char *key, uint8_t type, const uint8_t *value, size_t length)
+{
+    uint64_t number = 0;
+
+    if (type != NVS_TYPE_STR && type != NVS_TYPE_BLOB) {
+        if (length != (type & 0x0f) || length > sizeof(number)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        memcpy(&number, value, length);
+    }
+
+    switch (type) {
+        case NVS_TYPE_U8:
+            return nvs_set_u8(handle, key, (uint8_t)number);
+
+        case NVS_TYPE_I8:
+            return nvs_set_i8(handle, key, (int8_t)number);
+
+        case NVS_TYPE_U16:
+            return nvs_set_u16(handle, key, (uint16_t)number);
+
+        case NVS_TYPE_I16:
+            return nvs_set_i16(handle, key, (int16_t)number);
+
+        case NVS_TYPE_U32:
+            return nvs_set_u32(handle, key, (uint32_t)number);
+
+        case NVS_TYPE_I32:
+            return nvs_set_i32(handle, key, (int32_t)number);
+
+        case NVS_TYPE_U64:
+            return nvs_set_u64(handle, key, number);
+
+        case NVS_TYPE_I64:
+            return nvs_set_i64(handle, key, (int64_t)number);
+
+        case NVS_TYPE_STR:
+            if (!length || value[length - 1] != '\0') {
+                return ESP_ERR_INVALID_SIZE;
+            }
+
+            return nvs_set_str(handle, key, (const char *)value);
+
+        case NVS_TYPE_BLOB:
+            return nvs_set_blob(handle, key, value, length);
+
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+esp_err_t app_storage_iterate(const char *part_name, const char *name_space,
+                              app_storage_iterate_cb_t cb, void *arg)
+{
+    APP_STORAGE_PARAM_CHECK(part_name);
+    APP_STORAGE_PARAM_CHECK(name_space);
+    APP_STORAGE_PARAM_CHECK(cb);
+
+    esp_err_t ret     = ESP_OK;
+    nvs_handle handle = 0;
+
+    ret = storage_partition_init(part_name);
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Init partition: %s", part_name);
+
+    ret = nvs_open_from_partition(part_name, name_space, NVS_READONLY, &handle);
+
+    /**< A namespace is only created by its first write */
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Open non-volatile storage, namespace: %s", name_space);
+
+    uint8_t *value = malloc(CONFIG_APP_STORAGE_SNAPSHOT_VALUE_MAX_SIZE);
+
+    if (!value) {
+        nvs_close(handle);
+        return ESP_ERR_NO_MEM;
+    }
+
+    nvs_iterator_t it = nvs_entry_find(part_name, name_space, NVS_TYPE_ANY);
+
+    for (; it && ret == ESP_OK; it = nvs_entry_next(it)) {
+        nvs_entry_info_t info = {0};
+        size_t length = 0;
+
+        nvs_entry_info(it, &info);
+        ret = storage_read_item(handle, &info, value, &length);
+
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "<%s> Read item, key: %s, type: 0x%02x", esp_err_to_name(ret), info.key, info.type);
+            break;
+        }
+
+        ret = cb(info.key, info.type, value, length, arg);
+    }
+
+    /**< nvs_entry_next() releases the iterator when it reaches the end */
+    nvs_release_iterator(it);
+    nvs_close(handle);
+    free(value);
+
+    return ret;
+}
+
+static esp_err_t storage_export_write(storage_export_t *ctx, const void *data, size_t length)
+{
+    ctx->crc = esp_rom_crc32_le(ctx->crc, data, length);
+    return ctx->write_cb(data, length, ctx->arg);
+}
+
+static esp_err_t storage_export_item(const char *key, nvs_type_t type, const void *value, size_t length, void *arg)
+{
+    storage_export_t *ctx = (storage_export_t *)arg;
+    uint8_t header[2 + NVS_KEY_NAME_MAX_SIZE + 2];
+    size_t key_len = strlen(key);
+
+    header[0] = type;
+    header[1] = key_len;
+    memcpy(header + 2, key, key_len);
+    header[2 + key_len] = length & 0xff;
+    header[3 + key_len] = (length >> 8) & 0xff;
+
+    esp_err_t ret = storage_export_write(ctx, header, key_len + 4);
+
+    if (ret == ESP_OK && length) {
+        ret = storage_export_write(ctx, value, length);
+    }
+
+    return ret;
+}
+
+esp_err_t app_storage_export(const char *part_name, const char *name_space,
+                             app_storage_write_cb_t write_cb, void *arg)
+{
+    APP_STORAGE_PARAM_CHECK(part_name);
+    APP_STORAGE_PARAM_CHECK(name_space);
+    APP_STORAGE_PARAM_CHECK(strlen(name_space) < NVS_KEY_NAME_MAX_SIZE);
+    APP_STORAGE_PARAM_CHECK(write_cb);
+
+    esp_err_t ret = ESP_OK;
+    storage_export_t ctx = {
+        .write_cb = write_cb,
+        .arg      = arg,
+    };
+
+    uint8_t header[6 + NVS_KEY_NAME_MAX_SIZE];
+    size_t ns_len = strlen(name_space);
+
+    memcpy(header, APP_STORAGE_SNAPSHOT_MAGIC, 4);
+    header[4] = APP_STORAGE_SNAPSHOT_VERSION;
+    header[5] = ns_len;
+    memcpy(header + 6, name_space, ns_len);
+
+    ret = storage_export_write(&ctx, header, ns_len + 6);
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Write snapshot header");
+
+    ret = app_storage_iterate(part_name, name_space, storage_export_item, &ctx);
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Export namespace: %s", name_space);
+
+    uint8_t end = APP_STORAGE_SNAPSHOT_END;
+    ret = storage_export_write(&ctx, &end, sizeof(end));
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Write snapshot end");
+
+    uint8_t crc[4] = {ctx.crc & 0xff, (ctx.crc >> 8) & 0xff, (ctx.crc >> 16) & 0xff, (ctx.crc >> 24) & 0xff};
+    ret = write_cb(crc, sizeof(crc), arg);
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Write snapshot crc");
+
+    return ESP_OK;
+}
+
+static esp_err_t storage_import_read(app_storage_read_cb_t read_cb, void *arg, uint32_t *crc, void *data, size_t length)
+{
+    esp_err_t ret = read_cb(data, length, arg);
+
+    if (ret == ESP_OK) {
+        *crc = esp_rom_crc32_le(*crc, data, length);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Read the records of a snapshot up to its end marker into a single buffer, checking their sizes
+ */
+static esp_err_t storage_import_records(app_storage_read_cb_t read_cb, void *arg, uint32_t *crc,
+                                        uint8_t **records, size_t *size)
+{
+    esp_err_t ret   = ESP_OK;
+    size_t capacity = 0;
+
+    for (;;) {
+        uint8_t header[4 + NVS_KEY_NAME_MAX_SIZE];
+
+        ret = storage_import_read(read_cb, arg, crc, header, 1);
+
+        if (ret != ESP_OK || header[0] == APP_STORAGE_SNAPSHOT_END) {
+            return ret;
+        }
+
+        ret = storage_import_read(read_cb, arg, crc, header + 1, 1);
+
+        if (ret == ESP_OK && (header[1] == 0 || header[1] >= NVS_KEY_NAME_MAX_SIZE)) {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+
+        if (ret == ESP_OK) {
+            ret = storage_import_read(read_cb, arg, crc, header + 2, header[1] + 2);
+        }
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        size_t key_len    = header[1];
+        size_t value_len  = header[2 + key_len] | (header[3 + key_len] << 8);
+        size_t record_len = 4 + key_len + value_len;
+
+        APP_STORAGE_ERROR_CHECK(value_len > CONFIG_APP_STORAGE_SNAPSHOT_VALUE_MAX_SIZE,
+                                ESP_ERR_INVALID_SIZE, "Snapshot value length: %d", (int)value_len);
+        APP_STORAGE_ERROR_CHECK(*size + record_len > CONFIG_APP_STORAGE_SNAPSHOT_MAX_SIZE,
+                                ESP_ERR_INVALID_SIZE, "Snapshot larger than %d bytes", CONFIG_APP_STORAGE_SNAPSHOT_MAX_SIZE);
+
+        if (*size + record_len > capacity) {
+            size_t grown = capacity ? capacity * 2 : 512;
+            uint8_t *buffer = NULL;
+
+            grown  = (grown < *size + record_len) ? *size + record_len : grown;
+            grown  = (grown > CONFIG_APP_STORAGE_SNAPSHOT_MAX_SIZE) ? CONFIG_APP_STORAGE_SNAPSHOT_MAX_SIZE : grown;
+            buffer = realloc(*records, grown);
+
+            if (!buffer) {
+                return ESP_ERR_NO_MEM;
+            }
+
+            *records = buffer;
+            capacity = grown;
+        }
+
+        memcpy(*records + *size, header, 4 + key_len);
+
+        if (value_len) {
+            ret = storage_import_read(read_cb, arg, crc, *records + *size + 4 + key_len, value_len);
+        }
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        *size += record_len;
+    }
+}
+
+esp_err_t app_storage_import(const char *part_name, const char *name_space,
+                             app_storage_read_cb_t read_cb, void *arg)
+{
+    APP_STORAGE_PARAM_CHECK(part_name);
+    APP_STORAGE_PARAM_CHECK(read_cb);
+
+    esp_err_t ret     = ESP_OK;
+    nvs_handle handle = 0;
+    uint32_t crc      = 0;
+    uint8_t header[6];
+    char snapshot_ns[NVS_KEY_NAME_MAX_SIZE] = {0};
+    uint8_t *records    = NULL;
+    size_t records_size = 0;
+
+    ret = storage_import_read(read_cb, arg, &crc, header, sizeof(header));
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Read snapshot header");
+    APP_STORAGE_ERROR_CHECK(memcmp(header, APP_STORAGE_SNAPSHOT_MAGIC, 4) || header[4] != APP_STORAGE_SNAPSHOT_VERSION,
+                            ESP_ERR_INVALID_VERSION, "Snapshot version: %d", header[4]);
+    APP_STORAGE_ERROR_CHECK(header[5] == 0 || header[5] >= NVS_KEY_NAME_MAX_SIZE,
+                            ESP_ERR_INVALID_SIZE, "Snapshot namespace length: %d", header[5]);
+
+    ret = storage_import_read(read_cb, arg, &crc, snapshot_ns, header[5]);
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Read snapshot namespace");
+
+    /**< Nothing is written before the whole snapshot is read and its CRC checked */
+    ret = storage_import_records(read_cb, arg, &crc, &records, &records_size);
+
+    if (ret == ESP_OK) {
+        uint8_t expected[4];
+        uint32_t computed = crc;
+
+        ret = read_cb(expected, sizeof(expected), arg);
+
+        if (ret == ESP_OK && computed != (expected[0] | (expected[1] << 8) | (expected[2] << 16) | ((uint32_t)expected[3] << 24))) {
+            ret = ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    if (ret == ESP_OK) {
+        ret = storage_partition_init(part_name);
+    }
+
+    if (ret == ESP_OK) {
+        ret = nvs_open_from_partition(part_name, name_space ? name_space : snapshot_ns, NVS_READWRITE, &handle);
+    }
+
+    if (ret != ESP_OK) {
+        free(records);
+    }
+
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Import snapshot, namespace: %s", name_space ? name_space : snapshot_ns);
+
+    for (size_t offset = 0; offset < records_size;) {
+        const uint8_t *record = records + offset;
+        char key[NVS_KEY_NAME_MAX_SIZE] = {0};
+        size_t key_len   = record[1];
+        size_t value_len = record[2 + key_len] | (record[3 + key_len] << 8);
+
+        memcpy(key, record + 2, key_len);
+        ret = storage_write_item(handle, key, record[0], record + 4 + key_len, value_len);
+
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "<%s> Import record, key: %s", esp_err_to_name(ret), key);
+            break;
+        }
+
+        offset += 4 + key_len + value_len;
+    }
+
+    /**< Write any pending changes to non-volatile storage */
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+
+    /**< Close the storage handle and free any allocated resources */
+    nvs_close(handle);
+    free(records);
+
+    APP_STORAGE_ERROR_CHECK(ret != ESP_OK, ret, "Import snapshot");
+
+    return ESP_OK;
+}
@@ -16,6 +16,7 @@
 
 #include <esp_err.h>
 #include <esp_log.h>
+#include <nvs.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -94,6 +95,91 @@ esp_err_t app_storage_get(const char *key, void *value, size_t length);
  */
 esp_err_t app_storage_erase(const char *key);
 
+/**
+ * @brief Callback of app_storage_iterate(), called once for every key of the namespace
+ *
+ * @note  value is only valid during the call. Integer types are passed in
+ *        little-endian order, strings include the terminating zero.
+ *
+ * @return ESP_OK to continue, any other value stops the iteration and is returned by app_storage_iterate()
+ */
+typedef esp_err_t (*app_storage_iterate_cb_t)(const char *key, nvs_type_t type,
+                                              const void *value, size_t length, void *arg);
+
+/**
+ * @brief Stream callbacks of app_storage_export() and app_storage_import()
+ *
+ * @note  Both have to transfer exactly length bytes, otherwise return an error
+ */
+typedef esp_err_t (*app_storage_write_cb_t)(const void *data, size_t length, void *arg);
+typedef esp_err_t (*app_storage_read_cb_t)(void *data, size_t length, void *arg);
+
+/**
+ * @brief  Iterate over all the keys of a namespace
+ *
+ * @param  part_name  NVS partition label, e.g. NVS_DEFAULT_PART_NAME or "fctry"
+ * @param  name_space Namespace, e.g. CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE
+ * @param  cb         Called with the key, type and value of every item
+ * @param  arg        User data passed to cb
+ *
+ * @return
+ *     - ESP_OK  All keys visited, or the namespace does not exist
+ *     - ESP_ERR_NVS_VALUE_TOO_LONG  A value is larger than CONFIG_APP_STORAGE_SNAPSHOT_VALUE_MAX_SIZE
+ *     - Others  Error of NVS or of cb
+ */
+esp_err_t app_storage_iterate(const char *part_name, const char *name_space,
+                              app_storage_iterate_cb_t cb, void *arg);
+
+/**
+ * @brief  Export a namespace as a binary snapshot in a single pass
+ *
+ * The snapshot is a sequence of little-endian, length-prefixed records:
+ *     header: "ASNP" | version (u8) | namespace length (u8) | namespace
+ *     record: type (u8) | key length (u8) | key | value length (u16) | value
+ *     end:    0x00 | CRC32 of all the previous bytes (u32)
+ *
+ * Only one value buffer of CONFIG_APP_STORAGE_SNAPSHOT_VALUE_MAX_SIZE bytes is
+ * allocated, whatever the number of keys.
+ *
+ * @param  part_name  NVS partition label
+ * @param  name_space Namespace to export
+ * @param  write_cb   Called with consecutive chunks of the snapshot
+ * @param  arg        User data passed to write_cb
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NO_MEM
+ *     - Others  Error of NVS or of write_cb
+ */
+esp_err_t app_storage_export(const char *part_name, const char *name_space,
+                             app_storage_write_cb_t write_cb, void *arg);
+
+/**
+ * @brief  Import a snapshot created by app_storage_export()
+ *
+ * The snapshot is read into a buffer of up to CONFIG_APP_STORAGE_SNAPSHOT_MAX_SIZE
+ * bytes and its CRC checked before the first record is written, a corrupted or
+ * truncated snapshot leaves the partition untouched.
+ *
+ * @attention  NVS has no transactions, a valid snapshot failing on NVS, e.g. on a
+ *             full partition, may have been partially applied.
+ *
+ * @param  part_name  NVS partition label
+ * @param  name_space Namespace to write to, NULL to use the one stored in the snapshot
+ * @param  read_cb    Called to read consecutive chunks of the snapshot
+ * @param  arg        User data passed to read_cb
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_VERSION  Not a snapshot, or an unsupported version
+ *     - ESP_ERR_INVALID_SIZE     Malformed record, or a snapshot larger than CONFIG_APP_STORAGE_SNAPSHOT_MAX_SIZE
+ *     - ESP_ERR_INVALID_CRC      The snapshot is corrupted
+ *     - ESP_ERR_NO_MEM
+ *     - Others  Error of NVS or of read_cb
+ */
+esp_err_t app_storage_import(const char *part_name, const char *name_space,
+                             app_storage_read_cb_t read_cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
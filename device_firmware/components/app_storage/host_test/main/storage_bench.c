@@ -0,0 +1,634 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * @brief Replay realistic app_storage workloads on the host NVS emulator
+ *
+ * Every workload runs the unmodified app_storage.c against an emulated
+ * "nvs" partition and reports:
+ *  - bytes written to flash per logical update and write amplification
+ *  - erase count of every sector
+ *  - p50/p99/max modeled latency of the app_storage calls
+ *  - operations stalled by a page compaction (sector erase)
+ *
+ * The snapshot workload exports namespaces with app_storage_export(), clones
+ * them into another partition with app_storage_import() and compares them.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "nvs_emul.h"
+#include "app_storage.h"
+
+static const char *TAG = "storage_bench";
+
+/**
+ * @brief Same layout as light_status_t in light_driver.c, the value persisted on every light change
+ */
+typedef struct {
+    uint8_t mode;
+    uint8_t on;
+    uint16_t hue;
+    uint8_t saturation;
+    uint8_t value;
+    uint8_t color_temperature;
+    uint8_t brightness;
+    uint32_t fade_period_ms;
+    uint32_t blink_period_ms;
+} bench_light_status_t;
+
+#define LIGHT_STATUS_STORE_KEY  "light_status"
+#define BENCH_BOOT_KEY_COUNT    24
+
+typedef struct {
+    const char *workload;
+    uint32_t updates;
+    size_t sectors;
+    const char *image;
+    bool verify;
+} bench_config_t;
+
+typedef struct {
+    const char *name;
+    uint32_t ops;
+    uint64_t payload_bytes;
+    uint32_t *latency_us;
+    uint32_t stalls;
+    nvs_emul_stats_t stats;
+    uint32_t erase_count[NVS_EMUL_MAX_SECTORS];
+    size_t sector_count;
+} bench_result_t;
+
+static int g_failures = 0;
+
+#define BENCH_EXPECT(con, format, ...) do { \
+        if (!(con)) { \
+            fprintf(stderr, "FAIL %s:%d: " format "\n", __FILE__, __LINE__, ##__VA_ARGS__); \
+            g_failures++; \
+        } \
+    } while(0)
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, uint32_t count, uint32_t pct)
+{
+    if (!count) {
+        return 0;
+    }
+
+    uint32_t index = (uint64_t)count * pct / 100;
+    return sorted[index >= count ? count - 1 : index];
+}
+
+static void result_begin(bench_result_t *result, const char *name, uint32_t capacity)
+{
+    memset(result, 0, sizeof(bench_result_t));
+    result->name       = name;
+    result->latency_us = calloc(capacity ? capacity : 1, sizeof(uint32_t));
+    nvs_emul_reset_stats(NVS_DEFAULT_PART_NAME);
+}
+
+/**
+ * @brief Account one logical operation, a sector erase inside the call is a compaction stall
+ */
+static void result_record(bench_result_t *result, uint64_t start_us, uint32_t erase_before, size_t payload)
+{
+    nvs_emul_stats_t stats;
+    nvs_emul_get_stats(NVS_DEFAULT_PART_NAME, &stats);
+
+    result->latency_us[result->ops++] = nvs_emul_get_time_us() - start_us;
+    result->payload_bytes += payload;
+    result->stalls += (stats.erase_ops != erase_before);
+}
+
+static uint32_t current_erase_ops(void)
+{
+    nvs_emul_stats_t stats;
+    nvs_emul_get_stats(NVS_DEFAULT_PART_NAME, &stats);
+    return stats.erase_ops;
+}
+
+static void result_end(bench_result_t *result)
+{
+    nvs_emul_get_stats(NVS_DEFAULT_PART_NAME, &result->stats);
+    nvs_emul_get_erase_counts(NVS_DEFAULT_PART_NAME, result->erase_count, &result->sector_count);
+}
+
+static void result_print(bench_result_t *result)
+{
+    qsort(result->latency_us, result->ops, sizeof(uint32_t), compare_u32);
+
+    double per_update = result->ops ? (double)result->stats.bytes_written / result->ops : 0;
+    double amplification = result->payload_bytes ? (double)result->stats.bytes_written / result->payload_bytes : 0;
+
+    printf("\n[%s]\n", result->name);
+    printf("  logical ops        : %" PRIu32 "\n", result->ops);
+    printf("  payload bytes      : %" PRIu64 "\n", result->payload_bytes);
+    printf("  flash bytes written: %" PRIu64 " (%.1f per op, amplification x%.2f)\n",
+           result->stats.bytes_written, per_update, amplification);
+    printf("  flash bytes read   : %" PRIu64 "\n", result->stats.bytes_read);
+    printf("  sector erases      : %" PRIu32 " (gc %" PRIu32 ")\n", result->stats.erase_ops, result->stats.gc_count);
+    printf("  erase per sector   :");
+
+    for (size_t i = 0; i < result->sector_count; i++) {
+        printf(" %" PRIu32, result->erase_count[i]);
+    }
+
+    printf("\n");
+    printf("  latency us         : p50 %" PRIu32 ", p99 %" PRIu32 ", max %" PRIu32 "\n",
+           percentile(result->latency_us, result->ops, 50),
+           percentile(result->latency_us, result->ops, 99),
+           result->ops ? result->latency_us[result->ops - 1] : 0);
+    printf("  compaction stalls  : %" PRIu32 "\n", result->stalls);
+
+    free(result->latency_us);
+    result->latency_us = NULL;
+}
+
+/**
+ * @brief A slider drag on the app: light_driver_set_value() is called for every
+ *        step and each call persists the whole light status
+ */
+static void bench_slider_drag(const bench_config_t *config)
+{
+    bench_result_t result;
+    bench_light_status_t status = {
+        .mode = 1, .on = 1, .hue = 120, .saturation = 80, .value = 50,
+        .color_temperature = 50, .brightness = 50, .fade_period_ms = 800,
+    };
+
+    result_begin(&result, "slider drag", config->updates);
+
+    for (uint32_t i = 0; i < config->updates; i++) {
+        /**< Sweep 1..100 and back, the way a finger drags the brightness slider */
+        uint32_t pos = i % 198;
+        status.value = (pos < 99) ? pos + 1 : 197 - pos + 1;
+
+        uint64_t start_us = nvs_emul_get_time_us();
+        uint32_t erases   = current_erase_ops();
+        BENCH_EXPECT(app_storage_set(LIGHT_STATUS_STORE_KEY, &status, sizeof(status)) == ESP_OK, "set %u", i);
+        result_record(&result, start_us, erases, sizeof(status));
+    }
+
+    result_end(&result);
+
+    if (config->verify) {
+        bench_light_status_t restored = {0};
+        nvs_emul_reboot();
+        BENCH_EXPECT(app_storage_get(LIGHT_STATUS_STORE_KEY, &restored, sizeof(restored)) == ESP_OK, "get after reboot");
+        BENCH_EXPECT(!memcmp(&restored, &status, sizeof(status)), "slider value lost across reboot");
+    }
+
+    result_print(&result);
+}
+
+/**
+ * @brief A toggle storm: the power switch flipped as fast as the app allows
+ */
+static void bench_toggle_storm(const bench_config_t *config)
+{
+    bench_result_t result;
+    bench_light_status_t status = {
+        .mode = 1, .hue = 30, .saturation = 100, .value = 100,
+        .color_temperature = 50, .brightness = 100, .fade_period_ms = 800,
+    };
+
+    result_begin(&result, "toggle storm", config->updates);
+
+    for (uint32_t i = 0; i < config->updates; i++) {
+        status.on = !status.on;
+
+        uint64_t start_us = nvs_emul_get_time_us();
+        uint32_t erases   = current_erase_ops();
+        BENCH_EXPECT(app_storage_set(LIGHT_STATUS_STORE_KEY, &status, sizeof(status)) == ESP_OK, "set %u", i);
+        result_record(&result, start_us, erases, sizeof(status));
+    }
+
+    result_end(&result);
+
+    if (config->verify) {
+        bench_light_status_t restored = {0};
+        nvs_emul_reboot();
+        BENCH_EXPECT(app_storage_get(LIGHT_STATUS_STORE_KEY, &restored, sizeof(restored)) == ESP_OK, "get after reboot");
+        BENCH_EXPECT(restored.on == status.on, "power state lost across reboot");
+    }
+
+    result_print(&result);
+}
+
+/**
+ * @brief A boot restore: the partition holds the light status plus a set of
+ *        application keys, the device reboots and reads them back. The mount
+ *        (page scan) is reported separately from the per key lookups.
+ */
+static void bench_boot_restore(const bench_config_t *config)
+{
+    bench_result_t result;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint8_t value[64];
+
+    for (int i = 0; i < BENCH_BOOT_KEY_COUNT; i++) {
+        snprintf(key, sizeof(key), "app_key_%02d", i);
+        memset(value, i, sizeof(value));
+        BENCH_EXPECT(app_storage_set(key, value, 8 + (i % 8) * 7) == ESP_OK, "populate %s", key);
+    }
+
+    nvs_emul_reset_stats(NVS_DEFAULT_PART_NAME);
+    uint64_t start_us = nvs_emul_get_time_us();
+    nvs_emul_reboot();
+    uint64_t mount_us = nvs_emul_get_time_us() - start_us;
+
+    nvs_emul_stats_t mount_stats;
+    nvs_emul_get_stats(NVS_DEFAULT_PART_NAME, &mount_stats);
+
+    result_begin(&result, "boot restore", BENCH_BOOT_KEY_COUNT);
+
+    for (int i = 0; i < BENCH_BOOT_KEY_COUNT; i++) {
+        size_t length = 8 + (i % 8) * 7;
+        snprintf(key, sizeof(key), "app_key_%02d", i);
+        memset(value, 0, sizeof(value));
+
+        start_us = nvs_emul_get_time_us();
+        uint32_t erases = current_erase_ops();
+        BENCH_EXPECT(app_storage_get(key, value, length) == ESP_OK, "get %s", key);
+        result_record(&result, start_us, erases, length);
+
+        for (size_t j = 0; j < length && config->verify; j++) {
+            BENCH_EXPECT(value[j] == i, "%s corrupted at %zu", key, j);
+        }
+    }
+
+    result_end(&result);
+
+    printf("\n[boot mount]\n");
+    printf("  mount us           : %" PRIu64 " (%" PRIu64 " bytes scanned)\n", mount_us, mount_stats.bytes_read);
+
+    if (config->verify) {
+        BENCH_EXPECT(result.stats.bytes_written == 0, "a restore must not write to flash");
+    }
+
+    result_print(&result);
+}
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    size_t offset;
+    size_t max_chunk;
+    uint32_t chunks;
+} bench_stream_t;
+
+static esp_err_t bench_stream_write(const void *data, size_t length, void *arg)
+{
+    bench_stream_t *stream = (bench_stream_t *)arg;
+
+    if (stream->size + length > stream->capacity) {
+        stream->capacity = (stream->size + length) * 2;
+        stream->data = realloc(stream->data, stream->capacity);
+    }
+
+    memcpy(stream->data + stream->size, data, length);
+    stream->size += length;
+    stream->chunks++;
+    stream->max_chunk = (length > stream->max_chunk) ? length : stream->max_chunk;
+
+    return ESP_OK;
+}
+
+static esp_err_t bench_stream_read(void *data, size_t length, void *arg)
+{
+    bench_stream_t *stream = (bench_stream_t *)arg;
+
+    if (stream->offset + length > stream->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(data, stream->data + stream->offset, length);
+    stream->offset += length;
+
+    return ESP_OK;
+}
+
+typedef struct {
+    const char *part_name;
+    const char *name_space;
+    uint32_t count;
+    uint32_t mismatch;
+} bench_compare_t;
+
+typedef struct {
+    const char *key;
+    nvs_type_t type;
+    const void *value;
+    size_t length;
+    bool found;
+} bench_lookup_t;
+
+static esp_err_t bench_lookup_item(const char *key, nvs_type_t type, const void *value, size_t length, void *arg)
+{
+    bench_lookup_t *lookup = (bench_lookup_t *)arg;
+
+    if (!strcmp(key, lookup->key)) {
+        lookup->found = (type == lookup->type && length == lookup->length && !memcmp(value, lookup->value, length));
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Check every key of the source namespace against the clone
+ */
+static esp_err_t bench_compare_item(const char *key, nvs_type_t type, const void *value, size_t length, void *arg)
+{
+    bench_compare_t *compare = (bench_compare_t *)arg;
+    bench_lookup_t lookup = {
+        .key    = key,
+        .type   = type,
+        .value  = value,
+        .length = length,
+    };
+
+    app_storage_iterate(compare->part_name, compare->name_space, bench_lookup_item, &lookup);
+
+    compare->count++;
+    compare->mismatch += !lookup.found;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Export the application namespace and the factory credentials, clone
+ *        them into other partitions and check the copies
+ */
+static void bench_snapshot(const bench_config_t *config)
+{
+    nvs_handle_t handle = 0;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint8_t blob[300];
+
+    /**< Application namespace with every type of item */
+    BENCH_EXPECT(nvs_open(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK, "open");
+    nvs_set_u8(handle, "u8", 0xa5);
+    nvs_set_i8(handle, "i8", -5);
+    nvs_set_u16(handle, "u16", 0xbeef);
+    nvs_set_i16(handle, "i16", -1234);
+    nvs_set_u32(handle, "u32", 0xdeadbeef);
+    nvs_set_i32(handle, "i32", -123456);
+    nvs_set_u64(handle, "u64", 0x0123456789abcdefULL);
+    nvs_set_i64(handle, "i64", -1);
+    nvs_set_str(handle, "str", "ESP32-C3 Smart Light");
+    nvs_close(handle);
+
+    for (int i = 0; i < 16; i++) {
+        snprintf(key, sizeof(key), "blob_%02d", i);
+        memset(blob, i, sizeof(blob));
+        BENCH_EXPECT(app_storage_set(key, blob, 16 + i * 17) == ESP_OK, "set %s", key);
+    }
+
+    /**< Factory partition, written by the manufacturing tool on a real device */
+    if (nvs_emul_partition_add("fctry", 6) == ESP_OK) {
+        nvs_flash_init_partition("fctry");
+        BENCH_EXPECT(nvs_open_from_partition("fctry", "rmaker_creds", NVS_READWRITE, &handle) == ESP_OK, "open fctry");
+        nvs_set_str(handle, "node_id", "a1b2c3d4e5f6");
+        memset(blob, 0x5a, sizeof(blob));
+        nvs_set_blob(handle, "client_cert", blob, sizeof(blob));
+        nvs_set_blob(handle, "random", blob, 64);
+        nvs_close(handle);
+    }
+
+    nvs_emul_partition_add("clone", config->sectors);
+    nvs_flash_init_partition("clone");
+
+    const char *sources[][2] = {
+        {NVS_DEFAULT_PART_NAME, CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE},
+        {"fctry", "rmaker_creds"},
+    };
+
+    printf("\n[snapshot]\n");
+
+    for (int i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        bench_stream_t stream = {0};
+        uint64_t start_us = nvs_emul_get_time_us();
+
+        BENCH_EXPECT(app_storage_export(sources[i][0], sources[i][1], bench_stream_write, &stream) == ESP_OK,
+                     "export %s/%s", sources[i][0], sources[i][1]);
+        uint64_t export_us = nvs_emul_get_time_us() - start_us;
+
+        start_us = nvs_emul_get_time_us();
+        BENCH_EXPECT(app_storage_import("clone", NULL, bench_stream_read, &stream) == ESP_OK,
+                     "import %s/%s", sources[i][0], sources[i][1]);
+        uint64_t import_us = nvs_emul_get_time_us() - start_us;
+
+        bench_compare_t compare = {.part_name = "clone", .name_space = sources[i][1]};
+        BENCH_EXPECT(app_storage_iterate(sources[i][0], sources[i][1], bench_compare_item, &compare) == ESP_OK, "iterate");
+        BENCH_EXPECT(compare.count > 0 && compare.mismatch == 0, "%s/%s: %u keys, %u mismatch",
+                     sources[i][0], sources[i][1], compare.count, compare.mismatch);
+
+        printf("  %s/%s: %u keys, %zu bytes in %u chunks (largest %zu), export %" PRIu64 " us, import %" PRIu64 " us\n",
+               sources[i][0], sources[i][1], compare.count, stream.size, stream.chunks, stream.max_chunk,
+               export_us, import_us);
+
+        /**< A single flipped bit must be detected */
+        stream.data[stream.size / 2] ^= 0x01;
+        stream.offset = 0;
+        esp_err_t ret = app_storage_import("clone", "corrupted", bench_stream_read, &stream);
+        BENCH_EXPECT(ret != ESP_OK, "corrupted snapshot accepted");
+
+        /**< Nothing of it may have been written */
+        bench_compare_t corrupted = {.part_name = "clone", .name_space = "corrupted"};
+        BENCH_EXPECT(app_storage_iterate("clone", "corrupted", bench_compare_item, &corrupted) == ESP_OK
+                     && corrupted.count == 0, "corrupted snapshot partially applied: %u keys", corrupted.count);
+
+        /**< A truncated snapshot must be rejected */
+        stream.data[stream.size / 2] ^= 0x01;
+        stream.offset = 0;
+        stream.size  -= 3;
+        ret = app_storage_import("clone", "truncated", bench_stream_read, &stream);
+        BENCH_EXPECT(ret != ESP_OK, "truncated snapshot accepted");
+
+        free(stream.data);
+    }
+
+    /**< Iterating a namespace that was never written is not an error */
+    bench_compare_t empty = {.part_name = "clone", .name_space = "none"};
+    BENCH_EXPECT(app_storage_iterate(NVS_DEFAULT_PART_NAME, "none", bench_compare_item, &empty) == ESP_OK
+                 && empty.count == 0, "empty namespace");
+}
+
+/**
+ * @brief Checks of the emulator itself that the workload numbers rely on
+ */
+static void bench_self_test(const bench_config_t *config)
+{
+    bench_light_status_t status = {.on = 1, .value = 42};
+    nvs_emul_stats_t stats;
+
+    /**< Writing the same value twice must not touch the flash */
+    BENCH_EXPECT(app_storage_set(LIGHT_STATUS_STORE_KEY, &status, sizeof(status)) == ESP_OK, "set");
+    nvs_emul_reset_stats(NVS_DEFAULT_PART_NAME);
+    BENCH_EXPECT(app_storage_set(LIGHT_STATUS_STORE_KEY, &status, sizeof(status)) == ESP_OK, "set same");
+    nvs_emul_get_stats(NVS_DEFAULT_PART_NAME, &stats);
+    BENCH_EXPECT(stats.bytes_written == 0, "identical rewrite wrote %" PRIu64 " bytes", stats.bytes_written);
+
+    /**< A blob is written as a data chunk and an index entry, as on version 2 pages */
+    status.value++;
+    BENCH_EXPECT(app_storage_set(LIGHT_STATUS_STORE_KEY, &status, sizeof(status)) == ESP_OK, "set blob");
+    nvs_emul_get_stats(NVS_DEFAULT_PART_NAME, &stats);
+    BENCH_EXPECT(stats.bytes_written >= 3 * NVS_EMUL_ENTRY_SIZE, "blob update wrote %" PRIu64 " bytes", stats.bytes_written);
+
+    /**< Erase then read back */
+    BENCH_EXPECT(app_storage_erase(LIGHT_STATUS_STORE_KEY) == ESP_OK, "erase");
+    BENCH_EXPECT(app_storage_get(LIGHT_STATUS_STORE_KEY, &status, sizeof(status)) == ESP_ERR_NVS_NOT_FOUND, "erased key found");
+
+    /**< A too small buffer is reported, not truncated */
+    uint8_t small[4];
+    BENCH_EXPECT(app_storage_set("big_key", &status, sizeof(status)) == ESP_OK, "set big_key");
+    BENCH_EXPECT(app_storage_get("big_key", small, sizeof(small)) == ESP_ERR_NVS_INVALID_LENGTH, "short buffer");
+
+    /**< Erasing the namespace removes every key of it */
+    BENCH_EXPECT(app_storage_erase(CONFIG_RAINMAKER_APP_PARTITION_NAMESPACE) == ESP_OK, "erase namespace");
+    BENCH_EXPECT(app_storage_get("big_key", &status, sizeof(status)) == ESP_ERR_NVS_NOT_FOUND, "namespace not erased");
+
+    /**< Image round trip keeps the content */
+    if (config->image) {
+        return;
+    }
+
+    const char *path = "storage_bench_selftest.bin";
+    status.value = 77;
+    BENCH_EXPECT(app_storage_set(LIGHT_STATUS_STORE_KEY, &status, sizeof(status)) == ESP_OK, "set");
+    BENCH_EXPECT(nvs_emul_save_image(NVS_DEFAULT_PART_NAME, path) == ESP_OK, "save image");
+    BENCH_EXPECT(app_storage_erase(LIGHT_STATUS_STORE_KEY) == ESP_OK, "erase");
+    BENCH_EXPECT(nvs_emul_load_image(NVS_DEFAULT_PART_NAME, path) == ESP_OK, "load image");
+    BENCH_EXPECT(nvs_flash_init() == ESP_OK, "mount image");
+
+    bench_light_status_t restored = {0};
+    BENCH_EXPECT(app_storage_get(LIGHT_STATUS_STORE_KEY, &restored, sizeof(restored)) == ESP_OK, "get from image");
+    BENCH_EXPECT(restored.value == 77, "image round trip");
+    remove(path);
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options]\n", name);
+    printf("  -w, --workload <slider|toggle|boot|snapshot|all>  Workload to replay (default all)\n");
+    printf("  -n, --updates <N>                       Logical updates per workload (default 5000)\n");
+    printf("  -s, --sectors <N>                       Sectors of the nvs partition (default 6)\n");
+    printf("  -i, --image <path>                      Load the partition from and save it to a file\n");
+    printf("  -e, --erase-us <us>                     Modeled sector erase time\n");
+    printf("  -p, --write-ns-per-byte <ns>            Modeled program time per byte\n");
+    printf("      --verify                            Check results, exit code is the failure count\n");
+}
+
+int main(int argc, char **argv)
+{
+    bench_config_t config = {
+        .workload = "all",
+        .updates  = 5000,
+        .sectors  = 6,
+    };
+    nvs_emul_timing_t timing;
+    nvs_emul_get_timing(&timing);
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg  = argv[i];
+        const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (!strcmp(arg, "--verify")) {
+            config.verify = true;
+        } else if ((!strcmp(arg, "-w") || !strcmp(arg, "--workload")) && next) {
+            config.workload = next;
+            i++;
+        } else if ((!strcmp(arg, "-n") || !strcmp(arg, "--updates")) && next) {
+            config.updates = strtoul(next, NULL, 0);
+            i++;
+        } else if ((!strcmp(arg, "-s") || !strcmp(arg, "--sectors")) && next) {
+            config.sectors = strtoul(next, NULL, 0);
+            i++;
+        } else if ((!strcmp(arg, "-i") || !strcmp(arg, "--image")) && next) {
+            config.image = next;
+            i++;
+        } else if ((!strcmp(arg, "-e") || !strcmp(arg, "--erase-us")) && next) {
+            timing.erase_us = strtoul(next, NULL, 0);
+            i++;
+        } else if ((!strcmp(arg, "-p") || !strcmp(arg, "--write-ns-per-byte")) && next) {
+            timing.write_ns_per_byte = strtoul(next, NULL, 0);
+            i++;
+        } else {
+            usage(argv[0]);
+            return strcmp(arg, "-h") && strcmp(arg, "--help") ? 1 : 0;
+        }
+    }
+
+    nvs_emul_set_timing(&timing);
+
+    if (!config.image || nvs_emul_load_image(NVS_DEFAULT_PART_NAME, config.image) != ESP_OK) {
+        if (nvs_emul_partition_add(NVS_DEFAULT_PART_NAME, config.sectors) != ESP_OK) {
+            fprintf(stderr, "E (%s) Invalid partition size: %zu sectors\n", TAG, config.sectors);
+            return 1;
+        }
+    }
+
+    app_storage_init();
+
+    printf("nvs partition: %zu sectors, erase %" PRIu32 " us, write %" PRIu32 " us + %" PRIu32 " ns/byte, read %" PRIu32 " us + %" PRIu32 " ns/byte\n",
+           config.sectors, timing.erase_us, timing.write_op_us, timing.write_ns_per_byte,
+           timing.read_op_us, timing.read_ns_per_byte);
+
+    bool all = !strcmp(config.workload, "all");
+
+    if (config.verify) {
+        bench_self_test(&config);
+    }
+
+    if (all || !strcmp(config.workload, "slider")) {
+        bench_slider_drag(&config);
+    }
+
+    if (all || !strcmp(config.workload, "toggle")) {
+        bench_toggle_storm(&config);
+    }
+
+    if (all || !strcmp(config.workload, "boot")) {
+        bench_boot_restore(&config);
+    }
+
+    if (all || !strcmp(config.workload, "snapshot")) {
+        bench_snapshot(&config);
+    }
+
+    if (config.image) {
+        nvs_emul_save_image(NVS_DEFAULT_PART_NAME, config.image);
+    }
+
+    nvs_emul_destroy();
+
+    if (config.verify) {
+        printf("\n%s: %d failure(s)\n", g_failures ? "FAILED" : "PASSED", g_failures);
+    }
+
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,1326 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * @brief Host emulation of the NVS library on top of a flash image in memory
+ *
+ * The layout follows the NVS design: 4 KB pages made of a 32 byte header,
+ * a 32 byte entry state bitmap and 126 entries of 32 bytes. Items are
+ * appended to the active page, overwritten items are marked erased in the
+ * bitmap and a full partition is compacted by moving the live items of the
+ * page with the most erased entries into the reserved free page. As on
+ * version 2 pages, a blob is a data chunk followed by an index entry, both
+ * replaced on every write. The data is always a single chunk, NVS splits a
+ * blob across pages when the active page is short of room. Every
+ * flash access goes through flash_read()/flash_write()/flash_erase() so the
+ * benchmark can account bytes, erases and modeled time.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "nvs_emul.h"
+
+static const char *TAG = "nvs_emul";
+
+#define PAGE_STATE_UNINITIALIZED  0xFFFFFFFF
+#define PAGE_STATE_ACTIVE         0xFFFFFFFE
+#define PAGE_STATE_FULL           0xFFFFFFFC
+#define PAGE_STATE_FREEING        0xFFFFFFF8
+
+#define ENTRY_STATE_EMPTY         0x3
+#define ENTRY_STATE_WRITTEN       0x2
+#define ENTRY_STATE_ERASED        0x0
+
+#define ITEM_TYPE_BLOB_DATA       NVS_TYPE_BLOB  /**< Data chunk of a blob */
+#define ITEM_TYPE_BLOB_IDX        0x48           /**< Index of a blob: size, chunk count and first chunk index */
+#define CHUNK_INDEX_ANY           0xff           /**< Chunk index of every item but the blob data chunks */
+#define BLOB_CHUNK_VER_0          0x00           /**< First chunk index of a blob, alternates with VER_1 on every write */
+#define BLOB_CHUNK_VER_1          0x80
+
+#define PAGE_HEADER_OFFSET        0
+#define PAGE_BITMAP_OFFSET        32
+#define PAGE_ENTRY_OFFSET         64
+
+#define NS_INDEX_NAMESPACES       0     /**< Namespace entries live in namespace 0 */
+#define NS_INDEX_MAX              254
+#define MAX_HANDLES               32
+#define DEFAULT_SECTOR_COUNT      6     /**< nvs partition in partitions.csv is 0x6000 */
+
+typedef struct {
+    uint8_t ns;
+    uint8_t type;
+    uint8_t span;
+    uint8_t chunk_index;
+    uint32_t crc32;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint8_t data[8];
+} emul_entry_t;
+
+typedef struct {
+    uint32_t state;
+    uint32_t seq;
+    uint8_t next_free;
+    uint8_t used;
+    uint8_t erased;
+    uint32_t free_order;  /**< Erased pages are reused in FIFO order, as the NVS free page list */
+} emul_page_t;
+
+typedef struct {
+    uint8_t ns;
+    uint8_t type;
+    uint8_t span;
+    uint8_t entry;
+    uint8_t chunk_index;  /**< CHUNK_INDEX_ANY, or the index of a blob data chunk */
+    uint8_t chunk_start;  /**< Index of a blob: chunk index of its data */
+    uint16_t page;
+    uint16_t size;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+} emul_item_t;
+
+typedef struct {
+    bool used;
+    bool mounted;
+    char label[17];
+    size_t sector_count;
+    uint8_t *flash;
+    emul_page_t pages[NVS_EMUL_MAX_SECTORS];
+    int active;
+    uint32_t next_seq;
+    uint32_t next_free_order;
+    emul_item_t *items;
+    size_t item_count;
+    size_t item_capacity;
+    uint32_t erase_count[NVS_EMUL_MAX_SECTORS];
+    nvs_emul_stats_t stats;
+} emul_partition_t;
+
+typedef struct {
+    bool used;
+    int part;
+    uint8_t ns;
+    bool readonly;
+} emul_handle_t;
+
+static emul_partition_t g_partitions[NVS_EMUL_MAX_PARTITIONS];
+static emul_handle_t g_handles[MAX_HANDLES];
+static uint64_t g_flash_time_us = 0;
+static nvs_emul_timing_t g_timing = {
+    .erase_us          = 45000,
+    .write_op_us       = 15,
+    .write_ns_per_byte = 2500,
+    .read_op_us        = 5,
+    .read_ns_per_byte  = 50,
+};
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                        return "ESP_OK";
+        case ESP_FAIL:                      return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC:           return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION:       return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NVS_NOT_INITIALIZED:   return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_TYPE_MISMATCH:     return "ESP_ERR_NVS_TYPE_MISMATCH";
+        case ESP_ERR_NVS_READ_ONLY:         return "ESP_ERR_NVS_READ_ONLY";
+        case ESP_ERR_NVS_NOT_ENOUGH_SPACE:  return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+        case ESP_ERR_NVS_INVALID_NAME:      return "ESP_ERR_NVS_INVALID_NAME";
+        case ESP_ERR_NVS_INVALID_HANDLE:    return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_KEY_TOO_LONG:      return "ESP_ERR_NVS_KEY_TOO_LONG";
+        case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_NO_FREE_PAGES:     return "ESP_ERR_NVS_NO_FREE_PAGES";
+        case ESP_ERR_NVS_VALUE_TOO_LONG:    return "ESP_ERR_NVS_VALUE_TOO_LONG";
+        case ESP_ERR_NVS_PART_NOT_FOUND:    return "ESP_ERR_NVS_PART_NOT_FOUND";
+        default:                            return "UNKNOWN ERROR";
+    }
+}
+
+/**
+ * @brief Flash primitives, the only functions touching part->flash
+ */
+static void flash_read(emul_partition_t *part, size_t offset, void *dst, size_t length)
+{
+    memcpy(dst, part->flash + offset, length);
+    part->stats.bytes_read += length;
+    part->stats.read_ops++;
+
+    uint64_t cost = g_timing.read_op_us + (uint64_t)length * g_timing.read_ns_per_byte / 1000;
+    part->stats.flash_time_us += cost;
+    g_flash_time_us += cost;
+}
+
+static void flash_write(emul_partition_t *part, size_t offset, const void *src, size_t length)
+{
+    const uint8_t *data = (const uint8_t *)src;
+
+    /**< NOR flash can only clear bits, an erase is needed to set them again */
+    for (size_t i = 0; i < length; i++) {
+        part->flash[offset + i] &= data[i];
+    }
+
+    part->stats.bytes_written += length;
+    part->stats.write_ops++;
+
+    uint64_t cost = g_timing.write_op_us + (uint64_t)length * g_timing.write_ns_per_byte / 1000;
+    part->stats.flash_time_us += cost;
+    g_flash_time_us += cost;
+}
+
+static void flash_erase(emul_partition_t *part, int sector)
+{
+    memset(part->flash + (size_t)sector * NVS_EMUL_SECTOR_SIZE, 0xff, NVS_EMUL_SECTOR_SIZE);
+    part->erase_count[sector]++;
+    part->stats.erase_ops++;
+    part->stats.flash_time_us += g_timing.erase_us;
+    g_flash_time_us += g_timing.erase_us;
+}
+
+static inline size_t page_offset(int page)
+{
+    return (size_t)page * NVS_EMUL_SECTOR_SIZE;
+}
+
+static inline size_t entry_offset(int page, int entry)
+{
+    return page_offset(page) + PAGE_ENTRY_OFFSET + (size_t)entry * NVS_EMUL_ENTRY_SIZE;
+}
+
+static inline uint8_t entry_span_for(uint8_t type, size_t size)
+{
+    if (type == NVS_TYPE_STR || type == NVS_TYPE_BLOB) {
+        return 1 + (size + NVS_EMUL_ENTRY_SIZE - 1) / NVS_EMUL_ENTRY_SIZE;
+    }
+
+    return 1;
+}
+
+static inline size_t type_size(uint8_t type)
+{
+    return type & 0x0f;
+}
+
+static void page_write_state(emul_partition_t *part, int page, uint32_t state)
+{
+    flash_write(part, page_offset(page) + PAGE_HEADER_OFFSET, &state, sizeof(state));
+    part->pages[page].state = state;
+}
+
+/**
+ * @brief Update the 2 bit state of a range of entries, one word write per touched bitmap word
+ */
+static void page_write_entry_state(emul_partition_t *part, int page, int entry, int count, uint8_t state)
+{
+    uint32_t bitmap[8];
+    memcpy(bitmap, part->flash + page_offset(page) + PAGE_BITMAP_OFFSET, sizeof(bitmap));
+
+    int first_word = entry * 2 / 32;
+    int last_word  = (entry + count - 1) * 2 / 32;
+
+    for (int i = entry; i < entry + count; i++) {
+        int bit = i * 2;
+        bitmap[bit / 32] &= ~(0x3U << (bit % 32));
+        bitmap[bit / 32] |= ((uint32_t)state << (bit % 32));
+    }
+
+    for (int word = first_word; word <= last_word; word++) {
+        flash_write(part, page_offset(page) + PAGE_BITMAP_OFFSET + word * sizeof(uint32_t),
+                    &bitmap[word], sizeof(uint32_t));
+    }
+}
+
+static uint8_t page_get_entry_state(const uint32_t *bitmap, int entry)
+{
+    int bit = entry * 2;
+    return (bitmap[bit / 32] >> (bit % 32)) & 0x3;
+}
+
+static emul_partition_t *partition_find(const char *label)
+{
+    for (int i = 0; i < NVS_EMUL_MAX_PARTITIONS; i++) {
+        if (g_partitions[i].used && !strcmp(g_partitions[i].label, label)) {
+            return &g_partitions[i];
+        }
+    }
+
+    return NULL;
+}
+
+static emul_item_t *chunk_find(emul_partition_t *part, uint8_t ns, const char *key, uint8_t chunk_index)
+{
+    for (size_t i = 0; i < part->item_count; i++) {
+        if (part->items[i].ns == ns && part->items[i].chunk_index == chunk_index
+                && !strncmp(part->items[i].key, key, NVS_KEY_NAME_MAX_SIZE)) {
+            return &part->items[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Find a key, the index of a blob stands for it and its data chunk is left out
+ */
+static emul_item_t *item_find(emul_partition_t *part, uint8_t ns, const char *key)
+{
+    return chunk_find(part, ns, key, CHUNK_INDEX_ANY);
+}
+
+static esp_err_t item_add(emul_partition_t *part, const emul_item_t *item)
+{
+    if (part->item_count == part->item_capacity) {
+        size_t capacity = part->item_capacity ? part->item_capacity * 2 : 64;
+        emul_item_t *items = realloc(part->items, capacity * sizeof(emul_item_t));
+
+        if (!items) {
+            return ESP_ERR_NO_MEM;
+        }
+
+        part->items = items;
+        part->item_capacity = capacity;
+    }
+
+    part->items[part->item_count++] = *item;
+    return ESP_OK;
+}
+
+static void item_remove(emul_partition_t *part, emul_item_t *item)
+{
+    size_t index = item - part->items;
+    part->items[index] = part->items[--part->item_count];
+}
+
+static void page_activate(emul_partition_t *part, int page)
+{
+    uint8_t header[32];
+    uint32_t state = PAGE_STATE_ACTIVE;
+    uint32_t seq   = part->next_seq++;
+
+    memset(header, 0xff, sizeof(header));
+    memcpy(header, &state, sizeof(state));
+    memcpy(header + 4, &seq, sizeof(seq));
+    header[8] = 0xfe; /**< Version 2 */
+    flash_write(part, page_offset(page), header, sizeof(header));
+
+    part->pages[page].state     = PAGE_STATE_ACTIVE;
+    part->pages[page].seq       = seq;
+    part->pages[page].next_free = 0;
+    part->pages[page].used      = 0;
+    part->pages[page].erased    = 0;
+    part->active = page;
+}
+
+/**
+ * @brief Move the live items of the page with the most erased entries into
+ *        the reserved free page, then erase it. Equivalent of the NVS
+ *        PageManager::requestNewPage() compaction path.
+ */
+static esp_err_t partition_collect_garbage(emul_partition_t *part, int free_page)
+{
+    int victim = -1;
+
+    for (int i = 0; i < part->sector_count; i++) {
+        emul_page_t *page = &part->pages[i];
+
+        if (page->state != PAGE_STATE_FULL || page->erased == 0) {
+            continue;
+        }
+
+        /**< On a tie the oldest page wins, like the sequence ordered NVS page list */
+        if (victim < 0 || page->erased > part->pages[victim].erased
+                || (page->erased == part->pages[victim].erased && page->seq < part->pages[victim].seq)) {
+            victim = i;
+        }
+    }
+
+    if (victim < 0) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+
+    page_activate(part, free_page);
+    page_write_state(part, victim, PAGE_STATE_FREEING);
+
+    uint8_t buffer[NVS_EMUL_ENTRY_COUNT * NVS_EMUL_ENTRY_SIZE];
+
+    for (size_t i = 0; i < part->item_count; i++) {
+        emul_item_t *item = &part->items[i];
+
+        if (item->page != victim) {
+            continue;
+        }
+
+        emul_page_t *dst = &part->pages[free_page];
+        flash_read(part, entry_offset(victim, item->entry), buffer, item->span * NVS_EMUL_ENTRY_SIZE);
+        flash_write(part, entry_offset(free_page, dst->next_free), buffer, item->span * NVS_EMUL_ENTRY_SIZE);
+        page_write_entry_state(part, free_page, dst->next_free, item->span, ENTRY_STATE_WRITTEN);
+
+        item->page  = free_page;
+        item->entry = dst->next_free;
+        dst->next_free += item->span;
+        dst->used      += item->span;
+    }
+
+    flash_erase(part, victim);
+    memset(&part->pages[victim], 0, sizeof(emul_page_t));
+    part->pages[victim].state      = PAGE_STATE_UNINITIALIZED;
+    part->pages[victim].free_order = ++part->next_free_order;
+    part->stats.gc_count++;
+
+    return ESP_OK;
+}
+
+static esp_err_t partition_request_page(emul_partition_t *part)
+{
+    if (part->active >= 0) {
+        page_write_state(part, part->active, PAGE_STATE_FULL);
+        part->active = -1;
+    }
+
+    int free_count = 0;
+    int free_page  = -1;
+
+    for (int i = 0; i < part->sector_count; i++) {
+        if (part->pages[i].state == PAGE_STATE_UNINITIALIZED) {
+            if (free_page < 0 || part->pages[i].free_order < part->pages[free_page].free_order) {
+                free_page = i;
+            }
+
+            free_count++;
+        }
+    }
+
+    if (free_count == 0) {
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+
+    /**< One free page is always kept in reserve so that garbage collection can run */
+    if (free_count > 1) {
+        page_activate(part, free_page);
+        return ESP_OK;
+    }
+
+    return partition_collect_garbage(part, free_page);
+}
+
+static esp_err_t partition_reserve(emul_partition_t *part, uint8_t span)
+{
+    while (part->active < 0 || part->pages[part->active].next_free + span > NVS_EMUL_ENTRY_COUNT) {
+        esp_err_t ret = partition_request_page(part);
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Write the entries of an item at the end of the active page, room is made by partition_reserve()
+ */
+static void partition_append(emul_partition_t *part, const uint8_t *buffer, emul_item_t *item)
+{
+    emul_page_t *dst = &part->pages[part->active];
+
+    item->page  = part->active;
+    item->entry = dst->next_free;
+
+    flash_write(part, entry_offset(item->page, item->entry), buffer, item->span * NVS_EMUL_ENTRY_SIZE);
+    page_write_entry_state(part, item->page, item->entry, item->span, ENTRY_STATE_WRITTEN);
+    dst->next_free += item->span;
+    dst->used      += item->span;
+}
+
+static esp_err_t partition_erase_item(emul_partition_t *part, emul_item_t *item)
+{
+    page_write_entry_state(part, item->page, item->entry, item->span, ENTRY_STATE_ERASED);
+    part->pages[item->page].used   -= item->span;
+    part->pages[item->page].erased += item->span;
+    item_remove(part, item);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Erase a key, the index of a blob first and then its data chunk
+ */
+static esp_err_t partition_erase_key(emul_partition_t *part, emul_item_t *item)
+{
+    uint8_t ns          = item->ns;
+    uint8_t type        = item->type;
+    uint8_t chunk_start = item->chunk_start;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    memcpy(key, item->key, sizeof(key));
+    partition_erase_item(part, item);
+
+    if (type == NVS_TYPE_BLOB) {
+        emul_item_t *chunk = chunk_find(part, ns, key, chunk_start);
+
+        if (chunk) {
+            partition_erase_item(part, chunk);
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t partition_read_item(emul_partition_t *part, uint8_t ns, uint8_t type,
+                                     const char *key, void *data, size_t *size)
+{
+    emul_item_t *item = item_find(part, ns, key);
+
+    if (!item) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    if (type != NVS_TYPE_ANY && item->type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+
+    if (!data) {
+        *size = item->size;
+        return ESP_OK;
+    }
+
+    if (*size < item->size) {
+        *size = item->size;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    /**< The data of a blob is in the chunk pointed by its index */
+    if (item->type == NVS_TYPE_BLOB) {
+        item = chunk_find(part, ns, key, item->chunk_start);
+
+        if (!item) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+    }
+
+    uint8_t buffer[NVS_EMUL_ENTRY_COUNT * NVS_EMUL_ENTRY_SIZE];
+    flash_read(part, entry_offset(item->page, item->entry), buffer, item->span * NVS_EMUL_ENTRY_SIZE);
+
+    if (item->span > 1) {
+        memcpy(data, buffer + NVS_EMUL_ENTRY_SIZE, item->size);
+    } else {
+        memcpy(data, ((emul_entry_t *)buffer)->data, item->size);
+    }
+
+    *size = item->size;
+    return ESP_OK;
+}
+
+static esp_err_t partition_write_item(emul_partition_t *part, uint8_t ns, uint8_t type,
+                                      const char *key, const void *data, size_t size)
+{
+    uint8_t span = entry_span_for(type, size);
+
+    if (span > NVS_EMUL_ENTRY_COUNT - 1) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    emul_item_t *old = item_find(part, ns, key);
+
+    /**< Writing the value already stored is a no-op in NVS, no flash access besides the compare */
+    if (old && old->type == type && old->size == size) {
+        uint8_t current[NVS_EMUL_ENTRY_COUNT * NVS_EMUL_ENTRY_SIZE];
+        size_t current_size = sizeof(current);
+
+        if (partition_read_item(part, ns, type, key, current, &current_size) == ESP_OK
+                && !memcmp(current, data, size)) {
+            return ESP_OK;
+        }
+    }
+
+    /**< The new data chunk of a blob never has the chunk index of the old one */
+    uint8_t chunk_start = (old && old->type == NVS_TYPE_BLOB && old->chunk_start == BLOB_CHUNK_VER_0)
+                          ? BLOB_CHUNK_VER_1 : BLOB_CHUNK_VER_0;
+    uint8_t buffer[NVS_EMUL_ENTRY_COUNT * NVS_EMUL_ENTRY_SIZE];
+    emul_entry_t *entry = (emul_entry_t *)buffer;
+
+    memset(buffer, 0xff, span * NVS_EMUL_ENTRY_SIZE);
+    entry->ns          = ns;
+    entry->type        = type;
+    entry->span        = span;
+    entry->chunk_index = (type == NVS_TYPE_BLOB) ? chunk_start : CHUNK_INDEX_ANY;
+    memset(entry->key, 0, sizeof(entry->key));
+    strncpy(entry->key, key, sizeof(entry->key) - 1);
+
+    if (span > 1) {
+        uint16_t size16 = size;
+        memcpy(entry->data, &size16, sizeof(size16));
+        memcpy(buffer + NVS_EMUL_ENTRY_SIZE, data, size);
+    } else {
+        memcpy(entry->data, data, size);
+    }
+
+    emul_item_t item = {
+        .ns          = ns,
+        .type        = type,
+        .span        = span,
+        .chunk_index = entry->chunk_index,
+        .chunk_start = CHUNK_INDEX_ANY,
+        .size        = size,
+    };
+    strncpy(item.key, entry->key, sizeof(item.key));
+
+    esp_err_t ret = partition_reserve(part, span);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    partition_append(part, buffer, &item);
+
+    if (type == NVS_TYPE_BLOB) {
+        uint32_t size32 = size;
+
+        ret = item_add(part, &item);
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        memset(buffer, 0xff, NVS_EMUL_ENTRY_SIZE);
+        entry->ns          = ns;
+        entry->type        = ITEM_TYPE_BLOB_IDX;
+        entry->span        = 1;
+        entry->chunk_index = CHUNK_INDEX_ANY;
+        memcpy(entry->key, item.key, sizeof(entry->key));
+        memcpy(entry->data, &size32, sizeof(size32));
+        entry->data[4] = 1;             /**< chunk count */
+        entry->data[5] = chunk_start;
+
+        item.span        = 1;
+        item.chunk_index = CHUNK_INDEX_ANY;
+        item.chunk_start = chunk_start;
+
+        ret = partition_reserve(part, 1);
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        partition_append(part, buffer, &item);
+    }
+
+    /**< The old item may have been moved by the garbage collection */
+    old = item_find(part, ns, key);
+
+    if (old) {
+        partition_erase_key(part, old);
+    }
+
+    return item_add(part, &item);
+}
+
+/**
+ * @brief Build the RAM state of a partition from its flash content, like nvs_flash_init()
+ */
+static esp_err_t partition_mount(emul_partition_t *part)
+{
+    free(part->items);
+    part->items         = NULL;
+    part->item_count    = 0;
+    part->item_capacity = 0;
+    part->active        = -1;
+    part->next_seq      = 0;
+    part->next_free_order = 0;
+
+    for (int page = 0; page < part->sector_count; page++) {
+        emul_page_t *p = &part->pages[page];
+        uint8_t header[32];
+
+        memset(p, 0, sizeof(emul_page_t));
+        flash_read(part, page_offset(page), header, sizeof(header));
+        memcpy(&p->state, header, sizeof(p->state));
+        memcpy(&p->seq, header + 4, sizeof(p->seq));
+
+        if (p->state == PAGE_STATE_UNINITIALIZED) {
+            continue;
+        }
+
+        if (p->seq >= part->next_seq) {
+            part->next_seq = p->seq + 1;
+        }
+
+        uint32_t bitmap[8];
+        uint8_t entries[NVS_EMUL_ENTRY_COUNT * NVS_EMUL_ENTRY_SIZE];
+        flash_read(part, page_offset(page) + PAGE_BITMAP_OFFSET, bitmap, sizeof(bitmap));
+        flash_read(part, entry_offset(page, 0), entries, sizeof(entries));
+
+        for (int i = 0; i < NVS_EMUL_ENTRY_COUNT;) {
+            uint8_t state = page_get_entry_state(bitmap, i);
+
+            if (state == ENTRY_STATE_EMPTY) {
+                break;
+            }
+
+            emul_entry_t *entry = (emul_entry_t *)(entries + i * NVS_EMUL_ENTRY_SIZE);
+            uint8_t span = (entry->span > 0 && entry->span + i <= NVS_EMUL_ENTRY_COUNT) ? entry->span : 1;
+
+            if (state == ENTRY_STATE_WRITTEN) {
+                emul_item_t item = {
+                    .ns          = entry->ns,
+                    .type        = entry->type,
+                    .span        = span,
+                    .entry       = i,
+                    .chunk_index = entry->chunk_index,
+                    .chunk_start = CHUNK_INDEX_ANY,
+                    .page        = page,
+                    .size        = type_size(entry->type),
+                };
+
+                if (entry->type == ITEM_TYPE_BLOB_IDX) {
+                    uint32_t size32;
+                    memcpy(&size32, entry->data, sizeof(size32));
+                    item.type        = NVS_TYPE_BLOB;
+                    item.size        = size32;
+                    item.chunk_start = entry->data[5];
+                } else if (entry->type == NVS_TYPE_STR || entry->type == ITEM_TYPE_BLOB_DATA) {
+                    uint16_t size16;
+                    memcpy(&size16, entry->data, sizeof(size16));
+                    item.size = size16;
+                }
+
+                memcpy(item.key, entry->key, sizeof(item.key));
+                item.key[sizeof(item.key) - 1] = '\0';
+                item_add(part, &item);
+                p->used += span;
+            } else {
+                p->erased += span;
+            }
+
+            i += span;
+            p->next_free = i;
+        }
+
+        /**< An interrupted compaction leaves a FREEING page, it is kept as a full page */
+        if (p->state == PAGE_STATE_ACTIVE
+                && (part->active < 0 || p->seq > part->pages[part->active].seq)) {
+            part->active = page;
+        } else if (p->state == PAGE_STATE_FREEING) {
+            p->state = PAGE_STATE_FULL;
+        }
+    }
+
+    part->mounted = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_emul_partition_add(const char *label, size_t sector_count)
+{
+    if (!label || strlen(label) >= sizeof(g_partitions[0].label)
+            || sector_count < 2 || sector_count > NVS_EMUL_MAX_SECTORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (partition_find(label)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (int i = 0; i < NVS_EMUL_MAX_PARTITIONS; i++) {
+        emul_partition_t *part = &g_partitions[i];
+
+        if (part->used) {
+            continue;
+        }
+
+        memset(part, 0, sizeof(emul_partition_t));
+        part->flash = malloc(sector_count * NVS_EMUL_SECTOR_SIZE);
+
+        if (!part->flash) {
+            return ESP_ERR_NO_MEM;
+        }
+
+        memset(part->flash, 0xff, sector_count * NVS_EMUL_SECTOR_SIZE);
+        strcpy(part->label, label);
+        part->sector_count = sector_count;
+        part->active       = -1;
+        part->used         = true;
+        return ESP_OK;
+    }
+
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_emul_load_image(const char *label, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (size <= 0 || size % NVS_EMUL_SECTOR_SIZE) {
+        fclose(fp);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    emul_partition_t *part = partition_find(label);
+
+    if (!part) {
+        esp_err_t ret = nvs_emul_partition_add(label, size / NVS_EMUL_SECTOR_SIZE);
+
+        if (ret != ESP_OK) {
+            fclose(fp);
+            return ret;
+        }
+
+        part = partition_find(label);
+    } else if (part->sector_count != size / NVS_EMUL_SECTOR_SIZE) {
+        fclose(fp);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t ret = fread(part->flash, 1, size, fp);
+    fclose(fp);
+
+    part->mounted = false;
+    return (ret == size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_emul_save_image(const char *label, const char *path)
+{
+    emul_partition_t *part = partition_find(label);
+
+    if (!part) {
+        return ESP_ERR_NVS_PART_NOT_FOUND;
+    }
+
+    FILE *fp = fopen(path, "wb");
+
+    if (!fp) {
+        return ESP_FAIL;
+    }
+
+    size_t ret = fwrite(part->flash, 1, part->sector_count * NVS_EMUL_SECTOR_SIZE, fp);
+    fclose(fp);
+
+    return (ret == part->sector_count * NVS_EMUL_SECTOR_SIZE) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_emul_reboot(void)
+{
+    memset(g_handles, 0, sizeof(g_handles));
+
+    for (int i = 0; i < NVS_EMUL_MAX_PARTITIONS; i++) {
+        if (g_partitions[i].used && g_partitions[i].mounted) {
+            partition_mount(&g_partitions[i]);
+        }
+    }
+
+    return ESP_OK;
+}
+
+void nvs_emul_destroy(void)
+{
+    for (int i = 0; i < NVS_EMUL_MAX_PARTITIONS; i++) {
+        free(g_partitions[i].flash);
+        free(g_partitions[i].items);
+    }
+
+    memset(g_partitions, 0, sizeof(g_partitions));
+    memset(g_handles, 0, sizeof(g_handles));
+}
+
+void nvs_emul_set_timing(const nvs_emul_timing_t *timing)
+{
+    g_timing = *timing;
+}
+
+void nvs_emul_get_timing(nvs_emul_timing_t *timing)
+{
+    *timing = g_timing;
+}
+
+esp_err_t nvs_emul_get_stats(const char *label, nvs_emul_stats_t *stats)
+{
+    emul_partition_t *part = partition_find(label);
+
+    if (!part || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = part->stats;
+    return ESP_OK;
+}
+
+esp_err_t nvs_emul_reset_stats(const char *label)
+{
+    emul_partition_t *part = partition_find(label);
+
+    if (!part) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(&part->stats, 0, sizeof(part->stats));
+    memset(part->erase_count, 0, sizeof(part->erase_count));
+    return ESP_OK;
+}
+
+esp_err_t nvs_emul_get_erase_counts(const char *label, uint32_t *counts, size_t *number)
+{
+    emul_partition_t *part = partition_find(label);
+
+    if (!part || !counts || !number) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(counts, part->erase_count, part->sector_count * sizeof(uint32_t));
+    *number = part->sector_count;
+    return ESP_OK;
+}
+
+uint64_t nvs_emul_get_time_us(void)
+{
+    return g_flash_time_us;
+}
+
+/**
+ * @brief nvs_flash.h
+ */
+esp_err_t nvs_flash_init_partition(const char *partition_label)
+{
+    emul_partition_t *part = partition_find(partition_label);
+
+    if (!part) {
+        if (strcmp(partition_label, NVS_DEFAULT_PART_NAME)) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        esp_err_t ret = nvs_emul_partition_add(partition_label, DEFAULT_SECTOR_COUNT);
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        part = partition_find(partition_label);
+    }
+
+    if (part->mounted) {
+        return ESP_OK;
+    }
+
+    return partition_mount(part);
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_deinit_partition(const char *partition_label)
+{
+    emul_partition_t *part = partition_find(partition_label);
+
+    if (!part || !part->mounted) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    for (int i = 0; i < MAX_HANDLES; i++) {
+        if (g_handles[i].used && &g_partitions[g_handles[i].part] == part) {
+            g_handles[i].used = false;
+        }
+    }
+
+    part->mounted = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_deinit(void)
+{
+    return nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_erase_partition(const char *part_name)
+{
+    emul_partition_t *part = partition_find(part_name);
+
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (part->mounted) {
+        nvs_flash_deinit_partition(part_name);
+    }
+
+    for (int i = 0; i < part->sector_count; i++) {
+        flash_erase(part, i);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return nvs_flash_erase_partition(NVS_DEFAULT_PART_NAME);
+}
+
+/**
+ * @brief nvs.h
+ */
+static emul_handle_t *handle_get(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > MAX_HANDLES || !g_handles[handle - 1].used) {
+        return NULL;
+    }
+
+    return &g_handles[handle - 1];
+}
+
+static esp_err_t namespace_get(emul_partition_t *part, const char *name, bool create, uint8_t *index)
+{
+    size_t size = sizeof(uint8_t);
+
+    if (partition_read_item(part, NS_INDEX_NAMESPACES, NVS_TYPE_U8, name, index, &size) == ESP_OK) {
+        return ESP_OK;
+    }
+
+    if (!create) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    uint8_t used[NS_INDEX_MAX + 1] = {0};
+
+    for (size_t i = 0; i < part->item_count; i++) {
+        if (part->items[i].ns == NS_INDEX_NAMESPACES) {
+            size = sizeof(uint8_t);
+            uint8_t value = 0;
+            partition_read_item(part, NS_INDEX_NAMESPACES, NVS_TYPE_U8, part->items[i].key, &value, &size);
+            used[value] = 1;
+        }
+    }
+
+    for (int i = 1; i <= NS_INDEX_MAX; i++) {
+        if (!used[i]) {
+            *index = i;
+            return partition_write_item(part, NS_INDEX_NAMESPACES, NVS_TYPE_U8, name, index, sizeof(uint8_t));
+        }
+    }
+
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+esp_err_t nvs_open_from_partition(const char *part_name, const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!part_name || !name || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (strlen(name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    emul_partition_t *part = partition_find(part_name);
+
+    if (!part || !part->mounted) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    uint8_t ns = 0;
+    esp_err_t ret = namespace_get(part, name, open_mode == NVS_READWRITE, &ns);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    for (int i = 0; i < MAX_HANDLES; i++) {
+        if (!g_handles[i].used) {
+            g_handles[i].used     = true;
+            g_handles[i].part     = part - g_partitions;
+            g_handles[i].ns       = ns;
+            g_handles[i].readonly = (open_mode == NVS_READONLY);
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+
+    ESP_LOGE(TAG, "Out of handles");
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, name, open_mode, out_handle);
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    emul_handle_t *h = handle_get(handle);
+
+    if (h) {
+        h->used = false;
+    }
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    /**< Items are written through, like NVS, so commit only validates the handle */
+    return handle_get(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+static esp_err_t handle_set(nvs_handle_t handle, uint8_t type, const char *key, const void *data, size_t size)
+{
+    emul_handle_t *h = handle_get(handle);
+
+    if (!h) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    if (h->readonly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+
+    if (!key || !*key) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    return partition_write_item(&g_partitions[h->part], h->ns, type, key, data, size);
+}
+
+static esp_err_t handle_get_item(nvs_handle_t handle, uint8_t type, const char *key, void *data, size_t *size)
+{
+    emul_handle_t *h = handle_get(handle);
+
+    if (!h) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    if (!key || !size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return partition_read_item(&g_partitions[h->part], h->ns, type, key, data, size);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    emul_handle_t *h = handle_get(handle);
+
+    if (!h) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    if (h->readonly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+
+    emul_partition_t *part = &g_partitions[h->part];
+    emul_item_t *item = item_find(part, h->ns, key);
+
+    if (!item) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    return partition_erase_key(part, item);
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    emul_handle_t *h = handle_get(handle);
+
+    if (!h) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+
+    if (h->readonly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+
+    emul_partition_t *part = &g_partitions[h->part];
+
+    for (size_t i = 0; i < part->item_count;) {
+        if (part->items[i].ns == h->ns) {
+            partition_erase_item(part, &part->items[i]);
+        } else {
+            i++;
+        }
+    }
+
+    return ESP_OK;
+}
+
+#define NVS_EMUL_TYPED_ITEM(name, type, nvs_type) \
+    esp_err_t nvs_set_##name(nvs_handle_t handle, const char *key, type value) \
+    { \
+        return handle_set(handle, nvs_type, key, &value, sizeof(value)); \
+    } \
+    esp_err_t nvs_get_##name(nvs_handle_t handle, const char *key, type *out_value) \
+    { \
+        size_t size = sizeof(type); \
+        return handle_get_item(handle, nvs_type, key, out_value, &size); \
+    }
+
+NVS_EMUL_TYPED_ITEM(i8, int8_t, NVS_TYPE_I8)
+NVS_EMUL_TYPED_ITEM(u8, uint8_t, NVS_TYPE_U8)
+NVS_EMUL_TYPED_ITEM(i16, int16_t, NVS_TYPE_I16)
+NVS_EMUL_TYPED_ITEM(u16, uint16_t, NVS_TYPE_U16)
+NVS_EMUL_TYPED_ITEM(i32, int32_t, NVS_TYPE_I32)
+NVS_EMUL_TYPED_ITEM(u32, uint32_t, NVS_TYPE_U32)
+NVS_EMUL_TYPED_ITEM(i64, int64_t, NVS_TYPE_I64)
+NVS_EMUL_TYPED_ITEM(u64, uint64_t, NVS_TYPE_U64)
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    if (!value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return handle_set(handle, NVS_TYPE_STR, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return handle_get_item(handle, NVS_TYPE_STR, key, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (!value && length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return handle_set(handle, NVS_TYPE_BLOB, key, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return handle_get_item(handle, NVS_TYPE_BLOB, key, out_value, length);
+}
+
+struct nvs_opaque_iterator_t {
+    int part;
+    int ns;                 /**< -1 matches every namespace */
+    uint8_t type;
+    size_t index;
+};
+
+static bool iterator_match(const struct nvs_opaque_iterator_t *it, const emul_item_t *item)
+{
+    if (item->ns == NS_INDEX_NAMESPACES || item->chunk_index != CHUNK_INDEX_ANY) {
+        return false;
+    }
+
+    if (it->ns >= 0 && item->ns != it->ns) {
+        return false;
+    }
+
+    return it->type == NVS_TYPE_ANY || item->type == it->type;
+}
+
+static nvs_iterator_t iterator_seek(nvs_iterator_t it)
+{
+    emul_partition_t *part = &g_partitions[it->part];
+
+    for (; it->index < part->item_count; it->index++) {
+        if (iterator_match(it, &part->items[it->index])) {
+            return it;
+        }
+    }
+
+    free(it);
+    return NULL;
+}
+
+nvs_iterator_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type)
+{
+    emul_partition_t *part = partition_find(part_name);
+
+    if (!part || !part->mounted) {
+        return NULL;
+    }
+
+    int ns = -1;
+
+    if (namespace_name) {
+        uint8_t index = 0;
+
+        if (namespace_get(part, namespace_name, false, &index) != ESP_OK) {
+            return NULL;
+        }
+
+        ns = index;
+    }
+
+    nvs_iterator_t it = calloc(1, sizeof(struct nvs_opaque_iterator_t));
+
+    if (!it) {
+        return NULL;
+    }
+
+    it->part = part - g_partitions;
+    it->ns   = ns;
+    it->type = type;
+
+    return iterator_seek(it);
+}
+
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator)
+{
+    if (!iterator) {
+        return NULL;
+    }
+
+    iterator->index++;
+    return iterator_seek(iterator);
+}
+
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t *out_info)
+{
+    emul_partition_t *part = &g_partitions[iterator->part];
+    emul_item_t *item = &part->items[iterator->index];
+
+    memset(out_info, 0, sizeof(nvs_entry_info_t));
+    memcpy(out_info->key, item->key, sizeof(out_info->key));
+    out_info->type = item->type;
+
+    /**< The namespace name is the key of the namespace 0 entry holding the index */
+    for (size_t i = 0; i < part->item_count; i++) {
+        uint8_t index = 0;
+        size_t size   = sizeof(index);
+
+        if (part->items[i].ns == NS_INDEX_NAMESPACES
+                && partition_read_item(part, NS_INDEX_NAMESPACES, NVS_TYPE_U8, part->items[i].key, &index, &size) == ESP_OK
+                && index == item->ns) {
+            memcpy(out_info->namespace_name, part->items[i].key, sizeof(out_info->namespace_name));
+            break;
+        }
+    }
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator)
+{
+    free(iterator);
+}
@@ -0,0 +1,119 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define NVS_EMUL_SECTOR_SIZE     4096   /**< Size of one flash sector / NVS page */
+#define NVS_EMUL_ENTRY_SIZE      32     /**< Size of one NVS entry */
+#define NVS_EMUL_ENTRY_COUNT     126    /**< Entries per page, after the header and the state bitmap */
+#define NVS_EMUL_MAX_SECTORS     64     /**< Maximum sectors of an emulated partition */
+#define NVS_EMUL_MAX_PARTITIONS  4      /**< Maximum number of emulated partitions */
+
+/**
+ * @brief Flash cost model used to turn flash operations into modeled time
+ *
+ * The defaults are typical values for the SPI NOR flash on ESP32-C3 modules.
+ */
+typedef struct {
+    uint32_t erase_us;           /**< Time to erase one 4 KB sector */
+    uint32_t write_op_us;        /**< Fixed cost of one flash write call */
+    uint32_t write_ns_per_byte;  /**< Program time per byte */
+    uint32_t read_op_us;         /**< Fixed cost of one flash read call */
+    uint32_t read_ns_per_byte;   /**< Read time per byte */
+} nvs_emul_timing_t;
+
+/**
+ * @brief Flash statistics of one emulated partition
+ */
+typedef struct {
+    uint64_t bytes_written;  /**< Bytes programmed into the flash */
+    uint64_t bytes_read;     /**< Bytes read from the flash */
+    uint32_t write_ops;      /**< Number of flash write calls */
+    uint32_t read_ops;       /**< Number of flash read calls */
+    uint32_t erase_ops;      /**< Number of sector erases */
+    uint32_t gc_count;       /**< Number of pages reclaimed by garbage collection */
+    uint64_t flash_time_us;  /**< Modeled time spent in flash operations */
+} nvs_emul_stats_t;
+
+/**
+ * @brief  Create an emulated partition backed by memory, all sectors erased
+ *
+ * @param  label        Partition label, e.g. "nvs" or "fctry"
+ * @param  sector_count Number of 4 KB sectors, the partition table uses 0x6000 (6 sectors)
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_INVALID_STATE  The label already exists
+ *     - ESP_ERR_NO_MEM
+ */
+esp_err_t nvs_emul_partition_add(const char *label, size_t sector_count);
+
+/**
+ * @brief  Load a partition image from a file, creating the partition if needed
+ *
+ * @note   The image keeps the NVS page/entry geometry but is not byte compatible
+ *         with nvs_partition_gen.py (no CRCs, blobs are stored in a single chunk).
+ */
+esp_err_t nvs_emul_load_image(const char *label, const char *path);
+
+/**
+ * @brief  Save the raw flash content of a partition to a file
+ */
+esp_err_t nvs_emul_save_image(const char *label, const char *path);
+
+/**
+ * @brief  Simulate a power cycle: close all handles, drop the RAM index and
+ *         mount every initialized partition again by scanning the flash
+ */
+esp_err_t nvs_emul_reboot(void);
+
+/**
+ * @brief  Remove all partitions and free their memory
+ */
+void nvs_emul_destroy(void);
+
+void nvs_emul_set_timing(const nvs_emul_timing_t *timing);
+void nvs_emul_get_timing(nvs_emul_timing_t *timing);
+
+esp_err_t nvs_emul_get_stats(const char *label, nvs_emul_stats_t *stats);
+esp_err_t nvs_emul_reset_stats(const char *label);
+
+/**
+ * @brief  Get the erase count of every sector of a partition
+ *
+ * @param  label  Partition label
+ * @param  counts Output array, at least NVS_EMUL_MAX_SECTORS elements
+ * @param  number Output, number of sectors of the partition
+ */
+esp_err_t nvs_emul_get_erase_counts(const char *label, uint32_t *counts, size_t *number);
+
+/**
+ * @brief  Modeled flash time of all partitions since start, used to measure
+ *         the latency of a single operation
+ */
+uint64_t nvs_emul_get_time_us(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,6 +6,7 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <string.h>
+#include <sys/param.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
@@ -13,6 +14,8 @@
 #include <esp_event.h>
 #include <esp_log.h>
 #include <esp_idf_version.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 1, 0)
 // Features supported in 4.1+
 #define ESP_NETIF_SUPPORTED
@@ -34,11 +37,15 @@
 #include <qrcode.h>
 #include <nvs.h>
 #include <nvs_flash.h>
+#include "app_storage.h"
 #include "app_wifi.h"
+#include "app_wifi_priv.h"
 
 static const char *TAG = "app_wifi";
 static const int WIFI_CONNECTED_EVENT = BIT0;
+static const int WIFI_PROVISIONING_EVENT = BIT1;
 static EventGroupHandle_t wifi_event_group;
+static app_wifi_async_config_t wifi_async_config;
 
 #define PROV_QR_VERSION "v1"
 
@@ -49,6 +56,64 @@ static EventGroupHandle_t wifi_event_group;
 #define CREDENTIALS_NAMESPACE   "rmaker_creds"
 #define RANDOM_NVS_KEY          "random"
 
+#define WIFI_AP_CACHE_KEY       "wifi_ap"
+
+/**
+ * @brief The access point of the last connection, tried first at the next boot
+ */
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode;
+} app_wifi_ap_cache_t;
+
+/**
+ * @brief Phases of the connection started by wifi_init_sta()
+ */
+typedef struct {
+    int64_t start_time;             /**< esp_wifi_start() */
+    int64_t connected_time;         /**< associated with the AP */
+    int64_t attempt_time;           /**< last esp_wifi_connect() */
+    bool fast_connect;              /**< the station is pinned to the cached AP */
+    bool fallback;                  /**< the directed attempt failed, full scan */
+    bool cached_lease;              /**< the address of the last DHCP lease is used */
+    bool cache_valid;
+    wifi_auth_mode_t threshold;     /**< auth mode threshold of the configuration, replaced by the cached one for a fast connect */
+    app_wifi_ap_cache_t cache;      /**< loaded at boot, updated after each connection */
+    app_wifi_ap_cache_t connected;  /**< AP of the current connection, saved when it gets an IP */
+} app_wifi_connect_t;
+
+static app_wifi_connect_t wifi_connect;
+
+#define RECONNECT_BACKOFF_MIN_MS    CONFIG_APP_WIFI_RECONNECT_BACKOFF_MIN_MS
+#define RECONNECT_BACKOFF_MAX_MS    CONFIG_APP_WIFI_RECONNECT_BACKOFF_MAX_MS
+#define RECONNECT_AUTH_FAIL_MIN_MS  CONFIG_APP_WIFI_RECONNECT_AUTH_FAIL_MIN_MS
+
+/**
+ * @brief Reconnection scheduler, the delay doubles after each failed attempt
+ *        up to the ceiling, and a random jitter spreads the devices of a network
+ */
+typedef struct {
+    esp_timer_handle_t timer;
+    uint8_t attempt;                /**< failed attempts since the last connection */
+    app_wifi_stats_t stats;
+} app_wifi_reconnect_t;
+
+static app_wifi_reconnect_t wifi_reconnect;
+
+/**
+ * @brief Modem sleep settings, kept until Wi-Fi is initialized and the station started
+ */
+static struct {
+    bool wifi_initialized;
+    bool sta_started;               /**< the station configuration belongs to app_wifi, not to provisioning */
+    wifi_ps_type_t ps_type;
+    uint16_t listen_interval;       /**< beacon intervals, 0 for the default */
+} wifi_power_save = {
+    .ps_type = WIFI_PS_MIN_MODEM,
+};
+
 #ifdef CONFIG_APP_WIFI_SHOW_DEMO_INTRO_TEXT
 
 #define ESP_RAINMAKER_GITHUB_EXAMPLES_PATH  "https://github.com/espressif/esp-rainmaker/blob/master/examples"
@@ -109,6 +174,307 @@ static void app_wifi_print_qr(const char *name, const char *pop, const char *tra
     ESP_LOGI(TAG, "If QR code is not visible, copy paste the below URL in a browser.\n%s?data=%s", QRCODE_BASE_URL, payload);
 }
 
+/**
+ * @brief Log the phases of the connection and save the AP if it changed
+ */
+static void wifi_connect_done(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (wifi_connect.start_time) {
+        ESP_LOGI(TAG, "Wi-Fi %s: associated in %lld ms, got %s IP in %lld ms",
+                 wifi_connect.fast_connect ? "fast connect" : wifi_connect.fallback ? "fast connect fallback" : "full scan",
+                 (wifi_connect.connected_time - wifi_connect.start_time) / 1000,
+                 wifi_connect.cached_lease ? "cached" : "DHCP", (now - wifi_connect.start_time) / 1000);
+        wifi_connect.start_time = 0;
+    }
+
+    /**< Only written when the AP changed, a reconnection to the same AP costs no flash write */
+    if (!wifi_connect.cache_valid || memcmp(&wifi_connect.cache, &wifi_connect.connected, sizeof(app_wifi_ap_cache_t))) {
+        if (app_storage_set(WIFI_AP_CACHE_KEY, &wifi_connect.connected, sizeof(app_wifi_ap_cache_t)) == ESP_OK) {
+            wifi_connect.cache = wifi_connect.connected;
+            wifi_connect.cache_valid = true;
+        }
+    }
+}
+
+/**
+ * @brief Forget the cached AP in the station configuration, the next attempt scans all the channels
+ *        and accepts the APs allowed by the configuration, not only the auth mode of the cached one
+ */
+static void wifi_connect_full_scan(void)
+{
+    wifi_config_t wifi_config = {0};
+
+    esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+    wifi_config.sta.bssid_set = false;
+    wifi_config.sta.channel = 0;
+    wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    wifi_config.sta.threshold.authmode = wifi_connect.threshold;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+}
+
+/**
+ * @brief Connect to the AP of the last connection without scanning, if it is
+ *        known for the provisioned SSID
+ *
+ * @return true if the station is configured for a fast connect
+ */
+static bool wifi_connect_fast_config(void)
+{
+#ifdef CONFIG_APP_WIFI_FAST_CONNECT
+    wifi_config_t wifi_config = {0};
+
+    if (app_storage_get(WIFI_AP_CACHE_KEY, &wifi_connect.cache, sizeof(app_wifi_ap_cache_t)) != ESP_OK) {
+        return false;
+    }
+
+    wifi_connect.cache_valid = true;
+    esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+    wifi_connect.threshold = wifi_config.sta.threshold.authmode;
+
+    if (!wifi_connect.cache.channel) {
+        return false;
+    }
+
+    /**< A cache of other credentials, e.g. before a new provisioning, unless they are a stored profile */
+    if (memcmp(wifi_config.sta.ssid, wifi_connect.cache.ssid, sizeof(wifi_config.sta.ssid))
+            && !app_wifi_profile_config(wifi_connect.cache.ssid, &wifi_config)) {
+        return false;
+    }
+
+    memcpy(wifi_config.sta.bssid, wifi_connect.cache.bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.bssid_set = true;
+    wifi_config.sta.channel = wifi_connect.cache.channel;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    wifi_config.sta.threshold.authmode = wifi_connect.cache.authmode;
+
+    if (esp_wifi_set_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Fast connect to " MACSTR " on channel %d", MAC2STR(wifi_connect.cache.bssid), wifi_connect.cache.channel);
+    return true;
+#else
+    return false;
+#endif /* CONFIG_APP_WIFI_FAST_CONNECT */
+}
+
+/**
+ * @brief Connect with the station configuration
+ */
+static void wifi_connect_attempt(void)
+{
+    wifi_connect.attempt_time = esp_timer_get_time();
+    wifi_power_save_listen_interval_apply();
+    esp_wifi_connect();
+}
+
+/**
+ * @brief Connect again, or scan first if another profile may do better than the failing one
+ */
+static void wifi_reconnect_attempt(void)
+{
+    wifi_reconnect.stats.reconnect_attempts++;
+
+    if (!app_wifi_profile_rescan()) {
+        wifi_connect_attempt();
+    }
+}
+
+static void wifi_reconnect_timer_cb(void *arg)
+{
+    wifi_reconnect_attempt();
+}
+
+/**
+ * @brief Minimum delay before a reconnection for a disconnection reason, before the backoff
+ */
+static uint32_t wifi_reconnect_base_ms(uint8_t reason)
+{
+    switch (reason) {
+        /**< Wrong password or an AP refusing stations: retrying fast won't help */
+        case WIFI_REASON_AUTH_FAIL:
+        case WIFI_REASON_AUTH_EXPIRE:
+        case WIFI_REASON_ASSOC_FAIL:
+        case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+        case WIFI_REASON_HANDSHAKE_TIMEOUT:
+        case WIFI_REASON_MIC_FAILURE:
+            wifi_reconnect.stats.auth_failures++;
+            return RECONNECT_AUTH_FAIL_MIN_MS;
+
+        /**< The AP is rebooting or out of range */
+        case WIFI_REASON_NO_AP_FOUND:
+        case WIFI_REASON_BEACON_TIMEOUT:
+            wifi_reconnect.stats.ap_not_found++;
+            return RECONNECT_BACKOFF_MIN_MS;
+
+        default:
+            return RECONNECT_BACKOFF_MIN_MS;
+    }
+}
+
+/**
+ * @brief Schedule the next connection attempt after a disconnection
+ */
+static void wifi_reconnect_schedule(uint8_t reason)
+{
+    uint32_t delay_ms = wifi_reconnect_base_ms(reason);
+
+    /**< The first loss of a working connection is retried at once, most are short */
+    if (wifi_reconnect.attempt == 0 && delay_ms == RECONNECT_BACKOFF_MIN_MS) {
+        wifi_reconnect.attempt++;
+        wifi_reconnect.stats.backoff_ms = 0;
+        wifi_reconnect_attempt();
+        return;
+    }
+
+    for (int i = 1; i < wifi_reconnect.attempt && delay_ms < RECONNECT_BACKOFF_MAX_MS; i++) {
+        delay_ms *= 2;
+    }
+
+    delay_ms = MIN(delay_ms, RECONNECT_BACKOFF_MAX_MS);
+
+    /**< Equal jitter: a random delay in [delay / 2, delay] */
+    delay_ms = delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+
+    wifi_reconnect.attempt = MIN(wifi_reconnect.attempt + 1, UINT8_MAX);
+    wifi_reconnect.stats.backoff_ms = delay_ms;
+    wifi_reconnect.stats.max_backoff_ms = MAX(wifi_reconnect.stats.max_backoff_ms, delay_ms);
+
+    if (!wifi_reconnect.timer) {
+        esp_timer_create_args_t timer_args = {
+            .callback = wifi_reconnect_timer_cb,
+            .name = "wifi_reconnect",
+        };
+
+        if (esp_timer_create(&timer_args, &wifi_reconnect.timer) != ESP_OK) {
+            wifi_reconnect_attempt();
+            return;
+        }
+    }
+
+    esp_timer_stop(wifi_reconnect.timer);
+    esp_timer_start_once(wifi_reconnect.timer, delay_ms * 1000ULL);
+    ESP_LOGI(TAG, "Reconnecting in %u ms, attempt %d", delay_ms, wifi_reconnect.attempt);
+}
+
+esp_err_t app_wifi_get_stats(app_wifi_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = wifi_reconnect.stats;
+    return ESP_OK;
+}
+
+/**
+ * @brief Put the listen interval in the station configuration, only called while not
+ *        associated: it is sent in the association request, and a new configuration
+ *        while associated may reconnect the station
+ */
+static void wifi_power_save_listen_interval_apply(void)
+{
+    wifi_config_t wifi_config = {0};
+
+    if (!wifi_power_save.sta_started || esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+        return;
+    }
+
+    if (wifi_config.sta.listen_interval != wifi_power_save.listen_interval) {
+        wifi_config.sta.listen_interval = wifi_power_save.listen_interval;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    }
+}
+
+static esp_err_t wifi_power_save_apply(void)
+{
+    esp_err_t err = esp_wifi_set_ps(wifi_power_save.ps_type);
+
+    /**< BLE provisioning needs modem sleep, WIFI_PS_NONE is refused until it ends */
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Set power save type %d, err: %s", wifi_power_save.ps_type, esp_err_to_name(err));
+    }
+
+    wifi_power_save_listen_interval_apply();
+
+    return err;
+}
+
+esp_err_t app_wifi_set_power_save(wifi_ps_type_t ps_type, uint16_t listen_interval)
+{
+    if (ps_type != WIFI_PS_NONE && ps_type != WIFI_PS_MIN_MODEM && ps_type != WIFI_PS_MAX_MODEM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /**< Only the power save type changes at runtime, the listen interval waits for the next connection */
+    if (wifi_power_save.wifi_initialized) {
+        esp_err_t err = esp_wifi_set_ps(ps_type);
+
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Set power save type %d, err: %s", ps_type, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    wifi_power_save.ps_type = ps_type;
+    wifi_power_save.listen_interval = listen_interval;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Update the event groups and call the state callback of the application
+ */
+static void wifi_state_notify(app_wifi_state_t state)
+{
+    EventBits_t bits = xEventGroupGetBits(wifi_event_group);
+    EventGroupHandle_t group = wifi_async_config.event_group;
+
+    switch (state) {
+        case APP_WIFI_STATE_PROVISIONING:
+            xEventGroupSetBits(wifi_event_group, WIFI_PROVISIONING_EVENT);
+            if (group && wifi_async_config.provisioning_bit) {
+                xEventGroupSetBits(group, wifi_async_config.provisioning_bit);
+            }
+            break;
+
+        case APP_WIFI_STATE_PROVISIONED:
+            xEventGroupClearBits(wifi_event_group, WIFI_PROVISIONING_EVENT);
+            if (group && wifi_async_config.provisioning_bit) {
+                xEventGroupClearBits(group, wifi_async_config.provisioning_bit);
+            }
+            break;
+
+        case APP_WIFI_STATE_CONNECTED:
+            xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_EVENT);
+            if (group && wifi_async_config.connected_bit) {
+                xEventGroupSetBits(group, wifi_async_config.connected_bit);
+            }
+            break;
+
+        case APP_WIFI_STATE_DISCONNECTED:
+            /**< Only the loss of a connection, not each failed attempt */
+            if (!(bits & WIFI_CONNECTED_EVENT)) {
+                return;
+            }
+
+            xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_EVENT);
+            if (group && wifi_async_config.connected_bit) {
+                xEventGroupClearBits(group, wifi_async_config.connected_bit);
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    if (wifi_async_config.state_cb) {
+        wifi_async_config.state_cb(state, wifi_async_config.state_cb_arg);
+    }
+}
+
 /* Event handler for catching system events */
 static void event_handler(void* arg, esp_event_base_t event_base,
                           int32_t event_id, void* event_data)
@@ -117,6 +483,7 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         switch (event_id) {
             case WIFI_PROV_START:
                 ESP_LOGI(TAG, "Provisioning started");
+                wifi_state_notify(APP_WIFI_STATE_PROVISIONING);
                 break;
             case WIFI_PROV_CRED_RECV: {
                 wifi_sta_config_t *wifi_sta_cfg = (wifi_sta_config_t *)event_data;
@@ -136,6 +503,8 @@ static void event_handler(void* arg, esp_event_base_t event_base,
             }
             case WIFI_PROV_CRED_SUCCESS:
                 ESP_LOGI(TAG, "Provisioning successful");
+                app_wifi_profile_import();
+                wifi_state_notify(APP_WIFI_STATE_PROVISIONED);
                 break;
             case WIFI_PROV_END:
                 /* De-initialize manager once provisioning is finished */
@@ -145,21 +514,88 @@ static void event_handler(void* arg, esp_event_base_t event_base,
                 break;
         }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        /**< With several profiles, one scan selects the network to connect to */
+        if (wifi_connect.fast_connect || !app_wifi_profile_scan()) {
+            wifi_connect_attempt();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        if (app_wifi_profile_scan_done()) {
+            wifi_connect_attempt();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+        memset(&wifi_connect.connected, 0, sizeof(wifi_connect.connected));
+        memcpy(wifi_connect.connected.ssid, event->ssid, MIN(event->ssid_len, sizeof(wifi_connect.connected.ssid)));
+        memcpy(wifi_connect.connected.bssid, event->bssid, sizeof(wifi_connect.connected.bssid));
+        wifi_connect.connected.channel = event->channel;
+        wifi_connect.connected.authmode = event->authmode;
+        wifi_connect.connected_time = esp_timer_get_time();
+        /**< Before the handler of esp_netif, which starts the DHCP client */
+        wifi_connect.cached_lease = app_wifi_lease_connected(event->bssid);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
+
+        /**< The DHCP client renewing the cached address reports it again, the connection is the same */
+        if (app_wifi_lease_got_ip(wifi_connect.connected.bssid, &event->ip_info)) {
+            return;
+        }
+
         ESP_LOGI(TAG, "Connected with IP Address:" IPSTR, IP2STR(&event->ip_info.ip));
+        app_wifi_profile_connected(wifi_connect.connected.ssid,
+                                   (wifi_connect.connected_time - wifi_connect.attempt_time) / 1000);
+        wifi_connect_done();
+        wifi_reconnect.attempt = 0;
+        wifi_reconnect.stats.backoff_ms = 0;
         /* Signal main application to continue execution */
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_EVENT);
+        wifi_state_notify(APP_WIFI_STATE_CONNECTED);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGI(TAG, "Disconnected. Connecting to the AP again...");
-        esp_wifi_connect();
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+        wifi_reconnect.stats.disconnects++;
+        wifi_reconnect.stats.last_reason = event->reason;
+        app_wifi_lease_disconnected();
+        app_wifi_profile_disconnected(app_wifi_is_connected());
+        wifi_state_notify(APP_WIFI_STATE_DISCONNECTED);
+
+        if (wifi_connect.fast_connect && wifi_connect.start_time) {
+            ESP_LOGW(TAG, "Fast connect failed, reason: %d, %lld ms after start. Scanning all channels...",
+                     event->reason, (esp_timer_get_time() - wifi_connect.start_time) / 1000);
+            wifi_connect.fast_connect = false;
+            wifi_connect.fallback = true;
+            /**< The fallback is not a retry of the same attempt, no backoff */
+            wifi_reconnect.stats.reconnect_attempts++;
+
+            /**< Unpinned first, the scan of the profiles keeps the restored threshold */
+            wifi_connect_full_scan();
+
+            if (!app_wifi_profile_scan()) {
+                wifi_connect_attempt();
+            }
+        } else {
+            /**< Another AP of the SSID may be better now */
+            if (wifi_connect.fast_connect) {
+                wifi_connect.fast_connect = false;
+                wifi_connect_full_scan();
+            }
+
+            ESP_LOGI(TAG, "Disconnected, reason: %d. Connecting to the AP again...", event->reason);
+            wifi_reconnect_schedule(event->reason);
+        }
     }
 }
 
 static void wifi_init_sta()
 {
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+
+    /* The cached AP only lives in RAM, the provisioned configuration in flash is kept unchanged */
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    app_wifi_profile_import();
+    wifi_power_save.sta_started = true;
+    wifi_power_save_apply();
+    wifi_connect.fast_connect = wifi_connect_fast_config();
+    wifi_connect.fallback = false;
+    wifi_connect.start_time = esp_timer_get_time();
+
     ESP_ERROR_CHECK(esp_wifi_start());
 }
 
@@ -266,10 +702,16 @@ void app_wifi_init(void)
 #endif
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    wifi_power_save.wifi_initialized = true;
+    wifi_power_save_apply();
 }
 
-esp_err_t app_wifi_start(app_wifi_pop_type_t pop_type)
+esp_err_t app_wifi_start_async(app_wifi_pop_type_t pop_type, const app_wifi_async_config_t *async_config)
 {
+    if (async_config) {
+        wifi_async_config = *async_config;
+    }
+
     /* Configuration for the provisioning manager */
     wifi_prov_mgr_config_t config = {
         /* What is the Provisioning Scheme that we want ?
@@ -385,7 +827,29 @@ esp_err_t app_wifi_start(app_wifi_pop_type_t pop_type)
         /* Start Wi-Fi station */
         wifi_init_sta();
     }
-    /* Wait for Wi-Fi connection */
-    xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_EVENT, false, true, portMAX_DELAY);
+
     return ESP_OK;
 }
+
+esp_err_t app_wifi_wait_connected(TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_EVENT, false, true, timeout);
+    return (bits & WIFI_CONNECTED_EVENT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+bool app_wifi_is_connected(void)
+{
+    return wifi_event_group && (xEventGroupGetBits(wifi_event_group) & WIFI_CONNECTED_EVENT);
+}
+
+esp_err_t app_wifi_start(app_wifi_pop_type_t pop_type)
+{
+    esp_err_t err = app_wifi_start_async(pop_type, NULL);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    /* Wait for Wi-Fi connection */
+    return app_wifi_wait_connected(portMAX_DELAY);
+}
@@ -7,7 +7,12 @@
 */
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <esp_err.h>
+#include <esp_wifi_types.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
 
 /** Types of Proof of Possession */
 typedef enum {
@@ -17,6 +22,43 @@ typedef enum {
     POP_TYPE_RANDOM
 } app_wifi_pop_type_t;
 
+/** Connection states reported by app_wifi_start_async() */
+typedef enum {
+    /** Provisioning started, the device waits for credentials */
+    APP_WIFI_STATE_PROVISIONING,
+    /** Credentials received and verified */
+    APP_WIFI_STATE_PROVISIONED,
+    /** Connected with an IP address */
+    APP_WIFI_STATE_CONNECTED,
+    /** Connection lost, app_wifi reconnects by itself */
+    APP_WIFI_STATE_DISCONNECTED,
+} app_wifi_state_t;
+
+/**
+ * @brief Callback of the connection states, called from the default event loop task: it must not block
+ */
+typedef void (*app_wifi_state_cb_t)(app_wifi_state_t state, void *arg);
+
+/** Notifications of app_wifi_start_async(), all optional */
+typedef struct {
+    app_wifi_state_cb_t state_cb;       /**< called on each state change */
+    void *state_cb_arg;                 /**< argument of state_cb */
+    EventGroupHandle_t event_group;     /**< event group owned by the application */
+    EventBits_t connected_bit;          /**< set while connected */
+    EventBits_t provisioning_bit;       /**< set while provisioning */
+} app_wifi_async_config_t;
+
+/** Counters of the Wi-Fi reconnection scheduler */
+typedef struct {
+    uint32_t disconnects;           /**< WIFI_EVENT_STA_DISCONNECTED events */
+    uint32_t reconnect_attempts;    /**< esp_wifi_connect() calls after a disconnection */
+    uint32_t auth_failures;         /**< disconnections for an authentication or association failure */
+    uint32_t ap_not_found;          /**< disconnections for a missing AP or a beacon timeout */
+    uint32_t last_reason;           /**< wifi_err_reason_t of the last disconnection */
+    uint32_t backoff_ms;            /**< delay before the pending attempt, 0 when connected */
+    uint32_t max_backoff_ms;        /**< largest delay since boot */
+} app_wifi_stats_t;
+
 /**
  * @brief
  *
@@ -30,3 +72,86 @@ void app_wifi_init();
  * @return esp_err_t
  */
 esp_err_t app_wifi_start(app_wifi_pop_type_t pop_type);
+
+/**
+ * @brief Start provisioning or the connection without waiting for it, the
+ *        states are reported through the callback and the event group of the
+ *        application
+ *
+ * @param pop_type Type of the proof of possession for provisioning
+ * @param async_config Notifications, NULL for none
+ * @return
+ *     - ESP_OK  Provisioning or the connection started
+ *     - Others  Failed to get the PoP or to configure provisioning
+ */
+esp_err_t app_wifi_start_async(app_wifi_pop_type_t pop_type, const app_wifi_async_config_t *async_config);
+
+/**
+ * @brief Wait for a connection started by app_wifi_start_async()
+ *
+ * @param timeout Ticks to wait, portMAX_DELAY to wait forever
+ * @return
+ *     - ESP_OK  Connected
+ *     - ESP_ERR_TIMEOUT  Not connected within the timeout
+ */
+esp_err_t app_wifi_wait_connected(TickType_t timeout);
+
+/**
+ * @brief Whether the station is connected with an IP address
+ */
+bool app_wifi_is_connected(void);
+
+/**
+ * @brief Set the modem sleep mode of the station, can be called before app_wifi_init()
+ *        and at any time later
+ *
+ * @note  The listen interval is sent to the AP at the association, a new value
+ *        is put in the station configuration before the next connection attempt. It's only used by WIFI_PS_MAX_MODEM,
+ *        WIFI_PS_MIN_MODEM wakes up at each DTIM.
+ *
+ * @param ps_type WIFI_PS_NONE, WIFI_PS_MIN_MODEM or WIFI_PS_MAX_MODEM
+ * @param listen_interval Beacon intervals between two wake-ups, 0 for the default
+ * @return
+ *     - ESP_OK  Applied, or saved until Wi-Fi is initialized
+ *     - ESP_ERR_INVALID_ARG  Unknown power save type
+ *     - Others  Refused by the Wi-Fi driver, e.g. WIFI_PS_NONE during BLE provisioning,
+ *               the previous settings are kept
+ */
+esp_err_t app_wifi_set_power_save(wifi_ps_type_t ps_type, uint16_t listen_interval);
+
+/**
+ * @brief Store the credentials of a network, the best stored network in range
+ *        is selected at each connection. The provisioned network is stored
+ *        automatically.
+ *
+ * @note  A full list replaces the network unused for the longest time
+ *
+ * @param ssid SSID of the network, up to 32 characters
+ * @param password Password, NULL for an open network
+ * @return
+ *     - ESP_OK  Stored
+ *     - ESP_ERR_INVALID_ARG  Empty SSID, SSID or password too long
+ *     - ESP_ERR_NOT_SUPPORTED  CONFIG_APP_WIFI_PROFILES is disabled
+ */
+esp_err_t app_wifi_profile_add(const char *ssid, const char *password);
+
+/**
+ * @brief Forget the credentials of a network
+ *
+ * @param ssid SSID of the network
+ * @return
+ *     - ESP_OK  Removed
+ *     - ESP_ERR_NOT_FOUND  No network of this SSID is stored
+ *     - ESP_ERR_NOT_SUPPORTED  CONFIG_APP_WIFI_PROFILES is disabled
+ */
+esp_err_t app_wifi_profile_remove(const char *ssid);
+
+/**
+ * @brief Get the counters of the reconnection scheduler
+ *
+ * @param stats Counters since boot
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG  stats is NULL
+ */
+esp_err_t app_wifi_get_stats(app_wifi_stats_t *stats);
@@ -0,0 +1,395 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <lwip/netif.h>
+#include <lwip/etharp.h>
+#include <lwip/prot/ethernet.h>
+#include <lwip/prot/etharp.h>
+#include <lwip/dhcp.h>
+#include <lwip/tcpip.h>
+
+#include "app_storage.h"
+#include "app_wifi_priv.h"
+
+#ifdef CONFIG_APP_WIFI_LEASE_CACHE
+
+static const char *TAG = "app_wifi_lease";
+
+#define WIFI_LEASE_KEY              "wifi_lease"
+#define WIFI_LEASE_PROBE_PERIOD_MS  150     /**< ARP request period for the gateway and the cached address */
+#define WIFI_LEASE_PROBE_NUM        3       /**< RFC 5227 probes of the cached address unanswered before it is confirmed */
+#define WIFI_LEASE_PROBE_MAX        6       /**< requests before the cached lease is given up */
+#define WIFI_LEASE_TIME_VALID       1609459200  /**< 2021-01-01, an earlier time is not synchronized */
+
+/**
+ * @brief The last lease obtained by DHCP and the AP it was obtained from
+ */
+typedef struct {
+    uint8_t bssid[6];
+    esp_netif_ip_info_t ip_info;
+    esp_netif_dns_info_t dns[2];
+    uint32_t lease_time;    /**< seconds, 0 if unknown */
+    uint32_t obtained;      /**< time() when the lease was obtained, 0 if the time was not synchronized */
+} app_wifi_lease_t;
+
+/**
+ * @brief States of the address of the station
+ */
+typedef enum {
+    LEASE_STATE_DHCP = 0,   /**< obtained by the DHCP client of esp_netif */
+    LEASE_STATE_PROBING,    /**< cached address applied, the gateway and the address are probed */
+    LEASE_STATE_CONFIRMED,  /**< the gateway answered and nobody else has the address, the DHCP client of lwIP renews the lease */
+} app_wifi_lease_state_t;
+
+static struct {
+    app_wifi_lease_t cache;
+    bool cache_loaded;
+    bool cache_valid;
+    volatile app_wifi_lease_state_t state;
+    volatile bool gateway_found;
+    volatile bool conflict;         /**< another host sent an ARP packet from the cached address */
+    uint8_t conflict_mac[6];
+    netif_input_fn input;           /**< input of the netif, wrapped while probing */
+    uint8_t probes;
+    int64_t apply_time;
+    esp_netif_ip_info_t bound;      /**< address bound by the DHCP client of a confirmed lease */
+    esp_timer_handle_t timer;
+} wifi_lease;
+
+static esp_netif_t *wifi_lease_netif(void)
+{
+    return esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+}
+
+/**
+ * @brief Wi-Fi task: input of the station while probing, an ARP packet sent from the cached
+ *        address, or probing it, by another host is a conflict (RFC 5227 section 2.1.1)
+ */
+static err_t wifi_lease_input(struct pbuf *p, struct netif *netif)
+{
+    const struct eth_hdr *eth = (const struct eth_hdr *)p->payload;
+
+    if (p->len >= SIZEOF_ETH_HDR + SIZEOF_ETHARP_HDR && eth->type == PP_HTONS(ETHTYPE_ARP)) {
+        const struct etharp_hdr *hdr = (const struct etharp_hdr *)((const uint8_t *)p->payload + SIZEOF_ETH_HDR);
+        ip4_addr_t sender, target;
+
+        memcpy(&sender, &hdr->sipaddr, sizeof(sender));
+        memcpy(&target, &hdr->dipaddr, sizeof(target));
+
+        if (memcmp(&hdr->shwaddr, netif->hwaddr, ETH_HWADDR_LEN)
+                && (sender.addr == wifi_lease.cache.ip_info.ip.addr
+                    || (ip4_addr_isany_val(sender) && target.addr == wifi_lease.cache.ip_info.ip.addr))) {
+            memcpy(wifi_lease.conflict_mac, &hdr->shwaddr, sizeof(wifi_lease.conflict_mac));
+            wifi_lease.conflict = true;
+        }
+    }
+
+    return wifi_lease.input(p, netif);
+}
+
+/**
+ * @brief lwIP thread: probe the cached address from 0.0.0.0, look the gateway up in the
+ *        ARP table and send a request if it is missing
+ */
+static void wifi_lease_probe(void *arg)
+{
+    struct netif *netif = esp_netif_get_netif_impl(wifi_lease_netif());
+    struct eth_addr *eth_ret = NULL;
+    const ip4_addr_t *ip_ret = NULL;
+    ip4_addr_t gw = { .addr = wifi_lease.cache.ip_info.gw.addr };
+    ip4_addr_t ip = { .addr = wifi_lease.cache.ip_info.ip.addr };
+
+    if (!netif || wifi_lease.state != LEASE_STATE_PROBING) {
+        return;
+    }
+
+    if (netif->input != wifi_lease_input) {
+        wifi_lease.input = netif->input;
+        netif->input = wifi_lease_input;
+    }
+
+    etharp_acd_probe(netif, &ip);
+
+    if (etharp_find_addr(netif, &gw, &eth_ret, &ip_ret) >= 0) {
+        wifi_lease.gateway_found = true;
+    } else {
+        etharp_request(netif, &gw);
+    }
+}
+
+/**
+ * @brief lwIP thread: give the input of the station back once the probing is over
+ */
+static void wifi_lease_probe_end(void *arg)
+{
+    struct netif *netif = esp_netif_get_netif_impl(wifi_lease_netif());
+
+    if (netif && netif->input == wifi_lease_input) {
+        netif->input = wifi_lease.input;
+    }
+}
+
+/**
+ * @brief Save a lease obtained by DHCP. The times of an unchanged lease are rewritten once half
+ *        of it elapsed, so a renewed lease doesn't look expired at the next boot
+ */
+static void wifi_lease_save(const uint8_t bssid[6], const esp_netif_ip_info_t *ip_info)
+{
+    esp_netif_t *netif = wifi_lease_netif();
+    app_wifi_lease_t lease;
+    struct netif *lwip_netif = netif ? esp_netif_get_netif_impl(netif) : NULL;
+    struct dhcp *dhcp = lwip_netif ? netif_dhcp_data(lwip_netif) : NULL;
+    time_t now = time(NULL);
+
+    if (!netif) {
+        return;
+    }
+
+    memset(&lease, 0, sizeof(lease));
+    memcpy(lease.bssid, bssid, sizeof(lease.bssid));
+    lease.ip_info = *ip_info;
+    esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &lease.dns[0]);
+    esp_netif_get_dns_info(netif, ESP_NETIF_DNS_BACKUP, &lease.dns[1]);
+    lease.lease_time = dhcp ? dhcp->offered_t0_lease : 0;
+    lease.obtained = now >= WIFI_LEASE_TIME_VALID ? now : 0;
+
+    if (wifi_lease.cache_valid && !memcmp(&lease, &wifi_lease.cache, offsetof(app_wifi_lease_t, lease_time))) {
+        const app_wifi_lease_t *cache = &wifi_lease.cache;
+        bool stale = lease.obtained && (!cache->obtained || cache->lease_time != lease.lease_time
+                                        || lease.obtained - cache->obtained >= cache->lease_time / 2);
+
+        if (!stale) {
+            return;
+        }
+    }
+
+    if (app_storage_set(WIFI_LEASE_KEY, &lease, sizeof(app_wifi_lease_t)) == ESP_OK) {
+        wifi_lease.cache = lease;
+        wifi_lease.cache_valid = true;
+    }
+}
+
+/**
+ * @brief lwIP thread: the DHCP client of a confirmed lease bound or renewed it, handled by the timer
+ */
+static void wifi_lease_dhcp_cb(struct netif *netif)
+{
+    if (wifi_lease.state != LEASE_STATE_CONFIRMED || ip4_addr_isany_val(*netif_ip4_addr(netif))) {
+        return;
+    }
+
+    wifi_lease.bound.ip.addr      = netif_ip4_addr(netif)->addr;
+    wifi_lease.bound.netmask.addr = netif_ip4_netmask(netif)->addr;
+    wifi_lease.bound.gw.addr      = netif_ip4_gw(netif)->addr;
+    esp_timer_stop(wifi_lease.timer);
+    esp_timer_start_once(wifi_lease.timer, 0);
+}
+
+/**
+ * @brief lwIP thread: renew the confirmed lease with the DHCP client of lwIP, the address stays
+ *        on the netif during the exchange. esp_netif_dhcpc_start() would clear it first and break
+ *        the connections already opened, so the DHCP client of esp_netif stays stopped and the
+ *        address of esp_netif is kept in sync by wifi_lease_bound()
+ */
+static void wifi_lease_dhcp_start(void *arg)
+{
+    struct netif *netif = esp_netif_get_netif_impl(wifi_lease_netif());
+
+    if (!netif || wifi_lease.state != LEASE_STATE_CONFIRMED) {
+        return;
+    }
+
+    if (dhcp_start(netif) == ERR_OK) {
+        dhcp_set_cb(netif, wifi_lease_dhcp_cb);
+    }
+}
+
+/**
+ * @brief lwIP thread: stop the DHCP client started by wifi_lease_dhcp_start()
+ */
+static void wifi_lease_dhcp_stop(void *arg)
+{
+    struct netif *netif = esp_netif_get_netif_impl(wifi_lease_netif());
+
+    if (netif && netif_dhcp_data(netif)) {
+        dhcp_set_cb(netif, NULL);
+        dhcp_stop(netif);
+    }
+}
+
+/**
+ * @brief Timer: the DHCP client of a confirmed lease bound an address
+ */
+static void wifi_lease_bound(void)
+{
+    esp_netif_ip_info_t ip_info = wifi_lease.bound;
+
+    /**< esp_netif posts IP_EVENT_STA_GOT_IP for the new address, it is saved by app_wifi_lease_got_ip() */
+    if (memcmp(&ip_info, &wifi_lease.cache.ip_info, sizeof(ip_info))) {
+        if (ip_info.ip.addr != wifi_lease.cache.ip_info.ip.addr) {
+            ESP_LOGW(TAG, "Cached address " IPSTR " replaced by " IPSTR " at the renewal, its connections are lost",
+                     IP2STR(&wifi_lease.cache.ip_info.ip), IP2STR(&ip_info.ip));
+        }
+
+        esp_netif_set_ip_info(wifi_lease_netif(), &ip_info);
+        return;
+    }
+
+    wifi_lease_save(wifi_lease.cache.bssid, &ip_info);
+}
+
+static void wifi_lease_timer_cb(void *arg)
+{
+    esp_netif_t *netif = wifi_lease_netif();
+
+    if (wifi_lease.state == LEASE_STATE_CONFIRMED) {
+        wifi_lease_bound();
+        return;
+    }
+
+    if (wifi_lease.state != LEASE_STATE_PROBING) {
+        return;
+    }
+
+    if (wifi_lease.conflict) {
+        /**< The address was given to another host, it is released at once */
+        ESP_LOGW(TAG, "Cached address " IPSTR " used by %02x:%02x:%02x:%02x:%02x:%02x, requesting a new address",
+                 IP2STR(&wifi_lease.cache.ip_info.ip), MAC2STR(wifi_lease.conflict_mac));
+    } else if (wifi_lease.gateway_found && wifi_lease.probes + 1 >= WIFI_LEASE_PROBE_NUM) {
+        /**< The address stays in place while the lease is renewed */
+        ESP_LOGI(TAG, "Cached address confirmed in %lld ms", (esp_timer_get_time() - wifi_lease.apply_time) / 1000);
+        wifi_lease.state = LEASE_STATE_CONFIRMED;
+        tcpip_callback(wifi_lease_probe_end, NULL);
+        tcpip_callback(wifi_lease_dhcp_start, NULL);
+        return;
+    } else if (++wifi_lease.probes < WIFI_LEASE_PROBE_MAX) {
+        tcpip_callback(wifi_lease_probe, NULL);
+        esp_timer_start_once(wifi_lease.timer, WIFI_LEASE_PROBE_PERIOD_MS * 1000);
+        return;
+    } else {
+        /**< Another network behind the same BSSID: a full DHCP exchange */
+        ESP_LOGW(TAG, "Gateway " IPSTR " not found, requesting a new address", IP2STR(&wifi_lease.cache.ip_info.gw));
+    }
+
+    esp_netif_ip_info_t none = { 0 };
+
+    wifi_lease.state = LEASE_STATE_DHCP;
+    wifi_lease.cache_valid = false;
+    tcpip_callback(wifi_lease_probe_end, NULL);
+    app_storage_erase(WIFI_LEASE_KEY);
+    esp_netif_set_ip_info(netif, &none);
+    esp_netif_dhcpc_start(netif);
+}
+
+static bool wifi_lease_expired(const app_wifi_lease_t *lease)
+{
+    time_t now = time(NULL);
+
+    /**< Without a synchronized time the probe decides */
+    if (!lease->lease_time || !lease->obtained || now < WIFI_LEASE_TIME_VALID) {
+        return false;
+    }
+
+    return now >= (time_t)lease->obtained + lease->lease_time;
+}
+
+bool app_wifi_lease_connected(const uint8_t bssid[6])
+{
+    esp_netif_t *netif = wifi_lease_netif();
+
+    if (!wifi_lease.cache_loaded) {
+        wifi_lease.cache_loaded = true;
+        wifi_lease.cache_valid = app_storage_get(WIFI_LEASE_KEY, &wifi_lease.cache, sizeof(app_wifi_lease_t)) == ESP_OK;
+    }
+
+    /**< The DHCP client is started by esp_netif when the connected event is handled, after this handler */
+    if (!netif || !wifi_lease.cache_valid || memcmp(bssid, wifi_lease.cache.bssid, sizeof(wifi_lease.cache.bssid))
+            || wifi_lease_expired(&wifi_lease.cache)) {
+        wifi_lease.state = LEASE_STATE_DHCP;
+        esp_netif_dhcpc_start(netif);
+        return false;
+    }
+
+    if (!wifi_lease.timer) {
+        esp_timer_create_args_t timer_args = {
+            .callback = wifi_lease_timer_cb,
+            .name = "wifi_lease",
+        };
+
+        if (esp_timer_create(&timer_args, &wifi_lease.timer) != ESP_OK) {
+            return false;
+        }
+    }
+
+    esp_err_t ret = esp_netif_dhcpc_stop(netif);
+
+    if (ret != ESP_OK && ret != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        return false;
+    }
+
+    if (esp_netif_set_ip_info(netif, &wifi_lease.cache.ip_info) != ESP_OK) {
+        esp_netif_dhcpc_start(netif);
+        return false;
+    }
+
+    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &wifi_lease.cache.dns[0]);
+    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_BACKUP, &wifi_lease.cache.dns[1]);
+
+    ESP_LOGI(TAG, "Using the cached address " IPSTR ", gateway " IPSTR,
+             IP2STR(&wifi_lease.cache.ip_info.ip), IP2STR(&wifi_lease.cache.ip_info.gw));
+
+    /**< esp_netif posts IP_EVENT_STA_GOT_IP for the static address, the gateway and the address are probed meanwhile */
+    wifi_lease.state = LEASE_STATE_PROBING;
+    wifi_lease.gateway_found = false;
+    wifi_lease.conflict = false;
+    wifi_lease.probes = 0;
+    wifi_lease.apply_time = esp_timer_get_time();
+    tcpip_callback(wifi_lease_probe, NULL);
+    esp_timer_stop(wifi_lease.timer);
+    esp_timer_start_once(wifi_lease.timer, WIFI_LEASE_PROBE_PERIOD_MS * 1000);
+
+    return true;
+}
+
+bool app_wifi_lease_got_ip(const uint8_t bssid[6], const esp_netif_ip_info_t *ip_info)
+{
+    /**< The event of the cached address */
+    if (wifi_lease.state == LEASE_STATE_PROBING) {
+        return false;
+    }
+
+    /**< A confirmed lease renewed with a new netmask or gateway, the address in use is the same */
+    bool renewed = wifi_lease.state == LEASE_STATE_CONFIRMED && ip_info->ip.addr == wifi_lease.cache.ip_info.ip.addr;
+
+    wifi_lease_save(bssid, ip_info);
+
+    return renewed;
+}
+
+void app_wifi_lease_disconnected(void)
+{
+    if (wifi_lease.timer) {
+        esp_timer_stop(wifi_lease.timer);
+    }
+
+    if (wifi_lease.state == LEASE_STATE_PROBING) {
+        tcpip_callback(wifi_lease_probe_end, NULL);
+    } else if (wifi_lease.state == LEASE_STATE_CONFIRMED) {
+        tcpip_callback(wifi_lease_dhcp_stop, NULL);
+    }
+
+    wifi_lease.state = LEASE_STATE_DHCP;
+}
+
+#endif /* CONFIG_APP_WIFI_LEASE_CACHE */
@@ -0,0 +1,97 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_netif.h>
+#include <esp_wifi.h>
+
+/**
+ * @brief Internal interface between app_wifi.c, app_wifi_lease.c and app_wifi_profile.c
+ */
+
+#ifdef CONFIG_APP_WIFI_LEASE_CACHE
+/**
+ * @brief Apply the cached lease of the AP before the DHCP client starts,
+ *        called on WIFI_EVENT_STA_CONNECTED
+ *
+ * @return true if the cached address is used, IP_EVENT_STA_GOT_IP follows at once
+ */
+bool app_wifi_lease_connected(const uint8_t bssid[6]);
+
+/**
+ * @brief Save the lease of an address obtained by DHCP, called on IP_EVENT_STA_GOT_IP
+ *
+ * @return true if the event is the renewal of the cached address already in use, not a new address
+ */
+bool app_wifi_lease_got_ip(const uint8_t bssid[6], const esp_netif_ip_info_t *ip_info);
+
+/**
+ * @brief Stop the confirmation of a cached lease, called on WIFI_EVENT_STA_DISCONNECTED
+ */
+void app_wifi_lease_disconnected(void);
+#else
+#define app_wifi_lease_connected(bssid)         (false)
+#define app_wifi_lease_got_ip(bssid, ip_info)   (false)
+#define app_wifi_lease_disconnected()
+#endif /* CONFIG_APP_WIFI_LEASE_CACHE */
+
+#ifdef CONFIG_APP_WIFI_PROFILES
+/**
+ * @brief Add the credentials of the station configuration to the profiles,
+ *        called at start and once provisioning succeeded
+ */
+void app_wifi_profile_import(void);
+
+/**
+ * @brief Copy the credentials of a stored profile into a station configuration
+ *
+ * @return true if a profile of the SSID exists
+ */
+bool app_wifi_profile_config(const uint8_t ssid[32], wifi_config_t *wifi_config);
+
+/**
+ * @brief Scan to select a profile if there are several of them, instead of esp_wifi_connect()
+ *
+ * @return true if the scan started, app_wifi_profile_scan_done() follows
+ */
+bool app_wifi_profile_scan(void);
+
+/**
+ * @brief Scan again if the current profile failed too often, before a reconnection attempt
+ *
+ * @return true if the scan started, app_wifi_profile_scan_done() follows
+ */
+bool app_wifi_profile_rescan(void);
+
+/**
+ * @brief Configure the station for the best profile found, called on WIFI_EVENT_SCAN_DONE
+ *
+ * @return true if the scan was started by the profiles, the station has to connect
+ */
+bool app_wifi_profile_scan_done(void);
+
+/**
+ * @brief Learn from a successful connection, called on IP_EVENT_STA_GOT_IP
+ */
+void app_wifi_profile_connected(const uint8_t ssid[32], uint32_t assoc_ms);
+
+/**
+ * @brief Learn from a failed attempt, called on WIFI_EVENT_STA_DISCONNECTED
+ */
+void app_wifi_profile_disconnected(bool was_connected);
+#else
+#define app_wifi_profile_import()
+#define app_wifi_profile_config(ssid, wifi_config)  (false)
+#define app_wifi_profile_scan()                     (false)
+#define app_wifi_profile_rescan()                   (false)
+#define app_wifi_profile_scan_done()                (false)
+#define app_wifi_profile_connected(ssid, assoc_ms)
+#define app_wifi_profile_disconnected(was_connected)
+#endif /* CONFIG_APP_WIFI_PROFILES */
@@ -0,0 +1,383 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <esp_log.h>
+#include <esp_wifi.h>
+
+#include "app_storage.h"
+#include "app_wifi.h"
+#include "app_wifi_priv.h"
+
+#ifdef CONFIG_APP_WIFI_PROFILES
+
+static const char *TAG = "app_wifi_profile";
+
+#define WIFI_PROFILE_KEY            "wifi_profiles"
+#define WIFI_PROFILE_MAX            CONFIG_APP_WIFI_PROFILE_MAX
+#define WIFI_PROFILE_SWITCH_FAILS   2       /**< failed attempts before another profile is tried */
+#define WIFI_PROFILE_SCAN_MAX       20      /**< scan records examined */
+#define WIFI_PROFILE_RECENT_BONUS   6       /**< dB given to the profile of the last successful connection */
+#define WIFI_PROFILE_FAIL_PENALTY   10      /**< dB removed per failed attempt */
+#define WIFI_PROFILE_ASSOC_MS_DB    200     /**< association time worth 1 dB */
+
+/**
+ * @brief A stored network, ranked by the signal and the outcome of the past connections
+ */
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t password[64];
+    uint32_t last_success;  /**< order of the last successful connection, 0 if never */
+    uint16_t assoc_ms;      /**< average association time, 0 if unknown */
+    uint8_t failures;       /**< failed attempts since the last success */
+    uint8_t used;
+} app_wifi_profile_t;
+
+static struct {
+    app_wifi_profile_t list[WIFI_PROFILE_MAX];
+    bool loaded;
+    int current;            /**< profile of the station configuration, -1 if none */
+    bool scanning;
+} wifi_profile = {
+    .current = -1,
+};
+
+static void wifi_profile_load(void)
+{
+    if (wifi_profile.loaded) {
+        return;
+    }
+
+    if (app_storage_get(WIFI_PROFILE_KEY, wifi_profile.list, sizeof(wifi_profile.list)) != ESP_OK) {
+        memset(wifi_profile.list, 0, sizeof(wifi_profile.list));
+    }
+
+    wifi_profile.loaded = true;
+}
+
+static void wifi_profile_save(void)
+{
+    app_storage_set(WIFI_PROFILE_KEY, wifi_profile.list, sizeof(wifi_profile.list));
+}
+
+static int wifi_profile_find(const uint8_t ssid[32])
+{
+    for (int i = 0; i < WIFI_PROFILE_MAX; i++) {
+        if (wifi_profile.list[i].used && !strncmp((const char *)wifi_profile.list[i].ssid, (const char *)ssid, 32)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int wifi_profile_count(void)
+{
+    int count = 0;
+
+    for (int i = 0; i < WIFI_PROFILE_MAX; i++) {
+        count += wifi_profile.list[i].used;
+    }
+
+    return count;
+}
+
+static uint32_t wifi_profile_last_success(void)
+{
+    uint32_t last = 0;
+
+    for (int i = 0; i < WIFI_PROFILE_MAX; i++) {
+        last = MAX(last, wifi_profile.list[i].last_success);
+    }
+
+    return last;
+}
+
+esp_err_t app_wifi_profile_add(const char *ssid, const char *password)
+{
+    if (!ssid || !strlen(ssid) || strlen(ssid) > 32 || (password && strlen(password) > 64)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t key[32] = {0};
+    memcpy(key, ssid, strlen(ssid));
+    wifi_profile_load();
+
+    int index = wifi_profile_find(key);
+
+    if (index >= 0) {
+        if (!strncmp((const char *)wifi_profile.list[index].password, password ? password : "", 64)) {
+            return ESP_OK;
+        }
+    } else {
+        /**< A free slot, else the profile unused for the longest time */
+        index = 0;
+
+        for (int i = 0; i < WIFI_PROFILE_MAX; i++) {
+            if (!wifi_profile.list[i].used) {
+                index = i;
+                break;
+            }
+
+            if (wifi_profile.list[i].last_success < wifi_profile.list[index].last_success) {
+                index = i;
+            }
+        }
+
+        if (wifi_profile.list[index].used) {
+            ESP_LOGI(TAG, "Profile list full, replacing %.32s", wifi_profile.list[index].ssid);
+        }
+    }
+
+    app_wifi_profile_t *profile = &wifi_profile.list[index];
+    memset(profile, 0, sizeof(app_wifi_profile_t));
+    memcpy(profile->ssid, key, sizeof(profile->ssid));
+
+    if (password) {
+        memcpy(profile->password, password, strlen(password));
+    }
+
+    profile->used = true;
+
+    return app_storage_set(WIFI_PROFILE_KEY, wifi_profile.list, sizeof(wifi_profile.list));
+}
+
+esp_err_t app_wifi_profile_remove(const char *ssid)
+{
+    if (!ssid || strlen(ssid) > 32) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t key[32] = {0};
+    memcpy(key, ssid, strlen(ssid));
+    wifi_profile_load();
+
+    int index = wifi_profile_find(key);
+
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memset(&wifi_profile.list[index], 0, sizeof(app_wifi_profile_t));
+
+    if (wifi_profile.current == index) {
+        wifi_profile.current = -1;
+    }
+
+    return app_storage_set(WIFI_PROFILE_KEY, wifi_profile.list, sizeof(wifi_profile.list));
+}
+
+void app_wifi_profile_import(void)
+{
+    wifi_config_t wifi_config = {0};
+
+    wifi_profile_load();
+
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK || !wifi_config.sta.ssid[0]) {
+        return;
+    }
+
+    char ssid[33] = {0};
+    char password[65] = {0};
+    memcpy(ssid, wifi_config.sta.ssid, sizeof(wifi_config.sta.ssid));
+    memcpy(password, wifi_config.sta.password, sizeof(wifi_config.sta.password));
+
+    app_wifi_profile_add(ssid, password);
+    wifi_profile.current = wifi_profile_find(wifi_config.sta.ssid);
+}
+
+bool app_wifi_profile_config(const uint8_t ssid[32], wifi_config_t *wifi_config)
+{
+    wifi_profile_load();
+
+    int index = wifi_profile_find(ssid);
+
+    if (index < 0) {
+        return false;
+    }
+
+    memcpy(wifi_config->sta.ssid, wifi_profile.list[index].ssid, sizeof(wifi_config->sta.ssid));
+    memcpy(wifi_config->sta.password, wifi_profile.list[index].password, sizeof(wifi_config->sta.password));
+    wifi_profile.current = index;
+
+    return true;
+}
+
+bool app_wifi_profile_scan(void)
+{
+    wifi_scan_config_t scan_config = {
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+    };
+
+    wifi_profile_load();
+
+    /**< With one profile there is nothing to choose, the station scans by itself */
+    if (wifi_profile_count() < 2) {
+        return false;
+    }
+
+    if (esp_wifi_scan_start(&scan_config, false) != ESP_OK) {
+        return false;
+    }
+
+    wifi_profile.scanning = true;
+    return true;
+}
+
+bool app_wifi_profile_rescan(void)
+{
+    if (wifi_profile.current >= 0
+            && wifi_profile.list[wifi_profile.current].failures < WIFI_PROFILE_SWITCH_FAILS) {
+        return false;
+    }
+
+    return app_wifi_profile_scan();
+}
+
+bool app_wifi_profile_scan_done(void)
+{
+    if (!wifi_profile.scanning) {
+        return false;
+    }
+
+    wifi_profile.scanning = false;
+
+    uint16_t number = 0;
+    esp_wifi_scan_get_ap_num(&number);
+    number = MIN(number, WIFI_PROFILE_SCAN_MAX);
+
+    wifi_ap_record_t *records = calloc(MAX(number, 1), sizeof(wifi_ap_record_t));
+
+    if (!records) {
+        return true;
+    }
+
+    esp_wifi_scan_get_ap_records(&number, records);
+
+    uint32_t last_success = wifi_profile_last_success();
+    const wifi_ap_record_t *best_ap = NULL;
+    int best = -1;
+    int best_score = INT_MIN;
+
+    for (int i = 0; i < number; i++) {
+        int index = wifi_profile_find(records[i].ssid);
+
+        if (index < 0) {
+            continue;
+        }
+
+        const app_wifi_profile_t *profile = &wifi_profile.list[index];
+        int score = records[i].rssi
+                    - WIFI_PROFILE_FAIL_PENALTY * profile->failures
+                    - profile->assoc_ms / WIFI_PROFILE_ASSOC_MS_DB;
+
+        if (profile->last_success && profile->last_success == last_success) {
+            score += WIFI_PROFILE_RECENT_BONUS;
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            best = index;
+            best_ap = &records[i];
+        }
+    }
+
+    if (best >= 0) {
+        wifi_config_t wifi_config = {0};
+
+        esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+        memcpy(wifi_config.sta.ssid, wifi_profile.list[best].ssid, sizeof(wifi_config.sta.ssid));
+        memcpy(wifi_config.sta.password, wifi_profile.list[best].password, sizeof(wifi_config.sta.password));
+
+        /**< Straight to the strongest AP of the profile, the scan was just done */
+        memcpy(wifi_config.sta.bssid, best_ap->bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = best_ap->primary;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+
+        if (esp_wifi_set_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+            wifi_profile.current = best;
+            ESP_LOGI(TAG, "Selected %.32s, " MACSTR " rssi: %d, score: %d",
+                     wifi_profile.list[best].ssid, MAC2STR(best_ap->bssid), best_ap->rssi, best_score);
+        }
+    } else {
+        wifi_config_t wifi_config = {0};
+
+        /**< Not pinned to an AP that is gone, the station scans by itself */
+        esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        ESP_LOGW(TAG, "No stored network found in %d access points", number);
+    }
+
+    free(records);
+    return true;
+}
+
+void app_wifi_profile_connected(const uint8_t ssid[32], uint32_t assoc_ms)
+{
+    int index = wifi_profile_find(ssid);
+
+    if (index < 0) {
+        return;
+    }
+
+    app_wifi_profile_t *profile = &wifi_profile.list[index];
+    uint32_t last_success = wifi_profile_last_success();
+    bool recent = profile->last_success && profile->last_success == last_success;
+    int assoc_avg = profile->assoc_ms ? (profile->assoc_ms * 3 + MIN(assoc_ms, UINT16_MAX)) / 4 : MIN(assoc_ms, UINT16_MAX);
+
+    /**< A reconnection to the same network with a similar association time costs no flash write */
+    bool changed = !recent || profile->failures || abs(assoc_avg - profile->assoc_ms) > profile->assoc_ms / 4;
+
+    wifi_profile.current = index;
+    profile->assoc_ms = assoc_avg;
+    profile->failures = 0;
+
+    if (!recent) {
+        profile->last_success = last_success + 1;
+    }
+
+    if (changed) {
+        wifi_profile_save();
+    }
+}
+
+void app_wifi_profile_disconnected(bool was_connected)
+{
+    if (was_connected || wifi_profile.current < 0) {
+        return;
+    }
+
+    app_wifi_profile_t *profile = &wifi_profile.list[wifi_profile.current];
+
+    /**< Saturated, a long outage doesn't write the flash at each attempt */
+    if (profile->failures < WIFI_PROFILE_SWITCH_FAILS + 1) {
+        profile->failures++;
+        wifi_profile_save();
+    }
+}
+
+#else
+
+esp_err_t app_wifi_profile_add(const char *ssid, const char *password)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t app_wifi_profile_remove(const char *ssid)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_APP_WIFI_PROFILES */
@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "driver/adc.h"
@@ -41,6 +44,14 @@ static const char *TAG = "adc button";
 #define ADC_BUTTON_MAX_CHANNEL CONFIG_ADC_BUTTON_MAX_CHANNEL
 #define ADC_BUTTON_MAX_BUTTON  CONFIG_ADC_BUTTON_MAX_BUTTON_PER_CHANNEL
 
+#if CONFIG_ADC_BUTTON_CONTINUOUS_MODE
+#define ADC_CONTINUOUS_RESULT_SIZE   4     /**< adc_digi_output_data_t, type2 format */
+#define ADC_CONTINUOUS_FRAME_SIZE    128   /**< Bytes converted per DMA interrupt */
+#define ADC_CONTINUOUS_STORE_SIZE    1024  /**< Size of the driver ring buffer */
+#define ADC_CONTINUOUS_READ_TIMEOUT  100   /**< Lets the task notice a stop request */
+#define ADC_CONTINUOUS_TASK_STACK    2048
+#endif
+
 typedef struct {
     uint16_t min;
     uint16_t max;
@@ -51,6 +62,7 @@ typedef struct {
     uint8_t is_init;
     button_data_t btns[ADC_BUTTON_MAX_BUTTON];  /* all button on the channel */
     uint64_t last_time;  /* the last time of adc sample */
+    uint16_t voltage;    /* the last voltage of the channel in mv */
 } btn_adc_channel_t;
 
 typedef struct {
@@ -58,6 +70,11 @@ typedef struct {
     esp_adc_cal_characteristics_t adc_chars;
     btn_adc_channel_t ch[ADC_BUTTON_MAX_CHANNEL];
     uint8_t ch_num;
+#if CONFIG_ADC_BUTTON_CONTINUOUS_MODE
+    TaskHandle_t task;
+    SemaphoreHandle_t task_exit;
+    volatile bool task_running;
+#endif
 } adc_button_t;
 
 static adc_button_t g_button = {0};
@@ -82,6 +99,124 @@ static int find_channel(adc1_channel_t channel)
     return -1;
 }
 
+#if CONFIG_ADC_BUTTON_CONTINUOUS_MODE
+/**
+  * @brief  Average the conversions of each channel in every DMA frame, the
+  *         key level queries only read the resulting voltage.
+  */
+static void button_adc_continuous_task(void *arg)
+{
+    uint8_t result[ADC_CONTINUOUS_FRAME_SIZE];
+    uint32_t sum[ADC1_CHANNEL_MAX];
+    uint32_t count[ADC1_CHANNEL_MAX];
+
+    while (g_button.task_running) {
+        uint32_t length = 0;
+        esp_err_t ret = adc_digi_read_bytes(result, sizeof(result), &length, ADC_CONTINUOUS_READ_TIMEOUT);
+
+        /**< ESP_ERR_INVALID_STATE: the ring buffer overflowed, the returned data is still valid */
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+            continue;
+        }
+
+        memset(sum, 0, sizeof(sum));
+        memset(count, 0, sizeof(count));
+
+        for (uint32_t i = 0; i + ADC_CONTINUOUS_RESULT_SIZE <= length; i += ADC_CONTINUOUS_RESULT_SIZE) {
+            adc_digi_output_data_t *p = (adc_digi_output_data_t *)&result[i];
+
+            if (p->type2.unit == 0 && p->type2.channel < ADC1_CHANNEL_MAX) {
+                sum[p->type2.channel] += p->type2.data;
+                count[p->type2.channel]++;
+            }
+        }
+
+        for (size_t i = 0; i < ADC_BUTTON_MAX_CHANNEL; i++) {
+            adc1_channel_t channel = g_button.ch[i].channel;
+
+            if (g_button.ch[i].is_init && count[channel]) {
+                g_button.ch[i].voltage = esp_adc_cal_raw_to_voltage(sum[channel] / count[channel], &g_button.adc_chars);
+            }
+        }
+    }
+
+    xSemaphoreGive(g_button.task_exit);
+    vTaskDelete(NULL);
+}
+
+static void button_adc_continuous_stop(void)
+{
+    if (!g_button.task) {
+        return;
+    }
+
+    g_button.task_running = false;
+    xSemaphoreTake(g_button.task_exit, portMAX_DELAY);
+    g_button.task = NULL;
+
+    adc_digi_stop();
+    adc_digi_deinitialize();
+}
+
+/**
+  * @brief  (Re)start the conversions on all the initialized channels, the DMA
+  *         pattern can't be changed while running.
+  */
+static esp_err_t button_adc_continuous_start(void)
+{
+    adc_digi_pattern_table_t pattern[ADC_BUTTON_MAX_CHANNEL] = {0};
+    uint32_t mask = 0;
+    uint32_t pattern_len = 0;
+
+    button_adc_continuous_stop();
+
+    for (size_t i = 0; i < ADC_BUTTON_MAX_CHANNEL; i++) {
+        if (g_button.ch[i].is_init) {
+            pattern[pattern_len].atten   = ADC_BUTTON_ATTEN;
+            pattern[pattern_len].channel = g_button.ch[i].channel;
+            pattern[pattern_len].unit    = 0;
+            mask |= BIT(g_button.ch[i].channel);
+            pattern_len++;
+        }
+    }
+
+    if (0 == pattern_len) {
+        return ESP_OK;
+    }
+
+    adc_digi_init_config_t init_config = {
+        .max_store_buf_size = ADC_CONTINUOUS_STORE_SIZE,
+        .conv_num_each_intr = ADC_CONTINUOUS_FRAME_SIZE,
+        .adc1_chan_mask     = mask,
+        .adc2_chan_mask     = 0,
+    };
+    esp_err_t ret = adc_digi_initialize(&init_config);
+    ADC_BTN_CHECK(ESP_OK == ret, "adc digi initialize failed", ret);
+
+    adc_digi_config_t digi_config = {
+        .conv_limit_en   = false,
+        .conv_limit_num  = 250,
+        .adc_pattern_len = pattern_len,
+        .adc_pattern     = pattern,
+        .sample_freq_hz  = CONFIG_ADC_BUTTON_CONTINUOUS_SAMPLE_FREQ_HZ,
+    };
+    ret = adc_digi_controller_config(&digi_config);
+    ADC_BTN_CHECK(ESP_OK == ret, "adc digi controller config failed", ret);
+
+    if (!g_button.task_exit) {
+        g_button.task_exit = xSemaphoreCreateBinary();
+        ADC_BTN_CHECK(NULL != g_button.task_exit, "semaphore create failed", ESP_ERR_NO_MEM);
+    }
+
+    g_button.task_running = true;
+    BaseType_t err = xTaskCreate(button_adc_continuous_task, "adc_button", ADC_CONTINUOUS_TASK_STACK, NULL,
+                                 CONFIG_ADC_BUTTON_CONTINUOUS_TASK_PRIORITY, &g_button.task);
+    ADC_BTN_CHECK(pdPASS == err, "task create failed", ESP_ERR_NO_MEM);
+
+    return adc_digi_start();
+}
+#endif
+
 esp_err_t button_adc_init(const button_adc_config_t *config)
 {
     ADC_BTN_CHECK(NULL != config, "Pointer of config is invalid", ESP_ERR_INVALID_ARG);
@@ -100,8 +235,10 @@ esp_err_t button_adc_init(const button_adc_config_t *config)
 
     /** initialize adc */
     if (0 == g_button.is_configured) {
+#if !CONFIG_ADC_BUTTON_CONTINUOUS_MODE
         //Configure ADC
         adc1_config_width(ADC_BUTTON_WIDTH);
+#endif
         //Characterize ADC
         esp_adc_cal_value_t val_type = esp_adc_cal_characterize(ADC_BUTTON_ADC_UNIT, ADC_BUTTON_ATTEN, ADC_BUTTON_WIDTH, DEFAULT_VREF, &g_button.adc_chars);
         if (val_type == ESP_ADC_CAL_VAL_EFUSE_TP) {
@@ -116,10 +253,17 @@ esp_err_t button_adc_init(const button_adc_config_t *config)
 
     /** initialize adc channel */
     if (0 == g_button.ch[ch_index].is_init) {
+#if !CONFIG_ADC_BUTTON_CONTINUOUS_MODE
         adc1_config_channel_atten(config->adc_channel, ADC_BUTTON_ATTEN);
+#endif
         g_button.ch[ch_index].channel = config->adc_channel;
         g_button.ch[ch_index].is_init = 1;
         g_button.ch[ch_index].last_time = 0;
+        g_button.ch[ch_index].voltage = 0;
+#if CONFIG_ADC_BUTTON_CONTINUOUS_MODE
+        esp_err_t ret = button_adc_continuous_start();
+        ADC_BTN_CHECK(ESP_OK == ret, "adc continuous mode start failed", ret);
+#endif
     }
     g_button.ch[ch_index].btns[config->button_index].max = config->max;
     g_button.ch[ch_index].btns[config->button_index].min = config->min;
@@ -148,9 +292,13 @@ esp_err_t button_adc_deinit(adc1_channel_t channel, int button_index)
     }
     if (unused_button == ADC_BUTTON_MAX_BUTTON && g_button.ch[ch_index].is_init) {  /**< if all button is unused, deinit the channel */
         /* TODO: to deinit the channel  */
+        ESP_LOGD(TAG, "all button is unused on channel%d, deinit the channel", g_button.ch[ch_index].channel);
         g_button.ch[ch_index].is_init = 0;
         g_button.ch[ch_index].channel = ADC1_CHANNEL_MAX;
-        ESP_LOGD(TAG, "all button is unused on channel%d, deinit the channel", g_button.ch[ch_index].channel);
+#if CONFIG_ADC_BUTTON_CONTINUOUS_MODE
+        /**< Restart without the channel, or stop when it was the last one */
+        button_adc_continuous_start();
+#endif
     }
 
     /** check channel usage on the adc*/
@@ -163,13 +311,20 @@ esp_err_t button_adc_deinit(adc1_channel_t channel, int button_index)
     if (unused_ch == ADC_BUTTON_MAX_CHANNEL && g_button.is_configured) { /**< if all channel is unused, deinit the adc */
         /* TODO: to deinit the peripheral adc  */
         g_button.is_configured = false;
+#if CONFIG_ADC_BUTTON_CONTINUOUS_MODE
+        SemaphoreHandle_t task_exit = g_button.task_exit;
+        memset(&g_button, 0, sizeof(adc_button_t));
+        g_button.task_exit = task_exit;
+#else
         memset(&g_button, 0, sizeof(adc_button_t));
+#endif
         ESP_LOGD(TAG, "all channel is unused, , deinit adc");
     }
 
     return ESP_OK;
 }
 
+#if !CONFIG_ADC_BUTTON_CONTINUOUS_MODE
 static uint32_t get_adc_volatge(adc1_channel_t channel)
 {
     uint32_t adc_reading = 0;
@@ -183,10 +338,10 @@ static uint32_t get_adc_volatge(adc1_channel_t channel)
     ESP_LOGV(TAG, "Raw: %d\tVoltage: %dmV", adc_reading, voltage);
     return voltage;
 }
+#endif
 
 uint8_t button_adc_get_key_level(void *button_index)
 {
-    static uint16_t vol = 0;
     uint32_t ch = ADC_BUTTON_SPLIT_CHANNEL(button_index);
     uint32_t index = ADC_BUTTON_SPLIT_INDEX(button_index);
     ADC_BTN_CHECK(ch < ADC1_CHANNEL_MAX, "channel out of range", 0);
@@ -194,11 +349,16 @@ uint8_t button_adc_get_key_level(void *button_index)
     int ch_index = find_channel(ch);
     ADC_BTN_CHECK(ch_index >= 0, "The button_index is not init", 0);
 
+#if !CONFIG_ADC_BUTTON_CONTINUOUS_MODE
     /** It starts only when the elapsed time is more than 1ms */
     if ((esp_timer_get_time() - g_button.ch[ch_index].last_time) > 1000) {
-        vol = get_adc_volatge(ch);
+        g_button.ch[ch_index].voltage = get_adc_volatge(ch);
         g_button.ch[ch_index].last_time = esp_timer_get_time();
     }
+#endif
+
+    /** Each channel keeps its own voltage, the continuous mode task updates it in the background */
+    uint16_t vol = g_button.ch[ch_index].voltage;
 
     if (vol <= g_button.ch[ch_index].btns[index].max &&
             vol > g_button.ch[ch_index].btns[index].min) {
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "esp_log.h"
+#include "esp_sleep.h"
 #include "driver/gpio.h"
 #include "button_gpio.h"
 
@@ -42,11 +43,28 @@ esp_err_t button_gpio_init(const button_gpio_config_t *config)
     }
     gpio_config(&gpio_conf);
 
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    if (config->enable_power_save) {
+#if SOC_GPIO_SUPPORT_SLP_SWITCH
+        /**< Keep the pull resistor of the button while in light sleep (CONFIG_PM_SLP_DISABLE_GPIO) */
+        gpio_sleep_sel_dis(config->gpio_num);
+#endif
+        esp_err_t ret = button_gpio_enable_gpio_wakeup(config->gpio_num, config->active_level, true);
+        GPIO_BTN_CHECK(ESP_OK == ret, "Configure gpio as wakeup source failed", ret);
+    }
+#endif
+
     return ESP_OK;
 }
 
 esp_err_t button_gpio_deinit(int gpio_num)
 {
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    gpio_intr_disable(gpio_num);
+    gpio_isr_handler_remove(gpio_num);
+    gpio_wakeup_disable(gpio_num);
+#endif
+
     /** both disable pullup and pulldown */
     gpio_config_t gpio_conf = {
         .intr_type = GPIO_INTR_DISABLE,
@@ -63,3 +81,48 @@ uint8_t button_gpio_get_key_level(void *gpio_num)
 {
     return (uint8_t)gpio_get_level((uint32_t)gpio_num);
 }
+
+esp_err_t button_gpio_set_intr(int gpio_num, gpio_int_type_t intr_type, gpio_isr_t isr_handler, void *args)
+{
+    /**< The ISR service may already be installed by another driver */
+    esp_err_t ret = gpio_install_isr_service(0);
+    GPIO_BTN_CHECK(ESP_OK == ret || ESP_ERR_INVALID_STATE == ret, "Install gpio isr service failed", ret);
+
+    gpio_set_intr_type(gpio_num, intr_type);
+    ret = gpio_isr_handler_add(gpio_num, isr_handler, args);
+    GPIO_BTN_CHECK(ESP_OK == ret, "Add gpio isr handler failed", ret);
+
+    return gpio_intr_disable(gpio_num);
+}
+
+esp_err_t button_gpio_intr_control(int gpio_num, bool enable)
+{
+    /**< Called from the button ISR, no logging here */
+    if (!GPIO_IS_VALID_GPIO(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (enable) {
+        gpio_intr_enable(gpio_num);
+    } else {
+        gpio_intr_disable(gpio_num);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t button_gpio_enable_gpio_wakeup(int gpio_num, uint8_t active_level, bool enable)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (enable) {
+        /**< Only level triggers can wake the chip from light sleep */
+        ret = gpio_wakeup_enable(gpio_num, active_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+        GPIO_BTN_CHECK(ESP_OK == ret, "Enable gpio wakeup failed", ret);
+        ret = esp_sleep_enable_gpio_wakeup();
+    } else {
+        ret = gpio_wakeup_disable(gpio_num);
+    }
+
+    return ret;
+}
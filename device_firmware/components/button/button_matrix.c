@@ -0,0 +1,229 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "driver/gpio.h"
+#include "button_matrix.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "matrix button";
+
+#define MATRIX_BTN_CHECK(a, str, ret_val)                          \
+    if (!(a))                                                     \
+    {                                                             \
+        ESP_LOGE(TAG, "%s(%d): %s", __FUNCTION__, __LINE__, str); \
+        return (ret_val);                                         \
+    }
+
+typedef struct {
+    int32_t row_gpios[MATRIX_BUTTON_MAX_LINES];
+    int32_t col_gpios[MATRIX_BUTTON_MAX_LINES];
+    uint8_t row_num;
+    uint8_t col_num;
+    uint8_t key_num;                            /**< keys created on the matrix */
+    uint8_t used[MATRIX_BUTTON_MAX_LINES];      /**< created keys, a bit per column */
+    uint8_t keys[MATRIX_BUTTON_MAX_LINES];      /**< pressed keys of the last scan, a bit per column */
+    uint32_t ghost_count;
+} matrix_button_t;
+
+static matrix_button_t g_matrix = {0};
+
+static void matrix_gpio_release(const int32_t *gpios, uint8_t num)
+{
+    for (size_t i = 0; i < num; i++) {
+        gpio_config_t gpio_conf = {
+            .intr_type = GPIO_INTR_DISABLE,
+            .mode = GPIO_MODE_INPUT,
+            .pin_bit_mask = (1ULL << gpios[i]),
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .pull_up_en = GPIO_PULLUP_DISABLE,
+        };
+        gpio_config(&gpio_conf);
+    }
+}
+
+static esp_err_t matrix_gpio_config(const button_matrix_config_t *config)
+{
+    uint64_t row_mask = 0;
+    uint64_t col_mask = 0;
+
+    for (size_t i = 0; i < config->row_gpio_num; i++) {
+        MATRIX_BTN_CHECK(GPIO_IS_VALID_OUTPUT_GPIO(config->row_gpios[i]), "row gpio is invalid", ESP_ERR_INVALID_ARG);
+        row_mask |= 1ULL << config->row_gpios[i];
+    }
+
+    for (size_t i = 0; i < config->col_gpio_num; i++) {
+        MATRIX_BTN_CHECK(GPIO_IS_VALID_GPIO(config->col_gpios[i]), "col gpio is invalid", ESP_ERR_INVALID_ARG);
+        col_mask |= 1ULL << config->col_gpios[i];
+    }
+
+    MATRIX_BTN_CHECK(0 == (row_mask & col_mask), "a gpio is both a row and a column", ESP_ERR_INVALID_ARG);
+
+    /**< Released rows float, so a pressed key only pulls its column low while its row is scanned */
+    for (size_t i = 0; i < config->row_gpio_num; i++) {
+        gpio_set_level(config->row_gpios[i], 1);
+    }
+
+    gpio_config_t gpio_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT_OD,
+        .pin_bit_mask = row_mask,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+    };
+    esp_err_t ret = gpio_config(&gpio_conf);
+    MATRIX_BTN_CHECK(ESP_OK == ret, "row gpio config failed", ret);
+
+    gpio_conf.mode = GPIO_MODE_INPUT;
+    gpio_conf.pin_bit_mask = col_mask;
+    gpio_conf.pull_up_en = GPIO_PULLUP_ENABLE;
+    ret = gpio_config(&gpio_conf);
+    MATRIX_BTN_CHECK(ESP_OK == ret, "col gpio config failed", ret);
+
+    return ESP_OK;
+}
+
+esp_err_t button_matrix_init(const button_matrix_config_t *config)
+{
+    MATRIX_BTN_CHECK(NULL != config, "Pointer of config is invalid", ESP_ERR_INVALID_ARG);
+    MATRIX_BTN_CHECK(NULL != config->row_gpios && NULL != config->col_gpios, "Pointer of gpios is invalid", ESP_ERR_INVALID_ARG);
+    MATRIX_BTN_CHECK(config->row_gpio_num > 0 && config->row_gpio_num <= MATRIX_BUTTON_MAX_LINES, "row_gpio_num out of range", ESP_ERR_NOT_SUPPORTED);
+    MATRIX_BTN_CHECK(config->col_gpio_num > 0 && config->col_gpio_num <= MATRIX_BUTTON_MAX_LINES, "col_gpio_num out of range", ESP_ERR_NOT_SUPPORTED);
+    MATRIX_BTN_CHECK(config->row < config->row_gpio_num && config->col < config->col_gpio_num, "key out of range", ESP_ERR_NOT_SUPPORTED);
+
+    if (g_matrix.key_num) { /**< the matrix has been initialized */
+        MATRIX_BTN_CHECK(config->row_gpio_num == g_matrix.row_num && config->col_gpio_num == g_matrix.col_num &&
+                         !memcmp(config->row_gpios, g_matrix.row_gpios, g_matrix.row_num * sizeof(int32_t)) &&
+                         !memcmp(config->col_gpios, g_matrix.col_gpios, g_matrix.col_num * sizeof(int32_t)),
+                         "The gpios differ from the matrix", ESP_ERR_INVALID_STATE);
+        MATRIX_BTN_CHECK(!(g_matrix.used[config->row] & BIT(config->col)), "The key has been used", ESP_ERR_INVALID_STATE);
+    } else { /**< this is the first key */
+        esp_err_t ret = matrix_gpio_config(config);
+        MATRIX_BTN_CHECK(ESP_OK == ret, "matrix gpio config failed", ret);
+        memset(&g_matrix, 0, sizeof(matrix_button_t));
+        memcpy(g_matrix.row_gpios, config->row_gpios, config->row_gpio_num * sizeof(int32_t));
+        memcpy(g_matrix.col_gpios, config->col_gpios, config->col_gpio_num * sizeof(int32_t));
+        g_matrix.row_num = config->row_gpio_num;
+        g_matrix.col_num = config->col_gpio_num;
+    }
+
+    g_matrix.used[config->row] |= BIT(config->col);
+    g_matrix.key_num++;
+
+    return ESP_OK;
+}
+
+esp_err_t button_matrix_deinit(int row, int col)
+{
+    MATRIX_BTN_CHECK(row >= 0 && row < g_matrix.row_num, "row out of range", ESP_ERR_INVALID_ARG);
+    MATRIX_BTN_CHECK(col >= 0 && col < g_matrix.col_num, "col out of range", ESP_ERR_INVALID_ARG);
+    MATRIX_BTN_CHECK(g_matrix.used[row] & BIT(col), "The key is not init", ESP_ERR_INVALID_ARG);
+
+    g_matrix.used[row] &= ~BIT(col);
+    g_matrix.key_num--;
+
+    if (0 == g_matrix.key_num) { /**< if all keys are unused, release the gpios */
+        matrix_gpio_release(g_matrix.row_gpios, g_matrix.row_num);
+        matrix_gpio_release(g_matrix.col_gpios, g_matrix.col_num);
+        memset(&g_matrix, 0, sizeof(matrix_button_t));
+        ESP_LOGD(TAG, "all keys are unused, release the matrix");
+    }
+
+    return ESP_OK;
+}
+
+#if CONFIG_MATRIX_BUTTON_GHOST_DETECTION
+/**
+  * @brief  Without a diode per key, three pressed corners of a rectangle make
+  *         the fourth one read as pressed. Two rows sharing two or more columns
+  *         can't be told apart from a ghost: those keys keep their last level.
+  *
+  * @return true if some keys kept their last level
+  */
+static bool matrix_filter_ghost(uint8_t *scan)
+{
+    uint8_t ambiguous[MATRIX_BUTTON_MAX_LINES] = {0};
+    bool ghost = false;
+
+    for (size_t a = 0; a < g_matrix.row_num; a++) {
+        for (size_t b = a + 1; b < g_matrix.row_num; b++) {
+            uint8_t common = scan[a] & scan[b];
+
+            if (common & (common - 1)) {
+                ambiguous[a] |= common;
+                ambiguous[b] |= common;
+                ghost = true;
+            }
+        }
+    }
+
+    for (size_t r = 0; ghost && r < g_matrix.row_num; r++) {
+        scan[r] = (scan[r] & ~ambiguous[r]) | (g_matrix.keys[r] & ambiguous[r]);
+    }
+
+    return ghost;
+}
+#endif
+
+void button_matrix_scan(void)
+{
+    if (0 == g_matrix.key_num) {
+        return;
+    }
+
+    uint8_t scan[MATRIX_BUTTON_MAX_LINES] = {0};
+
+    /**< The cost of a scan only depends on the size of the matrix, not on the number of keys */
+    for (size_t r = 0; r < g_matrix.row_num; r++) {
+        gpio_set_level(g_matrix.row_gpios[r], 0);
+#if CONFIG_MATRIX_BUTTON_SETTLE_TIME_US
+        esp_rom_delay_us(CONFIG_MATRIX_BUTTON_SETTLE_TIME_US);
+#endif
+
+        for (size_t c = 0; c < g_matrix.col_num; c++) {
+            if (!gpio_get_level(g_matrix.col_gpios[c])) {
+                scan[r] |= BIT(c);
+            }
+        }
+
+        gpio_set_level(g_matrix.row_gpios[r], 1);
+    }
+
+#if CONFIG_MATRIX_BUTTON_GHOST_DETECTION
+    if (matrix_filter_ghost(scan)) {
+        g_matrix.ghost_count++;
+    }
+#endif
+
+    memcpy(g_matrix.keys, scan, sizeof(scan));
+}
+
+uint8_t button_matrix_get_key_level(void *key)
+{
+    uint32_t row = MATRIX_BUTTON_SPLIT_ROW(key);
+    uint32_t col = MATRIX_BUTTON_SPLIT_COL(key);
+
+    /**< Called for every key and tick, the bitmap is only read */
+    if (row >= MATRIX_BUTTON_MAX_LINES || col >= MATRIX_BUTTON_MAX_LINES) {
+        return 0;
+    }
+
+    return (g_matrix.keys[row] >> col) & 1;
+}
+
+uint32_t button_matrix_get_ghost_count(void)
+{
+    return g_matrix.ghost_count;
+}
@@ -0,0 +1,570 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * @brief Host benchmark of the button state machine: ticks per second per
+ *        button of iot_button.c, compared with the switch based state machine
+ *        it replaced (kept below as the reference), and the number of buttons
+ *        one tick can scan within a time budget.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "iot_button.h"
+#include "button_sim.h"
+
+#define BENCH_MAX_BUTTONS   BUTTON_SIM_MAX_GPIO
+#define BENCH_ROUNDS        5
+#define BENCH_BUDGET_SAMPLES    20000
+
+#define TICKS_INTERVAL    CONFIG_BUTTON_PERIOD_TIME_MS
+#define DEBOUNCE_TICKS    CONFIG_BUTTON_DEBOUNCE_TICKS
+#define SHORT_TICKS       (CONFIG_BUTTON_SHORT_PRESS_TIME_MS /TICKS_INTERVAL)
+#define LONG_TICKS        (CONFIG_BUTTON_LONG_PRESS_TIME_MS /TICKS_INTERVAL)
+
+/**
+ * @brief Reference: the button device and state machine before the table driven recogniser
+ */
+typedef struct legacy_button {
+    uint16_t        ticks;
+    uint8_t         repeat;
+    button_event_t  event;
+    uint8_t         state: 3;
+    uint8_t         debounce_cnt: 3;
+    uint8_t         active_level: 1;
+    uint8_t         button_level: 1;
+    uint8_t         (*hal_button_Level)(void *usr_data);
+    void            *usr_data;
+    button_cb_t     cb[BUTTON_EVENT_MAX];
+    struct legacy_button *next;
+} legacy_button_t;
+
+#define CALL_EVENT_CB(ev)   if(btn->cb[ev])btn->cb[ev](btn)
+
+static void legacy_handler(legacy_button_t *btn)
+{
+    uint8_t read_gpio_level = btn->hal_button_Level(btn->usr_data);
+
+    /** ticks counter working.. */
+    if ((btn->state) > 0) {
+        btn->ticks++;
+    }
+
+    /**< button debounce handle */
+    if (read_gpio_level != btn->button_level) {
+        if (++(btn->debounce_cnt) >= DEBOUNCE_TICKS) {
+            btn->button_level = read_gpio_level;
+            btn->debounce_cnt = 0;
+        }
+    } else {
+        btn->debounce_cnt = 0;
+    }
+
+    /** State machine */
+    switch (btn->state) {
+    case 0:
+        if (btn->button_level == btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
+            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
+            btn->ticks = 0;
+            btn->repeat = 1;
+            btn->state = 1;
+        } else {
+            btn->event = (uint8_t)BUTTON_NONE_PRESS;
+        }
+        break;
+
+    case 1:
+        if (btn->button_level != btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_UP;
+            CALL_EVENT_CB(BUTTON_PRESS_UP);
+            btn->ticks = 0;
+            btn->state = 2;
+
+        } else if (btn->ticks > LONG_TICKS) {
+            btn->event = (uint8_t)BUTTON_LONG_PRESS_START;
+            CALL_EVENT_CB(BUTTON_LONG_PRESS_START);
+            btn->state = 5;
+        }
+        break;
+
+    case 2:
+        if (btn->button_level == btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
+            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
+            btn->repeat++;
+            CALL_EVENT_CB(BUTTON_PRESS_REPEAT); // repeat hit
+            btn->ticks = 0;
+            btn->state = 3;
+        } else if (btn->ticks > SHORT_TICKS) {
+            if (btn->repeat == 1) {
+                btn->event = (uint8_t)BUTTON_SINGLE_CLICK;
+                CALL_EVENT_CB(BUTTON_SINGLE_CLICK);
+            } else if (btn->repeat == 2) {
+                btn->event = (uint8_t)BUTTON_DOUBLE_CLICK;
+                CALL_EVENT_CB(BUTTON_DOUBLE_CLICK); // repeat hit
+            }
+            btn->state = 0;
+        }
+        break;
+
+    case 3:
+        if (btn->button_level != btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_UP;
+            CALL_EVENT_CB(BUTTON_PRESS_UP);
+            if (btn->ticks < SHORT_TICKS) {
+                btn->ticks = 0;
+                btn->state = 2; //repeat press
+            } else {
+                btn->state = 0;
+            }
+        }
+        break;
+
+    case 5:
+        if (btn->button_level == btn->active_level) {
+            //continue hold trigger
+            btn->event = (uint8_t)BUTTON_LONG_PRESS_HOLD;
+            CALL_EVENT_CB(BUTTON_LONG_PRESS_HOLD);
+        } else { //releasd
+            btn->event = (uint8_t)BUTTON_PRESS_UP;
+            CALL_EVENT_CB(BUTTON_PRESS_UP);
+            btn->state = 0; //reset
+        }
+        break;
+    }
+}
+
+static legacy_button_t s_legacy[BENCH_MAX_BUTTONS];
+static legacy_button_t *s_legacy_head = NULL;
+
+static void legacy_cb(void *args)
+{
+    for (legacy_button_t *target = s_legacy_head; target; target = target->next) {
+        legacy_handler(target);
+    }
+}
+
+/**
+ * @brief Event counters, filled by the callbacks of both implementations
+ */
+static uint32_t s_count[BUTTON_EVENT_MAX];
+static uint32_t s_legacy_count[BUTTON_EVENT_MAX];
+
+static void count_cb(void *arg)
+{
+    s_count[iot_button_get_event(arg)]++;
+}
+
+static void legacy_count_cb(void *arg)
+{
+    s_legacy_count[((legacy_button_t *)arg)->event]++;
+}
+
+/**
+ * @brief Press pattern of one button: random press and release durations
+ *        covering clicks, multi clicks, long presses and contact bounce
+ */
+typedef struct {
+    uint32_t seed;
+    uint32_t next_toggle;
+    uint8_t level;
+} bench_pattern_t;
+
+static bench_pattern_t s_pattern[BENCH_MAX_BUTTONS];
+
+static uint32_t bench_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static void bench_pattern_init(int number, uint32_t seed)
+{
+    for (int i = 0; i < number; i++) {
+        s_pattern[i].seed = seed + i * 7919;
+        s_pattern[i].next_toggle = bench_rand(&s_pattern[i].seed) % 400;
+        s_pattern[i].level = 1;
+        button_sim_set_level(i, 1);
+    }
+}
+
+static void bench_pattern_step(int number, uint32_t tick)
+{
+    for (int i = 0; i < number; i++) {
+        bench_pattern_t *p = &s_pattern[i];
+
+        if (tick < p->next_toggle) {
+            continue;
+        }
+
+        uint32_t r = bench_rand(&p->seed);
+        uint32_t duration;
+
+        if (r % 16 == 0) {
+            duration = 1;                                   /**< bounce */
+        } else if (p->level == 1) {                         /**< pressing, pick the press length */
+            duration = (r % 8 == 0) ? LONG_TICKS + r % 200 : 4 + r % (SHORT_TICKS - 4);
+        } else {                                            /**< releasing, pick the gap */
+            duration = (r % 3 == 0) ? 4 + r % SHORT_TICKS : SHORT_TICKS * 2 + r % 300;
+        }
+
+        p->level = !p->level;
+        p->next_toggle = tick + duration;
+        button_sim_set_level(i, p->level);
+    }
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_create_buttons(button_handle_t *btns, int number)
+{
+    button_sim_reset();
+    memset(s_count, 0, sizeof(s_count));
+
+    for (int i = 0; i < number; i++) {
+        button_config_t cfg = {
+            .type = BUTTON_TYPE_GPIO,
+            .gpio_button_config = {
+                .gpio_num = i,
+                .active_level = 0,
+            },
+        };
+        btns[i] = iot_button_create(&cfg);
+
+        for (int ev = 0; ev < BUTTON_EVENT_MAX; ev++) {
+            iot_button_register_cb(btns[i], ev, count_cb);
+        }
+    }
+}
+
+/**
+ * @brief  Run the table driven recogniser of iot_button.c
+ *
+ * @return Seconds spent in the tick loop, the pattern update included
+ */
+static double bench_run_table(int number, uint32_t ticks, uint32_t seed)
+{
+    button_handle_t btns[BENCH_MAX_BUTTONS];
+    double elapsed;
+
+    bench_create_buttons(btns, number);
+    bench_pattern_init(number, seed);
+
+    double start = bench_now();
+
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        bench_pattern_step(number, tick);
+        button_sim_tick();
+    }
+
+    elapsed = bench_now() - start;
+
+    for (int i = 0; i < number; i++) {
+        iot_button_delete(btns[i]);
+    }
+
+    return elapsed;
+}
+
+/**
+ * @brief  Run the reference switch state machine on the same pattern and the same simulated timer
+ */
+static double bench_run_legacy(int number, uint32_t ticks, uint32_t seed)
+{
+    double elapsed;
+
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t timer_args = {
+        .callback = legacy_cb,
+        .name = "legacy_timer",
+    };
+
+    button_sim_reset();
+    esp_timer_create(&timer_args, &timer);
+    esp_timer_start_periodic(timer, TICKS_INTERVAL * 1000U);
+    memset(s_legacy, 0, sizeof(s_legacy));
+    memset(s_legacy_count, 0, sizeof(s_legacy_count));
+    s_legacy_head = NULL;
+
+    for (int i = 0; i < number; i++) {
+        legacy_button_t *btn = &s_legacy[i];
+        btn->event = BUTTON_NONE_PRESS;
+        btn->active_level = 0;
+        btn->button_level = 1;
+        btn->hal_button_Level = button_gpio_get_key_level;
+        btn->usr_data = (void *)(uintptr_t)i;
+
+        for (int ev = 0; ev < BUTTON_EVENT_MAX; ev++) {
+            btn->cb[ev] = legacy_count_cb;
+        }
+
+        btn->next = s_legacy_head;
+        s_legacy_head = btn;
+    }
+
+    bench_pattern_init(number, seed);
+
+    double start = bench_now();
+
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        bench_pattern_step(number, tick);
+        button_sim_tick();
+    }
+
+    elapsed = bench_now() - start;
+    esp_timer_stop(timer);
+    esp_timer_delete(timer);
+
+    return elapsed;
+}
+
+/**
+ * @brief  Both implementations must agree on every event the reference
+ *         knows, except LONG_PRESS_HOLD: the reference has no click then
+ *         hold, a third click or a hold after a click emit nothing there.
+ */
+static int bench_verify(int number, uint32_t ticks)
+{
+    static const button_event_t common[] = {
+        BUTTON_PRESS_DOWN, BUTTON_PRESS_UP, BUTTON_PRESS_REPEAT,
+        BUTTON_SINGLE_CLICK, BUTTON_DOUBLE_CLICK, BUTTON_LONG_PRESS_START,
+    };
+    int failed = 0;
+
+    bench_run_table(number, ticks, 1);
+    bench_run_legacy(number, ticks, 1);
+
+    for (int i = 0; i < sizeof(common) / sizeof(common[0]); i++) {
+        if (s_count[common[i]] != s_legacy_count[common[i]]) {
+            printf("FAIL: event %d, table %u, reference %u\n", common[i],
+                   s_count[common[i]], s_legacy_count[common[i]]);
+            failed++;
+        }
+    }
+
+    if (!s_count[BUTTON_MULTIPLE_CLICK] || !s_count[BUTTON_CLICK_HOLD_START] || !s_count[BUTTON_LONG_PRESS_START]) {
+        printf("FAIL: the pattern does not cover every gesture\n");
+        failed++;
+    }
+
+    printf("verify: %u presses, %u single, %u double, %u multiple, %u long, %u click hold: %s\n",
+           s_count[BUTTON_PRESS_DOWN], s_count[BUTTON_SINGLE_CLICK], s_count[BUTTON_DOUBLE_CLICK],
+           s_count[BUTTON_MULTIPLE_CLICK], s_count[BUTTON_LONG_PRESS_START],
+           s_count[BUTTON_CLICK_HOLD_START], failed ? "FAIL" : "OK");
+    return failed;
+}
+
+/**
+ * @brief Level patterns of the tick budget benchmark
+ */
+typedef enum {
+    BENCH_IDLE,     /**< every button released */
+    BENCH_BUSY,     /**< the random clicks and long presses of the throughput benchmark */
+    BENCH_HOLD,     /**< every button held, a LONG_PRESS_HOLD callback per button and tick */
+    BENCH_WORKLOAD_MAX,
+} bench_workload_t;
+
+static const char *const s_workload_name[BENCH_WORKLOAD_MAX] = {"idle", "busy", "hold"};
+
+static int bench_compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief  Duration of single ticks with a number of buttons
+ *
+ * @return p99 of the tick duration in microseconds, the maximum in *max_us
+ */
+static double bench_tick_time(int number, bench_workload_t workload, uint32_t samples, double *max_us)
+{
+    static double times[BENCH_BUDGET_SAMPLES];
+    button_handle_t btns[BENCH_MAX_BUTTONS];
+    uint32_t warmup = (workload == BENCH_HOLD) ? LONG_TICKS + 2 : 1000;
+
+    samples = samples > BENCH_BUDGET_SAMPLES ? BENCH_BUDGET_SAMPLES : samples;
+    bench_create_buttons(btns, number);
+    bench_pattern_init(number, 1);
+
+    for (int i = 0; i < number; i++) {
+        button_sim_set_level(i, workload == BENCH_HOLD ? 0 : 1);
+    }
+
+    for (uint32_t tick = 0; tick < warmup + samples; tick++) {
+        if (workload == BENCH_BUSY) {
+            bench_pattern_step(number, tick);
+        }
+
+        double start = bench_now();
+        button_sim_tick();
+        double elapsed = bench_now() - start;
+
+        if (tick >= warmup) {
+            times[tick - warmup] = elapsed * 1e6;
+        }
+    }
+
+    for (int i = 0; i < number; i++) {
+        iot_button_delete(btns[i]);
+    }
+
+    qsort(times, samples, sizeof(double), bench_compare_double);
+    *max_us = times[samples - 1];
+    return times[samples * 99 / 100];
+}
+
+/**
+ * @brief  How many buttons one tick can scan within a time budget: the p99
+ *         tick duration for 1 to BENCH_MAX_BUTTONS buttons, multiplied by the
+ *         speed ratio of the target, and the largest count within the budget
+ */
+static void bench_budget(double budget_us, double scale, uint32_t samples)
+{
+    int fit[BENCH_WORKLOAD_MAX] = {0};
+    double per_button_us[BENCH_WORKLOAD_MAX] = {0};
+
+    printf("tick budget %.1f us, host times x %.2f\n", budget_us, scale);
+    printf("%8s", "buttons");
+
+    for (int w = 0; w < BENCH_WORKLOAD_MAX; w++) {
+        printf(" %9s p99 %9s max", s_workload_name[w], s_workload_name[w]);
+    }
+
+    printf("\n");
+
+    for (int number = 1; number <= BENCH_MAX_BUTTONS; number *= 2) {
+        printf("%8d", number);
+
+        for (int w = 0; w < BENCH_WORKLOAD_MAX; w++) {
+            double max_us, p99_us = bench_tick_time(number, w, samples, &max_us) * scale;
+            printf(" %10.2fus %10.2fus", p99_us, max_us * scale);
+
+            if (p99_us <= budget_us) {
+                fit[w] = number;
+            }
+
+            per_button_us[w] = p99_us / number;
+        }
+
+        printf("\n");
+    }
+
+    /**< Beyond the measured counts, extrapolate with the cost per button of the largest count */
+    for (int w = 0; w < BENCH_WORKLOAD_MAX; w++) {
+        if (fit[w] < BENCH_MAX_BUTTONS) {
+            printf("%s: %d buttons within %.1f us at p99\n", s_workload_name[w], fit[w], budget_us);
+        } else {
+            printf("%s: %d buttons measured within %.1f us at p99, about %.0f extrapolated\n", s_workload_name[w],
+                   fit[w], budget_us, budget_us / per_button_us[w]);
+        }
+    }
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options]\n"
+           "  -b, --buttons N   number of buttons, default 1, 16 and 64\n"
+           "  -t, --ticks N     ticks per run, default 200000\n"
+           "      --verify      compare the events with the reference state machine\n"
+           "      --budget US   largest number of buttons scanned by one tick within US microseconds\n"
+           "      --scale F     with --budget, multiply the host times by F, the speed ratio of the target\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        {"buttons", required_argument, NULL, 'b'},
+        {"ticks",   required_argument, NULL, 't'},
+        {"verify",  no_argument,       NULL, 'v'},
+        {"budget",  required_argument, NULL, 'u'},
+        {"scale",   required_argument, NULL, 'x'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int numbers[] = {1, 16, 64};
+    int number_count = 3;
+    uint32_t ticks = 200000;
+    bool verify = false;
+    double budget_us = 0, scale = 1;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "b:t:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'b':
+            numbers[0] = atoi(optarg);
+            number_count = 1;
+            if (numbers[0] < 1 || numbers[0] > BENCH_MAX_BUTTONS) {
+                printf("buttons must be 1..%d\n", BENCH_MAX_BUTTONS);
+                return 1;
+            }
+            break;
+        case 't':
+            ticks = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            verify = true;
+            break;
+        case 'u':
+            budget_us = atof(optarg);
+            break;
+        case 'x':
+            scale = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (verify) {
+        return bench_verify(16, ticks) ? 1 : 0;
+    }
+
+    if (budget_us > 0) {
+        bench_budget(budget_us, scale, BENCH_BUDGET_SAMPLES);
+        return 0;
+    }
+
+    printf("%8s %12s %16s %16s %8s\n", "buttons", "impl", "ticks/s/button", "ns/button/tick", "ratio");
+
+    for (int i = 0; i < number_count; i++) {
+        int number = numbers[i];
+        double table = 1e9, legacy = 1e9;
+        double calls = (double)ticks * number;
+
+        /**< Best of alternated rounds, to cancel warm up and frequency scaling */
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            double t = bench_run_legacy(number, ticks, 1);
+            legacy = t < legacy ? t : legacy;
+            t = bench_run_table(number, ticks, 1);
+            table = t < table ? t : table;
+        }
+
+        printf("%8d %12s %16.0f %16.1f %8s\n", number, "reference", calls / legacy, legacy * 1e9 / calls, "");
+        printf("%8d %12s %16.0f %16.1f %8.2f\n", number, "table", calls / table, table * 1e9 / calls, table / legacy);
+    }
+
+    return 0;
+}
@@ -0,0 +1,686 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * @brief Host tests of the button state machine on scripted and random level
+ *        traces. Every tick is checked against a timing model of the
+ *        gestures: debounced edges, click, long press and hold deadlines.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "sdkconfig.h"
+#include "iot_button.h"
+#include "button_sim.h"
+#include "button_trace.h"
+
+#define TICKS_INTERVAL    CONFIG_BUTTON_PERIOD_TIME_MS
+#define DEBOUNCE_TICKS    CONFIG_BUTTON_DEBOUNCE_TICKS
+#define SHORT_TICKS       (CONFIG_BUTTON_SHORT_PRESS_TIME_MS /TICKS_INTERVAL)
+#define LONG_TICKS        (CONFIG_BUTTON_LONG_PRESS_TIME_MS /TICKS_INTERVAL)
+
+#define FUZZ_BUTTONS      8
+
+#define MATRIX_ROWS       3
+#define MATRIX_COLS       4
+#define FUZZ_TICKS        20000
+
+/**
+ * @brief Expected behaviour of one button, fed with the raw level of every tick
+ */
+typedef struct {
+    uint8_t active_level;
+    uint8_t debounce_ticks;
+    uint16_t short_ticks;
+    uint16_t long_ticks;
+    uint8_t level;              /**< debounced level */
+    uint8_t debounce_cnt;
+    bool open;                  /**< a gesture is in progress */
+    bool down;
+    bool hold;
+    uint8_t clicks;
+    uint32_t down_tick;
+    uint32_t up_tick;
+    char error[256];
+} button_model_t;
+
+static void model_init(button_model_t *model, uint8_t active_level, const button_timing_t *timing)
+{
+    memset(model, 0, sizeof(button_model_t));
+    model->active_level = active_level;
+    model->level = !active_level;
+    model->debounce_ticks = timing->debounce_ticks ? timing->debounce_ticks : DEBOUNCE_TICKS;
+    model->short_ticks = timing->short_press_time ? timing->short_press_time / TICKS_INTERVAL : SHORT_TICKS;
+    model->long_ticks = timing->long_press_time ? timing->long_press_time / TICKS_INTERVAL : LONG_TICKS;
+}
+
+/**
+ * @brief  Check the events of one tick, the log is emptied
+ *
+ * @return true if the events are the expected ones, else the reason is in model->error
+ */
+static bool model_tick(button_model_t *model, uint8_t raw, uint32_t tick, button_trace_log_t *log)
+{
+    button_event_t expect[3];
+    int expect_count = 0;
+    int edge = 0;
+
+    /**< A new level is accepted when it is stable for debounce_ticks ticks */
+    if (raw != model->level) {
+        if (++model->debounce_cnt >= model->debounce_ticks) {
+            model->level = raw;
+            model->debounce_cnt = 0;
+            edge = (raw == model->active_level) ? 1 : -1;
+        }
+    } else {
+        model->debounce_cnt = 0;
+    }
+
+    if (edge > 0) {
+        model->clicks = model->open ? model->clicks + 1 : 1;
+        model->open = true;
+        model->down = true;
+        model->down_tick = tick;
+        expect[expect_count++] = BUTTON_PRESS_DOWN;
+
+        if (model->clicks > 1) {
+            expect[expect_count++] = BUTTON_PRESS_REPEAT;
+        }
+    } else if (edge < 0) {
+        expect[expect_count++] = BUTTON_PRESS_UP;
+        model->down = false;
+        model->up_tick = tick;
+
+        /**< A hold, or a later press longer than a click, ends the gesture without a click */
+        if (model->hold || (model->clicks > 1 && tick - model->down_tick >= model->short_ticks)) {
+            model->open = false;
+            model->hold = false;
+        }
+    } else if (model->down && !model->hold && tick - model->down_tick == model->long_ticks + 1u) {
+        expect[expect_count++] = (model->clicks == 1) ? BUTTON_LONG_PRESS_START : BUTTON_CLICK_HOLD_START;
+        model->hold = true;
+    } else if (model->down && model->hold) {
+        expect[expect_count++] = BUTTON_LONG_PRESS_HOLD;
+    } else if (model->open && !model->down && tick - model->up_tick == model->short_ticks + 1u) {
+        expect[expect_count++] = (model->clicks == 1) ? BUTTON_SINGLE_CLICK :
+                                 (model->clicks == 2) ? BUTTON_DOUBLE_CLICK : BUTTON_MULTIPLE_CLICK;
+        model->open = false;
+    }
+
+    bool ok = (log->count == expect_count && !log->overflow);
+
+    for (int i = 0; ok && i < expect_count; i++) {
+        const button_trace_event_t *ev = &log->events[i];
+        ok = (ev->tick == tick && ev->event == expect[i] && ev->repeat == model->clicks);
+    }
+
+    if (!ok) {
+        char actual[128];
+        int len = 0;
+
+        button_trace_format(log, actual, sizeof(actual));
+        len += snprintf(model->error + len, sizeof(model->error) - len, "tick %u: expected [", tick);
+
+        for (int i = 0; i < expect_count; i++) {
+            len += snprintf(model->error + len, sizeof(model->error) - len, "%s%s", i ? " " : "",
+                            button_trace_event_name(expect[i]));
+        }
+
+        snprintf(model->error + len, sizeof(model->error) - len, "] repeat %u, got [%s] repeat %u",
+                 model->clicks, actual, log->count ? log->events[0].repeat : 0);
+    }
+
+    log->count = 0;
+    log->overflow = 0;
+    return ok;
+}
+
+static button_handle_t sim_button_create(int gpio_num, uint8_t active_level, const button_timing_t *timing)
+{
+    button_config_t cfg = {
+        .type = BUTTON_TYPE_GPIO,
+        .gpio_button_config = {
+            .gpio_num = gpio_num,
+            .active_level = active_level,
+        },
+    };
+
+    if (timing) {
+        cfg.timing = *timing;
+    }
+
+    button_sim_set_level(gpio_num, !active_level);
+    return iot_button_create(&cfg);
+}
+
+/**
+ * @brief Scripted traces and the events they must produce
+ */
+typedef struct {
+    const char *name;
+    button_timing_t timing;
+    uint8_t active_level;
+    const char *trace;
+    const char *expect;
+} scripted_case_t;
+
+static const scripted_case_t s_scripted[] = {
+    {"single click",              {0}, 0, "P10 R60",                    "DOWN UP SINGLE"},
+    {"single click ms",           {0}, 0, "P50ms R300ms",               "DOWN UP SINGLE"},
+    {"active high",               {0}, 1, "P10 R60",                    "DOWN UP SINGLE"},
+    {"double click",              {0}, 0, "P10 R10 P10 R60",            "DOWN UP DOWN REPEAT UP DOUBLE"},
+    {"triple click",              {0}, 0, "P10 R10 P10 R10 P10 R60",    "DOWN UP DOWN REPEAT UP DOWN REPEAT UP MULTI3"},
+    {"quadruple click",           {0}, 0, "P8 R8 P8 R8 P8 R8 P8 R60",   "DOWN UP DOWN REPEAT UP DOWN REPEAT UP DOWN REPEAT UP MULTI4"},
+    {"gap at the limit",          {0}, 0, "P10 R37 P10 R60",            "DOWN UP DOWN REPEAT UP DOUBLE"},
+    {"gap over the limit",        {0}, 0, "P10 R38 P10 R60",            "DOWN UP SINGLE DOWN UP SINGLE"},
+    {"slow second press",         {0}, 0, "P10 R10 P50 R60",            "DOWN UP DOWN REPEAT UP"},
+    {"long first press",          {0}, 0, "P200 R60",                   "DOWN UP SINGLE"},
+    {"long press",                {0}, 0, "P320 R10",                   "DOWN LONG HOLD*18 UP"},
+    {"long press at the limit",   {0}, 0, "P301 R60",                   "DOWN UP SINGLE"},
+    {"long press over the limit", {0}, 0, "P302 R10",                   "DOWN LONG UP"},
+    {"click then hold",           {0}, 0, "P10 R10 P320 R10",           "DOWN UP DOWN REPEAT CLICKHOLD2 HOLD*18 UP"},
+    {"double click then hold",    {0}, 0, "P10 R10 P10 R10 P320 R10",   "DOWN UP DOWN REPEAT UP DOWN REPEAT CLICKHOLD3 HOLD*18 UP"},
+    {"glitch",                    {0}, 0, "P1 R10",                     ""},
+    {"bounce",                    {0}, 0, "B9 R10",                     ""},
+    {"bounce then press",         {0}, 0, "B5 P10 R60",                 "DOWN UP SINGLE"},
+    {"bounce on release",         {0}, 0, "P10 B6 R60",                 "DOWN UP SINGLE"},
+    {"short profile",             {100, 500, 0}, 0, "P10 R30 P10 R30",  "DOWN UP SINGLE DOWN UP SINGLE"},
+    {"short profile long",        {100, 500, 0}, 0, "P120 R10",         "DOWN LONG HOLD*18 UP"},
+    {"slow debounce glitch",      {0, 0, 4}, 0, "P3 R10",               ""},
+    {"slow debounce",             {0, 0, 4}, 0, "P4 R60",               "DOWN UP SINGLE"},
+    {"no debounce",               {0, 0, 1}, 0, "P1 R60",               "DOWN UP SINGLE"},
+};
+
+static int run_scripted(void)
+{
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(s_scripted) / sizeof(s_scripted[0]); i++) {
+        const scripted_case_t *c = &s_scripted[i];
+        button_trace_log_t log;
+        char actual[512];
+
+        button_sim_reset();
+        button_trace_detach_all();
+        button_handle_t btn = sim_button_create(3, c->active_level, &c->timing);
+        button_trace_attach(btn, &log);
+
+        if (button_trace_play(3, c->active_level, c->trace) != ESP_OK) {
+            printf("FAIL %s: invalid trace \"%s\"\n", c->name, c->trace);
+            failed++;
+        } else {
+            button_trace_format(&log, actual, sizeof(actual));
+
+            if (strcmp(actual, c->expect)) {
+                printf("FAIL %s: \"%s\" expected \"%s\", got \"%s\"\n", c->name, c->trace, c->expect, actual);
+                failed++;
+            }
+        }
+
+        iot_button_delete(btn);
+    }
+
+    printf("scripted: %zu traces, %d failed\n", sizeof(s_scripted) / sizeof(s_scripted[0]), failed);
+    return failed;
+}
+
+/**
+ * @brief  Run a level array on one button, each tick checked against the model
+ */
+static bool run_levels(const uint8_t *levels, size_t number, uint8_t active_level, const button_timing_t *timing, char *error, size_t size)
+{
+    button_trace_log_t log;
+    button_model_t model;
+    bool ok = true;
+
+    button_sim_reset();
+    button_trace_detach_all();
+    button_handle_t btn = sim_button_create(0, active_level, timing);
+    button_trace_attach(btn, &log);
+    model_init(&model, active_level, timing);
+
+    for (size_t i = 0; i < number && ok; i++) {
+        button_sim_set_level(0, levels[i]);
+        button_sim_tick();
+        ok = model_tick(&model, levels[i], button_trace_get_tick(), &log);
+    }
+
+    /**< Every gesture must be finished after a long enough release */
+    if (ok && (model.open || iot_button_get_event(btn) != BUTTON_NONE_PRESS)) {
+        snprintf(model.error, sizeof(model.error), "gesture not finished at the end of the trace");
+        ok = false;
+    }
+
+    if (!ok) {
+        snprintf(error, size, "%s", model.error);
+    }
+
+    iot_button_delete(btn);
+    return ok;
+}
+
+static size_t append_level(uint8_t *levels, size_t pos, size_t max, uint8_t level, uint32_t ticks)
+{
+    for (uint32_t i = 0; i < ticks && pos < max; i++) {
+        levels[pos++] = level;
+    }
+
+    return pos;
+}
+
+static size_t add_value(uint32_t *values, size_t count, int64_t value)
+{
+    if (value < 1) {
+        return count;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] == value) {
+            return count;
+        }
+    }
+
+    values[count] = (uint32_t)value;
+    return count + 1;
+}
+
+/**
+ * @brief  Every gesture of up to 4 presses, with press, gap and last press
+ *         durations around every threshold, for several timing profiles
+ */
+static int run_exhaustive(void)
+{
+    static const button_timing_t profiles[] = {
+        {0, 0, 1}, {0, 0, 2}, {0, 0, 4}, {0, 0, 7},
+        {100, 500, 2}, {50, 200, 3}, {10, 100, 1},
+    };
+    static uint8_t levels[8192];
+    uint32_t runs = 0;
+    int failed = 0;
+
+    for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+        button_model_t model;
+        model_init(&model, 0, &profiles[p]);
+        int64_t d = model.debounce_ticks, s = model.short_ticks, l = model.long_ticks;
+        uint32_t press[16], last[24];
+        size_t press_count = 0, last_count;
+
+        int64_t around[] = {1, d - 1, d, d + 1, s - 1, s, s + 1, s + d, s + d + 1, 2 * s};
+
+        for (size_t i = 0; i < sizeof(around) / sizeof(around[0]); i++) {
+            press_count = add_value(press, press_count, around[i]);
+        }
+
+        memcpy(last, press, sizeof(uint32_t) * press_count);
+        last_count = press_count;
+        int64_t around_long[] = {l - 1, l, l + 1, l + 2, l + d, l + d + 1, l + d + 2};
+
+        for (size_t i = 0; i < sizeof(around_long) / sizeof(around_long[0]); i++) {
+            last_count = add_value(last, last_count, around_long[i]);
+        }
+
+        for (int clicks = 1; clicks <= 4; clicks++) {
+            for (size_t a = 0; a < press_count; a++) {
+                for (size_t g = 0; g < press_count; g++) {
+                    for (size_t z = 0; z < last_count; z++) {
+                        size_t n = append_level(levels, 0, sizeof(levels), 1, 5);
+
+                        for (int c = 0; c < clicks; c++) {
+                            n = append_level(levels, n, sizeof(levels), 0, (c == clicks - 1) ? last[z] : press[a]);
+                            n = append_level(levels, n, sizeof(levels), 1, (c == clicks - 1) ? s + d + 2 : press[g]);
+                        }
+
+                        char error[256];
+                        runs++;
+
+                        if (!run_levels(levels, n, 0, &profiles[p], error, sizeof(error))) {
+                            if (failed++ < 10) {
+                                printf("FAIL profile %zu, %d presses of %u, gaps of %u, last press %u: %s\n",
+                                       p, clicks, press[a], press[g], last[z], error);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("exhaustive: %u gestures, %d failed\n", runs, failed);
+    return failed;
+}
+
+static uint32_t fuzz_rand(uint32_t *seed)
+{
+    /**< xorshift32 */
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+/**
+ * @brief Random level generator of one fuzzed button
+ */
+typedef struct {
+    uint8_t level;
+    uint32_t remain;
+    uint32_t bounce;
+} fuzz_source_t;
+
+static uint8_t fuzz_next_level(fuzz_source_t *src, const button_model_t *model, uint32_t *seed)
+{
+    if (src->bounce) {
+        src->bounce--;
+        src->level = !src->level;
+        return src->level;
+    }
+
+    if (src->remain == 0) {
+        uint32_t r = fuzz_rand(seed);
+        uint32_t t = (r >> 8) % 8;
+
+        /**< Durations around the thresholds of this button, or bounce */
+        uint32_t base = (t < 2) ? model->debounce_ticks : (t < 5) ? model->short_ticks : (t < 7) ? model->long_ticks : 1;
+        src->remain = base + (r >> 16) % 5;
+        src->remain = src->remain > 2 ? src->remain - 2 : 1;
+        src->level = !src->level;
+
+        if ((r & 0xf) == 0) {
+            src->bounce = (r >> 4) % 12;
+        }
+    }
+
+    src->remain--;
+    return src->level;
+}
+
+/**
+ * @brief  Random traces on several buttons with random profiles at the same time
+ */
+static int run_fuzz(uint32_t iterations, uint32_t seed)
+{
+    static button_trace_log_t logs[FUZZ_BUTTONS];
+    int failed = 0;
+
+    for (uint32_t it = 0; it < iterations && !failed; it++) {
+        uint32_t iteration_seed = seed + it * 0x9e3779b9u;
+        uint32_t rng = iteration_seed ? iteration_seed : 1;
+        button_handle_t btns[FUZZ_BUTTONS];
+        button_model_t models[FUZZ_BUTTONS];
+        fuzz_source_t sources[FUZZ_BUTTONS];
+        uint8_t history[FUZZ_BUTTONS][64];
+
+        button_sim_reset();
+        button_trace_detach_all();
+
+        for (int i = 0; i < FUZZ_BUTTONS; i++) {
+            uint32_t r = fuzz_rand(&rng);
+            button_timing_t timing = {
+                .short_press_time = (r & 1) ? 0 : 5 + (r >> 1) % 400,
+                .long_press_time = (r & 2) ? 0 : 100 + (r >> 9) % 1000,
+                .debounce_ticks = (r >> 20) % 8,
+            };
+            uint8_t active_level = (r >> 24) & 1;
+
+            btns[i] = sim_button_create(i * 5, active_level, &timing);
+            button_trace_attach(btns[i], &logs[i]);
+            model_init(&models[i], active_level, &timing);
+            sources[i] = (fuzz_source_t) {
+                .level = !active_level,
+            };
+        }
+
+        for (uint32_t t = 0; t < FUZZ_TICKS && !failed; t++) {
+            uint8_t raw[FUZZ_BUTTONS];
+
+            for (int i = 0; i < FUZZ_BUTTONS; i++) {
+                raw[i] = fuzz_next_level(&sources[i], &models[i], &rng);
+                history[i][t % 64] = raw[i];
+                button_sim_set_level(i * 5, raw[i]);
+            }
+
+            button_sim_tick();
+
+            for (int i = 0; i < FUZZ_BUTTONS; i++) {
+                if (model_tick(&models[i], raw[i], button_trace_get_tick(), &logs[i])) {
+                    continue;
+                }
+
+                char recent[65];
+
+                for (int k = 0; k < 64; k++) {
+                    recent[k] = (t + 1 + k >= 64) ? '0' + history[i][(t + 1 + k) % 64] : ' ';
+                }
+
+                recent[64] = '\0';
+                printf("FAIL seed 0x%08x, button %d (active %u, debounce %u, short %u, long %u): %s\n"
+                       "     last levels: %s\n", iteration_seed, i, models[i].active_level,
+                       models[i].debounce_ticks, models[i].short_ticks, models[i].long_ticks,
+                       models[i].error, recent);
+                failed++;
+                break;
+            }
+        }
+
+        for (int i = 0; i < FUZZ_BUTTONS; i++) {
+            iot_button_delete(btns[i]);
+        }
+    }
+
+    printf("fuzz: %u iterations of %d buttons x %d ticks from seed 0x%08x, %d failed\n",
+           iterations, FUZZ_BUTTONS, FUZZ_TICKS, seed, failed);
+    return failed;
+}
+
+/**
+ * @brief A key of the matrix pressed or released at a tick
+ */
+typedef struct {
+    uint32_t tick;
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+} matrix_step_t;
+
+/**
+ * @brief Matrix scripts and the events of every key, row by row, "-" for no event
+ */
+typedef struct {
+    const char *name;
+    const matrix_step_t *steps;
+    size_t step_num;
+    uint32_t ticks;
+    const char *expect[MATRIX_ROWS * MATRIX_COLS];
+    bool ghost;                 /**< the script must be seen as ghosting */
+} matrix_case_t;
+
+static const matrix_step_t s_matrix_click[] = {
+    {10, 1, 2, true}, {20, 1, 2, false},
+};
+
+static const matrix_step_t s_matrix_diagonal[] = {
+    {10, 0, 0, true}, {12, 1, 1, true}, {14, 2, 3, true},
+    {330, 0, 0, false}, {332, 1, 1, false}, {334, 2, 3, false},
+};
+
+/**< (0,0), (0,1) and (1,0) pressed make (1,1) a ghost until (0,0) is released */
+static const matrix_step_t s_matrix_ghost[] = {
+    {10, 0, 0, true}, {30, 0, 1, true}, {50, 1, 0, true},
+    {110, 0, 0, false}, {150, 0, 1, false}, {150, 1, 0, false},
+};
+
+static const matrix_case_t s_matrix[] = {
+    {
+        "click", s_matrix_click, 2, 100,
+        {"-", "-", "-", "-", "-", "-", "DOWN UP SINGLE", "-", "-", "-", "-", "-"}, false,
+    },
+    {
+        "diagonal long press", s_matrix_diagonal, 6, 400,
+        {
+            "DOWN LONG HOLD*18 UP", "-", "-", "-",
+            "-", "DOWN LONG HOLD*18 UP", "-", "-",
+            "-", "-", "-", "DOWN LONG HOLD*18 UP",
+        }, false,
+    },
+    {
+        "ghost", s_matrix_ghost, 6, 250,
+        {"DOWN UP SINGLE", "DOWN UP SINGLE", "-", "-", "DOWN UP SINGLE", "-", "-", "-", "-", "-", "-", "-"}, true,
+    },
+};
+
+/**
+ * @brief  Run a script on a 3x4 key matrix without diodes, next to a GPIO
+ *         button, and compare the events of every key
+ */
+static int run_matrix(void)
+{
+    static const int32_t rows[MATRIX_ROWS] = {10, 11, 12};
+    static const int32_t cols[MATRIX_COLS] = {20, 21, 22, 23};
+    static button_trace_log_t logs[MATRIX_ROWS * MATRIX_COLS + 1];
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(s_matrix) / sizeof(s_matrix[0]); i++) {
+        const matrix_case_t *c = &s_matrix[i];
+        button_handle_t btns[MATRIX_ROWS * MATRIX_COLS + 1] = {0};
+        uint32_t ghost_count = button_matrix_get_ghost_count();
+        char actual[512];
+
+        button_sim_reset();
+        button_trace_detach_all();
+
+        for (int k = 0; k < MATRIX_ROWS * MATRIX_COLS; k++) {
+            button_config_t cfg = {
+                .type = BUTTON_TYPE_MATRIX,
+                .matrix_button_config = {
+                    .row_gpios = rows,
+                    .col_gpios = cols,
+                    .row_gpio_num = MATRIX_ROWS,
+                    .col_gpio_num = MATRIX_COLS,
+                    .row = k / MATRIX_COLS,
+                    .col = k % MATRIX_COLS,
+                },
+            };
+            btns[k] = iot_button_create(&cfg);
+            button_trace_attach(btns[k], &logs[k]);
+        }
+
+        /**< A GPIO button scanned in the same ticks stays silent */
+        btns[MATRIX_ROWS * MATRIX_COLS] = sim_button_create(3, 0, NULL);
+        button_trace_attach(btns[MATRIX_ROWS * MATRIX_COLS], &logs[MATRIX_ROWS * MATRIX_COLS]);
+
+        for (uint32_t tick = 0, step = 0; tick < c->ticks; tick++) {
+            for (; step < c->step_num && c->steps[step].tick == tick; step++) {
+                button_sim_set_switch(rows[c->steps[step].row], cols[c->steps[step].col], c->steps[step].pressed);
+            }
+
+            button_sim_tick();
+        }
+
+        for (int k = 0; k <= MATRIX_ROWS * MATRIX_COLS; k++) {
+            const char *expect = k < MATRIX_ROWS * MATRIX_COLS ? c->expect[k] : "-";
+            button_trace_format(&logs[k], actual, sizeof(actual));
+
+            if (strcmp(actual[0] ? actual : "-", expect)) {
+                printf("FAIL matrix %s: key %d expected \"%s\", got \"%s\"\n", c->name, k, expect, actual);
+                failed++;
+            }
+        }
+
+        if ((button_matrix_get_ghost_count() != ghost_count) != c->ghost) {
+            printf("FAIL matrix %s: ghost %s\n", c->name, c->ghost ? "not detected" : "detected");
+            failed++;
+        }
+
+        for (int k = 0; k <= MATRIX_ROWS * MATRIX_COLS; k++) {
+            iot_button_delete(btns[k]);
+        }
+    }
+
+    printf("matrix: %zu scripts, %d failed\n", sizeof(s_matrix) / sizeof(s_matrix[0]), failed);
+    return failed;
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options]\n"
+           "      --scripted      run the scripted traces\n"
+           "      --exhaustive    run every gesture around the thresholds\n"
+           "      --matrix        run the key matrix scripts\n"
+           "      --fuzz N        run N random traces\n"
+           "      --seed S        first seed of the random traces, default 1\n"
+           "  without option all the tests run, with 100 random traces\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        {"scripted",   no_argument,       NULL, 's'},
+        {"exhaustive", no_argument,       NULL, 'e'},
+        {"matrix",     no_argument,       NULL, 'm'},
+        {"fuzz",       required_argument, NULL, 'f'},
+        {"seed",       required_argument, NULL, 'r'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    bool scripted = false, exhaustive = false, matrix = false;
+    uint32_t fuzz = 0, seed = 1;
+    int opt, failed = 0;
+
+    while ((opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            scripted = true;
+            break;
+        case 'e':
+            exhaustive = true;
+            break;
+        case 'm':
+            matrix = true;
+            break;
+        case 'f':
+            fuzz = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (!scripted && !exhaustive && !matrix && !fuzz) {
+        scripted = exhaustive = matrix = true;
+        fuzz = 100;
+    }
+
+    if (scripted) {
+        failed += run_scripted();
+    }
+
+    if (exhaustive) {
+        failed += run_exhaustive();
+    }
+
+    if (matrix) {
+        failed += run_matrix();
+    }
+
+    if (fuzz) {
+        failed += run_fuzz(fuzz, seed);
+    }
+
+    return failed ? 1 : 0;
+}
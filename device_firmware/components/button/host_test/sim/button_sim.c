@@ -0,0 +1,253 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "button_gpio.h"
+#include "button_adc.h"
+#include "button_matrix.h"
+#include "button_sim.h"
+
+/**
+ * @brief Host implementation of the button HAL and esp_timer: a single periodic
+ *        timer driven by button_sim_tick() on a virtual clock, and GPIO levels
+ *        set by the test. The driver/gpio functions used by the matrix buttons
+ *        see the switches closed by the test.
+ */
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    uint64_t period_us;
+    bool running;
+};
+
+static struct esp_timer s_timer;
+static bool s_timer_created = false;
+static int64_t s_time_us = 0;
+static uint8_t s_level[BUTTON_SIM_MAX_GPIO];
+static uint8_t s_output[BUTTON_SIM_MAX_GPIO];     /**< 1 output driven low */
+
+typedef struct {
+    int16_t a;
+    int16_t b;
+} sim_switch_t;
+
+static sim_switch_t s_switch[BUTTON_SIM_MAX_SWITCH];
+static int s_switch_num = 0;
+
+void button_sim_reset(void)
+{
+    memset(&s_timer, 0, sizeof(s_timer));
+    s_timer_created = false;
+    s_time_us = 0;
+    memset(s_level, 1, sizeof(s_level));
+    memset(s_output, 0, sizeof(s_output));
+    s_switch_num = 0;
+}
+
+void button_sim_set_level(int gpio_num, uint8_t level)
+{
+    if (gpio_num >= 0 && gpio_num < BUTTON_SIM_MAX_GPIO) {
+        s_level[gpio_num] = level ? 1 : 0;
+    }
+}
+
+void button_sim_set_switch(int gpio_a, int gpio_b, bool closed)
+{
+    for (int i = 0; i < s_switch_num; i++) {
+        if ((s_switch[i].a == gpio_a && s_switch[i].b == gpio_b) || (s_switch[i].a == gpio_b && s_switch[i].b == gpio_a)) {
+            if (!closed) {
+                s_switch[i] = s_switch[--s_switch_num];
+            }
+            return;
+        }
+    }
+
+    if (closed && s_switch_num < BUTTON_SIM_MAX_SWITCH) {
+        s_switch[s_switch_num].a = gpio_a;
+        s_switch[s_switch_num].b = gpio_b;
+        s_switch_num++;
+    }
+}
+
+bool button_sim_tick(void)
+{
+    s_time_us += s_timer.period_us ? s_timer.period_us : CONFIG_BUTTON_PERIOD_TIME_MS * 1000;
+
+    if (!s_timer_created || !s_timer.running) {
+        return false;
+    }
+
+    s_timer.callback(s_timer.arg);
+    return true;
+}
+
+int64_t button_sim_get_time(void)
+{
+    return s_time_us;
+}
+
+bool button_sim_timer_running(void)
+{
+    return s_timer_created && s_timer.running;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !out_handle || s_timer_created) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(&s_timer, 0, sizeof(s_timer));
+    s_timer.callback = create_args->callback;
+    s_timer.arg = create_args->arg;
+    s_timer_created = true;
+    *out_handle = &s_timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (timer != &s_timer || !s_timer_created || timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->period_us = period;
+    timer->running = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer != &s_timer || !timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->running = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer != &s_timer || timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_timer_created = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return s_time_us;
+}
+
+esp_err_t button_gpio_init(const button_gpio_config_t *config)
+{
+    if (!config || config->gpio_num < 0 || config->gpio_num >= BUTTON_SIM_MAX_GPIO) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t button_gpio_deinit(int gpio_num)
+{
+    return ESP_OK;
+}
+
+uint8_t button_gpio_get_key_level(void *gpio_num)
+{
+    return s_level[(uint32_t)(uintptr_t)gpio_num % BUTTON_SIM_MAX_GPIO];
+}
+
+esp_err_t button_gpio_set_intr(int gpio_num, gpio_int_type_t intr_type, gpio_isr_t isr_handler, void *args)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t button_gpio_intr_control(int gpio_num, bool enable)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t button_adc_init(const button_adc_config_t *config)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t button_adc_deinit(adc1_channel_t channel, int button_index)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+uint8_t button_adc_get_key_level(void *button_index)
+{
+    return 0;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (int i = 0; i < 64; i++) {
+        if (config->pin_bit_mask & (1ULL << i)) {
+            s_output[i] = 0;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(int gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= BUTTON_SIM_MAX_GPIO) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_output[gpio_num] = level ? 0 : 1;
+    return ESP_OK;
+}
+
+int gpio_get_level(int gpio_num)
+{
+    uint8_t reached[BUTTON_SIM_MAX_GPIO] = {0};
+    bool grown = true;
+
+    if (gpio_num < 0 || gpio_num >= BUTTON_SIM_MAX_GPIO) {
+        return 0;
+    }
+
+    /**< Every GPIO connected through closed switches, the open drain rows only pull low */
+    reached[gpio_num] = 1;
+
+    while (grown) {
+        grown = false;
+
+        for (int i = 0; i < s_switch_num; i++) {
+            if (reached[s_switch[i].a] != reached[s_switch[i].b]) {
+                reached[s_switch[i].a] = reached[s_switch[i].b] = 1;
+                grown = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < BUTTON_SIM_MAX_GPIO; i++) {
+        if (reached[i] && s_output[i]) {
+            return 0;
+        }
+    }
+
+    return s_level[gpio_num];
+}
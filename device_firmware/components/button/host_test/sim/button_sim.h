@@ -0,0 +1,69 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define BUTTON_SIM_MAX_GPIO     256     /**< Number of simulated GPIOs */
+#define BUTTON_SIM_MAX_SWITCH   64      /**< Number of switches closed at the same time */
+
+/**
+ * @brief  Reset the virtual clock, the simulated timer and all GPIO levels to 1 (released, active low)
+ */
+void button_sim_reset(void);
+
+/**
+ * @brief  Set the level read by button_gpio_get_key_level() for a GPIO
+ */
+void button_sim_set_level(int gpio_num, uint8_t level);
+
+/**
+ * @brief  Close or open a switch between two GPIOs, e.g. a key of a matrix
+ *         between its row and its column. gpio_get_level() of a GPIO returns 0
+ *         when a chain of closed switches connects it to a GPIO driven low,
+ *         without diodes: three keys of a matrix can make a ghost key.
+ */
+void button_sim_set_switch(int gpio_a, int gpio_b, bool closed);
+
+/**
+ * @brief  Advance the virtual clock by one button period and run the button
+ *         timer callback if the timer is started
+ *
+ * @return
+ *     - true   The timer callback ran
+ *     - false  The timer is stopped or not created
+ */
+bool button_sim_tick(void);
+
+/**
+ * @brief  Virtual time in microseconds, returned by esp_timer_get_time()
+ */
+int64_t button_sim_get_time(void);
+
+/**
+ * @brief  Whether the button timer is running
+ */
+bool button_sim_timer_running(void);
+
+#ifdef __cplusplus
+}
+#endif
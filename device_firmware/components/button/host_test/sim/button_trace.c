@@ -0,0 +1,218 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "sdkconfig.h"
+#include "button_sim.h"
+#include "button_trace.h"
+
+#define TRACE_PERIOD_MS     CONFIG_BUTTON_PERIOD_TIME_MS
+
+typedef struct {
+    button_handle_t btn;
+    button_trace_log_t *log;
+} button_trace_attach_t;
+
+static button_trace_attach_t s_attach[BUTTON_SIM_MAX_GPIO];
+static size_t s_attach_count = 0;
+
+static const char *const s_event_name[] = {
+    [BUTTON_PRESS_DOWN]       = "DOWN",
+    [BUTTON_PRESS_UP]         = "UP",
+    [BUTTON_PRESS_REPEAT]     = "REPEAT",
+    [BUTTON_SINGLE_CLICK]     = "SINGLE",
+    [BUTTON_DOUBLE_CLICK]     = "DOUBLE",
+    [BUTTON_LONG_PRESS_START] = "LONG",
+    [BUTTON_LONG_PRESS_HOLD]  = "HOLD",
+    [BUTTON_MULTIPLE_CLICK]   = "MULTI",
+    [BUTTON_CLICK_HOLD_START] = "CLICKHOLD",
+};
+
+static void button_trace_log(void *arg, button_event_t event)
+{
+    for (size_t i = 0; i < s_attach_count; i++) {
+        if (s_attach[i].btn != arg) {
+            continue;
+        }
+
+        button_trace_log_t *log = s_attach[i].log;
+
+        if (log->count >= BUTTON_TRACE_MAX_EVENTS) {
+            log->overflow++;
+            return;
+        }
+
+        button_trace_event_t *ev = &log->events[log->count++];
+        ev->tick = button_trace_get_tick();
+        ev->event = event;
+        ev->repeat = iot_button_get_repeat(arg);
+        return;
+    }
+}
+
+/**
+ * @brief One callback per event: in the PRESS_REPEAT callback iot_button_get_event()
+ *        still returns PRESS_DOWN, the event is the one the callback is registered for
+ */
+#define BUTTON_TRACE_CB(ev) static void button_trace_cb_##ev(void *arg) { button_trace_log(arg, ev); }
+
+BUTTON_TRACE_CB(BUTTON_PRESS_DOWN)
+BUTTON_TRACE_CB(BUTTON_PRESS_UP)
+BUTTON_TRACE_CB(BUTTON_PRESS_REPEAT)
+BUTTON_TRACE_CB(BUTTON_SINGLE_CLICK)
+BUTTON_TRACE_CB(BUTTON_DOUBLE_CLICK)
+BUTTON_TRACE_CB(BUTTON_LONG_PRESS_START)
+BUTTON_TRACE_CB(BUTTON_LONG_PRESS_HOLD)
+BUTTON_TRACE_CB(BUTTON_MULTIPLE_CLICK)
+BUTTON_TRACE_CB(BUTTON_CLICK_HOLD_START)
+
+static const button_cb_t s_trace_cb[BUTTON_EVENT_MAX] = {
+    [BUTTON_PRESS_DOWN]       = button_trace_cb_BUTTON_PRESS_DOWN,
+    [BUTTON_PRESS_UP]         = button_trace_cb_BUTTON_PRESS_UP,
+    [BUTTON_PRESS_REPEAT]     = button_trace_cb_BUTTON_PRESS_REPEAT,
+    [BUTTON_SINGLE_CLICK]     = button_trace_cb_BUTTON_SINGLE_CLICK,
+    [BUTTON_DOUBLE_CLICK]     = button_trace_cb_BUTTON_DOUBLE_CLICK,
+    [BUTTON_LONG_PRESS_START] = button_trace_cb_BUTTON_LONG_PRESS_START,
+    [BUTTON_LONG_PRESS_HOLD]  = button_trace_cb_BUTTON_LONG_PRESS_HOLD,
+    [BUTTON_MULTIPLE_CLICK]   = button_trace_cb_BUTTON_MULTIPLE_CLICK,
+    [BUTTON_CLICK_HOLD_START] = button_trace_cb_BUTTON_CLICK_HOLD_START,
+};
+
+esp_err_t button_trace_attach(button_handle_t btn, button_trace_log_t *log)
+{
+    if (!btn || !log) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_attach_count >= BUTTON_SIM_MAX_GPIO) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(log, 0, sizeof(button_trace_log_t));
+    s_attach[s_attach_count].btn = btn;
+    s_attach[s_attach_count].log = log;
+    s_attach_count++;
+
+    for (int ev = 0; ev < BUTTON_EVENT_MAX; ev++) {
+        iot_button_register_cb(btn, ev, s_trace_cb[ev]);
+    }
+
+    return ESP_OK;
+}
+
+void button_trace_detach_all(void)
+{
+    s_attach_count = 0;
+}
+
+uint32_t button_trace_get_tick(void)
+{
+    return (uint32_t)(button_sim_get_time() / (TRACE_PERIOD_MS * 1000));
+}
+
+esp_err_t button_trace_play(int gpio_num, uint8_t active_level, const char *trace)
+{
+    const char *p = trace;
+
+    while (*p) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+
+        char step = *p++;
+        char *end;
+        unsigned long n = strtoul(p, &end, 10);
+
+        if (end == p) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        p = end;
+
+        if (p[0] == 'm' && p[1] == 's') {
+            n /= TRACE_PERIOD_MS;
+            p += 2;
+        }
+
+        if (*p && !isspace((unsigned char)*p)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        for (unsigned long i = 0; i < n; i++) {
+            switch (step) {
+            case 'P':
+                button_sim_set_level(gpio_num, active_level);
+                break;
+            case 'R':
+                button_sim_set_level(gpio_num, !active_level);
+                break;
+            case 'B':
+                button_sim_set_level(gpio_num, (i & 1) ? !active_level : active_level);
+                break;
+            default:
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            button_sim_tick();
+        }
+    }
+
+    return ESP_OK;
+}
+
+const char *button_trace_event_name(button_event_t event)
+{
+    if (event < BUTTON_EVENT_MAX && s_event_name[event]) {
+        return s_event_name[event];
+    }
+
+    return "NONE";
+}
+
+size_t button_trace_format(const button_trace_log_t *log, char *buf, size_t size)
+{
+    size_t len = 0;
+
+    buf[0] = '\0';
+
+    for (uint32_t i = 0; i < log->count && len < size; i++) {
+        const button_trace_event_t *ev = &log->events[i];
+        const char *sep = len ? " " : "";
+
+        if (ev->event == BUTTON_LONG_PRESS_HOLD) {
+            uint32_t run = 1;
+
+            while (i + 1 < log->count && log->events[i + 1].event == BUTTON_LONG_PRESS_HOLD) {
+                run++;
+                i++;
+            }
+
+            len += snprintf(buf + len, size - len, "%sHOLD*%u", sep, run);
+        } else if (ev->event == BUTTON_MULTIPLE_CLICK || ev->event == BUTTON_CLICK_HOLD_START) {
+            len += snprintf(buf + len, size - len, "%s%s%u", sep, button_trace_event_name(ev->event), ev->repeat);
+        } else {
+            len += snprintf(buf + len, size - len, "%s%s", sep, button_trace_event_name(ev->event));
+        }
+    }
+
+    if (log->overflow && len < size) {
+        len += snprintf(buf + len, size - len, " ...+%u", log->overflow);
+    }
+
+    return len < size ? len : size - 1;
+}
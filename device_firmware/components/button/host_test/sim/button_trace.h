@@ -0,0 +1,101 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "iot_button.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define BUTTON_TRACE_MAX_EVENTS     512     /**< Events kept by a log, the next ones are counted as overflow */
+
+/**
+ * @brief One event received by a button callback
+ */
+typedef struct {
+    uint32_t tick;              /**< virtual tick of the event, see button_trace_get_tick() */
+    button_event_t event;       /**< event of the callback */
+    uint8_t repeat;             /**< iot_button_get_repeat() in the callback */
+} button_trace_event_t;
+
+/**
+ * @brief Events of one button, in the order of the callbacks
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t overflow;
+    button_trace_event_t events[BUTTON_TRACE_MAX_EVENTS];
+} button_trace_log_t;
+
+/**
+ * @brief  Register a callback for every event of a button, the events are appended to the log
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NO_MEM  Too many buttons attached
+ */
+esp_err_t button_trace_attach(button_handle_t btn, button_trace_log_t *log);
+
+/**
+ * @brief  Forget all the attached buttons, to be called after button_sim_reset()
+ */
+void button_trace_detach_all(void);
+
+/**
+ * @brief  Current virtual tick, the number of button periods since button_sim_reset()
+ */
+uint32_t button_trace_get_tick(void);
+
+/**
+ * @brief  Play a scripted level trace on a GPIO, one simulated tick per trace tick
+ *
+ * The trace is a list of steps separated by spaces:
+ *     - P<n>   pressed (active level) for n ticks, P<n>ms for n milliseconds
+ *     - R<n>   released for n ticks, R<n>ms for n milliseconds
+ *     - B<n>   contact bounce, the level toggles every tick for n ticks
+ *
+ * @param  gpio_num      GPIO of the button
+ * @param  active_level  Level of a pressed button
+ * @param  trace         Trace, e.g. "P20 R10 P20 R100"
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG  Syntax error in the trace
+ */
+esp_err_t button_trace_play(int gpio_num, uint8_t active_level, const char *trace);
+
+/**
+ * @brief  Short name of an event, e.g. "DOWN" or "SINGLE"
+ */
+const char *button_trace_event_name(button_event_t event);
+
+/**
+ * @brief  Format the events of a log as names separated by spaces,
+ *         multiple clicks and click then hold include the repeat count,
+ *         LONG_PRESS_HOLD runs are collapsed into "HOLD*<n>"
+ *
+ * @return Length of the formatted string
+ */
+size_t button_trace_format(const button_trace_log_t *log, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
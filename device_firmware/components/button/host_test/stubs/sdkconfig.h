@@ -0,0 +1,28 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/**
+ * @brief Host configuration of the button component, the Kconfig defaults
+ */
+#define CONFIG_BUTTON_PERIOD_TIME_MS                5
+#define CONFIG_BUTTON_DEBOUNCE_TICKS                2
+#define CONFIG_BUTTON_SHORT_PRESS_TIME_MS           180
+#define CONFIG_BUTTON_LONG_PRESS_TIME_MS            1500
+#define CONFIG_ADC_BUTTON_MAX_CHANNEL               3
+#define CONFIG_ADC_BUTTON_MAX_BUTTON_PER_CHANNEL    8
+#define CONFIG_ADC_BUTTON_SAMPLE_TIMES              1
+#define CONFIG_MATRIX_BUTTON_GHOST_DETECTION        1
+#define CONFIG_MATRIX_BUTTON_SETTLE_TIME_US         2
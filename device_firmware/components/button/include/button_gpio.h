@@ -27,6 +27,7 @@ extern "C" {
 typedef struct {
     int32_t gpio_num;
     uint8_t active_level;
+    bool enable_power_save;    /**< Wake up on a GPIO interrupt instead of polling, requires CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE */
 } button_gpio_config_t;
 
 /**
@@ -58,6 +59,45 @@ esp_err_t button_gpio_deinit(int gpio_num);
  */
 uint8_t button_gpio_get_key_level(void *gpio_num);
 
+/**
+ * @brief Install the interrupt handler of a gpio button
+ *
+ * @param gpio_num gpio number of button
+ * @param intr_type GPIO_INTR_LOW_LEVEL or GPIO_INTR_HIGH_LEVEL, the active level of the button
+ * @param isr_handler Interrupt handler, the interrupt stays disabled until button_gpio_intr_control()
+ * @param args Argument of the handler
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - Others  Error of the gpio driver
+ */
+esp_err_t button_gpio_set_intr(int gpio_num, gpio_int_type_t intr_type, gpio_isr_t isr_handler, void *args);
+
+/**
+ * @brief Enable or disable the interrupt of a gpio button, can be called from an ISR
+ *
+ * @param gpio_num gpio number of button
+ * @param enable true to enable, false to disable
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG  gpio_num is invalid
+ */
+esp_err_t button_gpio_intr_control(int gpio_num, bool enable);
+
+/**
+ * @brief Use a gpio button as light sleep wakeup source
+ *
+ * @param gpio_num gpio number of button
+ * @param active_level active level of the button
+ * @param enable true to enable, false to disable
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - Others  Error of the gpio driver or of esp_sleep
+ */
+esp_err_t button_gpio_enable_gpio_wakeup(int gpio_num, uint8_t active_level, bool enable);
+
 #ifdef __cplusplus
 }
 #endif
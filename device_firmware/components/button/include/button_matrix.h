@@ -0,0 +1,99 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef __IOT_BUTTON_MATRIX_H__
+#define __IOT_BUTTON_MATRIX_H__
+
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MATRIX_BUTTON_MAX_LINES 8   /**< max number of rows and of columns */
+
+#define MATRIX_BUTTON_COMBINE(row, col) ((row)<<8 | (col))
+#define MATRIX_BUTTON_SPLIT_COL(data) ((uint32_t)(data)&0xff)
+#define MATRIX_BUTTON_SPLIT_ROW(data) (((uint32_t)(data) >> 8) & 0xff)
+
+/**
+ * @brief matrix button configuration
+ *
+ * All the keys of a panel share one matrix: the rows are open drain outputs
+ * driven low one at a time, the columns are inputs with pull-ups. Every key
+ * must be created with the same row and column GPIOs.
+ *
+ */
+typedef struct {
+    const int32_t *row_gpios;   /**< GPIOs of the rows */
+    const int32_t *col_gpios;   /**< GPIOs of the columns */
+    uint8_t row_gpio_num;       /**< number of rows, max MATRIX_BUTTON_MAX_LINES */
+    uint8_t col_gpio_num;       /**< number of columns, max MATRIX_BUTTON_MAX_LINES */
+    uint8_t row;                /**< row of the key */
+    uint8_t col;                /**< column of the key */
+} button_matrix_config_t;
+
+/**
+ * @brief Initialize matrix button, the GPIOs are configured by the first key
+ *
+ * @param config pointer of configuration struct
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   Arguments is NULL.
+ *      - ESP_ERR_NOT_SUPPORTED Arguments out of range.
+ *      - ESP_ERR_INVALID_STATE The key is used or the GPIOs differ from the matrix.
+ */
+esp_err_t button_matrix_init(const button_matrix_config_t *config);
+
+/**
+ * @brief Deinitialize matrix button, the GPIOs are released with the last key
+ *
+ * @param row Row of the key
+ * @param col Column of the key
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   Arguments is invalid.
+ */
+esp_err_t button_matrix_deinit(int row, int col);
+
+/**
+ * @brief Scan the whole matrix into the key bitmap, called once per button tick
+ *        before the key levels are read. Does nothing without a matrix key.
+ */
+void button_matrix_scan(void);
+
+/**
+ * @brief Get the matrix button level from the last scan
+ *
+ * @param key It is compressed by row and column, use the macro MATRIX_BUTTON_COMBINE to generate. It will be treated as a uint32_t variable.
+ *
+ * @return
+ *      - 0 Not pressed
+ *      - 1 Pressed
+ */
+uint8_t button_matrix_get_key_level(void *key);
+
+/**
+ * @brief Get the number of scans with ghost keys, see CONFIG_MATRIX_BUTTON_GHOST_DETECTION
+ *
+ * @return Number of scans in which some keys kept their previous level
+ */
+uint32_t button_matrix_get_ghost_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< __IOT_BUTTON_MATRIX_H__ */
@@ -16,6 +16,7 @@
 
 #include "button_adc.h"
 #include "button_gpio.h"
+#include "button_matrix.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +37,8 @@ typedef enum {
     BUTTON_DOUBLE_CLICK,
     BUTTON_LONG_PRESS_START,
     BUTTON_LONG_PRESS_HOLD,
+    BUTTON_MULTIPLE_CLICK,      /**< three or more clicks, iot_button_get_repeat() returns the count */
+    BUTTON_CLICK_HOLD_START,    /**< one or more clicks then a long press, iot_button_get_repeat() returns the presses including the hold */
     BUTTON_EVENT_MAX,
     BUTTON_NONE_PRESS,
 } button_event_t;
@@ -47,17 +50,30 @@ typedef enum {
 typedef enum {
     BUTTON_TYPE_GPIO,
     BUTTON_TYPE_ADC,
+    BUTTON_TYPE_MATRIX,
 } button_type_t;
 
+/**
+ * @brief Button timing, a zero field uses the Kconfig default
+ *
+ */
+typedef struct {
+    uint16_t short_press_time;    /**< ms, longest gap between the clicks of a gesture, default CONFIG_BUTTON_SHORT_PRESS_TIME_MS */
+    uint16_t long_press_time;     /**< ms, press duration of a long press, default CONFIG_BUTTON_LONG_PRESS_TIME_MS */
+    uint8_t debounce_ticks;       /**< scan ticks a new level must be stable, max 7, default CONFIG_BUTTON_DEBOUNCE_TICKS */
+} button_timing_t;
+
 /**
  * @brief Button configuration
  *
  */
 typedef struct {
     button_type_t type;                           /**< button type, The corresponding button configuration must be filled */
+    button_timing_t timing;                       /**< button timing, all zero for the Kconfig defaults */
     union {
         button_gpio_config_t gpio_button_config; /**< gpio button configuration */
         button_adc_config_t adc_button_config;   /**< adc button configuration */
+        button_matrix_config_t matrix_button_config; /**< matrix button configuration */
     }; /**< button configuration */
 } button_config_t;
 
@@ -124,6 +140,38 @@ button_event_t iot_button_get_event(button_handle_t btn_handle);
  */
 uint8_t iot_button_get_repeat(button_handle_t btn_handle);
 
+/**
+ * @brief Change the timing of a button at runtime
+ *
+ * @param btn_handle Button handle
+ * @param timing Button timing, a zero field restores the Kconfig default
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG   Arguments is invalid.
+ */
+esp_err_t iot_button_set_timing(button_handle_t btn_handle, const button_timing_t *timing);
+
+/**
+ * @brief Get the time of the current button event
+ *
+ * @note Called from an event callback, it is the esp_timer_get_time() of the tick
+ *       that detected the event, also with CONFIG_BUTTON_EVENT_DISPATCH_TASK.
+ *       The difference with the current time is the dispatch latency.
+ *
+ * @param btn_handle Button handle
+ *
+ * @return Time of the event in microseconds since boot
+ */
+int64_t iot_button_get_event_time(button_handle_t btn_handle);
+
+/**
+ * @brief Get the number of events dropped because the event queue was full
+ *
+ * @return Dropped events since boot, always 0 without CONFIG_BUTTON_EVENT_DISPATCH_TASK
+ */
+uint32_t iot_button_get_dropped_events(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "iot_button.h"
@@ -33,6 +35,9 @@ static const char *TAG = "button";
 
 typedef struct Button {
     uint16_t        ticks;
+    uint16_t        short_ticks;
+    uint16_t        long_ticks;
+    uint8_t         debounce_ticks;
     uint8_t         repeat;
     button_event_t  event;
     uint8_t         state: 3;
@@ -42,24 +47,171 @@ typedef struct Button {
     uint8_t         (*hal_button_Level)(void *usr_data);
     void            *usr_data;
     button_type_t   type;
+    bool            enable_power_save;
+    int64_t         event_time_us;
     button_cb_t     cb[BUTTON_EVENT_MAX];
     struct Button   *next;
 } button_dev_t;
 
 //button handle list head.
 static button_dev_t *g_head_handle = NULL;
-static esp_timer_handle_t g_button_timer_handle;
+static esp_timer_handle_t g_button_timer_handle = NULL;
 static bool g_is_timer_running = false;
+static portMUX_TYPE g_timer_lock = portMUX_INITIALIZER_UNLOCKED;  /**< g_is_timer_running, shared with the GPIO interrupt */
+static int64_t g_tick_time_us = 0;
 
 #define TICKS_INTERVAL    CONFIG_BUTTON_PERIOD_TIME_MS
 #define DEBOUNCE_TICKS    CONFIG_BUTTON_DEBOUNCE_TICKS //MAX 8
 #define SHORT_TICKS       (CONFIG_BUTTON_SHORT_PRESS_TIME_MS /TICKS_INTERVAL)
 #define LONG_TICKS        (CONFIG_BUTTON_LONG_PRESS_TIME_MS /TICKS_INTERVAL)
 
-#define CALL_EVENT_CB(ev)   if(btn->cb[ev])btn->cb[ev](btn)
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+/**
+ * @brief Event posted by the timer to the dispatch task, the state of the
+ *        button may have changed by the time it is handled
+ */
+typedef struct {
+    button_dev_t    *btn;
+    int64_t         time_us;
+    uint8_t         event;
+    uint8_t         repeat;
+} button_event_record_t;
+
+static QueueHandle_t g_event_queue = NULL;
+static TaskHandle_t g_event_task = NULL;
+static SemaphoreHandle_t g_list_lock = NULL;  /**< the button list, a button isn't freed while its callback is dispatched */
+static const button_event_record_t *g_dispatching = NULL;
+static uint32_t g_dropped_events = 0;
+
+static void button_post_event(button_dev_t *btn, button_event_t event)
+{
+    button_event_record_t record = {
+        .btn     = btn,
+        .time_us = g_tick_time_us,
+        .event   = event,
+        .repeat  = btn->repeat,
+    };
+
+    if (xQueueSend(g_event_queue, &record, 0) != pdTRUE) {
+        g_dropped_events++;
+    }
+}
+
+#define CALL_EVENT_CB(ev)   do { btn->event_time_us = g_tick_time_us; if(btn->cb[ev])button_post_event(btn, ev); } while(0)
+#else
+#define CALL_EVENT_CB(ev)   do { btn->event_time_us = g_tick_time_us; if(btn->cb[ev])btn->cb[ev](btn); } while(0)
+#endif
 
 /**
-  * @brief  Button driver core function, driver state machine.
+ * @brief States of the gesture recogniser
+ */
+enum {
+    BUTTON_STATE_IDLE = 0,      /**< released, no gesture in progress */
+    BUTTON_STATE_DOWN,          /**< first press of a gesture */
+    BUTTON_STATE_UP,            /**< released, waiting for another click */
+    BUTTON_STATE_REPEAT_DOWN,   /**< second or later press of a gesture */
+    BUTTON_STATE_HOLD,          /**< held after a long press or a click then hold */
+    BUTTON_STATE_MAX,
+};
+
+/**
+ * @brief Conditions of a transition, a rule fires when all its condition bits
+ *        are set for the current tick. Rules are checked in the order of the table.
+ */
+#define BUTTON_COND_END             0           /**< end of the rules of a state */
+#define BUTTON_COND_PRESSED         (1 << 0) /**< debounced level is active */
+#define BUTTON_COND_RELEASED        (1 << 1) /**< debounced level is inactive */
+#define BUTTON_COND_BEFORE_SHORT    (1 << 2) /**< ticks < short press time */
+#define BUTTON_COND_AFTER_SHORT     (1 << 3) /**< ticks > short press time */
+#define BUTTON_COND_AFTER_LONG      (1 << 4) /**< ticks > long press time */
+
+#define BUTTON_COND_RELEASED_QUICK  (BUTTON_COND_RELEASED | BUTTON_COND_BEFORE_SHORT)   /**< released before the short press time */
+#define BUTTON_COND_HELD_LONG       (BUTTON_COND_PRESSED | BUTTON_COND_AFTER_LONG)      /**< still pressed after the long press time */
+#define BUTTON_COND_WAITED_SHORT    (BUTTON_COND_RELEASED | BUTTON_COND_AFTER_SHORT)    /**< still released after the short press time */
+
+/**
+ * @brief Action applied before the event of a transition is emitted
+ */
+#define BUTTON_ACTION_NONE          0
+#define BUTTON_ACTION_RESET_TICKS   (1 << 0)                                /**< ticks = 0 */
+#define BUTTON_ACTION_FIRST_PRESS   ((1 << 1) | BUTTON_ACTION_RESET_TICKS)  /**< ticks = 0, repeat = 1 */
+#define BUTTON_ACTION_REPEAT        ((1 << 2) | BUTTON_ACTION_RESET_TICKS)  /**< ticks = 0, repeat++, PRESS_REPEAT emitted after PRESS_DOWN */
+
+/**
+ * @brief Events resolved from the click count when the transition fires
+ */
+#define BUTTON_EVENT_CLICK      (BUTTON_NONE_PRESS + 1)   /**< SINGLE, DOUBLE or MULTIPLE click */
+#define BUTTON_EVENT_HOLD_START (BUTTON_NONE_PRESS + 2)   /**< LONG_PRESS_START or CLICK_HOLD_START */
+#define BUTTON_EVENT_SILENT     BUTTON_NONE_PRESS         /**< sets NONE_PRESS, no callback */
+
+typedef struct {
+    uint8_t cond;
+    uint8_t next;
+    uint8_t event;
+    uint8_t action;
+} button_rule_t;
+
+#define BUTTON_RULES_PER_STATE  4   /**< including the BUTTON_COND_END terminator */
+
+/**
+ * @brief Transition table, the first matching rule of the current state fires.
+ *        A state without a matching rule stays unchanged, unused slots are
+ *        zero (BUTTON_COND_END) and every state ends with one.
+ */
+static const button_rule_t g_button_rules[BUTTON_STATE_MAX][BUTTON_RULES_PER_STATE] = {
+    [BUTTON_STATE_IDLE] = {
+        {BUTTON_COND_RELEASED,       BUTTON_STATE_IDLE,        BUTTON_EVENT_SILENT,     BUTTON_ACTION_NONE},
+        {BUTTON_COND_PRESSED,        BUTTON_STATE_DOWN,        BUTTON_PRESS_DOWN,       BUTTON_ACTION_FIRST_PRESS},
+    },
+    [BUTTON_STATE_DOWN] = {
+        {BUTTON_COND_RELEASED,       BUTTON_STATE_UP,          BUTTON_PRESS_UP,         BUTTON_ACTION_RESET_TICKS},
+        {BUTTON_COND_HELD_LONG,      BUTTON_STATE_HOLD,        BUTTON_EVENT_HOLD_START, BUTTON_ACTION_NONE},
+    },
+    [BUTTON_STATE_UP] = {
+        {BUTTON_COND_PRESSED,        BUTTON_STATE_REPEAT_DOWN, BUTTON_PRESS_DOWN,       BUTTON_ACTION_REPEAT},
+        {BUTTON_COND_WAITED_SHORT,   BUTTON_STATE_IDLE,        BUTTON_EVENT_CLICK,      BUTTON_ACTION_NONE},
+    },
+    [BUTTON_STATE_REPEAT_DOWN] = {
+        {BUTTON_COND_RELEASED_QUICK, BUTTON_STATE_UP,          BUTTON_PRESS_UP,         BUTTON_ACTION_RESET_TICKS},
+        {BUTTON_COND_RELEASED,       BUTTON_STATE_IDLE,        BUTTON_PRESS_UP,         BUTTON_ACTION_NONE}, /**< too slow for a click */
+        {BUTTON_COND_HELD_LONG,      BUTTON_STATE_HOLD,        BUTTON_EVENT_HOLD_START, BUTTON_ACTION_NONE},
+    },
+    [BUTTON_STATE_HOLD] = {
+        {BUTTON_COND_PRESSED,        BUTTON_STATE_HOLD,        BUTTON_LONG_PRESS_HOLD,  BUTTON_ACTION_NONE},
+        {BUTTON_COND_RELEASED,       BUTTON_STATE_IDLE,        BUTTON_PRESS_UP,         BUTTON_ACTION_NONE},
+    },
+};
+
+#define BUTTON_COND_MASK_MAX    (1 << 5)
+
+/**
+ * @brief Rule of every state for every combination of conditions, compiled
+ *        from g_button_rules so a tick costs one lookup: 0 no rule, else the
+ *        rule index + 1.
+ */
+static uint8_t g_button_dispatch[BUTTON_STATE_MAX][BUTTON_COND_MASK_MAX];
+static bool g_button_dispatch_ready = false;
+
+static void button_dispatch_init(void)
+{
+    for (int state = 0; state < BUTTON_STATE_MAX; state++) {
+        for (int cond = 0; cond < BUTTON_COND_MASK_MAX; cond++) {
+            const button_rule_t *rule = g_button_rules[state];
+
+            for (int i = 0; rule[i].cond != BUTTON_COND_END; i++) {
+                if ((rule[i].cond & cond) == rule[i].cond) {
+                    g_button_dispatch[state][cond] = i + 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    g_button_dispatch_ready = true;
+}
+
+/**
+  * @brief  Button driver core function, table driven gesture recogniser.
   */
 static void button_handler(button_dev_t *btn)
 {
@@ -72,7 +224,7 @@ static void button_handler(button_dev_t *btn)
 
     /**< button debounce handle */
     if (read_gpio_level != btn->button_level) {
-        if (++(btn->debounce_cnt) >= DEBOUNCE_TICKS) {
+        if (++(btn->debounce_cnt) >= btn->debounce_ticks) {
             btn->button_level = read_gpio_level;
             btn->debounce_cnt = 0;
         }
@@ -80,93 +232,189 @@ static void button_handler(button_dev_t *btn)
         btn->debounce_cnt = 0;
     }
 
-    /** State machine */
-    switch (btn->state) {
-    case 0:
-        if (btn->button_level == btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
-            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
-            btn->ticks = 0;
-            btn->repeat = 1;
-            btn->state = 1;
-        } else {
-            btn->event = (uint8_t)BUTTON_NONE_PRESS;
+    /**< Conditions true for this tick, compared with the rules as a mask. The idle rules have no timing */
+    uint8_t cond = (btn->button_level == btn->active_level) ? BUTTON_COND_PRESSED : BUTTON_COND_RELEASED;
+
+    if (btn->state != BUTTON_STATE_IDLE) {
+        cond |= (btn->ticks < btn->short_ticks) ? BUTTON_COND_BEFORE_SHORT : 0;
+        cond |= (btn->ticks > btn->short_ticks) ? BUTTON_COND_AFTER_SHORT : 0;
+        cond |= (btn->ticks > btn->long_ticks) ? BUTTON_COND_AFTER_LONG : 0;
+    }
+
+    uint8_t index = g_button_dispatch[btn->state][cond];
+
+    if (index == 0) {
+        return;
+    }
+
+    const button_rule_t *rule = &g_button_rules[btn->state][index - 1];
+    uint8_t event = rule->event;
+    uint8_t action = rule->action;
+    btn->state = rule->next;
+
+    /**< Staying idle is the most frequent transition, it needs no action */
+    if (event == BUTTON_EVENT_SILENT) {
+        btn->event = BUTTON_NONE_PRESS;
+        return;
+    }
+
+    if (action & BUTTON_ACTION_RESET_TICKS) {
+        btn->ticks = 0;
+        btn->repeat = (action == BUTTON_ACTION_FIRST_PRESS) ? 1 :
+                      (action == BUTTON_ACTION_REPEAT) ? btn->repeat + 1 : btn->repeat;
+    }
+
+    if (event == BUTTON_EVENT_CLICK) {
+        event = (btn->repeat == 1) ? BUTTON_SINGLE_CLICK :
+                (btn->repeat == 2) ? BUTTON_DOUBLE_CLICK : BUTTON_MULTIPLE_CLICK;
+    } else if (event == BUTTON_EVENT_HOLD_START) {
+        event = (btn->repeat == 1) ? BUTTON_LONG_PRESS_START : BUTTON_CLICK_HOLD_START;
+    }
+
+    btn->event = (button_event_t)event;
+    CALL_EVENT_CB(event);
+
+    if (action == BUTTON_ACTION_REPEAT) {
+        CALL_EVENT_CB(BUTTON_PRESS_REPEAT); // repeat hit
+    }
+}
+
+static void button_cb(void *args)
+{
+    button_dev_t *target;
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    bool enter_power_save_flag = true;
+#endif
+
+    /**< One timestamp for all the events of this tick */
+    g_tick_time_us = esp_timer_get_time();
+
+    /**< One scan of the key matrix for all the matrix buttons of this tick */
+    button_matrix_scan();
+
+    for (target = g_head_handle; target; target = target->next) {
+        button_handler(target);
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+        if (!(target->enable_power_save && target->debounce_cnt == 0 && target->event == BUTTON_NONE_PRESS)) {
+            enter_power_save_flag = false;
         }
-        break;
+#endif
+    }
 
-    case 1:
-        if (btn->button_level != btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_UP;
-            CALL_EVENT_CB(BUTTON_PRESS_UP);
-            btn->ticks = 0;
-            btn->state = 2;
-
-        } else if (btn->ticks > LONG_TICKS) {
-            btn->event = (uint8_t)BUTTON_LONG_PRESS_START;
-            CALL_EVENT_CB(BUTTON_LONG_PRESS_START);
-            btn->state = 5;
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    /**< All buttons released and idle: stop scanning and wait for the next interrupt */
+    if (enter_power_save_flag && g_head_handle) {
+        /**< An interrupt in between would see the timer running and not start it again */
+        portENTER_CRITICAL(&g_timer_lock);
+
+        if (g_is_timer_running) {
+            esp_timer_stop(g_button_timer_handle);
+            g_is_timer_running = false;
         }
-        break;
 
-    case 2:
-        if (btn->button_level == btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
-            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
-            btn->repeat++;
-            CALL_EVENT_CB(BUTTON_PRESS_REPEAT); // repeat hit
-            btn->ticks = 0;
-            btn->state = 3;
-        } else if (btn->ticks > SHORT_TICKS) {
-            if (btn->repeat == 1) {
-                btn->event = (uint8_t)BUTTON_SINGLE_CLICK;
-                CALL_EVENT_CB(BUTTON_SINGLE_CLICK);
-            } else if (btn->repeat == 2) {
-                btn->event = (uint8_t)BUTTON_DOUBLE_CLICK;
-                CALL_EVENT_CB(BUTTON_DOUBLE_CLICK); // repeat hit
-            }
-            btn->state = 0;
+        for (target = g_head_handle; target; target = target->next) {
+            button_gpio_intr_control((int)(target->usr_data), true);
         }
-        break;
 
-    case 3:
-        if (btn->button_level != btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_UP;
-            CALL_EVENT_CB(BUTTON_PRESS_UP);
-            if (btn->ticks < SHORT_TICKS) {
-                btn->ticks = 0;
-                btn->state = 2; //repeat press
-            } else {
-                btn->state = 0;
-            }
+        portEXIT_CRITICAL(&g_timer_lock);
+    }
+#endif
+}
+
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+static void button_power_save_isr_handler(void *arg)
+{
+    /**< The interrupt only starts the scan, the state machine runs in the timer */
+    portENTER_CRITICAL_ISR(&g_timer_lock);
+
+    if (!g_is_timer_running) {
+        esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
+        g_is_timer_running = true;
+    }
+
+    portEXIT_CRITICAL_ISR(&g_timer_lock);
+
+    button_gpio_intr_control((int)arg, false);
+}
+#endif
+
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+static bool button_is_registered(const button_dev_t *btn)
+{
+    for (button_dev_t *target = g_head_handle; target; target = target->next) {
+        if (target == btn) {
+            return true;
         }
-        break;
+    }
+
+    return false;
+}
 
-    case 5:
-        if (btn->button_level == btn->active_level) {
-            //continue hold trigger
-            btn->event = (uint8_t)BUTTON_LONG_PRESS_HOLD;
-            CALL_EVENT_CB(BUTTON_LONG_PRESS_HOLD);
-        } else { //releasd
-            btn->event = (uint8_t)BUTTON_PRESS_UP;
-            CALL_EVENT_CB(BUTTON_PRESS_UP);
-            btn->state = 0; //reset
+static void button_event_task(void *arg)
+{
+    button_event_record_t record;
+
+    for (;;) {
+        if (xQueueReceive(g_event_queue, &record, portMAX_DELAY) != pdTRUE) {
+            continue;
         }
-        break;
+
+        /**< The button may have been deleted since the event was posted, recursive for a callback deleting its button */
+        xSemaphoreTakeRecursive(g_list_lock, portMAX_DELAY);
+
+        if (button_is_registered(record.btn) && record.btn->cb[record.event]) {
+            g_dispatching = &record;
+            record.btn->cb[record.event](record.btn);
+            g_dispatching = NULL;
+        }
+
+        xSemaphoreGiveRecursive(g_list_lock);
     }
 }
 
-static void button_cb(void *args)
+/**
+ * @brief Return the record being dispatched when called from a callback of btn
+ */
+static const button_event_record_t *button_get_dispatching(const button_dev_t *btn)
 {
-    button_dev_t *target;
-    for (target = g_head_handle; target; target = target->next) {
-        button_handler(target);
+    if (g_dispatching && g_dispatching->btn == btn && xTaskGetCurrentTaskHandle() == g_event_task) {
+        return g_dispatching;
     }
+
+    return NULL;
 }
+#endif
 
-static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_key_state)(void *usr_data), void *usr_data)
+static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_key_state)(void *usr_data), void *usr_data, bool enable_power_save)
 {
     BTN_CHECK(NULL != hal_get_key_state, "Function pointer is invalid", NULL);
 
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    if (NULL == g_list_lock) {
+        g_list_lock = xSemaphoreCreateRecursiveMutex();
+        BTN_CHECK(NULL != g_list_lock, "List lock create failed", NULL);
+    }
+
+    if (NULL == g_event_queue) {
+        g_event_queue = xQueueCreate(CONFIG_BUTTON_EVENT_QUEUE_LENGTH, sizeof(button_event_record_t));
+        BTN_CHECK(NULL != g_event_queue, "Event queue create failed", NULL);
+        BaseType_t ret = xTaskCreate(button_event_task, "button_event", CONFIG_BUTTON_EVENT_TASK_STACK_SIZE,
+                                     NULL, CONFIG_BUTTON_EVENT_TASK_PRIORITY, &g_event_task);
+
+        if (pdPASS != ret) {
+            vQueueDelete(g_event_queue);
+            g_event_queue = NULL;
+            g_event_task = NULL;
+        }
+
+        BTN_CHECK(pdPASS == ret, "Event task create failed", NULL);
+    }
+#endif
+
+    if (!g_button_dispatch_ready) {
+        button_dispatch_init();
+    }
+
     button_dev_t *btn = (button_dev_t *) calloc(1, sizeof(button_dev_t));
     BTN_CHECK(NULL != btn, "Button memory alloc failed", NULL);
     btn->usr_data = usr_data;
@@ -174,22 +422,40 @@ static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_k
     btn->active_level = active_level;
     btn->hal_button_Level = hal_get_key_state;
     btn->button_level = !active_level;
+    btn->enable_power_save = enable_power_save;
+    btn->short_ticks = SHORT_TICKS;
+    btn->long_ticks = LONG_TICKS;
+    btn->debounce_ticks = DEBOUNCE_TICKS;
 
     /** Add handle to list */
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    xSemaphoreTakeRecursive(g_list_lock, portMAX_DELAY);
+#endif
     btn->next = g_head_handle;
     g_head_handle = btn;
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    xSemaphoreGiveRecursive(g_list_lock);
+#endif
 
-    if (false == g_is_timer_running) {
+    if (NULL == g_button_timer_handle) {
         esp_timer_create_args_t button_timer;
         button_timer.arg = NULL;
         button_timer.callback = button_cb;
         button_timer.dispatch_method = ESP_TIMER_TASK;
         button_timer.name = "button_timer";
         esp_timer_create(&button_timer, &g_button_timer_handle);
+    }
+
+    /**< A power save button starts the timer from its interrupt */
+    portENTER_CRITICAL(&g_timer_lock);
+
+    if (!enable_power_save && false == g_is_timer_running) {
         esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
         g_is_timer_running = true;
     }
 
+    portEXIT_CRITICAL(&g_timer_lock);
+
     return btn;
 }
 
@@ -197,6 +463,10 @@ static esp_err_t button_delete_com(button_dev_t *btn)
 {
     BTN_CHECK(NULL != btn, "Pointer of handle is invalid", ESP_ERR_INVALID_ARG);
 
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    xSemaphoreTakeRecursive(g_list_lock, portMAX_DELAY);
+#endif
+
     button_dev_t **curr;
     for (curr = &g_head_handle; *curr; ) {
         button_dev_t *entry = *curr;
@@ -208,6 +478,10 @@ static esp_err_t button_delete_com(button_dev_t *btn)
         }
     }
 
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    xSemaphoreGiveRecursive(g_list_lock);
+#endif
+
     /* count button number */
     uint16_t number = 0;
     button_dev_t *target = g_head_handle;
@@ -217,10 +491,15 @@ static esp_err_t button_delete_com(button_dev_t *btn)
     }
     ESP_LOGD(TAG, "remain btn number=%d", number);
 
-    if (0 == number && g_is_timer_running) { /**<  if all button is deleted, stop the timer */
-        esp_timer_stop(g_button_timer_handle);
+    if (0 == number && g_button_timer_handle) { /**<  if all button is deleted, stop the timer */
+        portENTER_CRITICAL(&g_timer_lock);
+        if (g_is_timer_running) {
+            esp_timer_stop(g_button_timer_handle);
+            g_is_timer_running = false;
+        }
+        portEXIT_CRITICAL(&g_timer_lock);
         esp_timer_delete(g_button_timer_handle);
-        g_is_timer_running = false;
+        g_button_timer_handle = NULL;
     }
     return ESP_OK;
 }
@@ -234,13 +513,39 @@ button_handle_t iot_button_create(const button_config_t *config)
         const button_gpio_config_t *cfg = &(config->gpio_button_config);
         ret = button_gpio_init(cfg);
         BTN_CHECK(ESP_OK == ret, "gpio button init failed", NULL);
-        btn = button_create_com(cfg->active_level, button_gpio_get_key_level, (void *)cfg->gpio_num);
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+        bool enable_power_save = cfg->enable_power_save;
+#else
+        bool enable_power_save = false;
+#endif
+        btn = button_create_com(cfg->active_level, button_gpio_get_key_level, (void *)cfg->gpio_num, enable_power_save);
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+        if (btn && enable_power_save) {
+            ret = button_gpio_set_intr(cfg->gpio_num, cfg->active_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL,
+                                       button_power_save_isr_handler, (void *)cfg->gpio_num);
+            if (ESP_OK == ret) {
+                button_gpio_intr_control(cfg->gpio_num, true);
+            } else {
+                button_delete_com(btn);
+                btn = NULL;
+            }
+        }
+#endif
     } break;
     case BUTTON_TYPE_ADC: {
         const button_adc_config_t *cfg = &(config->adc_button_config);
         ret = button_adc_init(cfg);
         BTN_CHECK(ESP_OK == ret, "adc button init failed", NULL);
-        btn = button_create_com(1, button_adc_get_key_level, (void *)ADC_BUTTON_COMBINE(cfg->adc_channel, cfg->button_index));
+        btn = button_create_com(1, button_adc_get_key_level, (void *)ADC_BUTTON_COMBINE(cfg->adc_channel, cfg->button_index), false);
+    } break;
+    case BUTTON_TYPE_MATRIX: {
+        const button_matrix_config_t *cfg = &(config->matrix_button_config);
+        ret = button_matrix_init(cfg);
+        BTN_CHECK(ESP_OK == ret, "matrix button init failed", NULL);
+        btn = button_create_com(1, button_matrix_get_key_level, (void *)MATRIX_BUTTON_COMBINE(cfg->row, cfg->col), false);
+        if (NULL == btn) {
+            button_matrix_deinit(cfg->row, cfg->col);
+        }
     } break;
 
     default:
@@ -249,6 +554,7 @@ button_handle_t iot_button_create(const button_config_t *config)
     }
     BTN_CHECK(NULL != btn, "button create failed", NULL);
     btn->type = config->type;
+    iot_button_set_timing((button_handle_t)btn, &config->timing);
     return (button_handle_t)btn;
 }
 
@@ -264,6 +570,9 @@ esp_err_t iot_button_delete(button_handle_t btn_handle)
     case BUTTON_TYPE_ADC:
         ret = button_adc_deinit(ADC_BUTTON_SPLIT_CHANNEL(btn->usr_data), ADC_BUTTON_SPLIT_INDEX(btn->usr_data));
         break;
+    case BUTTON_TYPE_MATRIX:
+        ret = button_matrix_deinit(MATRIX_BUTTON_SPLIT_ROW(btn->usr_data), MATRIX_BUTTON_SPLIT_COL(btn->usr_data));
+        break;
     default:
         break;
     }
@@ -294,6 +603,12 @@ button_event_t iot_button_get_event(button_handle_t btn_handle)
 {
     BTN_CHECK(NULL != btn_handle, "Pointer of handle is invalid", BUTTON_NONE_PRESS);
     button_dev_t *btn = (button_dev_t *) btn_handle;
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    const button_event_record_t *record = button_get_dispatching(btn);
+    if (record) {
+        return (button_event_t)record->event;
+    }
+#endif
     return btn->event;
 }
 
@@ -301,5 +616,45 @@ uint8_t iot_button_get_repeat(button_handle_t btn_handle)
 {
     BTN_CHECK(NULL != btn_handle, "Pointer of handle is invalid", 0);
     button_dev_t *btn = (button_dev_t *) btn_handle;
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    const button_event_record_t *record = button_get_dispatching(btn);
+    if (record) {
+        return record->repeat;
+    }
+#endif
     return btn->repeat;
 }
+
+esp_err_t iot_button_set_timing(button_handle_t btn_handle, const button_timing_t *timing)
+{
+    BTN_CHECK(NULL != btn_handle, "Pointer of handle is invalid", ESP_ERR_INVALID_ARG);
+    BTN_CHECK(NULL != timing, "Pointer of timing is invalid", ESP_ERR_INVALID_ARG);
+    BTN_CHECK(timing->debounce_ticks < 8, "debounce_ticks is invalid", ESP_ERR_INVALID_ARG);
+    button_dev_t *btn = (button_dev_t *) btn_handle;
+    btn->short_ticks = timing->short_press_time ? timing->short_press_time / TICKS_INTERVAL : SHORT_TICKS;
+    btn->long_ticks = timing->long_press_time ? timing->long_press_time / TICKS_INTERVAL : LONG_TICKS;
+    btn->debounce_ticks = timing->debounce_ticks ? timing->debounce_ticks : DEBOUNCE_TICKS;
+    return ESP_OK;
+}
+
+int64_t iot_button_get_event_time(button_handle_t btn_handle)
+{
+    BTN_CHECK(NULL != btn_handle, "Pointer of handle is invalid", 0);
+    button_dev_t *btn = (button_dev_t *) btn_handle;
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    const button_event_record_t *record = button_get_dispatching(btn);
+    if (record) {
+        return record->time_us;
+    }
+#endif
+    return btn->event_time_us;
+}
+
+uint32_t iot_button_get_dropped_events(void)
+{
+#if CONFIG_BUTTON_EVENT_DISPATCH_TASK
+    return g_dropped_events;
+#else
+    return 0;
+#endif
+}
@@ -18,6 +18,8 @@
 #include "freertos/queue.h"
 #include "freertos/timers.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 #include "unity.h"
 #include "iot_button.h"
 
@@ -80,6 +82,18 @@ static void button_long_press_hold_cb(void *arg)
     ESP_LOGI(TAG, "BTN%d: BUTTON_LONG_PRESS_HOLD", get_btn_index((button_handle_t)arg));
 }
 
+static void button_multiple_click_cb(void *arg)
+{
+    TEST_ASSERT_EQUAL_HEX(BUTTON_MULTIPLE_CLICK, iot_button_get_event(arg));
+    ESP_LOGI(TAG, "BTN%d: BUTTON_MULTIPLE_CLICK[%d]", get_btn_index((button_handle_t)arg), iot_button_get_repeat((button_handle_t)arg));
+}
+
+static void button_click_hold_start_cb(void *arg)
+{
+    TEST_ASSERT_EQUAL_HEX(BUTTON_CLICK_HOLD_START, iot_button_get_event(arg));
+    ESP_LOGI(TAG, "BTN%d: BUTTON_CLICK_HOLD_START[%d]", get_btn_index((button_handle_t)arg), iot_button_get_repeat((button_handle_t)arg));
+}
+
 static void print_button_event(button_handle_t btn)
 {
     button_event_t evt = iot_button_get_event(btn);
@@ -105,6 +119,12 @@ static void print_button_event(button_handle_t btn)
     case BUTTON_LONG_PRESS_HOLD:
         ESP_LOGI(TAG, "BUTTON_LONG_PRESS_HOLD");
         break;
+    case BUTTON_MULTIPLE_CLICK:
+        ESP_LOGI(TAG, "BUTTON_MULTIPLE_CLICK");
+        break;
+    case BUTTON_CLICK_HOLD_START:
+        ESP_LOGI(TAG, "BUTTON_CLICK_HOLD_START");
+        break;
 
     default:
         break;
@@ -129,6 +149,8 @@ TEST_CASE("gpio button test", "[button][iot]")
     iot_button_register_cb(g_btns[0], BUTTON_DOUBLE_CLICK, button_double_click_cb);
     iot_button_register_cb(g_btns[0], BUTTON_LONG_PRESS_START, button_long_press_start_cb);
     iot_button_register_cb(g_btns[0], BUTTON_LONG_PRESS_HOLD, button_long_press_hold_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_MULTIPLE_CLICK, button_multiple_click_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_CLICK_HOLD_START, button_click_hold_start_cb);
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
@@ -136,6 +158,39 @@ TEST_CASE("gpio button test", "[button][iot]")
     iot_button_delete(g_btns[0]);
 }
 
+TEST_CASE("gpio button timing test", "[button][iot]")
+{
+    button_config_t cfg = {
+        .type = BUTTON_TYPE_GPIO,
+        .timing = {
+            .short_press_time = 300,
+            .long_press_time = 800,
+        },
+        .gpio_button_config = {
+            .gpio_num = 0,
+            .active_level = 0,
+        },
+    };
+    g_btns[0] = iot_button_create(&cfg);
+    TEST_ASSERT_NOT_NULL(g_btns[0]);
+
+    button_timing_t timing = {
+        .debounce_ticks = 8,
+    };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, iot_button_set_timing(g_btns[0], &timing));
+    timing.debounce_ticks = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_set_timing(g_btns[0], &timing));
+    TEST_ASSERT_EQUAL(ESP_OK, iot_button_set_timing(g_btns[0], &cfg.timing));
+
+    iot_button_register_cb(g_btns[0], BUTTON_SINGLE_CLICK, button_single_click_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_DOUBLE_CLICK, button_double_click_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_MULTIPLE_CLICK, button_multiple_click_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_LONG_PRESS_START, button_long_press_start_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_CLICK_HOLD_START, button_click_hold_start_cb);
+    vTaskDelay(pdMS_TO_TICKS(10000));
+    iot_button_delete(g_btns[0]);
+}
+
 TEST_CASE("adc button test", "[button][iot]")
 {
     /** ESP32-LyraT-Mini board */
@@ -231,4 +286,220 @@ TEST_CASE("adc gpio button test", "[button][iot]")
     for (size_t i = 0; i < 6; i++) {
         iot_button_delete(g_btns[i]);
     }
-}
\ No newline at end of file
+}
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+#include "esp_pm.h"
+
+TEST_CASE("gpio button power save test", "[button][iot]")
+{
+    button_config_t cfg = {
+        .type = BUTTON_TYPE_GPIO,
+        .gpio_button_config = {
+            .gpio_num = BUTTON_IO_NUM,
+            .active_level = BUTTON_ACTIVE_LEVEL,
+            .enable_power_save = true,
+        },
+    };
+    g_btns[0] = iot_button_create(&cfg);
+    TEST_ASSERT_NOT_NULL(g_btns[0]);
+    iot_button_register_cb(g_btns[0], BUTTON_PRESS_DOWN, button_press_down_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_PRESS_UP, button_press_up_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_PRESS_REPEAT, button_press_repeat_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_SINGLE_CLICK, button_single_click_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_DOUBLE_CLICK, button_double_click_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_LONG_PRESS_START, button_long_press_start_cb);
+    iot_button_register_cb(g_btns[0], BUTTON_LONG_PRESS_HOLD, button_long_press_hold_cb);
+
+#if CONFIG_PM_ENABLE
+    /** The button must still work with light sleep, it is a wakeup source */
+    esp_pm_config_esp32c3_t pm_config = {
+        .max_freq_mhz = 160,
+        .min_freq_mhz = 40,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true
+#endif
+    };
+    TEST_ESP_OK(esp_pm_configure(&pm_config));
+#endif
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+
+    iot_button_delete(g_btns[0]);
+}
+#endif
+
+/**
+ * @brief Time spent by the esp_timer task in the ADC button HAL, for 1, 4 and 8 buttons.
+ *        Each tick calls button_adc_get_key_level() once per button, like button_cb().
+ *        Build once with and once without CONFIG_ADC_BUTTON_CONTINUOUS_MODE to compare.
+ */
+TEST_CASE("adc button timer task cpu time", "[button][iot][benchmark]")
+{
+#define BENCH_TICKS 200
+#if CONFIG_ADC_BUTTON_CONTINUOUS_MODE
+    const char *mode = "continuous";
+#else
+    const char *mode = "oneshot";
+#endif
+    const int button_count[] = {1, 4, 8};
+    const adc1_channel_t channels[] = {ADC1_CHANNEL_0, ADC1_CHANNEL_1, ADC1_CHANNEL_2, ADC1_CHANNEL_3};
+
+    for (size_t n = 0; n < sizeof(button_count) / sizeof(button_count[0]); n++) {
+        int num = button_count[n];
+        int ch_num = CONFIG_ADC_BUTTON_MAX_CHANNEL < 4 ? CONFIG_ADC_BUTTON_MAX_CHANNEL : 4;
+        void *btns[8] = {0};
+
+        for (int i = 0; i < num; i++) {
+            button_adc_config_t cfg = {
+                .adc_channel = channels[i % ch_num],
+                .button_index = i / ch_num,
+                .min = 100 + i * 300,
+                .max = 400 + i * 300,
+            };
+            TEST_ESP_OK(button_adc_init(&cfg));
+            btns[i] = (void *)ADC_BUTTON_COMBINE(cfg.adc_channel, cfg.button_index);
+        }
+
+        /**< Let the continuous mode produce its first frames */
+        vTaskDelay(pdMS_TO_TICKS(100));
+
+        int64_t busy_us = 0;
+        int64_t max_us = 0;
+
+        for (int tick = 0; tick < BENCH_TICKS; tick++) {
+            int64_t start = esp_timer_get_time();
+
+            for (int i = 0; i < num; i++) {
+                button_adc_get_key_level(btns[i]);
+            }
+
+            int64_t elapsed = esp_timer_get_time() - start;
+            busy_us += elapsed;
+            max_us = elapsed > max_us ? elapsed : max_us;
+
+            esp_rom_delay_us(CONFIG_BUTTON_PERIOD_TIME_MS * 1000);
+        }
+
+        ESP_LOGI(TAG, "%d adc button(s), %s: %lld us/tick avg, %lld us max, %.2f%% of the timer task",
+                 num, mode,
+                 busy_us / BENCH_TICKS, max_us,
+                 busy_us * 100.0 / (BENCH_TICKS * CONFIG_BUTTON_PERIOD_TIME_MS * 1000));
+
+        for (int i = 0; i < num; i++) {
+            TEST_ESP_OK(button_adc_deinit(ADC_BUTTON_SPLIT_CHANNEL(btns[i]), ADC_BUTTON_SPLIT_INDEX(btns[i])));
+        }
+    }
+#undef BENCH_TICKS
+}
+
+/** Key matrix of a wall panel, 3 rows and 4 columns */
+static const int32_t g_matrix_rows[] = {4, 5, 6};
+static const int32_t g_matrix_cols[] = {7, 10, 18, 19};
+#define MATRIX_ROW_NUM (sizeof(g_matrix_rows) / sizeof(g_matrix_rows[0]))
+#define MATRIX_COL_NUM (sizeof(g_matrix_cols) / sizeof(g_matrix_cols[0]))
+
+TEST_CASE("matrix button test", "[button][iot]")
+{
+    for (int i = 0; i < MATRIX_ROW_NUM * MATRIX_COL_NUM; i++) {
+        button_config_t cfg = {
+            .type = BUTTON_TYPE_MATRIX,
+            .matrix_button_config = {
+                .row_gpios = g_matrix_rows,
+                .col_gpios = g_matrix_cols,
+                .row_gpio_num = MATRIX_ROW_NUM,
+                .col_gpio_num = MATRIX_COL_NUM,
+                .row = i / MATRIX_COL_NUM,
+                .col = i % MATRIX_COL_NUM,
+            },
+        };
+        g_btns[i] = iot_button_create(&cfg);
+        TEST_ASSERT_NOT_NULL(g_btns[i]);
+        iot_button_register_cb(g_btns[i], BUTTON_PRESS_DOWN, button_press_down_cb);
+        iot_button_register_cb(g_btns[i], BUTTON_PRESS_UP, button_press_up_cb);
+        iot_button_register_cb(g_btns[i], BUTTON_SINGLE_CLICK, button_single_click_cb);
+        iot_button_register_cb(g_btns[i], BUTTON_DOUBLE_CLICK, button_double_click_cb);
+        iot_button_register_cb(g_btns[i], BUTTON_LONG_PRESS_START, button_long_press_start_cb);
+    }
+
+    /** A key used twice is refused */
+    button_config_t cfg = {
+        .type = BUTTON_TYPE_MATRIX,
+        .matrix_button_config = {
+            .row_gpios = g_matrix_rows,
+            .col_gpios = g_matrix_cols,
+            .row_gpio_num = MATRIX_ROW_NUM,
+            .col_gpio_num = MATRIX_COL_NUM,
+        },
+    };
+    TEST_ASSERT_NULL(iot_button_create(&cfg));
+
+    for (int i = 0; i < 30; i++) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        ESP_LOGI(TAG, "ghost scans: %u", button_matrix_get_ghost_count());
+    }
+
+    for (int i = 0; i < MATRIX_ROW_NUM * MATRIX_COL_NUM; i++) {
+        TEST_ESP_OK(iot_button_delete(g_btns[i]));
+    }
+}
+
+/**
+ * @brief Time spent by the esp_timer task in the HAL for 1 to 12 keys, as GPIO
+ *        buttons (one read per key) and as a 3x4 matrix (one scan per tick).
+ */
+TEST_CASE("matrix button timer task cpu time", "[button][iot][benchmark]")
+{
+#define BENCH_TICKS 200
+    const int key_count[] = {1, 4, 8, 12};
+
+    for (size_t n = 0; n < sizeof(key_count) / sizeof(key_count[0]); n++) {
+        int num = key_count[n];
+        void *keys[MATRIX_ROW_NUM * MATRIX_COL_NUM] = {0};
+
+        for (int i = 0; i < num; i++) {
+            button_matrix_config_t cfg = {
+                .row_gpios = g_matrix_rows,
+                .col_gpios = g_matrix_cols,
+                .row_gpio_num = MATRIX_ROW_NUM,
+                .col_gpio_num = MATRIX_COL_NUM,
+                .row = i / MATRIX_COL_NUM,
+                .col = i % MATRIX_COL_NUM,
+            };
+            TEST_ESP_OK(button_matrix_init(&cfg));
+            keys[i] = (void *)MATRIX_BUTTON_COMBINE(cfg.row, cfg.col);
+        }
+
+        int64_t gpio_us = 0;
+        int64_t matrix_us = 0;
+
+        for (int tick = 0; tick < BENCH_TICKS; tick++) {
+            int64_t start = esp_timer_get_time();
+
+            for (int i = 0; i < num; i++) {
+                button_gpio_get_key_level((void *)g_matrix_cols[i % MATRIX_COL_NUM]);
+            }
+
+            int64_t middle = esp_timer_get_time();
+            button_matrix_scan();
+
+            for (int i = 0; i < num; i++) {
+                button_matrix_get_key_level(keys[i]);
+            }
+
+            matrix_us += esp_timer_get_time() - middle;
+            gpio_us += middle - start;
+
+            esp_rom_delay_us(CONFIG_BUTTON_PERIOD_TIME_MS * 1000);
+        }
+
+        ESP_LOGI(TAG, "%d key(s): gpio %lld us/tick, matrix %lld us/tick", num,
+                 gpio_us / BENCH_TICKS, matrix_us / BENCH_TICKS);
+
+        for (int i = 0; i < num; i++) {
+            TEST_ESP_OK(button_matrix_deinit(MATRIX_BUTTON_SPLIT_ROW(keys[i]), MATRIX_BUTTON_SPLIT_COL(keys[i])));
+        }
+    }
+#undef BENCH_TICKS
+}
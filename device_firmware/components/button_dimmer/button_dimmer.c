@@ -0,0 +1,224 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "light_driver.h"
+#include "button_dimmer.h"
+
+static const char *TAG = "button_dimmer";
+
+#define DIMMER_CHECK(a, str, ret_val)                             \
+    if (!(a))                                                     \
+    {                                                             \
+        ESP_LOGE(TAG, "%s(%d): %s", __FUNCTION__, __LINE__, str); \
+        return (ret_val);                                         \
+    }
+
+#define DIMMER_UPDATE_PERIOD_MS_DEFAULT  50
+#define DIMMER_RAMP_TIME_MS_DEFAULT      3000
+#define DIMMER_MIN_LEVEL_DEFAULT         1
+#define DIMMER_MAX_LEVEL_DEFAULT         100
+#define DIMMER_LEVEL_SCALE               1000    /**< the ramp position is in 1/1000 level */
+
+typedef struct button_dimmer {
+    button_handle_t btn;
+    button_dimmer_config_t config;
+    int64_t speed;              /**< start speed, 1/1000 level per second */
+    int64_t start_us;
+    int64_t last_push_us;
+    int32_t position;           /**< level * DIMMER_LEVEL_SCALE */
+    int8_t direction;           /**< 1 up, -1 down, of the current or previous ramp */
+    uint8_t level;              /**< last level pushed to the light */
+    bool ramping;
+    struct button_dimmer *next;
+} button_dimmer_t;
+
+static button_dimmer_t *g_dimmer_head = NULL;
+
+static button_dimmer_t *button_dimmer_find(button_handle_t btn)
+{
+    for (button_dimmer_t *dimmer = g_dimmer_head; dimmer; dimmer = dimmer->next) {
+        if (dimmer->btn == btn) {
+            return dimmer;
+        }
+    }
+
+    return NULL;
+}
+
+static void button_dimmer_push(button_dimmer_t *dimmer, uint8_t level)
+{
+    if (level == dimmer->level) {
+        return;
+    }
+
+    /**< Fade over one update period, the next target arrives when the fade ends */
+    if (light_driver_set_level(level, dimmer->config.update_period_ms) == ESP_OK) {
+        dimmer->level = level;
+
+        if (dimmer->config.step_cb) {
+            dimmer->config.step_cb(level, dimmer->config.step_cb_arg);
+        }
+    }
+}
+
+static void button_dimmer_start_cb(void *arg)
+{
+    button_dimmer_t *dimmer = button_dimmer_find(arg);
+
+    if (!dimmer) {
+        return;
+    }
+
+    uint8_t level = light_driver_get_level();
+    const button_dimmer_config_t *config = &dimmer->config;
+
+    /**< Reverse on each hold, away from the limit the light is at. A light off starts from the bottom */
+    if (!light_driver_get_switch()) {
+        level = config->min_level;
+        dimmer->direction = 1;
+        dimmer->level = 0;
+    } else {
+        level = (level < config->min_level) ? config->min_level : (level > config->max_level) ? config->max_level : level;
+        dimmer->direction = (level >= config->max_level) ? -1 : (level <= config->min_level) ? 1 : -dimmer->direction;
+        dimmer->level = light_driver_get_level();
+    }
+
+    dimmer->position = level * DIMMER_LEVEL_SCALE;
+    dimmer->start_us = esp_timer_get_time();
+    dimmer->last_push_us = dimmer->start_us;
+    dimmer->ramping = true;
+    button_dimmer_push(dimmer, level);
+
+    ESP_LOGD(TAG, "ramp %s from %d", dimmer->direction > 0 ? "up" : "down", level);
+}
+
+static void button_dimmer_hold_cb(void *arg)
+{
+    button_dimmer_t *dimmer = button_dimmer_find(arg);
+
+    if (!dimmer || !dimmer->ramping) {
+        return;
+    }
+
+    /**< The hold event comes every button tick, the fade engine only gets a target per update period */
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - dimmer->last_push_us;
+
+    if (elapsed < dimmer->config.update_period_ms * 1000LL) {
+        return;
+    }
+
+    const button_dimmer_config_t *config = &dimmer->config;
+    int64_t speed = dimmer->speed + dimmer->speed * config->acceleration * (now - dimmer->start_us) / (100 * 1000000LL);
+    int64_t position = dimmer->position + dimmer->direction * speed * elapsed / 1000000LL;
+    int64_t min = config->min_level * DIMMER_LEVEL_SCALE;
+    int64_t max = config->max_level * DIMMER_LEVEL_SCALE;
+
+    dimmer->position = (position < min) ? min : (position > max) ? max : position;
+    dimmer->last_push_us = now;
+    button_dimmer_push(dimmer, (dimmer->position + DIMMER_LEVEL_SCALE / 2) / DIMMER_LEVEL_SCALE);
+}
+
+static void button_dimmer_end_cb(void *arg)
+{
+    button_dimmer_t *dimmer = button_dimmer_find(arg);
+
+    if (!dimmer || !dimmer->ramping) {
+        return;
+    }
+
+    dimmer->ramping = false;
+
+    /**< The only flash write of the ramp */
+    if (light_driver_save_status() != ESP_OK) {
+        ESP_LOGW(TAG, "Save the light status failed");
+    }
+
+    ESP_LOGD(TAG, "ramp end at %d", dimmer->level);
+
+    if (dimmer->config.end_cb) {
+        dimmer->config.end_cb(dimmer->level, dimmer->config.end_cb_arg);
+    }
+}
+
+button_dimmer_handle_t button_dimmer_create(button_handle_t btn_handle, const button_dimmer_config_t *config)
+{
+    DIMMER_CHECK(NULL != btn_handle, "Pointer of button handle is invalid", NULL);
+    DIMMER_CHECK(NULL != config, "Pointer of config is invalid", NULL);
+    DIMMER_CHECK(NULL == button_dimmer_find(btn_handle), "The button already has a dimmer", NULL);
+
+    button_dimmer_t *dimmer = (button_dimmer_t *) calloc(1, sizeof(button_dimmer_t));
+    DIMMER_CHECK(NULL != dimmer, "Dimmer memory alloc failed", NULL);
+
+    dimmer->btn = btn_handle;
+    dimmer->config = *config;
+    dimmer->direction = -1; /**< The first hold ramps up */
+
+    button_dimmer_config_t *cfg = &dimmer->config;
+    cfg->update_period_ms = cfg->update_period_ms ? cfg->update_period_ms : DIMMER_UPDATE_PERIOD_MS_DEFAULT;
+    cfg->ramp_time_ms = cfg->ramp_time_ms ? cfg->ramp_time_ms : DIMMER_RAMP_TIME_MS_DEFAULT;
+    cfg->min_level = cfg->min_level ? cfg->min_level : DIMMER_MIN_LEVEL_DEFAULT;
+    cfg->max_level = cfg->max_level ? cfg->max_level : DIMMER_MAX_LEVEL_DEFAULT;
+
+    if (cfg->max_level > 100 || cfg->min_level >= cfg->max_level) {
+        ESP_LOGE(TAG, "%s(%d): %s", __FUNCTION__, __LINE__, "Levels are invalid");
+        free(dimmer);
+        return NULL;
+    }
+
+    dimmer->speed = (int64_t)(cfg->max_level - cfg->min_level) * DIMMER_LEVEL_SCALE * 1000 / cfg->ramp_time_ms;
+
+    iot_button_register_cb(btn_handle, BUTTON_LONG_PRESS_START, button_dimmer_start_cb);
+    iot_button_register_cb(btn_handle, BUTTON_LONG_PRESS_HOLD, button_dimmer_hold_cb);
+    iot_button_register_cb(btn_handle, BUTTON_PRESS_UP, button_dimmer_end_cb);
+
+    dimmer->next = g_dimmer_head;
+    g_dimmer_head = dimmer;
+
+    return (button_dimmer_handle_t)dimmer;
+}
+
+esp_err_t button_dimmer_delete(button_dimmer_handle_t dimmer_handle)
+{
+    DIMMER_CHECK(NULL != dimmer_handle, "Pointer of handle is invalid", ESP_ERR_INVALID_ARG);
+    button_dimmer_t *dimmer = (button_dimmer_t *)dimmer_handle;
+
+    for (button_dimmer_t **curr = &g_dimmer_head; *curr; curr = &(*curr)->next) {
+        if (*curr == dimmer) {
+            *curr = dimmer->next;
+            break;
+        }
+    }
+
+    iot_button_unregister_cb(dimmer->btn, BUTTON_LONG_PRESS_START);
+    iot_button_unregister_cb(dimmer->btn, BUTTON_LONG_PRESS_HOLD);
+    iot_button_unregister_cb(dimmer->btn, BUTTON_PRESS_UP);
+
+    if (dimmer->ramping) {
+        light_driver_save_status();
+    }
+
+    free(dimmer);
+    return ESP_OK;
+}
+
+bool button_dimmer_is_ramping(button_dimmer_handle_t dimmer_handle)
+{
+    DIMMER_CHECK(NULL != dimmer_handle, "Pointer of handle is invalid", false);
+    return ((button_dimmer_t *)dimmer_handle)->ramping;
+}
@@ -0,0 +1,86 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __BUTTON_DIMMER_H__
+#define __BUTTON_DIMMER_H__
+
+#include "esp_err.h"
+#include "iot_button.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *button_dimmer_handle_t;
+
+/**
+ * @brief Called when the ramp ends, with the level saved to the flash, or at each step of the ramp
+ */
+typedef void (* button_dimmer_cb_t)(uint8_t level, void *arg);
+
+/**
+ * @brief Dimmer configuration, a zero field uses the default
+ *
+ */
+typedef struct {
+    uint16_t update_period_ms;  /**< period of the targets pushed to the fade engine, default 50 ms */
+    uint16_t ramp_time_ms;      /**< time of a ramp from min_level to max_level at the start speed, default 3000 ms */
+    uint16_t acceleration;      /**< speed increase in percent per second of hold, 0 for a constant speed */
+    uint8_t min_level;          /**< lowest level of the ramp, the light is never turned off, default 1 */
+    uint8_t max_level;          /**< highest level of the ramp, default 100 */
+    button_dimmer_cb_t end_cb;  /**< optional, called on release */
+    void *end_cb_arg;           /**< argument of end_cb */
+    button_dimmer_cb_t step_cb; /**< optional, called with each new level of the ramp, the level is not saved yet */
+    void *step_cb_arg;          /**< argument of step_cb */
+} button_dimmer_config_t;
+
+/**
+ * @brief Create a dimmer on a button
+ *
+ * Holding the button ramps the level of the light, each hold in the opposite
+ * direction of the previous one, and away from the limit the light is at.
+ *
+ * @note The dimmer registers the BUTTON_LONG_PRESS_START, BUTTON_LONG_PRESS_HOLD
+ *       and BUTTON_PRESS_UP callbacks of the button.
+ *
+ * @param btn_handle Button, created by iot_button_create()
+ * @param config Dimmer configuration
+ * @return A handle to the created dimmer, or NULL in case of error.
+ */
+button_dimmer_handle_t button_dimmer_create(button_handle_t btn_handle, const button_dimmer_config_t *config);
+
+/**
+ * @brief Delete a dimmer and unregister its button callbacks
+ *
+ * @param dimmer_handle A dimmer handle to delete
+ *
+ * @return
+ *      - ESP_OK  Success
+ *      - ESP_ERR_INVALID_ARG  Arguments is invalid.
+ */
+esp_err_t button_dimmer_delete(button_dimmer_handle_t dimmer_handle);
+
+/**
+ * @brief Whether the button is held and the level is ramping
+ *
+ * @param dimmer_handle Dimmer handle
+ * @return true when ramping
+ */
+bool button_dimmer_is_ramping(button_dimmer_handle_t dimmer_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< __BUTTON_DIMMER_H__ */
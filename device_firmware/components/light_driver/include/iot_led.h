@@ -51,6 +51,29 @@ extern "C" {
         } \
     } while(0)
 
+/**
+ * @brief States of the light measured by CONFIG_LIGHT_DRIVER_PM_MEASUREMENT
+ */
+typedef enum {
+    IOT_LED_POWER_OFF_IDLE,     /**< all the channels at 0, no fade */
+    IOT_LED_POWER_ON_IDLE,      /**< static output */
+    IOT_LED_POWER_FADING,       /**< fade or blink timer running, the APB lock is held */
+    IOT_LED_POWER_STATE_MAX,
+} iot_led_power_state_t;
+
+/**
+ * @brief Measurements of a light state since iot_led_init()
+ */
+typedef struct {
+    uint64_t time_ms;           /**< time spent in the state */
+    uint32_t wakeups;           /**< wake-ups of the CPU from idle */
+} iot_led_power_stats_t;
+
+/**
+  * @brief Acquire or release callback of iot_led_set_pm_hooks()
+  */
+typedef void (*iot_led_pm_cb_t)(void *arg);
+
 /**
   * @brief Initialize and set the ledc timer for the iot led
   *
@@ -63,7 +86,8 @@ extern "C" {
   * @param freq_hz frequency of ledc timer
   *     This parameter must be less than 5000
   *
-  * @param clk_cfg clock srouce of ledc
+  * @param clk_cfg clock srouce of ledc, LEDC_USE_RTC8M_CLK keeps the output
+  *     unchanged by DFS and light sleep
   *
   * @param duty_resolution LEDC channel duty resolution
   *
@@ -182,6 +206,65 @@ esp_err_t iot_led_stop_blink(ledc_channel_t channel);
 */
 esp_err_t iot_led_set_gamma_table(const uint16_t gamma_table[GAMMA_TABLE_SIZE]);
 
+/**
+  * @brief Get the output of a channel integrated over time since iot_led_init()
+  *
+  * @param channel The ledc channel
+  * @param duty_ms Time at full duty equivalent to the output, e.g. 1000 for 2 s at 50 %
+  *
+  * @return
+  *	    - ESP_OK if sucess
+  *	    - ESP_ERR_INVALID_ARG Parameter error or iot_led_init() not called yet
+*/
+esp_err_t iot_led_get_duty_ms(ledc_channel_t channel, uint64_t *duty_ms);
+
+/**
+  * @brief Restart the period of the fade timer, its next step is DUTY_SET_CYCLE from now
+  *
+  * @note  The fades set right after start on the same step on every light that restarted
+  *     its timer at the same time, instead of anywhere within the first period
+  *
+  * @return
+  *	    - ESP_OK if sucess
+  *	    - ESP_ERR_INVALID_ARG iot_led_init() not called yet
+*/
+esp_err_t iot_led_restart_tick(void);
+
+/**
+  * @brief Hold the APB frequency during fades with a lock of the application instead of
+  *     the "led_fade" lock of the driver, e.g. to account it with the other locks
+  *
+  * @note  release is called from the ISR of the fade timer, both must be in IRAM
+  *
+  * @param acquire Called when the fade timer starts, NULL to use the lock of the driver again
+  * @param release Called when the fade timer stops
+  * @param arg Passed to acquire and release
+  *
+  * @return
+  *	    - ESP_OK if sucess
+  *	    - ESP_ERR_INVALID_ARG only one of acquire and release is set
+  *	    - ESP_ERR_INVALID_STATE a fade or a blink is running
+*/
+esp_err_t iot_led_set_pm_hooks(iot_led_pm_cb_t acquire, iot_led_pm_cb_t release, void *arg);
+
+/**
+  * @brief Get the time and the CPU wake-ups measured in a light state
+  *
+  * @param state The light state
+  * @param stats The measurements
+  *
+  * @return
+  *	    - ESP_OK if sucess
+  *	    - ESP_ERR_INVALID_ARG Parameter error
+  *	    - ESP_ERR_NOT_SUPPORTED if CONFIG_LIGHT_DRIVER_PM_MEASUREMENT is disabled
+*/
+esp_err_t iot_led_get_power_stats(iot_led_power_state_t state, iot_led_power_stats_t *stats);
+
+/**
+  * @brief Log the measurements of all the light states
+*/
+void iot_led_dump_power_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
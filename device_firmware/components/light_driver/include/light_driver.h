@@ -39,6 +39,10 @@ enum light_mode {
     MODE_BRIGHTNESS_DECREASE = 9,
 };
 
+#define LIGHT_DRIVER_CHANNEL_NUM    5   /**< red, green, blue, warm and cold */
+#define LIGHT_FADE_PERIOD_MAX_MS    (3 * 1000)  /**< longest fade time of a change */
+#define LIGHT_DRIVER_FADE_DEFAULT   UINT32_MAX  /**< no override, the fade time of light_driver_config() */
+
 /**
  * @brief Light driven configuration
  */
@@ -79,7 +83,7 @@ esp_err_t light_driver_deinit();
 /**
  * @brief Set the fade time of the light
  *
- * @param  fade_period_ms  The time from the current color to the next color
+ * @param  fade_period_ms  The time from the current color to the next color, up to LIGHT_FADE_PERIOD_MAX_MS
  * @param  blink_period_ms Light flashing frequency
  *
  * @return
@@ -88,6 +92,31 @@ esp_err_t light_driver_deinit();
  */
 esp_err_t light_driver_config(uint32_t fade_period_ms, uint32_t blink_period_ms);
 
+/**
+ * @brief Set the fade time of the next changes only, e.g. the one of a single request
+ *
+ * @note  Unlike light_driver_config(), the fade time is not saved with the status of the light.
+ *        Set LIGHT_DRIVER_FADE_DEFAULT once the changes are made.
+ *
+ * @param  fade_period_ms  Up to LIGHT_FADE_PERIOD_MAX_MS, or LIGHT_DRIVER_FADE_DEFAULT
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t light_driver_set_fade_override(uint32_t fade_period_ms);
+
+/**
+ * @brief Get the fade time and the blink period of the light
+ *
+ * @param  fade_period_ms  The time from the current color to the next color, may be NULL
+ * @param  blink_period_ms Light flashing frequency, may be NULL
+ *
+ * @return
+ *      - ESP_OK
+ */
+esp_err_t light_driver_get_config(uint32_t *fade_period_ms, uint32_t *blink_period_ms);
+
 /**@{*/
 /**
  * @brief  Set the status of the light
@@ -154,6 +183,110 @@ esp_err_t light_driver_fade_warm(uint8_t color_temperature);
 esp_err_t light_driver_fade_stop();
 /**@}*/
 
+/**
+ * @brief  Fade the level of the current mode (value in HSV mode, brightness in
+ *         CTB mode) and turn the light on, without saving the status
+ *
+ * @note   For ramps that push a new target every few tens of milliseconds, call
+ *         light_driver_save_status() once the ramp ends.
+ *
+ * @param  level           Level 0 ~ 100
+ * @param  fade_period_ms  Fade time to the level, usually the period of the targets
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t light_driver_set_level(uint8_t level, uint32_t fade_period_ms);
+
+/**
+ * @brief  Get the level of the current mode, value in HSV mode, brightness in CTB mode
+ */
+uint8_t light_driver_get_level();
+
+/**
+ * @brief  Save the status of the light to the flash
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_FAIL
+ */
+esp_err_t light_driver_save_status();
+
+/**
+ * @brief  Set the switch and the HSV color of the light at once, with a single
+ *         fade and a single write of the status to the flash
+ *
+ * @note   When off, the color is only saved, it is shown at the next switch on
+ *
+ * @param  on          Switch of the light
+ * @param  hue         Hue 0 ~ 360
+ * @param  saturation  Saturation 0 ~ 100
+ * @param  value       Value 0 ~ 100
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ *      - ESP_FAIL
+ */
+esp_err_t light_driver_set_hsv_switch(bool on, uint16_t hue, uint8_t saturation, uint8_t value);
+
+/**
+ * @brief  Set the switch and the color temperature of the light at once, as
+ *         light_driver_set_hsv_switch() does for the HSV color
+ *
+ * @param  on                 Switch of the light
+ * @param  color_temperature  Color temperature 0 ~ 100
+ * @param  brightness         Brightness 0 ~ 100
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ *      - ESP_FAIL
+ */
+esp_err_t light_driver_set_ctb_switch(bool on, uint8_t color_temperature, uint8_t brightness);
+
+/**
+ * @brief  Get the output of each channel integrated over time, for the energy accounting
+ *
+ * @param  duty_ms  Time at full duty of red, green, blue, warm and cold
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t light_driver_get_duty_ms(uint64_t duty_ms[LIGHT_DRIVER_CHANNEL_NUM]);
+
+/**
+ * @brief  Fade the output of each channel to a raw value, without changing the
+ *         mode or the color and without saving the status
+ *
+ * @note   For streams of frames, e.g. DMX, that push a new target every few tens of
+ *         milliseconds. The light is on as long as one of the channels is.
+ *
+ * @param  value           Output 0 ~ 255 of red, green, blue, warm and cold
+ * @param  fade_period_ms  The time from the current output to the new one
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG
+ */
+esp_err_t light_driver_set_channels(const uint8_t value[LIGHT_DRIVER_CHANNEL_NUM], uint32_t fade_period_ms);
+
+/**
+ * @brief  Align the steps of the fades set next on the time of this call
+ *
+ * @note   The fade engine steps every DUTY_SET_CYCLE ms on its own timer, a fade set
+ *         at the same time on several lights starts anywhere within that period.
+ *         Called right before setting the light on each of them, e.g. at a start
+ *         time agreed over the network, their fades step together.
+ *
+ * @return
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG  light_driver_init() not called yet
+ */
+esp_err_t light_driver_align_fade(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,11 @@
 
 #include "math.h"
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_freertos_hooks.h"
+#include "soc/rtc.h"
 #include "soc/ledc_reg.h"
 #include "soc/timer_group_struct.h"
 #include "soc/ledc_struct.h"
@@ -53,14 +58,66 @@ typedef struct {
     ledc_mode_t speed_mode;
     ledc_timer_t timer_num;
     hw_timer_idx_t timer_id;
+    uint32_t clk_hz;            /**< source clock of the LEDC timer */
 } iot_light_t;
 
 static const char *TAG = "iot_light";
 static DRAM_ATTR iot_light_t *g_light_config = NULL;
 static DRAM_ATTR uint16_t *g_gamma_table = NULL;
 static DRAM_ATTR bool g_hw_timer_started = false;
+static portMUX_TYPE g_hw_timer_lock = portMUX_INITIALIZER_UNLOCKED;
 static DRAM_ATTR timg_dev_t *TG[2] = {&TIMERG0, &TIMERG1};
 
+/**
+ * Output integrated over time for the energy accounting, in duty x us,
+ * the full duty is (1 << LEDC_TIMER_PRECISION)
+ */
+static DRAM_ATTR uint64_t g_duty_acc[LEDC_CHANNEL_MAX];
+static DRAM_ATTR int64_t g_duty_since = 0;
+static portMUX_TYPE g_duty_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef CONFIG_PM_ENABLE
+/**
+ * The fade timer counts APB cycles and stops in light sleep, the lock is only
+ * held while it runs. A static output on a sleep-safe LEDC clock needs no lock.
+ */
+static DRAM_ATTR esp_pm_lock_handle_t g_fade_pm_lock = NULL;
+#endif
+
+/**< Set by iot_led_set_pm_hooks(), they replace g_fade_pm_lock */
+static DRAM_ATTR iot_led_pm_cb_t g_pm_acquire = NULL;
+static DRAM_ATTR iot_led_pm_cb_t g_pm_release = NULL;
+static DRAM_ATTR void *g_pm_arg = NULL;
+
+#ifdef CONFIG_LIGHT_DRIVER_PM_MEASUREMENT
+static DRAM_ATTR iot_led_power_stats_t g_power_stats[IOT_LED_POWER_STATE_MAX];
+static DRAM_ATTR iot_led_power_state_t g_power_state = IOT_LED_POWER_OFF_IDLE;
+static DRAM_ATTR int64_t g_power_state_since = 0;
+static portMUX_TYPE g_power_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static IRAM_ATTR void iot_led_power_state_set(iot_led_power_state_t state)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&g_power_stats_lock);
+    g_power_stats[g_power_state].time_ms += (now - g_power_state_since) / 1000;
+    g_power_state_since = now;
+    g_power_state = state;
+    portEXIT_CRITICAL_SAFE(&g_power_stats_lock);
+}
+
+/**
+ * @brief Called by the idle task before each wait for an interrupt, so once per wake-up
+ */
+static bool iot_led_idle_hook(void)
+{
+    g_power_stats[g_power_state].wakeups++;
+    return true;
+}
+#else
+#define iot_led_power_state_set(state)
+#endif /* CONFIG_LIGHT_DRIVER_PM_MEASUREMENT */
+
 static IRAM_ATTR esp_err_t _timer_pause(timer_group_t group_num, timer_idx_t timer_num)
 {
     TG[group_num]->hw_timer[timer_num].config.enable = 0;
@@ -94,16 +151,78 @@ static void iot_timer_create(hw_timer_idx_t *timer_id, bool auto_reload,
                        (void *) timer_id->timer_id, ESP_INTR_FLAG_IRAM, NULL);
 }
 
+static IRAM_ATTR void iot_led_pm_acquire(void)
+{
+    if (g_pm_acquire) {
+        g_pm_acquire(g_pm_arg);
+        return;
+    }
+
+#ifdef CONFIG_PM_ENABLE
+    if (g_fade_pm_lock) {
+        esp_pm_lock_acquire(g_fade_pm_lock);
+    }
+#endif
+}
+
+static IRAM_ATTR void iot_led_pm_release(void)
+{
+    if (g_pm_release) {
+        g_pm_release(g_pm_arg);
+        return;
+    }
+
+#ifdef CONFIG_PM_ENABLE
+    if (g_fade_pm_lock) {
+        esp_pm_lock_release(g_fade_pm_lock);
+    }
+#endif
+}
+
+/**
+ * @brief Start the fade timer unless it runs, the flag and the PM lock change together with the
+ *        stop of the ISR so the lock is taken once per run
+ */
 static void iot_timer_start(hw_timer_idx_t *timer_id)
 {
-    timer_start(timer_id->timer_group, timer_id->timer_id);
+    portENTER_CRITICAL(&g_hw_timer_lock);
+
+    if (g_hw_timer_started) {
+        portEXIT_CRITICAL(&g_hw_timer_lock);
+        return;
+    }
+
     g_hw_timer_started = true;
+    iot_led_pm_acquire();
+    iot_led_power_state_set(IOT_LED_POWER_FADING);
+    timer_start(timer_id->timer_group, timer_id->timer_id);
+
+    portEXIT_CRITICAL(&g_hw_timer_lock);
 }
 
 static IRAM_ATTR void iot_timer_stop(hw_timer_idx_t *timer_id)
 {
+    portENTER_CRITICAL_ISR(&g_hw_timer_lock);
+
     _timer_pause(timer_id->timer_group, timer_id->timer_id);
     g_hw_timer_started = false;
+
+#ifdef CONFIG_LIGHT_DRIVER_PM_MEASUREMENT
+    iot_led_power_state_t state = IOT_LED_POWER_OFF_IDLE;
+
+    for (int channel = 0; channel < LEDC_CHANNEL_MAX; channel++) {
+        if (g_light_config->fade_data[channel].cur > 0) {
+            state = IOT_LED_POWER_ON_IDLE;
+            break;
+        }
+    }
+
+    iot_led_power_state_set(state);
+#endif
+
+    iot_led_pm_release();
+
+    portEXIT_CRITICAL_ISR(&g_hw_timer_lock);
 }
 
 static IRAM_ATTR esp_err_t iot_ledc_duty_config(ledc_mode_t speed_mode, ledc_channel_t channel, int hpoint_val, int duty_val,
@@ -166,16 +285,11 @@ static IRAM_ATTR esp_err_t _iot_set_fade_with_time(ledc_mode_t speed_mode, ledc_
     uint32_t duty_cur = LEDC.channel_group[speed_mode].channel[channel].duty_rd.duty_read >> 4;
     uint32_t duty_delta = target_duty > duty_cur ? target_duty - duty_cur : duty_cur - target_duty;
 
-    uint32_t timer_source_clk = LEDC.timer_group[speed_mode].timer[g_light_config->timer_num].conf.tick_sel;
     uint32_t duty_resolution = LEDC.timer_group[speed_mode].timer[g_light_config->timer_num].conf.duty_resolution;
     uint32_t clock_divider = LEDC.timer_group[speed_mode].timer[g_light_config->timer_num].conf.clock_divider;
     uint32_t precision = (0x1U << duty_resolution);
 
-    if (timer_source_clk == LEDC_APB_CLK) {
-        freq = ((uint64_t)LEDC_APB_CLK_HZ << 8) / precision / clock_divider;
-    } else {
-        freq = ((uint64_t)LEDC_REF_CLK_HZ << 8) / precision / clock_divider;
-    }
+    freq = ((uint64_t)g_light_config->clk_hz << 8) / precision / clock_divider;
 
     if (duty_delta == 0) {
         return _iot_set_fade_with_step(speed_mode, channel, target_duty, 0, 0);
@@ -264,6 +378,24 @@ static IRAM_ATTR uint32_t gamma_value_to_duty(int value)
     return tmp;
 }
 
+/**
+ * @brief Account the output since the last update, before a channel changes
+ */
+static IRAM_ATTR void iot_led_duty_update(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&g_duty_lock);
+    int64_t elapsed = now - g_duty_since;
+    g_duty_since = now;
+
+    for (int channel = 0; channel < LEDC_CHANNEL_MAX; channel++) {
+        g_duty_acc[channel] += (uint64_t)gamma_value_to_duty(g_light_config->fade_data[channel].cur) * elapsed;
+    }
+
+    portEXIT_CRITICAL_SAFE(&g_duty_lock);
+}
+
 static IRAM_ATTR void fade_timercb(void *para)
 {
     int timer_idx = (int) para;
@@ -329,6 +461,8 @@ static IRAM_ATTR void fade_timercb(void *para)
     }
 #endif
 
+    iot_led_duty_update();
+
     for (int channel = 0; channel < LEDC_CHANNEL_MAX; channel++) {
         ledc_fade_data_t *fade_data = g_light_config->fade_data + channel;
 
@@ -390,6 +524,23 @@ esp_err_t iot_led_init(ledc_timer_t timer_num, ledc_mode_t speed_mode, uint32_t
     ret = ledc_timer_config(&ledc_time_config);
     LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "LEDC timer configuration");
 
+    if (clk_cfg == LEDC_USE_RTC8M_CLK) {
+        /**< Keep the clock running in light sleep, the output stays on */
+        esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);
+    }
+
+#ifdef CONFIG_PM_ENABLE
+    if (g_fade_pm_lock == NULL && g_pm_acquire == NULL) {
+        ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "led_fade", &g_fade_pm_lock);
+        LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "esp_pm_lock_create");
+    }
+#endif
+
+#ifdef CONFIG_LIGHT_DRIVER_PM_MEASUREMENT
+    g_power_state_since = esp_timer_get_time();
+    esp_register_freertos_idle_hook_for_cpu(iot_led_idle_hook, 0);
+#endif
+
     if (g_gamma_table == NULL) {
         /* g_gamma_table[GAMMA_TABLE_SIZE] must be 0 */
         g_gamma_table = calloc(GAMMA_TABLE_SIZE + 1, sizeof(uint16_t));
@@ -403,12 +554,21 @@ esp_err_t iot_led_init(ledc_timer_t timer_num, ledc_mode_t speed_mode, uint32_t
         g_light_config->timer_num  = timer_num;
         g_light_config->speed_mode = speed_mode;
 
+        if (clk_cfg == LEDC_USE_RTC8M_CLK) {
+            g_light_config->clk_hz = RTC_FAST_CLK_FREQ_APPROX;
+        } else if (clk_cfg == LEDC_USE_REF_TICK) {
+            g_light_config->clk_hz = LEDC_REF_CLK_HZ;
+        } else {
+            g_light_config->clk_hz = LEDC_APB_CLK_HZ;
+        }
+
 
         hw_timer_idx_t hw_timer = {
             .timer_group = HW_TIMER_GROUP,
             .timer_id    = HW_TIMER_ID,
         };
         g_light_config->timer_id = hw_timer;
+        g_duty_since = esp_timer_get_time();
         iot_timer_create(&hw_timer, 1, DUTY_SET_CYCLE, fade_timercb);
     } else {
         ESP_LOGE(TAG, "g_light_config has been initialized");
@@ -486,9 +646,7 @@ esp_err_t iot_led_set_channel(ledc_channel_t channel, uint8_t value, uint32_t fa
         fade_data->cycle = 0;
     }
 
-    if (g_hw_timer_started != true) {
-        iot_timer_start(&g_light_config->timer_id);
-    }
+    iot_timer_start(&g_light_config->timer_id);
 
     return ESP_OK;
 }
@@ -498,14 +656,13 @@ esp_err_t iot_led_start_blink(ledc_channel_t channel, uint8_t value, uint32_t pe
     LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
     ledc_fade_data_t *fade_data = g_light_config->fade_data + channel;
 
+    iot_led_duty_update();
     fade_data->final = fade_data->cur = FLOATINT_2_FIXED(value, LEDC_FIXED_Q);
     fade_data->cycle = period_ms / 2 / DUTY_SET_CYCLE;
     fade_data->num = (fade_flag) ? period_ms / 2 / DUTY_SET_CYCLE : 0;
     fade_data->step  = (fade_flag) ? fade_data->cur / fade_data->num * -1 : 0;
 
-    if (g_hw_timer_started != true) {
-        iot_timer_start(&g_light_config->timer_id);
-    }
+    iot_timer_start(&g_light_config->timer_id);
 
     return ESP_OK;
 
@@ -526,3 +683,86 @@ esp_err_t iot_led_set_gamma_table(const uint16_t gamma_table[GAMMA_TABLE_SIZE])
     memcpy(g_gamma_table, gamma_table, GAMMA_TABLE_SIZE * sizeof(uint16_t));
     return ESP_OK;
 }
+
+esp_err_t iot_led_get_duty_ms(ledc_channel_t channel, uint64_t *duty_ms)
+{
+    LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+    LIGHT_PARAM_CHECK(channel < LEDC_CHANNEL_MAX);
+    LIGHT_PARAM_CHECK(duty_ms);
+
+    iot_led_duty_update();
+    *duty_ms = g_duty_acc[channel] / (1 << LEDC_TIMER_PRECISION) / 1000;
+
+    return ESP_OK;
+}
+
+esp_err_t iot_led_restart_tick(void)
+{
+    LIGHT_ERROR_CHECK(g_light_config == NULL, ESP_ERR_INVALID_ARG, "iot_led_init() must be called first");
+
+    /**< The alarm reloads the counter to 0, it is now one full period away */
+    return timer_set_counter_value(g_light_config->timer_id.timer_group, g_light_config->timer_id.timer_id, 0);
+}
+
+esp_err_t iot_led_set_pm_hooks(iot_led_pm_cb_t acquire, iot_led_pm_cb_t release, void *arg)
+{
+    LIGHT_PARAM_CHECK(!acquire == !release);
+    LIGHT_ERROR_CHECK(g_hw_timer_started, ESP_ERR_INVALID_STATE, "The fade timer is running");
+
+#ifdef CONFIG_PM_ENABLE
+    /**< The lock of the driver is only created when no hook replaces it */
+    if (acquire == NULL && g_fade_pm_lock == NULL && g_light_config) {
+        esp_err_t ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "led_fade", &g_fade_pm_lock);
+        LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "esp_pm_lock_create");
+    }
+#endif
+
+    g_pm_acquire = acquire;
+    g_pm_release = release;
+    g_pm_arg     = arg;
+
+    return ESP_OK;
+}
+
+#ifdef CONFIG_LIGHT_DRIVER_PM_MEASUREMENT
+esp_err_t iot_led_get_power_stats(iot_led_power_state_t state, iot_led_power_stats_t *stats)
+{
+    LIGHT_PARAM_CHECK(state < IOT_LED_POWER_STATE_MAX);
+    LIGHT_PARAM_CHECK(stats);
+
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_power_stats_lock);
+    *stats = g_power_stats[state];
+
+    if (state == g_power_state) {
+        stats->time_ms += (now - g_power_state_since) / 1000;
+    }
+    portEXIT_CRITICAL(&g_power_stats_lock);
+
+    return ESP_OK;
+}
+
+void iot_led_dump_power_stats(void)
+{
+    static const char *state_str[IOT_LED_POWER_STATE_MAX] = {"off idle", "on idle", "fading"};
+
+    for (int i = 0; i < IOT_LED_POWER_STATE_MAX; i++) {
+        iot_led_power_stats_t stats = {0};
+        iot_led_get_power_stats(i, &stats);
+        /**< Only fading holds the APB lock, the wake-up rate is the proxy of the idle current */
+        ESP_LOGI(TAG, "%-8s time: %llu ms, APB max: %s, wake-ups: %u (%u/s)", state_str[i], stats.time_ms,
+                 i == IOT_LED_POWER_FADING ? "100%" : "0%", stats.wakeups,
+                 stats.time_ms ? (uint32_t)(stats.wakeups * 1000ULL / stats.time_ms) : 0);
+    }
+}
+#else
+esp_err_t iot_led_get_power_stats(iot_led_power_state_t state, iot_led_power_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void iot_led_dump_power_stats(void)
+{
+}
+#endif /* CONFIG_LIGHT_DRIVER_PM_MEASUREMENT */
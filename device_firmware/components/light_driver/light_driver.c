@@ -50,7 +50,6 @@ enum light_channel {
 };
 
 #define LIGHT_STATUS_STORE_KEY   "light_status"
-#define LIGHT_FADE_PERIOD_MAX_MS (3 * 1000)
 
 static const char *TAG               = "light_driver";
 static light_status_t g_light_status = {0};
@@ -58,6 +57,13 @@ static bool g_light_blink_flag       = false;
 static TimerHandle_t g_fade_timer    = NULL;
 static int g_fade_mode               = MODE_NONE;
 static uint16_t g_fade_hue           = 0;
+static uint32_t g_fade_override_ms   = LIGHT_DRIVER_FADE_DEFAULT;
+
+/**< The fade time of a change, the one saved in the status unless overridden for a request */
+static uint32_t light_driver_fade_period_ms(void)
+{
+    return g_fade_override_ms != LIGHT_DRIVER_FADE_DEFAULT ? g_fade_override_ms : g_light_status.fade_period_ms;
+}
 
 esp_err_t light_driver_init(light_driver_config_t *config)
 {
@@ -106,12 +112,36 @@ esp_err_t light_driver_deinit()
 
 esp_err_t light_driver_config(uint32_t fade_period_ms, uint32_t blink_period_ms)
 {
+    LIGHT_PARAM_CHECK(fade_period_ms <= LIGHT_FADE_PERIOD_MAX_MS);
+
     g_light_status.fade_period_ms = fade_period_ms;
     g_light_status.blink_period_ms = blink_period_ms;
 
     return ESP_OK;
 }
 
+esp_err_t light_driver_set_fade_override(uint32_t fade_period_ms)
+{
+    LIGHT_PARAM_CHECK(fade_period_ms <= LIGHT_FADE_PERIOD_MAX_MS || fade_period_ms == LIGHT_DRIVER_FADE_DEFAULT);
+
+    g_fade_override_ms = fade_period_ms;
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_get_config(uint32_t *fade_period_ms, uint32_t *blink_period_ms)
+{
+    if (fade_period_ms) {
+        *fade_period_ms = g_light_status.fade_period_ms;
+    }
+
+    if (blink_period_ms) {
+        *blink_period_ms = g_light_status.blink_period_ms;
+    }
+
+    return ESP_OK;
+}
+
 esp_err_t light_driver_set_rgb(uint8_t red, uint8_t green, uint8_t blue)
 {
     esp_err_t ret = 0;
@@ -244,20 +274,20 @@ esp_err_t light_driver_set_hsv(uint16_t hue, uint8_t saturation, uint8_t value)
 
     ESP_LOGV(TAG, "red: %d, green: %d, blue: %d", red, green, blue);
 
-    ret = iot_led_set_channel(CHANNEL_ID_RED, red, g_light_status.fade_period_ms);
+    ret = iot_led_set_channel(CHANNEL_ID_RED, red, light_driver_fade_period_ms());
     LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_GREEN, green, g_light_status.fade_period_ms);
+    ret = iot_led_set_channel(CHANNEL_ID_GREEN, green, light_driver_fade_period_ms());
     LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
-    ret = iot_led_set_channel(CHANNEL_ID_BLUE, blue, g_light_status.fade_period_ms);
+    ret = iot_led_set_channel(CHANNEL_ID_BLUE, blue, light_driver_fade_period_ms());
     LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
     if (g_light_status.mode != MODE_HSV) {
-        ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
     }
 
@@ -273,6 +303,24 @@ esp_err_t light_driver_set_hsv(uint16_t hue, uint8_t saturation, uint8_t value)
     return ESP_OK;
 }
 
+esp_err_t light_driver_set_hsv_switch(bool on, uint16_t hue, uint8_t saturation, uint8_t value)
+{
+    LIGHT_PARAM_CHECK(hue <= 360);
+    LIGHT_PARAM_CHECK(saturation <= 100);
+    LIGHT_PARAM_CHECK(value <= 100);
+
+    if (on) {
+        return light_driver_set_hsv(hue, saturation, value);
+    }
+
+    g_light_status.mode       = MODE_HSV;
+    g_light_status.hue        = hue;
+    g_light_status.value      = value;
+    g_light_status.saturation = saturation;
+
+    return light_driver_set_switch(false);
+}
+
 esp_err_t light_driver_set_hue(uint16_t hue)
 {
     return light_driver_set_hsv(hue, g_light_status.saturation, g_light_status.value);
@@ -321,33 +369,42 @@ uint8_t light_driver_get_mode()
     return g_light_status.mode;
 }
 
+static void light_driver_ctb2warm_cold(uint8_t color_temperature, uint8_t brightness,
+                                       uint8_t *warm, uint8_t *cold)
+{
+    uint8_t warm_tmp = color_temperature * brightness / 100;
+    uint8_t cold_tmp = (100 - color_temperature) * brightness / 100;
+    *warm            = warm_tmp < 15 ? warm_tmp : 14 + warm_tmp * 86 / 100;
+    *cold            = cold_tmp < 15 ? cold_tmp : 14 + cold_tmp * 86 / 100;
+}
+
 esp_err_t light_driver_set_ctb(uint8_t color_temperature, uint8_t brightness)
 {
     LIGHT_PARAM_CHECK(brightness <= 100);
     LIGHT_PARAM_CHECK(color_temperature <= 100);
 
     esp_err_t ret = ESP_OK;
-    uint8_t warm_tmp = color_temperature * brightness / 100;
-    uint8_t cold_tmp = (100 - color_temperature) * brightness / 100;
-    warm_tmp         = warm_tmp < 15 ? warm_tmp : 14 + warm_tmp * 86 / 100;
-    cold_tmp         = cold_tmp < 15 ? cold_tmp : 14 + cold_tmp * 86 / 100;
+    uint8_t warm_tmp = 0;
+    uint8_t cold_tmp = 0;
+
+    light_driver_ctb2warm_cold(color_temperature, brightness, &warm_tmp, &cold_tmp);
 
     ret = iot_led_set_channel(CHANNEL_ID_COLD,
-                              cold_tmp * 255 / 100, g_light_status.fade_period_ms);
+                              cold_tmp * 255 / 100, light_driver_fade_period_ms());
     LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
     ret = iot_led_set_channel(CHANNEL_ID_WARM,
-                              warm_tmp * 255 / 100, g_light_status.fade_period_ms);
+                              warm_tmp * 255 / 100, light_driver_fade_period_ms());
     LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
     if (g_light_status.mode != MODE_CTB) {
-        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
     }
 
@@ -362,6 +419,22 @@ esp_err_t light_driver_set_ctb(uint8_t color_temperature, uint8_t brightness)
     return ESP_OK;
 }
 
+esp_err_t light_driver_set_ctb_switch(bool on, uint8_t color_temperature, uint8_t brightness)
+{
+    LIGHT_PARAM_CHECK(brightness <= 100);
+    LIGHT_PARAM_CHECK(color_temperature <= 100);
+
+    if (on) {
+        return light_driver_set_ctb(color_temperature, brightness);
+    }
+
+    g_light_status.mode              = MODE_CTB;
+    g_light_status.brightness        = brightness;
+    g_light_status.color_temperature = color_temperature;
+
+    return light_driver_set_switch(false);
+}
+
 esp_err_t light_driver_set_color_temperature(uint8_t color_temperature)
 {
     return light_driver_set_ctb(color_temperature, g_light_status.brightness);
@@ -399,19 +472,19 @@ esp_err_t light_driver_set_switch(bool on)
     g_light_status.on = on;
 
     if (!g_light_status.on) {
-        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "iot_led_set_channel, ret: %d", ret);
 
     } else {
@@ -631,13 +704,13 @@ esp_err_t light_driver_fade_warm(uint8_t color_temperature)
     g_fade_mode   = MODE_CTB;
 
     if (g_light_status.mode != MODE_CTB) {
-        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_RED, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_GREEN, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
 
-        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, g_light_status.fade_period_ms);
+        ret = iot_led_set_channel(CHANNEL_ID_BLUE, 0, light_driver_fade_period_ms());
         LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
     }
 
@@ -725,3 +798,104 @@ esp_err_t light_driver_fade_stop()
     g_fade_mode = MODE_NONE;
     return ESP_OK;
 }
+
+esp_err_t light_driver_set_channels(const uint8_t value[LIGHT_DRIVER_CHANNEL_NUM], uint32_t fade_period_ms)
+{
+    LIGHT_PARAM_CHECK(value);
+
+    esp_err_t ret = ESP_OK;
+    bool on = false;
+
+    for (int i = 0; i < LIGHT_DRIVER_CHANNEL_NUM; i++) {
+        ret = iot_led_set_channel(CHANNEL_ID_RED + i, value[i], fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        on |= (value[i] != 0);
+    }
+
+    g_light_status.on = on;
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_align_fade(void)
+{
+    return iot_led_restart_tick();
+}
+
+esp_err_t light_driver_set_level(uint8_t level, uint32_t fade_period_ms)
+{
+    LIGHT_PARAM_CHECK(level <= 100);
+
+    esp_err_t ret = ESP_OK;
+
+    if (g_light_status.mode == MODE_CTB) {
+        uint8_t warm_tmp = 0;
+        uint8_t cold_tmp = 0;
+
+        light_driver_ctb2warm_cold(g_light_status.color_temperature, level, &warm_tmp, &cold_tmp);
+
+        ret = iot_led_set_channel(CHANNEL_ID_COLD, cold_tmp * 255 / 100, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+
+        ret = iot_led_set_channel(CHANNEL_ID_WARM, warm_tmp * 255 / 100, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+
+        g_light_status.brightness = level;
+    } else {
+        uint8_t red   = 0;
+        uint8_t green = 0;
+        uint8_t blue  = 0;
+
+        ret = light_driver_hsv2rgb(g_light_status.hue, g_light_status.saturation, level, &red, &green, &blue);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "light_driver_hsv2rgb, ret: %d", ret);
+
+        ret = iot_led_set_channel(CHANNEL_ID_RED, red, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+
+        ret = iot_led_set_channel(CHANNEL_ID_GREEN, green, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+
+        ret = iot_led_set_channel(CHANNEL_ID_BLUE, blue, fade_period_ms);
+        LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+
+        if (g_light_status.mode != MODE_HSV) {
+            ret = iot_led_set_channel(CHANNEL_ID_WARM, 0, fade_period_ms);
+            LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+
+            ret = iot_led_set_channel(CHANNEL_ID_COLD, 0, fade_period_ms);
+            LIGHT_ERROR_CHECK(ret < 0, ret, "iot_led_set_channel, ret: %d", ret);
+        }
+
+        g_light_status.mode  = MODE_HSV;
+        g_light_status.value = level;
+    }
+
+    g_light_status.on = 1;
+
+    return ESP_OK;
+}
+
+uint8_t light_driver_get_level()
+{
+    return (g_light_status.mode == MODE_CTB) ? g_light_status.brightness : g_light_status.value;
+}
+
+esp_err_t light_driver_save_status()
+{
+    esp_err_t ret = app_storage_set(LIGHT_STATUS_STORE_KEY, &g_light_status, sizeof(light_status_t));
+    LIGHT_ERROR_CHECK(ret < 0, ESP_FAIL, "app_storage_set, ret: %d", ret);
+
+    return ESP_OK;
+}
+
+esp_err_t light_driver_get_duty_ms(uint64_t duty_ms[LIGHT_DRIVER_CHANNEL_NUM])
+{
+    LIGHT_PARAM_CHECK(duty_ms);
+
+    for (int i = 0; i < LIGHT_DRIVER_CHANNEL_NUM; i++) {
+        esp_err_t ret = iot_led_get_duty_ms(CHANNEL_ID_RED + i, duty_ms + i);
+        LIGHT_ERROR_CHECK(ret != ESP_OK, ret, "iot_led_get_duty_ms, channel: %d", i);
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,595 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * @brief Compare the light_protocol packets with the JSON messages they replace
+ *
+ * For the messages exchanged by the network examples it reports:
+ *  - the size of the binary packet and of the equivalent JSON text
+ *  - the encode and decode time of both, best of 5 rounds
+ *
+ * The JSON side is a flat object parser written for these messages, without
+ * allocation. A generic parser such as cJSON allocates a node per value, so
+ * its cost is higher still.
+ *
+ * --verify checks the codec: round trips, truncated and corrupted packets,
+ * unknown tags, out of range values and output buffers of every size.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "light_protocol.h"
+
+#define BENCH_ROUNDS    5
+#define JSON_SIZE_MAX   256
+
+#define FIELD(tag)      LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_##tag)
+
+static int g_failures = 0;
+
+#define CHECK(cond, fmt, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__); \
+            g_failures++; \
+        } \
+    } while (0)
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                  return "ESP_OK";
+        case ESP_FAIL:                return "ESP_FAIL";
+        case ESP_ERR_INVALID_ARG:     return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_SIZE:    return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_SUPPORTED:   return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+        default:                      return "UNKNOWN";
+    }
+}
+
+typedef struct {
+    const char *name;
+    light_protocol_msg_t msg;
+} bench_message_t;
+
+static const bench_message_t g_messages[] = {
+    {
+        .name = "power",
+        .msg  = { .type = LIGHT_PROTOCOL_MSG_SET, .seq = 7, .fields = FIELD(POWER), .on = true },
+    },
+    {
+        .name = "hsv+fade",
+        .msg  = {
+            .type = LIGHT_PROTOCOL_MSG_SET, .seq = 1234, .fields = FIELD(POWER) | FIELD(HSV) | FIELD(FADE),
+            .on = true, .hue = 240, .saturation = 80, .value = 60, .fade_ms = 500,
+        },
+    },
+    {
+        .name = "get",
+        .msg  = { .type = LIGHT_PROTOCOL_MSG_GET, .seq = 65535 },
+    },
+    {
+        .name = "state",
+        .msg  = {
+            .type = LIGHT_PROTOCOL_MSG_STATE, .seq = 1234,
+            .fields = FIELD(POWER) | FIELD(MODE) | FIELD(HSV) | FIELD(CTB) | FIELD(FADE) | FIELD(RESULT),
+            .on = true, .mode = 1, .hue = 240, .saturation = 80, .value = 60,
+            .color_temperature = 30, .brightness = 100, .fade_ms = 800, .result = ESP_OK,
+        },
+    },
+};
+
+#define BENCH_MESSAGE_NUM   (sizeof(g_messages) / sizeof(g_messages[0]))
+
+/**
+ * @brief The same message as JSON, with the key names a hand written example would use
+ */
+static const char *g_json_type[] = {
+    [LIGHT_PROTOCOL_MSG_SET]   = "set",
+    [LIGHT_PROTOCOL_MSG_GET]   = "get",
+    [LIGHT_PROTOCOL_MSG_STATE] = "state",
+};
+
+static int json_encode(const light_protocol_msg_t *msg, char *buf, size_t size)
+{
+    int len = snprintf(buf, size, "{\"type\":\"%s\",\"seq\":%u", g_json_type[msg->type], msg->seq);
+
+#define JSON_APPEND(...) len += snprintf(buf + len, size - len, __VA_ARGS__)
+
+    if (msg->fields & FIELD(POWER)) {
+        JSON_APPEND(",\"power\":%s", msg->on ? "true" : "false");
+    }
+
+    if (msg->fields & FIELD(MODE)) {
+        JSON_APPEND(",\"mode\":%u", msg->mode);
+    }
+
+    if (msg->fields & FIELD(HSV)) {
+        JSON_APPEND(",\"hue\":%u,\"saturation\":%u,\"value\":%u", msg->hue, msg->saturation, msg->value);
+    }
+
+    if (msg->fields & FIELD(CTB)) {
+        JSON_APPEND(",\"temperature\":%u,\"brightness\":%u", msg->color_temperature, msg->brightness);
+    }
+
+    if (msg->fields & FIELD(FADE)) {
+        JSON_APPEND(",\"fade_ms\":%" PRIu32, msg->fade_ms);
+    }
+
+    if (msg->fields & FIELD(SCENE)) {
+        JSON_APPEND(",\"scene\":%u", msg->scene);
+    }
+
+    if (msg->fields & FIELD(RESULT)) {
+        JSON_APPEND(",\"result\":%" PRId32, msg->result);
+    }
+
+    JSON_APPEND("}");
+
+#undef JSON_APPEND
+
+    return len;
+}
+
+static const char *json_skip_space(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+
+    return p;
+}
+
+/**
+ * @brief Parse a flat JSON object of numbers, booleans and strings into a message
+ */
+static bool json_decode(const char *buf, size_t len, light_protocol_msg_t *msg)
+{
+    const char *p = buf;
+    const char *end = buf + len;
+
+    memset(msg, 0, sizeof(light_protocol_msg_t));
+    p = json_skip_space(p, end);
+
+    if (p == end || *p++ != '{') {
+        return false;
+    }
+
+    while (1) {
+        p = json_skip_space(p, end);
+
+        if (p < end && *p == '}') {
+            return true;
+        }
+
+        if (p == end || *p++ != '"') {
+            return false;
+        }
+
+        const char *key = p;
+
+        while (p < end && *p != '"') {
+            p++;
+        }
+
+        if (p == end) {
+            return false;
+        }
+
+        size_t key_len = p++ - key;
+        p = json_skip_space(p, end);
+
+        if (p == end || *p++ != ':') {
+            return false;
+        }
+
+        p = json_skip_space(p, end);
+
+        const char *str = NULL;
+        size_t str_len = 0;
+        long number = 0;
+        bool boolean = false;
+
+        if (p < end && *p == '"') {
+            str = ++p;
+
+            while (p < end && *p != '"') {
+                p++;
+            }
+
+            if (p == end) {
+                return false;
+            }
+
+            str_len = p++ - str;
+        } else if (end - p >= 4 && !memcmp(p, "true", 4)) {
+            boolean = true;
+            p += 4;
+        } else if (end - p >= 5 && !memcmp(p, "false", 5)) {
+            p += 5;
+        } else {
+            char *num_end = NULL;
+            number = strtol(p, &num_end, 10);
+
+            if (num_end == p || num_end > end) {
+                return false;
+            }
+
+            p = num_end;
+        }
+
+#define KEY_IS(name) (key_len == sizeof(name) - 1 && !memcmp(key, name, key_len))
+
+        if (KEY_IS("type") && str) {
+            for (uint8_t type = LIGHT_PROTOCOL_MSG_SET; type <= LIGHT_PROTOCOL_MSG_STATE; type++) {
+                if (strlen(g_json_type[type]) == str_len && !memcmp(g_json_type[type], str, str_len)) {
+                    msg->type = type;
+                }
+            }
+        } else if (KEY_IS("seq")) {
+            msg->seq = number;
+        } else if (KEY_IS("power")) {
+            msg->on = boolean;
+            msg->fields |= FIELD(POWER);
+        } else if (KEY_IS("mode")) {
+            msg->mode = number;
+            msg->fields |= FIELD(MODE);
+        } else if (KEY_IS("hue")) {
+            msg->hue = number;
+            msg->fields |= FIELD(HSV);
+        } else if (KEY_IS("saturation")) {
+            msg->saturation = number;
+        } else if (KEY_IS("value")) {
+            msg->value = number;
+        } else if (KEY_IS("temperature")) {
+            msg->color_temperature = number;
+            msg->fields |= FIELD(CTB);
+        } else if (KEY_IS("brightness")) {
+            msg->brightness = number;
+        } else if (KEY_IS("fade_ms")) {
+            msg->fade_ms = number;
+            msg->fields |= FIELD(FADE);
+        } else if (KEY_IS("scene")) {
+            msg->scene = number;
+            msg->fields |= FIELD(SCENE);
+        } else if (KEY_IS("result")) {
+            msg->result = number;
+            msg->fields |= FIELD(RESULT);
+        }
+
+#undef KEY_IS
+
+        p = json_skip_space(p, end);
+
+        if (p < end && *p == ',') {
+            p++;
+        }
+    }
+}
+
+static bool msg_equal(const light_protocol_msg_t *a, const light_protocol_msg_t *b)
+{
+    uint16_t f = a->fields;
+
+    return a->type == b->type && a->seq == b->seq && a->fields == b->fields
+           && (!(f & FIELD(POWER)) || a->on == b->on)
+           && (!(f & FIELD(MODE)) || a->mode == b->mode)
+           && (!(f & FIELD(HSV)) || (a->hue == b->hue && a->saturation == b->saturation && a->value == b->value))
+           && (!(f & FIELD(CTB)) || (a->color_temperature == b->color_temperature && a->brightness == b->brightness))
+           && (!(f & FIELD(FADE)) || a->fade_ms == b->fade_ms)
+           && (!(f & FIELD(SCENE)) || a->scene == b->scene)
+           && (!(f & FIELD(RESULT)) || a->result == b->result);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**< Keeps the compiler from dropping the work measured */
+static volatile uint32_t g_sink;
+
+static double bench_binary_encode(const light_protocol_msg_t *msg, uint32_t iterations)
+{
+    uint8_t buf[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t len = 0;
+    light_protocol_msg_t m = *msg;
+    uint64_t start = now_ns();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        m.seq = i;
+        light_protocol_encode(&m, buf, sizeof(buf), &len);
+        g_sink += buf[len - 1];
+    }
+
+    return (double)(now_ns() - start) / iterations;
+}
+
+static double bench_binary_decode(const uint8_t *packet, size_t len, uint32_t iterations)
+{
+    light_protocol_msg_t msg;
+    uint64_t start = now_ns();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        light_protocol_decode(packet, len, &msg);
+        g_sink += msg.seq;
+    }
+
+    return (double)(now_ns() - start) / iterations;
+}
+
+static double bench_json_encode(const light_protocol_msg_t *msg, uint32_t iterations)
+{
+    char buf[JSON_SIZE_MAX];
+    light_protocol_msg_t m = *msg;
+    uint64_t start = now_ns();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        m.seq = i;
+        g_sink += json_encode(&m, buf, sizeof(buf));
+    }
+
+    return (double)(now_ns() - start) / iterations;
+}
+
+static double bench_json_decode(const char *json, size_t len, uint32_t iterations)
+{
+    light_protocol_msg_t msg;
+    uint64_t start = now_ns();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        json_decode(json, len, &msg);
+        g_sink += msg.seq;
+    }
+
+    return (double)(now_ns() - start) / iterations;
+}
+
+static double best_of(double values[BENCH_ROUNDS])
+{
+    double best = values[0];
+
+    for (int i = 1; i < BENCH_ROUNDS; i++) {
+        best = values[i] < best ? values[i] : best;
+    }
+
+    return best;
+}
+
+static void run_bench(uint32_t iterations)
+{
+    printf("%-10s %8s %8s %10s %10s %10s %10s\n", "message", "binary", "json",
+           "bin enc", "json enc", "bin dec", "json dec");
+    printf("%-10s %8s %8s %10s %10s %10s %10s\n", "", "bytes", "bytes", "ns", "ns", "ns", "ns");
+
+    for (size_t i = 0; i < BENCH_MESSAGE_NUM; i++) {
+        const light_protocol_msg_t *msg = &g_messages[i].msg;
+        uint8_t packet[LIGHT_PROTOCOL_PACKET_MAX];
+        char json[JSON_SIZE_MAX];
+        size_t packet_len = 0;
+        double t[4][BENCH_ROUNDS];
+
+        ESP_ERROR_CHECK(light_protocol_encode(msg, packet, sizeof(packet), &packet_len));
+        int json_len = json_encode(msg, json, sizeof(json));
+
+        /**< Alternated so that a slower period of the host hits all of them */
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            t[0][round] = bench_binary_encode(msg, iterations);
+            t[1][round] = bench_json_encode(msg, iterations);
+            t[2][round] = bench_binary_decode(packet, packet_len, iterations);
+            t[3][round] = bench_json_decode(json, json_len, iterations);
+        }
+
+        printf("%-10s %8zu %8d %10.1f %10.1f %10.1f %10.1f\n", g_messages[i].name, packet_len, json_len,
+               best_of(t[0]), best_of(t[1]), best_of(t[2]), best_of(t[3]));
+    }
+}
+
+static void verify_round_trip(void)
+{
+    for (size_t i = 0; i < BENCH_MESSAGE_NUM; i++) {
+        const light_protocol_msg_t *msg = &g_messages[i].msg;
+        uint8_t packet[LIGHT_PROTOCOL_PACKET_MAX];
+        char json[JSON_SIZE_MAX];
+        light_protocol_msg_t decoded;
+        size_t len = 0;
+
+        CHECK(light_protocol_encode(msg, packet, sizeof(packet), &len) == ESP_OK, "%s encode", g_messages[i].name);
+        CHECK(light_protocol_decode(packet, len, &decoded) == ESP_OK, "%s decode", g_messages[i].name);
+        CHECK(msg_equal(msg, &decoded), "%s binary round trip", g_messages[i].name);
+
+        size_t packet_len = 0;
+        CHECK(light_protocol_packet_len(packet, LIGHT_PROTOCOL_HEADER_SIZE, &packet_len) == ESP_OK
+              && packet_len == len, "%s packet length", g_messages[i].name);
+
+        int json_len = json_encode(msg, json, sizeof(json));
+        CHECK(json_decode(json, json_len, &decoded) && msg_equal(msg, &decoded), "%s json round trip: %s",
+              g_messages[i].name, json);
+
+        /**< Every truncation is detected, the bytes after the packet are ignored */
+        for (size_t cut = 0; cut < len; cut++) {
+            esp_err_t ret = light_protocol_decode(packet, cut, &decoded);
+            CHECK(ret == ESP_ERR_INVALID_SIZE, "%s cut at %zu: %s", g_messages[i].name, cut, esp_err_to_name(ret));
+        }
+
+        packet[len] = 0xFF;
+        CHECK(light_protocol_decode(packet, len + 1, &decoded) == ESP_OK && msg_equal(msg, &decoded),
+              "%s with a trailing byte", g_messages[i].name);
+
+        /**< Every output buffer too small is refused */
+        for (size_t size = 0; size < len; size++) {
+            size_t out_len = 0;
+            esp_err_t ret = light_protocol_encode(msg, packet, size, &out_len);
+            CHECK(ret == ESP_ERR_INVALID_SIZE, "%s in %zu bytes: %s", g_messages[i].name, size, esp_err_to_name(ret));
+        }
+    }
+
+    /**< Every field at once fits in LIGHT_PROTOCOL_PACKET_MAX */
+    light_protocol_msg_t all = g_messages[BENCH_MESSAGE_NUM - 1].msg;
+    uint8_t packet[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t len = 0;
+
+    all.fields |= FIELD(SCENE);
+    CHECK(light_protocol_encode(&all, packet, sizeof(packet), &len) == ESP_OK, "all the fields");
+}
+
+static void verify_errors(void)
+{
+    const light_protocol_msg_t *msg = &g_messages[1].msg;
+    uint8_t packet[LIGHT_PROTOCOL_PACKET_MAX + 8];
+    light_protocol_msg_t decoded;
+    size_t len = 0;
+
+    ESP_ERROR_CHECK(light_protocol_encode(msg, packet, sizeof(packet), &len));
+
+    packet[0] = '{';
+    CHECK(light_protocol_decode(packet, len, &decoded) == ESP_ERR_INVALID_ARG, "JSON taken as a packet");
+    packet[0] = LIGHT_PROTOCOL_MAGIC;
+
+    packet[1] = LIGHT_PROTOCOL_VERSION + 1;
+    CHECK(light_protocol_decode(packet, len, &decoded) == ESP_ERR_INVALID_VERSION, "other version");
+    CHECK(decoded.seq == msg->seq, "seq of another version");
+    packet[1] = LIGHT_PROTOCOL_VERSION;
+
+    /**< The first TLV is the power, 1 byte */
+    packet[LIGHT_PROTOCOL_HEADER_SIZE + 2] = 2;
+    CHECK(light_protocol_decode(packet, len, &decoded) == ESP_ERR_INVALID_ARG, "power 2");
+    packet[LIGHT_PROTOCOL_HEADER_SIZE + 2] = 1;
+
+    packet[LIGHT_PROTOCOL_HEADER_SIZE + 1] = 2;
+    CHECK(light_protocol_decode(packet, len, &decoded) != ESP_OK, "power on 2 bytes");
+    packet[LIGHT_PROTOCOL_HEADER_SIZE + 1] = 1;
+
+    /**< An unknown tag of a newer firmware is skipped */
+    const uint8_t unknown[] = { 0x40, 3, 0xAA, 0xBB, 0xCC };
+    memcpy(packet + len, unknown, sizeof(unknown));
+    packet[7] += sizeof(unknown);
+    CHECK(light_protocol_decode(packet, len + sizeof(unknown), &decoded) == ESP_OK && msg_equal(msg, &decoded),
+          "unknown tag");
+    packet[7] -= sizeof(unknown);
+
+    light_protocol_msg_t bad = *msg;
+    bad.hue = 361;
+    CHECK(light_protocol_encode(&bad, packet, sizeof(packet), &len) == ESP_ERR_INVALID_ARG, "hue 361");
+    bad = *msg;
+    bad.value = 101;
+    CHECK(light_protocol_encode(&bad, packet, sizeof(packet), &len) == ESP_ERR_INVALID_ARG, "value 101");
+    bad = *msg;
+    bad.type = 0;
+    CHECK(light_protocol_encode(&bad, packet, sizeof(packet), &len) == ESP_ERR_INVALID_ARG, "type 0");
+    bad = *msg;
+    bad.fade_ms = LIGHT_PROTOCOL_FADE_MAX_MS + 1;
+    CHECK(light_protocol_encode(&bad, packet, sizeof(packet), &len) == ESP_ERR_INVALID_ARG, "fade too long");
+
+    /**< A fade of 49 days received from the network, the last TLV of the message */
+    bad.fade_ms = LIGHT_PROTOCOL_FADE_MAX_MS;
+    ESP_ERROR_CHECK(light_protocol_encode(&bad, packet, sizeof(packet), &len));
+    CHECK(packet[len - 6] == LIGHT_PROTOCOL_TAG_FADE, "fade is the last TLV");
+    memset(packet + len - 4, 0xFF, 4);
+    CHECK(light_protocol_decode(packet, len, &decoded) == ESP_ERR_INVALID_ARG, "fade 0xFFFFFFFF");
+}
+
+/**
+ * @brief Random and mutated packets, decoded without reading outside of the buffer
+ *
+ * The buffer is allocated with the exact length so that AddressSanitizer or
+ * valgrind catch any read past its end.
+ */
+static void verify_fuzz(uint32_t iterations)
+{
+    uint8_t packet[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t len = 0;
+    uint32_t accepted = 0;
+
+    srand(1);
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        ESP_ERROR_CHECK(light_protocol_encode(&g_messages[i % BENCH_MESSAGE_NUM].msg, packet, sizeof(packet), &len));
+
+        for (int flips = rand() % 4; flips >= 0; flips--) {
+            packet[rand() % len] = rand();
+        }
+
+        size_t fuzz_len = (rand() % 8) ? len : rand() % (len + 1);
+        uint8_t *buf = malloc(fuzz_len ? fuzz_len : 1);
+        memcpy(buf, packet, fuzz_len);
+
+        light_protocol_msg_t decoded;
+
+        if (light_protocol_decode(buf, fuzz_len, &decoded) == ESP_OK) {
+            uint8_t out[LIGHT_PROTOCOL_PACKET_MAX];
+            size_t out_len = 0;
+
+            /**< Whatever is accepted can be encoded again */
+            CHECK(light_protocol_encode(&decoded, out, sizeof(out), &out_len) == ESP_OK, "re-encode %u", i);
+            accepted++;
+        }
+
+        free(buf);
+    }
+
+    printf("fuzz: %u packets, %u accepted\n", iterations, accepted);
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [--iterations N] [--verify]\n", name);
+    printf("  -n, --iterations  encodes and decodes of each message per round, or fuzzed packets with --verify\n");
+    printf("      --verify      check the codec instead of measuring it\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 1000000;
+    bool verify = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg  = argv[i];
+        const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (!strcmp(arg, "--verify")) {
+            verify = true;
+        } else if ((!strcmp(arg, "-n") || !strcmp(arg, "--iterations")) && next) {
+            iterations = strtoul(next, NULL, 0);
+            i++;
+        } else {
+            usage(argv[0]);
+            return strcmp(arg, "-h") && strcmp(arg, "--help") ? 1 : 0;
+        }
+    }
+
+    if (!iterations) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (verify) {
+        verify_round_trip();
+        verify_errors();
+        verify_fuzz(iterations);
+        printf("%s, %d failures\n", g_failures ? "FAILED" : "PASSED", g_failures);
+        return g_failures ? 1 : 0;
+    }
+
+    run_bench(iterations);
+
+    return 0;
+}
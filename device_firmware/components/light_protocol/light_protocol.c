@@ -0,0 +1,252 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#include "light_protocol.h"
+
+/**< Length of the value of each tag, 0 for the unknown ones */
+static const uint8_t g_tag_len[LIGHT_PROTOCOL_TAG_MAX] = {
+    [LIGHT_PROTOCOL_TAG_POWER]  = 1,
+    [LIGHT_PROTOCOL_TAG_MODE]   = 1,
+    [LIGHT_PROTOCOL_TAG_HSV]    = 4,
+    [LIGHT_PROTOCOL_TAG_CTB]    = 2,
+    [LIGHT_PROTOCOL_TAG_FADE]   = 4,
+    [LIGHT_PROTOCOL_TAG_SCENE]  = 1,
+    [LIGHT_PROTOCOL_TAG_RESULT] = 4,
+};
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool light_protocol_msg_valid(const light_protocol_msg_t *msg)
+{
+    if ((msg->fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_HSV))
+            && (msg->hue > 360 || msg->saturation > 100 || msg->value > 100)) {
+        return false;
+    }
+
+    if ((msg->fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_CTB))
+            && (msg->color_temperature > 100 || msg->brightness > 100)) {
+        return false;
+    }
+
+    if ((msg->fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_FADE)) && msg->fade_ms > LIGHT_PROTOCOL_FADE_MAX_MS) {
+        return false;
+    }
+
+    return msg->type >= LIGHT_PROTOCOL_MSG_SET && msg->type <= LIGHT_PROTOCOL_MSG_STATE;
+}
+
+esp_err_t light_protocol_encode(const light_protocol_msg_t *msg, uint8_t *buf, size_t size, size_t *len)
+{
+    if (!msg || !buf || !len || !light_protocol_msg_valid(msg)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t offset = LIGHT_PROTOCOL_HEADER_SIZE;
+
+    if (size < offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (uint8_t tag = LIGHT_PROTOCOL_TAG_POWER; tag < LIGHT_PROTOCOL_TAG_MAX; tag++) {
+        if (!(msg->fields & LIGHT_PROTOCOL_FIELD(tag))) {
+            continue;
+        }
+
+        if (offset + 2 + g_tag_len[tag] > size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint8_t *p = buf + offset;
+        p[0] = tag;
+        p[1] = g_tag_len[tag];
+        p += 2;
+
+        switch (tag) {
+            case LIGHT_PROTOCOL_TAG_POWER:
+                p[0] = msg->on;
+                break;
+
+            case LIGHT_PROTOCOL_TAG_MODE:
+                p[0] = msg->mode;
+                break;
+
+            case LIGHT_PROTOCOL_TAG_HSV:
+                put_u16(p, msg->hue);
+                p[2] = msg->saturation;
+                p[3] = msg->value;
+                break;
+
+            case LIGHT_PROTOCOL_TAG_CTB:
+                p[0] = msg->color_temperature;
+                p[1] = msg->brightness;
+                break;
+
+            case LIGHT_PROTOCOL_TAG_FADE:
+                put_u32(p, msg->fade_ms);
+                break;
+
+            case LIGHT_PROTOCOL_TAG_SCENE:
+                p[0] = msg->scene;
+                break;
+
+            case LIGHT_PROTOCOL_TAG_RESULT:
+                put_u32(p, (uint32_t)msg->result);
+                break;
+        }
+
+        offset += 2 + g_tag_len[tag];
+    }
+
+    buf[0] = LIGHT_PROTOCOL_MAGIC;
+    buf[1] = LIGHT_PROTOCOL_VERSION;
+    buf[2] = msg->type;
+    buf[3] = 0;
+    put_u16(buf + 4, msg->seq);
+    put_u16(buf + 6, offset - LIGHT_PROTOCOL_HEADER_SIZE);
+    *len = offset;
+
+    return ESP_OK;
+}
+
+esp_err_t light_protocol_packet_len(const uint8_t *buf, size_t len, size_t *packet_len)
+{
+    if (!buf || !packet_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (len && buf[0] != LIGHT_PROTOCOL_MAGIC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (len < LIGHT_PROTOCOL_HEADER_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    *packet_len = LIGHT_PROTOCOL_HEADER_SIZE + get_u16(buf + 6);
+
+    return ESP_OK;
+}
+
+esp_err_t light_protocol_decode(const uint8_t *buf, size_t len, light_protocol_msg_t *msg)
+{
+    size_t packet_len = 0;
+
+    if (!msg) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = light_protocol_packet_len(buf, len, &packet_len);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    memset(msg, 0, sizeof(light_protocol_msg_t));
+    msg->type = buf[2];
+    msg->seq  = get_u16(buf + 4);
+
+    /**< A new version may change the layout of the known tags */
+    if (buf[1] != LIGHT_PROTOCOL_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    if (packet_len > len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (size_t offset = LIGHT_PROTOCOL_HEADER_SIZE; offset < packet_len;) {
+        if (offset + 2 > packet_len || offset + 2 + buf[offset + 1] > packet_len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint8_t tag = buf[offset];
+        uint8_t tag_len = buf[offset + 1];
+        const uint8_t *p = buf + offset + 2;
+
+        offset += 2 + tag_len;
+
+        if (tag >= LIGHT_PROTOCOL_TAG_MAX || !g_tag_len[tag]) {
+            continue;
+        }
+
+        if (tag_len != g_tag_len[tag]) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        switch (tag) {
+            case LIGHT_PROTOCOL_TAG_POWER:
+                if (p[0] > 1) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+
+                msg->on = p[0];
+                break;
+
+            case LIGHT_PROTOCOL_TAG_MODE:
+                msg->mode = p[0];
+                break;
+
+            case LIGHT_PROTOCOL_TAG_HSV:
+                msg->hue        = get_u16(p);
+                msg->saturation = p[2];
+                msg->value      = p[3];
+                break;
+
+            case LIGHT_PROTOCOL_TAG_CTB:
+                msg->color_temperature = p[0];
+                msg->brightness        = p[1];
+                break;
+
+            case LIGHT_PROTOCOL_TAG_FADE:
+                msg->fade_ms = get_u32(p);
+                break;
+
+            case LIGHT_PROTOCOL_TAG_SCENE:
+                msg->scene = p[0];
+                break;
+
+            case LIGHT_PROTOCOL_TAG_RESULT:
+                msg->result = (int32_t)get_u32(p);
+                break;
+        }
+
+        msg->fields |= LIGHT_PROTOCOL_FIELD(tag);
+    }
+
+    return light_protocol_msg_valid(msg) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
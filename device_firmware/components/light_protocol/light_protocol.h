@@ -0,0 +1,171 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Packet layout, all the multi-byte values are big-endian:
+ *
+ *   0        1         2      3      4 ~ 5  6 ~ 7
+ *   +--------+---------+------+------+------+--------+---------------------
+ *   | magic  | version | type | 0    | seq  | length | TLVs, length bytes
+ *   +--------+---------+------+------+------+--------+---------------------
+ *
+ * Each TLV is a one byte tag, a one byte length and the value. The length of
+ * every known tag is fixed, unknown tags are skipped so that fields can be
+ * added without a new version.
+ */
+#define LIGHT_PROTOCOL_MAGIC        0xA5    /**< not a printable character, never the start of a text or JSON message */
+#define LIGHT_PROTOCOL_VERSION      1
+#define LIGHT_PROTOCOL_HEADER_SIZE  8
+#define LIGHT_PROTOCOL_PACKET_MAX   (LIGHT_PROTOCOL_HEADER_SIZE + 32)   /**< all the fields of this version */
+#define LIGHT_PROTOCOL_FADE_MAX_MS  (3 * 1000)  /**< LIGHT_FADE_PERIOD_MAX_MS of the light driver */
+
+typedef enum {
+    LIGHT_PROTOCOL_MSG_SET   = 1,   /**< apply the fields, answered with a state */
+    LIGHT_PROTOCOL_MSG_GET   = 2,   /**< no field, answered with a state */
+    LIGHT_PROTOCOL_MSG_STATE = 3,   /**< state of the light and result of the request with the same seq */
+} light_protocol_msg_type_t;
+
+typedef enum {
+    LIGHT_PROTOCOL_TAG_POWER  = 1,  /**< 1 byte, 0 or 1 */
+    LIGHT_PROTOCOL_TAG_MODE   = 2,  /**< 1 byte, mode of light_driver_get_mode(), MODE_HSV or MODE_CTB in a set request */
+    LIGHT_PROTOCOL_TAG_HSV    = 3,  /**< 4 bytes, hue 0 ~ 360 on 2 bytes, saturation and value 0 ~ 100 */
+    LIGHT_PROTOCOL_TAG_CTB    = 4,  /**< 2 bytes, color temperature and brightness 0 ~ 100 */
+    LIGHT_PROTOCOL_TAG_FADE   = 5,  /**< 4 bytes, fade time in ms up to LIGHT_PROTOCOL_FADE_MAX_MS, of this request only */
+    LIGHT_PROTOCOL_TAG_SCENE  = 6,  /**< 1 byte, scene number */
+    LIGHT_PROTOCOL_TAG_RESULT = 7,  /**< 4 bytes, esp_err_t of the request */
+    LIGHT_PROTOCOL_TAG_MAX,
+} light_protocol_tag_t;
+
+#define LIGHT_PROTOCOL_FIELD(tag)   (1 << (tag))
+
+/**
+ * @brief Decoded packet, only the fields set in fields are meaningful
+ */
+typedef struct {
+    uint8_t type;               /**< light_protocol_msg_type_t */
+    uint16_t seq;               /**< chosen by the sender of the request, copied in the state replied */
+    uint16_t fields;            /**< LIGHT_PROTOCOL_FIELD() of the tags present */
+    bool on;
+    uint8_t mode;
+    uint16_t hue;
+    uint8_t saturation;
+    uint8_t value;
+    uint8_t color_temperature;
+    uint8_t brightness;
+    uint32_t fade_ms;
+    uint8_t scene;
+    int32_t result;
+} light_protocol_msg_t;
+
+/**
+ * @brief  Encode a message, without any allocation
+ *
+ * @param  msg  Message, the fields outside of their range are refused
+ * @param  buf  Output, LIGHT_PROTOCOL_PACKET_MAX bytes are always enough
+ * @param  size Size of buf
+ * @param  len  Length of the packet
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_INVALID_SIZE  buf too small
+ */
+esp_err_t light_protocol_encode(const light_protocol_msg_t *msg, uint8_t *buf, size_t size, size_t *len);
+
+/**
+ * @brief  Decode a packet, without any allocation
+ *
+ * @param  buf  Packet, bytes after the length given in its header are ignored
+ * @param  len  Bytes available in buf
+ * @param  msg  Decoded message
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG      Not a packet of this protocol, or a field is out of range
+ *     - ESP_ERR_INVALID_VERSION  Packet of another version
+ *     - ESP_ERR_INVALID_SIZE     Truncated packet or TLV
+ */
+esp_err_t light_protocol_decode(const uint8_t *buf, size_t len, light_protocol_msg_t *msg);
+
+/**
+ * @brief  Total length of the packet starting in buf, to cut packets out of a stream
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG   buf doesn't start with LIGHT_PROTOCOL_MAGIC
+ *     - ESP_ERR_INVALID_SIZE  Less than LIGHT_PROTOCOL_HEADER_SIZE bytes
+ */
+esp_err_t light_protocol_packet_len(const uint8_t *buf, size_t len, size_t *packet_len);
+
+/**
+ * @brief  Recall a scene, registered by the application
+ */
+typedef esp_err_t (*light_protocol_scene_cb_t)(uint8_t scene);
+
+/**
+ * @brief  Set the function recalling the scenes, without one the scene field is refused
+ */
+void light_protocol_set_scene_cb(light_protocol_scene_cb_t scene_cb);
+
+/**
+ * @brief  Encode the state of the light driver, e.g. for a GET without request packet
+ *
+ * @param  seq    Sequence number of the request answered, 0 if none
+ * @param  result Result of the request answered
+ * @param  buf    Output, LIGHT_PROTOCOL_PACKET_MAX bytes
+ * @param  size   Size of buf
+ * @param  len    Length of the packet
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_SIZE  buf too small
+ */
+esp_err_t light_protocol_encode_state(uint16_t seq, esp_err_t result, uint8_t *buf, size_t size, size_t *len);
+
+/**
+ * @brief  Handle a request with the light driver and encode the state replied
+ *
+ * The same function serves every transport: the payload of a TCP stream, a
+ * UDP datagram, a CoAP or an HTTP request is given as is. A set request
+ * applies the scene, the color and the switch with a single write of the
+ * status to the flash, faded with its fade time without saving it.
+ *
+ * @param  req       Request
+ * @param  req_len   Length of the request
+ * @param  resp      Output, LIGHT_PROTOCOL_PACKET_MAX bytes
+ * @param  resp_size Size of resp
+ * @param  resp_len  Length of the reply
+ *
+ * @return
+ *     - ESP_OK                A state is replied, with the result of the request in its result field
+ *     - ESP_ERR_INVALID_ARG   Not a packet of this protocol, nothing to reply
+ *     - ESP_ERR_INVALID_SIZE  resp too small
+ */
+esp_err_t light_protocol_handle(const uint8_t *req, size_t req_len, uint8_t *resp, size_t resp_size, size_t *resp_len);
+
+#ifdef __cplusplus
+}
+#endif
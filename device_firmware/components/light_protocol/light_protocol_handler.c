@@ -0,0 +1,188 @@
+// Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "light_driver.h"
+#include "light_protocol.h"
+
+_Static_assert(LIGHT_PROTOCOL_FADE_MAX_MS <= LIGHT_FADE_PERIOD_MAX_MS, "fade time refused by the light driver");
+
+static const char *TAG = "light_protocol";
+
+static light_protocol_scene_cb_t g_scene_cb = NULL;
+static SemaphoreHandle_t g_apply_lock = NULL;   /**< requests of several transports, the fade override is global */
+static portMUX_TYPE g_apply_lock_init = portMUX_INITIALIZER_UNLOCKED;
+
+void light_protocol_set_scene_cb(light_protocol_scene_cb_t scene_cb)
+{
+    g_scene_cb = scene_cb;
+}
+
+static esp_err_t light_protocol_apply_fields(const light_protocol_msg_t *msg)
+{
+    const uint16_t fields = msg->fields;
+    esp_err_t ret = ESP_OK;
+
+    /**< Refused before anything is applied */
+    if ((fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_HSV))
+            && (fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_CTB))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if ((fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_SCENE)) && !g_scene_cb) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /**< The mode selects the colour kept by the driver, it must agree with the colour sent along */
+    bool mode = fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_MODE);
+
+    if (mode && msg->mode != MODE_HSV && msg->mode != MODE_CTB) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (mode && (((fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_HSV)) && msg->mode != MODE_HSV)
+                 || ((fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_CTB)) && msg->mode != MODE_CTB))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_SCENE)) {
+        ret = g_scene_cb(msg->scene);
+
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    bool power = fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_POWER);
+    bool on = power ? msg->on : light_driver_get_switch();
+
+    if (fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_HSV)) {
+        ret = light_driver_set_hsv_switch(on, msg->hue, msg->saturation, msg->value);
+    } else if (fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_CTB)) {
+        ret = light_driver_set_ctb_switch(on, msg->color_temperature, msg->brightness);
+    } else if (mode && msg->mode == MODE_HSV) {
+        uint16_t hue = 0;
+        uint8_t saturation = 0, value = 0;
+
+        light_driver_get_hsv(&hue, &saturation, &value);
+        ret = light_driver_set_hsv_switch(on, hue, saturation, value);
+    } else if (mode) {
+        uint8_t color_temperature = 0, brightness = 0;
+
+        light_driver_get_ctb(&color_temperature, &brightness);
+        ret = light_driver_set_ctb_switch(on, color_temperature, brightness);
+    } else if (power && on != light_driver_get_switch()) {
+        ret = light_driver_set_switch(on);
+    }
+
+    return ret;
+}
+
+static esp_err_t light_protocol_apply_locked(const light_protocol_msg_t *msg)
+{
+    if (!(msg->fields & LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_FADE))) {
+        return light_protocol_apply_fields(msg);
+    }
+
+    /**< The fade time is the one of this request, the configured one is kept and saved */
+    esp_err_t ret = light_driver_set_fade_override(msg->fade_ms);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = light_protocol_apply_fields(msg);
+    light_driver_set_fade_override(LIGHT_DRIVER_FADE_DEFAULT);
+
+    return ret;
+}
+
+static esp_err_t light_protocol_apply(const light_protocol_msg_t *msg)
+{
+    /**< Created by the first request, the transports may start their tasks in any order */
+    if (!g_apply_lock) {
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+
+        if (!lock) {
+            return ESP_ERR_NO_MEM;
+        }
+
+        portENTER_CRITICAL(&g_apply_lock_init);
+
+        if (!g_apply_lock) {
+            g_apply_lock = lock;
+            lock = NULL;
+        }
+
+        portEXIT_CRITICAL(&g_apply_lock_init);
+
+        if (lock) {
+            vSemaphoreDelete(lock);
+        }
+    }
+
+    xSemaphoreTake(g_apply_lock, portMAX_DELAY);
+    esp_err_t ret = light_protocol_apply_locked(msg);
+    xSemaphoreGive(g_apply_lock);
+
+    return ret;
+}
+
+esp_err_t light_protocol_encode_state(uint16_t seq, esp_err_t result, uint8_t *buf, size_t size, size_t *len)
+{
+    light_protocol_msg_t state = {
+        .type   = LIGHT_PROTOCOL_MSG_STATE,
+        .seq    = seq,
+        .fields = LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_POWER) | LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_MODE)
+                  | LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_HSV) | LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_CTB)
+                  | LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_FADE) | LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_RESULT),
+        .on     = light_driver_get_switch(),
+        .mode   = light_driver_get_mode(),
+        .result = result,
+    };
+
+    light_driver_get_hsv(&state.hue, &state.saturation, &state.value);
+    light_driver_get_ctb(&state.color_temperature, &state.brightness);
+    light_driver_get_config(&state.fade_ms, NULL);
+
+    return light_protocol_encode(&state, buf, size, len);
+}
+
+esp_err_t light_protocol_handle(const uint8_t *req, size_t req_len, uint8_t *resp, size_t resp_size, size_t *resp_len)
+{
+    light_protocol_msg_t msg = {0};
+
+    if (!req || !req_len || req[0] != LIGHT_PROTOCOL_MAGIC || !resp || !resp_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t result = light_protocol_decode(req, req_len, &msg);
+
+    if (result == ESP_OK) {
+        if (msg.type == LIGHT_PROTOCOL_MSG_SET) {
+            result = light_protocol_apply(&msg);
+        } else if (msg.type != LIGHT_PROTOCOL_MSG_GET) {
+            result = ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+
+    if (result != ESP_OK) {
+        ESP_LOGW(TAG, "Request %d, type: %d, failed: %s", msg.seq, msg.type, esp_err_to_name(result));
+    }
+
+    return light_protocol_encode_state(msg.seq, result, resp, resp_size, resp_len);
+}
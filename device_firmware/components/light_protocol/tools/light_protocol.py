@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Host side of light_protocol, see light_protocol.h for the packet layout:
+#
+#   python3 light_protocol.py tcp 192.168.3.119 --power 1 --hsv 120 100 50
+#   python3 light_protocol.py udp 192.168.3.119 --ctb 30 80 --fade 2000
+#   python3 light_protocol.py udp 192.168.3.119                  # get the state
+#
+# For CoAP and HTTP, the packet is written to stdout and the state decoded from stdin:
+#
+#   python3 light_protocol.py encode --power 0 | coap-client -m put -f - coap://192.168.3.119/light
+#   curl -sk https://192.168.3.119/light | python3 light_protocol.py decode
+
+import argparse
+import random
+import socket
+import struct
+import sys
+
+MAGIC = 0xA5
+VERSION = 1
+HEADER = struct.Struct('>BBBBHH')
+
+MSG_SET, MSG_GET, MSG_STATE = 1, 2, 3
+TAG_POWER, TAG_MODE, TAG_HSV, TAG_CTB, TAG_FADE, TAG_SCENE, TAG_RESULT = range(1, 8)
+
+TAG_FORMATS = {
+    TAG_POWER: ('power', '>B'),
+    TAG_MODE: ('mode', '>B'),
+    TAG_HSV: ('hsv', '>HBB'),
+    TAG_CTB: ('ctb', '>BB'),
+    TAG_FADE: ('fade', '>I'),
+    TAG_SCENE: ('scene', '>B'),
+    TAG_RESULT: ('result', '>i'),
+}
+
+ERRORS = {0: 'ESP_OK', -1: 'ESP_FAIL', 0x102: 'ESP_ERR_INVALID_ARG', 0x104: 'ESP_ERR_INVALID_SIZE',
+          0x106: 'ESP_ERR_NOT_SUPPORTED', 0x10A: 'ESP_ERR_INVALID_VERSION'}
+
+
+def encode(msg_type, seq, fields):
+    """fields maps the names of TAG_FORMATS to a value or a tuple of values"""
+    payload = b''
+    for tag, (name, fmt) in sorted(TAG_FORMATS.items()):
+        if fields.get(name) is None:
+            continue
+        values = fields[name] if isinstance(fields[name], tuple) else (fields[name],)
+        value = struct.pack(fmt, *values)
+        payload += struct.pack('>BB', tag, len(value)) + value
+    return HEADER.pack(MAGIC, VERSION, msg_type, 0, seq, len(payload)) + payload
+
+
+def decode(packet):
+    """Return (type, seq, fields), unknown tags are skipped"""
+    if len(packet) < HEADER.size:
+        raise ValueError('truncated header')
+    magic, version, msg_type, _, seq, length = HEADER.unpack_from(packet)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('not a light_protocol packet of version %d' % VERSION)
+    if len(packet) < HEADER.size + length:
+        raise ValueError('truncated packet')
+    fields = {}
+    offset = HEADER.size
+    while offset < HEADER.size + length:
+        tag, tag_len = struct.unpack_from('>BB', packet, offset)
+        offset += 2
+        if tag in TAG_FORMATS:
+            name, fmt = TAG_FORMATS[tag]
+            values = struct.unpack_from(fmt, packet, offset)
+            fields[name] = values if len(values) > 1 else values[0]
+        offset += tag_len
+    return msg_type, seq, fields
+
+
+def show(packet):
+    msg_type, seq, fields = decode(packet)
+    result = fields.pop('result', 0)
+    print('seq %d, result %s' % (seq, ERRORS.get(result, hex(result))))
+    for name, value in fields.items():
+        print('  %-6s %s' % (name, ' '.join(str(v) for v in value) if isinstance(value, tuple) else value))
+    return 0 if result == 0 else 1
+
+
+def request(args):
+    fields = {
+        'power': args.power,
+        'hsv': tuple(args.hsv) if args.hsv else None,
+        'ctb': tuple(args.ctb) if args.ctb else None,
+        'fade': args.fade,
+        'scene': args.scene,
+    }
+    msg_type = MSG_SET if any(v is not None for v in fields.values()) else MSG_GET
+    return encode(msg_type, random.randint(0, 0xFFFF), fields)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Send light_protocol requests')
+    parser.add_argument('transport', choices=['tcp', 'udp', 'encode', 'decode'])
+    parser.add_argument('host', nargs='?')
+    parser.add_argument('--port', type=int, default=3333)
+    parser.add_argument('--power', type=int, choices=[0, 1])
+    parser.add_argument('--hsv', type=int, nargs=3, metavar=('H', 'S', 'V'))
+    parser.add_argument('--ctb', type=int, nargs=2, metavar=('TEMPERATURE', 'BRIGHTNESS'))
+    parser.add_argument('--fade', type=int, metavar='MS')
+    parser.add_argument('--scene', type=int)
+    parser.add_argument('--timeout', type=float, default=2)
+    args = parser.parse_args()
+
+    if args.transport == 'decode':
+        return show(sys.stdin.buffer.read())
+
+    packet = request(args)
+
+    if args.transport == 'encode':
+        sys.stdout.buffer.write(packet)
+        return 0
+
+    if not args.host:
+        parser.error('the host is required with %s' % args.transport)
+
+    if args.transport == 'tcp':
+        sock = socket.create_connection((args.host, args.port), args.timeout)
+        sock.sendall(packet)
+        reply = b''
+        while len(reply) < HEADER.size or len(reply) < HEADER.size + HEADER.unpack_from(reply)[5]:
+            data = sock.recv(256)
+            if not data:
+                raise ConnectionError('connection closed by the device')
+            reply += data
+    else:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.settimeout(args.timeout)
+        sock.sendto(packet, (args.host, args.port))
+        reply = sock.recv(256)
+
+    sock.close()
+    return show(reply)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -24,6 +24,7 @@
 #include "lwip/err.h"
 #include "lwip/sys.h"
 
+#include "light_protocol.h"
 #include "app_priv.h"
 #if 1
 /* Needed until coap_dtls.h becomes a part of libcoap proper */
@@ -130,20 +131,22 @@ static void wifi_station_initialize(void)
     }
 }
 
-static char buf[100] = "{\"status\": true}";
-// CoAP GET 方法回调处理函数
+// CoAP GET 方法回调处理函数，回复灯控制协议编码的灯的状态
 static void esp_coap_get(coap_context_t *ctx, coap_resource_t *resource,
                   coap_session_t *session,
                   coap_pdu_t *request, coap_binary_t *token,
                   coap_string_t *query, coap_pdu_t *response)
 {
+    uint8_t state[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t len = 0;
+
+    light_protocol_encode_state(0, ESP_OK, state, sizeof(state), &len);
     coap_add_data_blocked_response(resource, session, request, response, token,
-                                   COAP_MEDIATYPE_TEXT_PLAIN, 0,
-                                   strlen(buf),
-                                   (const u_char *)buf);
+                                   COAP_MEDIATYPE_APPLICATION_OCTET_STREAM, 0,
+                                   len, state);
 }
 
-// CoAP PUT 方法回调处理函数
+// CoAP PUT 方法回调处理函数，执行灯控制协议的数据包，回复灯的状态
 static void esp_coap_put(coap_context_t *ctx,
                   coap_resource_t *resource,
                   coap_session_t *session,
@@ -154,23 +157,23 @@ static void esp_coap_put(coap_context_t *ctx,
 {
     size_t size;
     const unsigned char *data;
-
-    coap_resource_notify_observers(resource, NULL);
+    uint8_t state[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t len = 0;
 
     /* 读取收到的 CoAP 数据 */
     (void)coap_get_data(request, &size, &data);
 
-    if (size) {
-        if (strncmp((char *)data, buf, size)) {
-            memcpy(buf, data, size);
-            buf[size] = 0;
-            response->code = COAP_RESPONSE_CODE(204);
-        } else {
-            response->code = COAP_RESPONSE_CODE(500);
-        }
-    } else { /* size 为 0 表示接收错误 */
-        response->code = COAP_RESPONSE_CODE(500);
+    /* size 为 0 表示接收错误，不是灯控制协议的数据包也回复错误 */
+    if (!size || light_protocol_handle(data, size, state, sizeof(state), &len) != ESP_OK) {
+        response->code = COAP_RESPONSE_CODE(400);
+        return;
     }
+
+    // 通知观察者灯的状态变化
+    coap_resource_notify_observers(resource, NULL);
+
+    response->code = COAP_RESPONSE_CODE(204);
+    coap_add_data(response, len, state);
 }
 
 static void esp_create_coap_server(void)
@@ -25,6 +25,7 @@
 #include "lwip/sys.h"
 
 #include "app_storage.h"
+#include "light_protocol.h"
 #include "app_priv.h"
 #include <esp_https_server.h>
 
@@ -126,32 +127,51 @@ static void wifi_station_initialize(void)
     }
 }
 
-static char buf[100] = "{\"status\": true}";
 // HTTP GET 请求回调处理函数
 static esp_err_t esp_light_get_handler(httpd_req_t *req)
 {
-    // 发送含有灯的状态的 JSON 格式数据给客户端
-    httpd_resp_send(req, buf, strlen(buf));
+    uint8_t state[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t len = 0;
+
+    // 发送灯控制协议编码的灯的状态给客户端
+    light_protocol_encode_state(0, ESP_OK, state, sizeof(state), &len);
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_send(req, (const char *)state, len);
     return ESP_OK;
 }
 
 // HTTP POST 请求回调处理函数
 static esp_err_t esp_light_set_handler(httpd_req_t *req)
 {
-    int ret, remaining = req->content_len;
-    memset(buf, 0 ,sizeof(buf));
-    while (remaining > 0) {
+    uint8_t buf[LIGHT_PROTOCOL_PACKET_MAX];
+    uint8_t state[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t len = 0;
+    int ret, received = 0;
+
+    if (req->content_len > sizeof(buf)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Request too long");
+        return ESP_FAIL;
+    }
+
+    while (received < req->content_len) {
         // 读取 http 请求数据
-        if ((ret = httpd_req_recv(req, buf, remaining)) <= 0) {
+        if ((ret = httpd_req_recv(req, (char *)buf + received, req->content_len - received)) <= 0) {
             if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
                 continue;
             }
             return ESP_FAIL;
         }
-        remaining -= ret;
+        received += ret;
     }
-    ESP_LOGI(TAG, "%.*s", req->content_len, buf);
-    // TODO: 读到数据后解析并且操作灯
+
+    // 解析灯控制协议的数据包并操作灯，回复灯的状态
+    if (light_protocol_handle(buf, received, state, sizeof(state), &len) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Not a light_protocol packet");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_send(req, (const char *)state, len);
     return ESP_OK;
 }
 
@@ -0,0 +1,448 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "esp_err.h"
+#include "light_driver.h"
+#include "light_protocol.h"
+#include "app_priv.h"
+#include "host_sim.h"
+
+/**
+ * Every device is a process running app_group_sync.c on its own clock: a
+ * random offset, as after a boot at a random time, and a random drift. They
+ * start one after the other on the loopback interface, each datagram delayed
+ * by a random time. The processes write what the parent measures:
+ *
+ *   T <device> <true time> <group time>   every 20 ms once the group time is known
+ *   S <device> <seq> <true time>          a command sent
+ *   F <device> <seq> <true time>          a command started on the light
+ *
+ * The true time is CLOCK_MONOTONIC, shared by the processes. With --restart,
+ * the device sending the commands is killed halfway through them and started
+ * again with the same MAC address, as after a reboot.
+ */
+#define SIM_DEVICE_MAX      16
+#define SIM_COMMAND_MAX     256
+#define SIM_SAMPLE_MAX      4096
+
+typedef struct {
+    int devices;
+    int duration_s;
+    int stagger_ms;
+    uint32_t jitter_us;
+    double drift_ppm;
+    int period_ms;
+    int lead_ms;
+    int64_t max_spread_us;
+    int64_t max_skew_us;
+    int64_t max_convergence_ms;
+    bool restart;
+    bool verify;
+    bool verbose;
+} sim_config_t;
+
+static int g_device_index;
+
+esp_err_t light_driver_align_fade(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t light_protocol_handle(const uint8_t *req, size_t req_len, uint8_t *resp, size_t resp_size, size_t *resp_len)
+{
+    light_protocol_msg_t msg = {0};
+    int64_t now = host_sim_true_us();
+
+    if (light_protocol_decode(req, req_len, &msg) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    printf("F %d %u %" PRId64 "\n", g_device_index, msg.seq, now);
+    *resp_len = 0;
+    return ESP_OK;
+}
+
+static void sim_device(const sim_config_t *config, int index, uint32_t mac_seed, int64_t command_start_us,
+                       int64_t end_us)
+{
+    host_sim_config_t sim = {
+        .index           = index,
+        .mac_seed        = mac_seed,
+        .clock_offset_us = (int64_t)(rand() % 100000) * 1000 + rand() % 1000,
+        .drift_ppm       = config->drift_ppm * (2.0 * rand() / RAND_MAX - 1),
+        .jitter_us       = config->jitter_us,
+        .verbose         = config->verbose,
+    };
+    bool commander = index == config->devices - 1;
+    int64_t next_command_us = command_start_us;
+
+    g_device_index = index;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    host_sim_init(&sim);
+    host_sim_log('I', "sim", "clock offset %" PRId64 " us, drift %.1f ppm", sim.clock_offset_us, sim.drift_ppm);
+    ESP_ERROR_CHECK(app_group_sync_start());
+
+    while (host_sim_true_us() < end_us) {
+        int64_t group_us = 0;
+
+        if (app_group_sync_get_time(&group_us) == ESP_OK) {
+            printf("T %d %" PRId64 " %" PRId64 "\n", index, host_sim_true_us(), group_us);
+        }
+
+        /**< The last device started sends, it follows the group */
+        if (commander && host_sim_true_us() >= next_command_us && host_sim_true_us() < end_us - 1000000) {
+            /**< Numbered by their time, the same after a restart */
+            uint16_t seq = (next_command_us - command_start_us) / (config->period_ms * 1000LL) + 1;
+            light_protocol_msg_t msg = {
+                .type       = LIGHT_PROTOCOL_MSG_SET,
+                .seq        = seq,
+                .fields     = LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_POWER) | LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_HSV)
+                              | LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_FADE),
+                .on         = true,
+                .hue        = seq * 37 % 360,
+                .saturation = 100,
+                .value      = 100,
+                .fade_ms    = 1000,
+            };
+
+            if (app_group_sync_send(&msg, config->lead_ms) == ESP_OK) {
+                printf("S %d %u %" PRId64 "\n", index, seq, host_sim_true_us());
+            }
+
+            while (next_command_us <= host_sim_true_us()) {
+                next_command_us += config->period_ms * 1000LL;
+            }
+        }
+
+        usleep(20000);
+    }
+
+    fflush(stdout);
+    _exit(0);
+}
+
+typedef struct {
+    int64_t true_us;
+    int64_t group_us;
+} sim_sample_t;
+
+static struct {
+    sim_sample_t samples[SIM_DEVICE_MAX][SIM_SAMPLE_MAX];
+    int sample_num[SIM_DEVICE_MAX];
+    int64_t start_us[SIM_COMMAND_MAX][SIM_DEVICE_MAX];
+    int start_num[SIM_COMMAND_MAX][SIM_DEVICE_MAX];
+    bool sent[SIM_COMMAND_MAX];
+} g_result;
+
+/**
+ * @brief Group time of a device at a true time, from the samples around it
+ */
+static bool sim_group_time(int device, int64_t true_us, int64_t *group_us)
+{
+    const sim_sample_t *samples = g_result.samples[device];
+    int num = g_result.sample_num[device];
+
+    for (int i = 1; i < num; i++) {
+        if (samples[i].true_us >= true_us) {
+            if (samples[i - 1].true_us > true_us || samples[i].true_us - samples[i - 1].true_us > 100000) {
+                return false;
+            }
+
+            *group_us = samples[i - 1].group_us + (true_us - samples[i - 1].true_us)
+                        * (samples[i].group_us - samples[i - 1].group_us) / (samples[i].true_us - samples[i - 1].true_us);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief The device restarted has no group time until it joined the group again
+ */
+static bool sim_absent(const sim_config_t *config, int device, int64_t true_us, int64_t restart_us)
+{
+    return config->restart && device == config->devices - 1
+           && true_us >= restart_us && true_us < restart_us + config->max_convergence_ms * 1000LL;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int sim_run(const sim_config_t *config)
+{
+    int fds[2];
+    int64_t start_us = host_sim_true_us();
+    int64_t last_start_us = start_us + (config->devices - 1) * config->stagger_ms * 1000LL;
+    int64_t end_us = start_us + config->duration_s * 1000000LL;
+    int64_t command_start_us = last_start_us + config->max_convergence_ms * 1000LL;
+    pid_t pids[SIM_DEVICE_MAX];
+    uint32_t mac_seeds[SIM_DEVICE_MAX];
+    char line[128];
+
+    /**< Between the start of a command and the sending of the next one */
+    int64_t period_us = config->period_ms * 1000LL;
+    int64_t restart_us = command_start_us + (end_us - command_start_us) / 2 / period_us * period_us
+                         + (config->lead_ms * 1000LL + period_us) / 2;
+    bool restarted = !config->restart;
+
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    for (int i = 0; i < config->devices; i++) {
+        int64_t at = start_us + i * config->stagger_ms * 1000LL;
+
+        while (host_sim_true_us() < at) {
+            usleep(1000);
+        }
+
+        srand(getpid() * 31 + i);
+        mac_seeds[i] = (uint32_t)(start_us * 7919 + i);
+        pids[i] = fork();
+
+        if (pids[i] == 0) {
+            close(fds[0]);
+            dup2(fds[1], STDOUT_FILENO);
+            close(fds[1]);
+            sim_device(config, i, mac_seeds[i], command_start_us, end_us);
+        }
+    }
+
+    if (restarted) {
+        close(fds[1]);
+    }
+
+    FILE *in = fdopen(fds[0], "r");
+
+    while (fgets(line, sizeof(line), in)) {
+        /**< The devices write every 20 ms, the restart is checked as often */
+        if (!restarted && host_sim_true_us() >= restart_us) {
+            int i = config->devices - 1;
+
+            kill(pids[i], SIGKILL);
+            waitpid(pids[i], NULL, 0);
+            srand(getpid() * 31 + i + SIM_DEVICE_MAX);
+            pids[i] = fork();
+
+            if (pids[i] == 0) {
+                close(fds[0]);
+                dup2(fds[1], STDOUT_FILENO);
+                close(fds[1]);
+                sim_device(config, i, mac_seeds[i], command_start_us, end_us);
+            }
+
+            close(fds[1]);
+            restarted = true;
+        }
+
+        char type = 0;
+        int device = 0;
+        int64_t a = 0, b = 0;
+
+        if (sscanf(line, "%c %d %" SCNd64 " %" SCNd64, &type, &device, &a, &b) != 4
+                || device < 0 || device >= config->devices) {
+            continue;
+        }
+
+        if (type == 'T' && g_result.sample_num[device] < SIM_SAMPLE_MAX) {
+            g_result.samples[device][g_result.sample_num[device]++] = (sim_sample_t) { a, b };
+        } else if (type == 'S' && a < SIM_COMMAND_MAX) {
+            g_result.sent[a] = true;
+        } else if (type == 'F' && a < SIM_COMMAND_MAX) {
+            g_result.start_us[a][device] = b;
+            g_result.start_num[a][device]++;
+        }
+    }
+
+    for (int i = 0; i < config->devices; i++) {
+        waitpid(pids[i], NULL, 0);
+    }
+
+    /**< Spread of the group times, from the start of the last device */
+    int64_t converged_us = -1;
+    int64_t max_spread = 0;
+    static int64_t spreads[SIM_SAMPLE_MAX * 4];
+    int spread_num = 0;
+
+    for (int64_t t = last_start_us; t < end_us - 200000; t += 50000) {
+        int64_t min = INT64_MAX, max = INT64_MIN;
+        bool all = true;
+
+        for (int i = 0; i < config->devices && all; i++) {
+            int64_t group_us = 0;
+
+            if (sim_absent(config, i, t, restart_us)) {
+                continue;
+            }
+
+            all = sim_group_time(i, t, &group_us);
+            min = group_us < min ? group_us : min;
+            max = group_us > max ? group_us : max;
+        }
+
+        if (!all || max - min > config->max_spread_us) {
+            converged_us = -1;
+            continue;
+        }
+
+        converged_us = converged_us < 0 ? t : converged_us;
+        spreads[spread_num++] = max - min;
+    }
+
+    if (converged_us >= 0) {
+        spread_num = 0;
+
+        for (int64_t t = converged_us; t < end_us - 200000 && spread_num < SIM_SAMPLE_MAX * 4; t += 50000) {
+            int64_t min = INT64_MAX, max = INT64_MIN;
+
+            for (int i = 0; i < config->devices; i++) {
+                int64_t group_us = 0;
+
+                if (!sim_group_time(i, t, &group_us)) {
+                    continue;
+                }
+
+                min = group_us < min ? group_us : min;
+                max = group_us > max ? group_us : max;
+            }
+
+            spreads[spread_num++] = max - min;
+            max_spread = max - min > max_spread ? max - min : max_spread;
+        }
+
+        qsort(spreads, spread_num, sizeof(int64_t), cmp_i64);
+    }
+
+    /**< Skew of the start of every command over the devices */
+    static int64_t skews[SIM_COMMAND_MAX];
+    int skew_num = 0, sent = 0, incomplete = 0;
+
+    for (int seq = 0; seq < SIM_COMMAND_MAX; seq++) {
+        if (!g_result.sent[seq]) {
+            continue;
+        }
+
+        int64_t min = INT64_MAX, max = INT64_MIN;
+        bool complete = true;
+
+        for (int i = 0; i < config->devices; i++) {
+            complete &= g_result.start_num[seq][i] == 1;
+            min = g_result.start_us[seq][i] < min ? g_result.start_us[seq][i] : min;
+            max = g_result.start_us[seq][i] > max ? g_result.start_us[seq][i] : max;
+        }
+
+        sent++;
+
+        if (!complete) {
+            incomplete++;
+            continue;
+        }
+
+        skews[skew_num++] = max - min;
+    }
+
+    qsort(skews, skew_num, sizeof(int64_t), cmp_i64);
+
+    printf("%d devices started %d ms apart, jitter up to %" PRIu32 " us per datagram, drift up to %.0f ppm\n",
+           config->devices, config->stagger_ms, config->jitter_us, config->drift_ppm);
+
+    if (config->restart) {
+        printf("  restart          : device %d, the commander, %" PRId64 " ms after the last device started\n",
+               config->devices - 1, (restart_us - last_start_us) / 1000);
+    }
+
+    if (converged_us < 0) {
+        printf("  group time       : never within %" PRId64 " us on all the devices\n", config->max_spread_us);
+    } else {
+        printf("  convergence      : %" PRId64 " ms after the last device started\n", (converged_us - last_start_us) / 1000);
+        printf("  group time spread: p50 %" PRId64 " us, p99 %" PRId64 " us, max %" PRId64 " us\n",
+               spreads[spread_num / 2], spreads[spread_num * 99 / 100], max_spread);
+    }
+
+    printf("  commands         : %d sent, %d started on all the devices exactly once\n", sent, skew_num);
+
+    if (skew_num) {
+        printf("  start skew       : p50 %" PRId64 " us, p99 %" PRId64 " us, max %" PRId64 " us\n",
+               skews[skew_num / 2], skews[skew_num * 99 / 100], skews[skew_num - 1]);
+    }
+
+    if (!config->verify) {
+        return 0;
+    }
+
+    bool ok = converged_us >= 0 && converged_us - last_start_us <= config->max_convergence_ms * 1000LL
+              && sent > 0 && !incomplete && skews[skew_num - 1] <= config->max_skew_us;
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    sim_config_t config = {
+        .devices            = 5,
+        .duration_s         = 20,
+        .stagger_ms         = 700,
+        .jitter_us          = 2000,
+        .drift_ppm          = 40,
+        .period_ms          = 500,
+        .lead_ms            = 200,
+        .max_spread_us      = 2000,
+        .max_skew_us        = 3000,
+        .max_convergence_ms = 8000,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--verify")) {
+            config.verify = true;
+        } else if (!strcmp(argv[i], "--restart")) {
+            config.restart = true;
+        } else if (!strcmp(argv[i], "--verbose")) {
+            config.verbose = true;
+        } else if (!strcmp(argv[i], "--devices") && i + 1 < argc) {
+            config.devices = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+            config.duration_s = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--stagger-ms") && i + 1 < argc) {
+            config.stagger_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--jitter-us") && i + 1 < argc) {
+            config.jitter_us = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--drift-ppm") && i + 1 < argc) {
+            config.drift_ppm = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--period-ms") && i + 1 < argc) {
+            config.period_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--lead-ms") && i + 1 < argc) {
+            config.lead_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--verify] [--restart] [--verbose] [--devices N] [--duration S] [--stagger-ms MS]\n"
+                    "       [--jitter-us US] [--drift-ppm PPM] [--period-ms MS] [--lead-ms MS]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (config.devices < 2 || config.devices > SIM_DEVICE_MAX) {
+        fprintf(stderr, "2 ~ %d devices\n", SIM_DEVICE_MAX);
+        return 2;
+    }
+
+    return sim_run(&config);
+}
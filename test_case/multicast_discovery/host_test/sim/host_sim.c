@@ -0,0 +1,296 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_netif.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "host_sim.h"
+
+static host_sim_config_t g_config;
+static int64_t g_true_start_us;
+static unsigned int g_seed;
+static pthread_mutex_t g_seed_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int64_t host_sim_true_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static uint32_t host_sim_rand(void)
+{
+    pthread_mutex_lock(&g_seed_lock);
+    uint32_t value = rand_r(&g_seed);
+    pthread_mutex_unlock(&g_seed_lock);
+
+    return value;
+}
+
+void host_sim_init(const host_sim_config_t *config)
+{
+    g_config = *config;
+    g_true_start_us = host_sim_true_us();
+    g_seed = (unsigned int)(g_true_start_us ^ (config->index * 7919));
+}
+
+void host_sim_log(char level, const char *tag, const char *format, ...)
+{
+    va_list args;
+
+    if (level == 'I' && !g_config.verbose) {
+        return;
+    }
+
+    flockfile(stderr);
+    fprintf(stderr, "%c [device %d] (%s) ", level, g_config.index, tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+/**
+ * The local clock runs drift_ppm fast from clock_offset_us, the true time of a
+ * local time is its inverse to sleep until a local deadline.
+ */
+int64_t esp_timer_get_time(void)
+{
+    int64_t elapsed = host_sim_true_us() - g_true_start_us;
+
+    return g_config.clock_offset_us + elapsed + (int64_t)(elapsed * g_config.drift_ppm / 1e6);
+}
+
+static struct timespec host_sim_local_to_abs(int64_t local_us)
+{
+    int64_t elapsed = (int64_t)((local_us - g_config.clock_offset_us) / (1 + g_config.drift_ppm / 1e6));
+    int64_t true_us = g_true_start_us + elapsed;
+    struct timespec ts = {
+        .tv_sec  = true_us / 1000000,
+        .tv_nsec = (true_us % 1000000) * 1000,
+    };
+
+    return ts;
+}
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool armed;
+    int64_t deadline_us;
+};
+
+static void *host_sim_timer_thread(void *arg)
+{
+    esp_timer_handle_t timer = arg;
+
+    pthread_mutex_lock(&timer->lock);
+
+    while (1) {
+        if (!timer->armed) {
+            pthread_cond_wait(&timer->cond, &timer->lock);
+            continue;
+        }
+
+        struct timespec abs = host_sim_local_to_abs(timer->deadline_us);
+
+        if (pthread_cond_timedwait(&timer->cond, &timer->lock, &abs) == 0 || !timer->armed
+                || esp_timer_get_time() < timer->deadline_us) {
+            continue;
+        }
+
+        timer->armed = false;
+        pthread_mutex_unlock(&timer->lock);
+        timer->args.callback(timer->args.arg);
+        pthread_mutex_lock(&timer->lock);
+    }
+
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+    pthread_condattr_t attr;
+
+    timer->args = *create_args;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->cond, &attr);
+    pthread_create(&timer->thread, NULL, host_sim_timer_thread, timer);
+    *out_handle = timer;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    pthread_mutex_lock(&timer->lock);
+    timer->armed = true;
+    timer->deadline_us = esp_timer_get_time() + timeout_us;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    bool armed = timer->armed;
+    timer->armed = false;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+
+    return armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t function;
+    void *arg;
+    sem_t notify;
+};
+
+static __thread TaskHandle_t g_current_task = NULL;
+
+static void *host_sim_task_thread(void *arg)
+{
+    TaskHandle_t task = arg;
+
+    g_current_task = task;
+    task->function(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       uint32_t priority, TaskHandle_t *created_task)
+{
+    TaskHandle_t task = calloc(1, sizeof(struct host_task));
+
+    task->function = function;
+    task->arg = arg;
+    sem_init(&task->notify, 0, 0);
+
+    if (created_task) {
+        *created_task = task;
+    }
+
+    return pthread_create(&task->thread, NULL, host_sim_task_thread, task) == 0 ? pdPASS : pdFALSE;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    pthread_exit(NULL);
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    sem_post(&task->notify);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    TaskHandle_t task = g_current_task;
+    uint32_t count = 1;
+
+    sem_wait(&task->notify);
+
+    while (clear_count_on_exit && sem_trywait(&task->notify) == 0) {
+        count++;
+    }
+
+    return count;
+}
+
+struct host_mutex {
+    pthread_mutex_t mutex;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = calloc(1, sizeof(struct host_mutex));
+
+    pthread_mutex_init(&mutex->mutex, NULL);
+    return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks_to_wait)
+{
+    return pthread_mutex_lock(&mutex->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    return pthread_mutex_unlock(&mutex->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    unsigned int seed = g_config.mac_seed;
+
+    for (int i = 0; i < 6; i++) {
+        mac[i] = rand_r(&seed);
+    }
+
+    return ESP_OK;
+}
+
+uint32_t esp_random(void)
+{
+    return host_sim_rand();
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key)
+{
+    return NULL;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
+{
+    memset(ip_info, 0, sizeof(esp_netif_ip_info_t));
+    ip_info->ip.addr = htonl(INADDR_LOOPBACK);
+
+    return ESP_OK;
+}
+
+ssize_t host_sim_sendto(int sockfd, const void *buf, size_t len, int flags,
+                        const struct sockaddr *dest_addr, socklen_t addrlen)
+{
+    if (g_config.jitter_us) {
+        struct timespec delay = { .tv_nsec = (host_sim_rand() % g_config.jitter_us) * 1000L };
+        nanosleep(&delay, NULL);
+    }
+
+    return sendto(sockfd, buf, len, flags, dest_addr, addrlen);
+}
@@ -0,0 +1,36 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief A device simulated in a process, its clock and its network
+ */
+typedef struct {
+    int index;                  /**< shown in the logs */
+    uint32_t mac_seed;          /**< the MAC address, the same when the device restarts */
+    int64_t clock_offset_us;    /**< esp_timer_get_time() at the start of the process */
+    double drift_ppm;           /**< rate of the crystal, e.g. 20 for a clock 20 us/s fast */
+    uint32_t jitter_us;         /**< each datagram sent waits a random delay up to this */
+    bool verbose;               /**< ESP_LOGI shown */
+} host_sim_config_t;
+
+/**
+ * @brief Set up the simulation of this process, before anything else
+ */
+void host_sim_init(const host_sim_config_t *config);
+
+/**
+ * @brief CLOCK_MONOTONIC in us, the same for all the processes: the real time the devices are compared on
+ */
+int64_t host_sim_true_us(void);
+
+void host_sim_log(char level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
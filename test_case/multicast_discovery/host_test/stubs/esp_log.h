@@ -0,0 +1,23 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include "host_sim.h"
+
+/**
+ * @brief Host replacement of the ESP-IDF esp_log.h
+ *
+ * Errors and warnings go to stderr with the index of the device, the other
+ * levels only with --verbose. The standard output carries the measurements.
+ */
+#define ESP_LOGE(tag, format, ...) host_sim_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) host_sim_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) host_sim_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { (void)(tag); } while(0)
+#define ESP_LOGV(tag, format, ...) do { (void)(tag); } while(0)
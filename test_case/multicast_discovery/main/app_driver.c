@@ -21,11 +21,22 @@
 
 #define TAG "app_driver"
 
+#define APP_DRIVER_GROUP_LEAD_MS    200     /**< time for the multicast to reach every light */
+
 static bool g_output_state = true;
 
 static void push_btn_cb(void *arg)
 {
-    app_driver_set_state(!g_output_state);
+    light_protocol_msg_t msg = {
+        .type   = LIGHT_PROTOCOL_MSG_SET,
+        .fields = LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_POWER),
+        .on     = !app_driver_get_state(),
+    };
+
+    /**< The lights of the LAN switch together, this one alone until the group time is known */
+    if (app_group_sync_send(&msg, APP_DRIVER_GROUP_LEAD_MS) != ESP_OK) {
+        app_driver_set_state(msg.on);
+    }
 }
 
 void app_driver_init()
@@ -81,5 +92,7 @@ int IRAM_ATTR app_driver_set_state(bool state)
 
 bool app_driver_get_state(void)
 {
+    /**< A group command switches the light without app_driver_set_state() */
+    g_output_state = light_driver_get_switch();
     return g_output_state;
 }
@@ -0,0 +1,767 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_netif.h"
+
+#include "lwip/sockets.h"
+#include "lwip/err.h"
+#include "lwip/sys.h"
+
+#include "light_driver.h"
+#include "light_protocol.h"
+#include "app_priv.h"
+
+#define APP_GROUP_ADDR              "232.10.11.12"  /**< multicast group of the discovery */
+#define APP_GROUP_PORT              3334
+#define APP_GROUP_MAGIC             0x4753          /**< "GS" */
+#define APP_GROUP_VERSION           1
+#define APP_GROUP_HEADER_SIZE       8
+#define APP_GROUP_MSG_MAX           (APP_GROUP_HEADER_SIZE + 12 + LIGHT_PROTOCOL_PACKET_MAX)
+#define APP_GROUP_ANNOUNCE_MS       1000
+#define APP_GROUP_EXCHANGE_MS       250
+#define APP_GROUP_LISTEN_MS         2500            /**< a new device follows an existing group before it may lead one */
+#define APP_GROUP_PEER_TIMEOUT_MS   3500
+#define APP_GROUP_PEER_MAX          16
+#define APP_GROUP_SAMPLE_NUM        16              /**< exchanges of the last 4 s the offset is estimated from */
+#define APP_GROUP_SAMPLE_BEST       4               /**< shortest round trips of them averaged */
+#define APP_GROUP_STEP_MS           10              /**< larger offset changes are another group time */
+#define APP_GROUP_PENDING_MAX       4
+#define APP_GROUP_REPEAT_NUM        3               /**< transmissions of a command, multicast is not acknowledged */
+#define APP_GROUP_REPEAT_MS         20
+#define APP_GROUP_SEEN_NUM          16
+#define APP_GROUP_SEEN_MS           500             /**< longer than the repeats of a command and their delays */
+#define APP_GROUP_LEAD_MAX_MS       5000            /**< commands starting later are refused, they would hold a pending slot */
+#define APP_GROUP_STACK_SIZE        4096
+
+#define APP_GROUP_FLAG_ELIGIBLE     BIT0            /**< the group time is known well enough to lead the group */
+#define APP_GROUP_FLAG_REFERENCE    BIT1
+
+static const char *TAG = "group_sync";
+
+/**
+ * Messages, a header then the fields of the type, all the values big-endian:
+ *
+ *   0 ~ 1   2         3      4 ~ 7
+ *   +-------+---------+------+-----------+------------------------------
+ *   | magic | version | type | sender id | fields
+ *   +-------+---------+------+-----------+------------------------------
+ *
+ * The times are in us. Local times are esp_timer_get_time() of the device that
+ * sent them, group times are the local time of the reference plus its offset.
+ */
+typedef enum {
+    APP_GROUP_MSG_ANNOUNCE   = 1,   /**< multicast, flags on 1 byte */
+    APP_GROUP_MSG_DELAY_REQ  = 2,   /**< to the reference, local time t1 of the follower */
+    APP_GROUP_MSG_DELAY_RESP = 3,   /**< to the follower, t1, group times t2 of the reception and t3 of the reply */
+    APP_GROUP_MSG_COMMAND    = 4,   /**< multicast, seq on 2 bytes, group time to start at, light_protocol set request */
+} app_group_msg_type_t;
+
+typedef struct {
+    uint32_t id;
+    struct sockaddr_in addr;        /**< unicast socket of the peer */
+    uint8_t flags;
+    int64_t last_us;
+} app_group_peer_t;
+
+typedef struct {
+    int64_t offset_us;
+    int64_t delay_us;               /**< round trip, without the time spent by the reference */
+} app_group_sample_t;
+
+typedef struct {
+    bool used;
+    int64_t local_us;
+    size_t len;
+    uint8_t packet[LIGHT_PROTOCOL_PACKET_MAX];
+} app_group_pending_t;
+
+static struct {
+    uint32_t id;
+    int mcast_sock;                 /**< bound to APP_GROUP_PORT, receives the multicast messages */
+    int sock;                       /**< sends everything, receives the unicast messages */
+    struct sockaddr_in group_addr;
+    SemaphoreHandle_t lock;
+    TaskHandle_t apply_task;
+    esp_timer_handle_t timer;
+    int64_t start_us;
+
+    bool synced;
+    int64_t offset_us;              /**< group time - local time */
+    uint32_t reference;             /**< own id when this device is the reference, 0 if none */
+    app_group_peer_t peers[APP_GROUP_PEER_MAX];
+    app_group_sample_t samples[APP_GROUP_SAMPLE_NUM];
+    uint8_t sample_num;
+    uint8_t sample_next;
+    int64_t req_local_us;
+
+    app_group_pending_t pending[APP_GROUP_PENDING_MAX];
+    struct {
+        uint32_t id;
+        uint16_t seq;
+        int64_t local_us;
+    } seen[APP_GROUP_SEEN_NUM];     /**< commands received, each is sent APP_GROUP_REPEAT_NUM times */
+    uint8_t seen_next;
+
+    uint16_t seq;                   /**< random at boot, the peers may still remember the last ones */
+    uint8_t tx[APP_GROUP_MSG_MAX];
+    size_t tx_len;
+    uint8_t tx_left;
+    int64_t tx_next_us;
+} g_group;
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v >> 16);
+    put_u16(p + 2, v);
+}
+
+static inline void put_i64(uint8_t *p, int64_t v)
+{
+    put_u32(p, (uint64_t)v >> 32);
+    put_u32(p + 4, (uint32_t)v);
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)get_u16(p) << 16 | get_u16(p + 2);
+}
+
+static inline int64_t get_i64(const uint8_t *p)
+{
+    return (int64_t)((uint64_t)get_u32(p) << 32 | get_u32(p + 4));
+}
+
+static size_t app_group_header(uint8_t *buf, app_group_msg_type_t type)
+{
+    put_u16(buf, APP_GROUP_MAGIC);
+    buf[2] = APP_GROUP_VERSION;
+    buf[3] = type;
+    put_u32(buf + 4, g_group.id);
+
+    return APP_GROUP_HEADER_SIZE;
+}
+
+static void app_group_sendto(const uint8_t *buf, size_t len, const struct sockaddr_in *addr)
+{
+    if (sendto(g_group.sock, buf, len, 0, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        ESP_LOGW(TAG, "Error occurred during sending: errno %d", errno);
+    }
+}
+
+/**
+ * @brief Arm the timer on the earliest command, called with the lock held
+ */
+static void app_group_arm(int64_t now)
+{
+    app_group_pending_t *earliest = NULL;
+
+    for (int i = 0; i < APP_GROUP_PENDING_MAX; i++) {
+        if (g_group.pending[i].used && (!earliest || g_group.pending[i].local_us < earliest->local_us)) {
+            earliest = &g_group.pending[i];
+        }
+    }
+
+    esp_timer_stop(g_group.timer);
+
+    if (!earliest) {
+        return;
+    }
+
+    if (earliest->local_us <= now) {
+        xTaskNotifyGive(g_group.apply_task);
+    } else {
+        esp_timer_start_once(g_group.timer, earliest->local_us - now);
+    }
+}
+
+static esp_err_t app_group_schedule(int64_t local_us, const uint8_t *packet, size_t len)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(g_group.lock, portMAX_DELAY);
+
+    for (int i = 0; i < APP_GROUP_PENDING_MAX; i++) {
+        app_group_pending_t *pending = &g_group.pending[i];
+
+        if (!pending->used) {
+            pending->used     = true;
+            pending->local_us = local_us;
+            pending->len      = len;
+            memcpy(pending->packet, packet, len);
+            app_group_arm(esp_timer_get_time());
+            ret = ESP_OK;
+            break;
+        }
+    }
+
+    xSemaphoreGive(g_group.lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "%d commands are pending, the new one is dropped", APP_GROUP_PENDING_MAX);
+    }
+
+    return ret;
+}
+
+static void app_group_timer_cb(void *arg)
+{
+    xTaskNotifyGive(g_group.apply_task);
+}
+
+/**
+ * @brief Start the commands due, the light is set right after the fade steps are aligned on the start time
+ */
+static void app_group_apply_task(void *arg)
+{
+    uint8_t resp[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t resp_len = 0;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (1) {
+            app_group_pending_t due = { .used = false };
+            int64_t now = esp_timer_get_time();
+
+            xSemaphoreTake(g_group.lock, portMAX_DELAY);
+
+            for (int i = 0; i < APP_GROUP_PENDING_MAX; i++) {
+                app_group_pending_t *pending = &g_group.pending[i];
+
+                if (pending->used && pending->local_us <= now && (!due.used || pending->local_us < due.local_us)) {
+                    due = *pending;
+                    pending->used = false;
+                }
+            }
+
+            if (!due.used) {
+                app_group_arm(now);
+            }
+
+            xSemaphoreGive(g_group.lock);
+
+            if (!due.used) {
+                break;
+            }
+
+            light_driver_align_fade();
+            light_protocol_handle(due.packet, due.len, resp, sizeof(resp), &resp_len);
+            ESP_LOGI(TAG, "Command started %" PRId64 " us after its start time", now - due.local_us);
+        }
+    }
+}
+
+static app_group_peer_t *app_group_peer(uint32_t id, const struct sockaddr_in *addr, int64_t now)
+{
+    app_group_peer_t *free_peer = NULL;
+
+    for (int i = 0; i < APP_GROUP_PEER_MAX; i++) {
+        app_group_peer_t *peer = &g_group.peers[i];
+        bool active = peer->id && now - peer->last_us < APP_GROUP_PEER_TIMEOUT_MS * 1000LL;
+
+        if (active && peer->id == id) {
+            free_peer = peer;
+            break;
+        }
+
+        free_peer = (!free_peer && !active) ? peer : free_peer;
+    }
+
+    if (free_peer) {
+        if (free_peer->id != id) {
+            memset(free_peer, 0, sizeof(app_group_peer_t));
+            free_peer->id = id;
+        }
+
+        free_peer->addr    = *addr;
+        free_peer->last_us = now;
+    }
+
+    return free_peer;
+}
+
+static bool app_group_eligible(void)
+{
+    return g_group.reference == g_group.id || g_group.sample_num == APP_GROUP_SAMPLE_NUM;
+}
+
+/**
+ * @brief Keep the reference while it is there, the lowest id if several claim it. Without one, the
+ *        eligible device of the lowest id takes over, a device alone after listening leads its own group
+ */
+static void app_group_elect(int64_t now)
+{
+    uint32_t best = g_group.reference == g_group.id ? g_group.id : UINT32_MAX;
+
+    for (int i = 0; i < APP_GROUP_PEER_MAX; i++) {
+        app_group_peer_t *peer = &g_group.peers[i];
+
+        if (peer->id && now - peer->last_us < APP_GROUP_PEER_TIMEOUT_MS * 1000LL
+                && (peer->flags & APP_GROUP_FLAG_REFERENCE) && peer->id < best) {
+            best = peer->id;
+        }
+    }
+
+    if (best == UINT32_MAX) {
+        best = app_group_eligible() ? g_group.id : UINT32_MAX;
+
+        for (int i = 0; i < APP_GROUP_PEER_MAX; i++) {
+            app_group_peer_t *peer = &g_group.peers[i];
+
+            if (peer->id && now - peer->last_us < APP_GROUP_PEER_TIMEOUT_MS * 1000LL
+                    && (peer->flags & APP_GROUP_FLAG_ELIGIBLE) && peer->id < best) {
+                best = peer->id;
+            }
+        }
+    }
+
+    if (best == UINT32_MAX) {
+        best = now - g_group.start_us > APP_GROUP_LISTEN_MS * 1000LL ? g_group.id : 0;
+    }
+
+    if (best == g_group.reference) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Reference %08" PRIx32 " -> %08" PRIx32 "%s", g_group.reference, best,
+             best == g_group.id ? ", this device" : "");
+
+    /**< The offset and the samples are kept, the group time goes on from the one of the previous reference */
+    g_group.reference = best;
+
+    if (best == g_group.id) {
+        g_group.synced = true;
+    }
+}
+
+static void app_group_add_sample(int64_t t1, int64_t t2, int64_t t3, int64_t t4)
+{
+    app_group_sample_t *sample = NULL;
+    int64_t offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    int64_t delay_us  = (t4 - t1) - (t3 - t2);
+    bool step = llabs(offset_us - g_group.offset_us) > APP_GROUP_STEP_MS * 1000LL;
+
+    /**< The error of an offset is at most half of its round trip, a long one explains the step */
+    if (g_group.synced && step && delay_us > APP_GROUP_STEP_MS * 1000LL) {
+        return;
+    }
+
+    /**< Another group time, e.g. two groups merged: the samples of the previous one are dropped */
+    if (!g_group.synced || step) {
+        if (g_group.synced) {
+            ESP_LOGW(TAG, "Group time stepped by %" PRId64 " us", offset_us - g_group.offset_us);
+        }
+
+        g_group.sample_num  = 0;
+        g_group.sample_next = 0;
+    }
+
+    sample = &g_group.samples[g_group.sample_next];
+    sample->offset_us = offset_us;
+    sample->delay_us  = delay_us;
+    g_group.sample_next = (g_group.sample_next + 1) % APP_GROUP_SAMPLE_NUM;
+    g_group.sample_num += g_group.sample_num < APP_GROUP_SAMPLE_NUM;
+
+    /**
+     * The exchanges of the shortest round trips were the least delayed one way
+     * more than the other, their offsets are averaged to halve the error left
+     */
+    bool used[APP_GROUP_SAMPLE_NUM] = {0};
+    int64_t sum_us = 0;
+    int best_num = MIN(g_group.sample_num, APP_GROUP_SAMPLE_BEST);
+
+    for (int n = 0; n < best_num; n++) {
+        int best = -1;
+
+        for (int i = 0; i < g_group.sample_num; i++) {
+            if (!used[i] && (best < 0 || g_group.samples[i].delay_us < g_group.samples[best].delay_us)) {
+                best = i;
+            }
+        }
+
+        used[best] = true;
+        sum_us += g_group.samples[best].offset_us;
+    }
+
+    xSemaphoreTake(g_group.lock, portMAX_DELAY);
+    g_group.offset_us = sum_us / best_num;
+    g_group.synced    = true;
+    xSemaphoreGive(g_group.lock);
+}
+
+static bool app_group_seen(uint32_t id, uint16_t seq, int64_t now)
+{
+    /**< Only the repeats of a command are dropped, not the same seq of a sender after a reboot */
+    for (int i = 0; i < APP_GROUP_SEEN_NUM; i++) {
+        if (g_group.seen[i].id == id && g_group.seen[i].seq == seq
+                && now - g_group.seen[i].local_us < APP_GROUP_SEEN_MS * 1000LL) {
+            return true;
+        }
+    }
+
+    g_group.seen[g_group.seen_next].id       = id;
+    g_group.seen[g_group.seen_next].seq      = seq;
+    g_group.seen[g_group.seen_next].local_us = now;
+    g_group.seen_next = (g_group.seen_next + 1) % APP_GROUP_SEEN_NUM;
+
+    return false;
+}
+
+static void app_group_receive(int sock)
+{
+    uint8_t buf[APP_GROUP_MSG_MAX];
+    uint8_t reply[APP_GROUP_MSG_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+
+    int len = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len);
+    int64_t now = esp_timer_get_time();
+
+    if (len < APP_GROUP_HEADER_SIZE || get_u16(buf) != APP_GROUP_MAGIC || buf[2] != APP_GROUP_VERSION) {
+        return;
+    }
+
+    uint32_t sender = get_u32(buf + 4);
+
+    if (!sender || sender == g_group.id) {
+        return;
+    }
+
+    app_group_peer_t *peer = app_group_peer(sender, &from, now);
+
+    switch (buf[3]) {
+        case APP_GROUP_MSG_ANNOUNCE:
+            if (len >= APP_GROUP_HEADER_SIZE + 1 && peer) {
+                peer->flags = buf[APP_GROUP_HEADER_SIZE];
+                app_group_elect(now);
+            }
+
+            break;
+
+        case APP_GROUP_MSG_DELAY_REQ:
+            if (len >= APP_GROUP_HEADER_SIZE + 8 && g_group.reference == g_group.id) {
+                size_t reply_len = app_group_header(reply, APP_GROUP_MSG_DELAY_RESP);
+
+                memcpy(reply + reply_len, buf + APP_GROUP_HEADER_SIZE, 8);
+                put_i64(reply + reply_len + 8, now + g_group.offset_us);
+                put_i64(reply + reply_len + 16, esp_timer_get_time() + g_group.offset_us);
+                app_group_sendto(reply, reply_len + 24, &from);
+            }
+
+            break;
+
+        case APP_GROUP_MSG_DELAY_RESP:
+            if (len >= APP_GROUP_HEADER_SIZE + 24 && sender == g_group.reference
+                    && get_i64(buf + APP_GROUP_HEADER_SIZE) == g_group.req_local_us) {
+                app_group_add_sample(g_group.req_local_us, get_i64(buf + APP_GROUP_HEADER_SIZE + 8),
+                                     get_i64(buf + APP_GROUP_HEADER_SIZE + 16), now);
+                g_group.req_local_us = 0;
+            }
+
+            break;
+
+        case APP_GROUP_MSG_COMMAND: {
+            uint16_t seq = get_u16(buf + APP_GROUP_HEADER_SIZE);
+            uint16_t packet_len = get_u16(buf + APP_GROUP_HEADER_SIZE + 2);
+            int64_t start_us = get_i64(buf + APP_GROUP_HEADER_SIZE + 4);
+
+            if (len < APP_GROUP_HEADER_SIZE + 12 + packet_len || packet_len > LIGHT_PROTOCOL_PACKET_MAX
+                    || app_group_seen(sender, seq, now)) {
+                break;
+            }
+
+            if (g_group.synced && start_us > now + g_group.offset_us + APP_GROUP_LEAD_MAX_MS * 1000LL) {
+                ESP_LOGW(TAG, "Command %d of %08" PRIx32 " refused, it starts in %" PRId64 " ms", seq, sender,
+                         (start_us - now - g_group.offset_us) / 1000);
+                break;
+            }
+
+            if (!g_group.synced) {
+                ESP_LOGW(TAG, "Command %d of %08" PRIx32 " started on reception, the group time is unknown", seq, sender);
+                start_us = now + g_group.offset_us;
+            } else if (start_us < now + g_group.offset_us) {
+                ESP_LOGW(TAG, "Command %d of %08" PRIx32 " received %" PRId64 " us after its start time", seq, sender,
+                         now + g_group.offset_us - start_us);
+            }
+
+            app_group_schedule(start_us - g_group.offset_us, buf + APP_GROUP_HEADER_SIZE + 12, packet_len);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static void app_group_task(void *arg)
+{
+    int64_t next_announce_us = 0;
+    int64_t next_exchange_us = 0;
+    int64_t next_log_us = g_group.start_us + 10 * 1000000LL;
+    uint8_t buf[APP_GROUP_MSG_MAX];
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+
+        app_group_elect(now);
+
+        if (now >= next_announce_us) {
+            size_t len = app_group_header(buf, APP_GROUP_MSG_ANNOUNCE);
+
+            buf[len++] = (app_group_eligible() ? APP_GROUP_FLAG_ELIGIBLE : 0)
+                         | (g_group.reference == g_group.id ? APP_GROUP_FLAG_REFERENCE : 0);
+            app_group_sendto(buf, len, &g_group.group_addr);
+            next_announce_us = now + APP_GROUP_ANNOUNCE_MS * 1000LL;
+        }
+
+        if (now >= next_exchange_us && g_group.reference && g_group.reference != g_group.id) {
+            for (int i = 0; i < APP_GROUP_PEER_MAX; i++) {
+                if (g_group.peers[i].id == g_group.reference) {
+                    size_t len = app_group_header(buf, APP_GROUP_MSG_DELAY_REQ);
+
+                    g_group.req_local_us = esp_timer_get_time();
+                    put_i64(buf + len, g_group.req_local_us);
+                    app_group_sendto(buf, len + 8, &g_group.peers[i].addr);
+                    break;
+                }
+            }
+
+            next_exchange_us = now + APP_GROUP_EXCHANGE_MS * 1000LL;
+        }
+
+        xSemaphoreTake(g_group.lock, portMAX_DELAY);
+
+        if (g_group.tx_left && now >= g_group.tx_next_us) {
+            app_group_sendto(g_group.tx, g_group.tx_len, &g_group.group_addr);
+            g_group.tx_left--;
+            g_group.tx_next_us = now + APP_GROUP_REPEAT_MS * 1000LL;
+        }
+
+        int64_t next_us = MIN(next_announce_us, next_exchange_us);
+        next_us = g_group.tx_left ? MIN(next_us, g_group.tx_next_us) : next_us;
+
+        xSemaphoreGive(g_group.lock);
+
+        if (now >= next_log_us) {
+            ESP_LOGI(TAG, "Reference: %08" PRIx32 ", offset: %" PRId64 " us, samples: %d",
+                     g_group.reference, g_group.offset_us, g_group.sample_num);
+            next_log_us = now + 10 * 1000000LL;
+        }
+
+        int64_t wait_us = MAX(next_us - esp_timer_get_time(), 1000);
+        struct timeval timeout = {
+            .tv_sec  = wait_us / 1000000,
+            .tv_usec = wait_us % 1000000,
+        };
+        fd_set readfds;
+
+        FD_ZERO(&readfds);
+        FD_SET(g_group.mcast_sock, &readfds);
+        FD_SET(g_group.sock, &readfds);
+
+        int ready = select(MAX(g_group.mcast_sock, g_group.sock) + 1, &readfds, NULL, NULL, &timeout);
+
+        if (ready < 0) {
+            ESP_LOGE(TAG, "select failed: errno %d", errno);
+            break;
+        }
+
+        if (FD_ISSET(g_group.sock, &readfds)) {
+            app_group_receive(g_group.sock);
+        }
+
+        if (FD_ISSET(g_group.mcast_sock, &readfds)) {
+            app_group_receive(g_group.mcast_sock);
+        }
+    }
+
+    close(g_group.mcast_sock);
+    close(g_group.sock);
+    vTaskDelete(NULL);
+}
+
+static int app_group_socket(uint16_t port)
+{
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port        = htons(port),
+    };
+    int opt = 1;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Create UDP socket fail");
+        return -1;
+    }
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind socket. Error %d", errno);
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+esp_err_t app_group_sync_start(void)
+{
+    uint8_t mac[6] = {0};
+    esp_netif_ip_info_t ip_info = {0};
+    struct in_addr iaddr = {0};
+    struct ip_mreq imreq = {0};
+    uint8_t ttl = 1;
+
+    if (g_group.lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    g_group.id       = get_u32(mac + 2) ? get_u32(mac + 2) : 1;
+    g_group.start_us = esp_timer_get_time();
+    g_group.seq      = esp_random();
+    g_group.group_addr.sin_family = AF_INET;
+    g_group.group_addr.sin_port   = htons(APP_GROUP_PORT);
+    inet_aton(APP_GROUP_ADDR, &g_group.group_addr.sin_addr);
+
+    g_group.mcast_sock = app_group_socket(APP_GROUP_PORT);
+    g_group.sock       = app_group_socket(0);
+
+    if (g_group.mcast_sock < 0 || g_group.sock < 0) {
+        goto exit;
+    }
+
+    /**< Multicast sent and received on the station interface, one hop */
+    esp_netif_get_ip_info(esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"), &ip_info);
+    inet_addr_from_ip4addr(&iaddr, &ip_info.ip);
+    imreq.imr_multiaddr.s_addr = g_group.group_addr.sin_addr.s_addr;
+    imreq.imr_interface.s_addr = iaddr.s_addr;
+
+    if (setsockopt(g_group.sock, IPPROTO_IP, IP_MULTICAST_IF, &iaddr, sizeof(iaddr)) < 0
+            || setsockopt(g_group.sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0
+            || setsockopt(g_group.mcast_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &imreq, sizeof(imreq)) < 0) {
+        ESP_LOGE(TAG, "Failed to join multicast group. Error %d", errno);
+        goto exit;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = app_group_timer_cb,
+        .name     = "group_sync",
+    };
+
+    g_group.lock = xSemaphoreCreateMutex();
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &g_group.timer));
+
+    /**< Above the other application tasks, the start time is only late by the wake-up of this task */
+    if (xTaskCreate(app_group_apply_task, "group_apply", APP_GROUP_STACK_SIZE, NULL, 10, &g_group.apply_task) != pdPASS
+            || xTaskCreate(app_group_task, "group_sync", APP_GROUP_STACK_SIZE, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "create task failed");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Device %08" PRIx32 ", group %s:%d", g_group.id, APP_GROUP_ADDR, APP_GROUP_PORT);
+    return ESP_OK;
+
+exit:
+    if (g_group.mcast_sock >= 0) {
+        close(g_group.mcast_sock);
+    }
+
+    if (g_group.sock >= 0) {
+        close(g_group.sock);
+    }
+
+    return ESP_FAIL;
+}
+
+esp_err_t app_group_sync_get_time(int64_t *group_time_us)
+{
+    if (!group_time_us) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!g_group.lock || !g_group.synced) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(g_group.lock, portMAX_DELAY);
+    *group_time_us = esp_timer_get_time() + g_group.offset_us;
+    xSemaphoreGive(g_group.lock);
+
+    return ESP_OK;
+}
+
+esp_err_t app_group_sync_send(const light_protocol_msg_t *msg, uint32_t lead_ms)
+{
+    uint8_t packet[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t packet_len = 0;
+    int64_t start_us = 0;
+
+    if (!msg || msg->type != LIGHT_PROTOCOL_MSG_SET || lead_ms > APP_GROUP_LEAD_MAX_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (app_group_sync_get_time(&start_us) != ESP_OK) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = light_protocol_encode(msg, packet, sizeof(packet), &packet_len);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    start_us += lead_ms * 1000LL;
+
+    xSemaphoreTake(g_group.lock, portMAX_DELAY);
+
+    size_t len = app_group_header(g_group.tx, APP_GROUP_MSG_COMMAND);
+
+    put_u16(g_group.tx + len, ++g_group.seq);
+    put_u16(g_group.tx + len + 2, packet_len);
+    put_i64(g_group.tx + len + 4, start_us);
+    memcpy(g_group.tx + len + 12, packet, packet_len);
+    g_group.tx_len     = len + 12 + packet_len;
+    g_group.tx_left    = APP_GROUP_REPEAT_NUM - 1;
+    g_group.tx_next_us = esp_timer_get_time() + APP_GROUP_REPEAT_MS * 1000LL;
+    app_group_sendto(g_group.tx, g_group.tx_len, &g_group.group_addr);
+
+    int64_t local_us = start_us - g_group.offset_us;
+
+    xSemaphoreGive(g_group.lock);
+
+    ESP_LOGI(TAG, "Command %d sent, starts in %" PRIu32 " ms", g_group.seq, lead_ms);
+
+    return app_group_schedule(local_us, packet, packet_len);
+}
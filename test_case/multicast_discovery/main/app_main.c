@@ -28,6 +28,7 @@
 #include "app_priv.h"
 
 #define LIGHT_MULTICAST_CLIENT  1
+#define LIGHT_GROUP_SYNC        1   /**< the button switches every light of the LAN at the same time */
 #define LIGHT_ESP_WIFI_SSID     "YOUR-SSID"
 #define LIGHT_ESP_WIFI_PASS     "YOUR-PASS"
 #define LIGHT_ESP_MAXIMUM_RETRY 5
@@ -320,6 +321,14 @@ void app_main()
     ESP_LOGI(TAG, "Wi-Fi Station initialization");
     wifi_station_initialize();
 
+#if LIGHT_GROUP_SYNC
+    /**
+     * @brief Group time shared with the other lights, to start the fades together
+     */
+    ESP_LOGI(TAG, "Group sync initialization");
+    ESP_ERROR_CHECK(app_group_sync_start());
+#endif
+
 #if LIGHT_MULTICAST_CLIENT
     esp_send_multicast();
 #else
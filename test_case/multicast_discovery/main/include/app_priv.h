@@ -15,6 +15,8 @@
 #ifndef __APP_PRIVATE_H__
 #define __APP_PRIVATE_H__
 
+#include "light_protocol.h"
+
 /**
  * @brief 
  * 
@@ -37,4 +39,36 @@ int app_driver_set_state(bool state);
  */
 bool app_driver_get_state(void);
 
+/**
+ * @brief Join the group of the lights on the LAN and agree on a shared clock with them
+ *
+ * @note The device of the lowest id among the ones already synchronised is the reference of
+ *       the group time, the others measure their offset to it every 250 ms.
+ *
+ * @return esp_err_t
+ */
+esp_err_t app_group_sync_start(void);
+
+/**
+ * @brief Time shared by the group, in us
+ *
+ * @param group_time_us Output
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_STATE  Not synchronised yet
+ */
+esp_err_t app_group_sync_get_time(int64_t *group_time_us);
+
+/**
+ * @brief Send a light_protocol set request to the group, started at the same time by every light, this one included
+ *
+ * @param msg     Set request
+ * @param lead_ms Time from now to the start, enough for the multicast to reach every light, up to 5 s
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG    Not a set request, or lead_ms too long
+ *     - ESP_ERR_INVALID_STATE  Not synchronised yet
+ */
+esp_err_t app_group_sync_send(const light_protocol_msg_t *msg, uint32_t lead_ms);
+
 #endif /**< __APP_PRIVATE_H__ */
@@ -127,95 +127,6 @@ static void wifi_station_initialize(void)
     }
 }
 
-static esp_err_t esp_create_tcp_server(void)
-{
-   int len;
-   int keepAlive = 1;
-   int keepIdle = 5;
-   int keepInterval = 5;
-   int keepCount = 3;
-   char rx_buffer[128] = {0};
-   char addr_str[32] = {0};
-   esp_err_t err = ESP_FAIL;
-   struct sockaddr_in server_addr;
-
-   // 创建 TCP 套接字
-   int listenfd = socket(AF_INET, SOCK_STREAM, 0);
-   if (listenfd < 0) {
-      ESP_LOGE(TAG, "create socket error");
-      return err;
-   }
-
-   ESP_LOGI(TAG, "create socket success, listenfd : %d", listenfd);
-
-   // 启用 SO_REUSEADDR 选项， 允许服务器绑定当前已经存在已建立连接的地址
-   int opt = 1;
-   int ret = setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-   if (ret < 0) {
-      ESP_LOGE(TAG, "Failed to set SO_REUSEADDR. Error %d", errno);
-      goto exit;
-   }
-
-   // 服务器绑定 IP 全 0，端口 3333 的接口
-   server_addr.sin_family = AF_INET;
-   server_addr.sin_addr.s_addr = INADDR_ANY;
-   server_addr.sin_port = htons(PORT);
-   ret = bind(listenfd, (struct sockaddr *) &server_addr, sizeof(server_addr));
-   if (ret < 0) {
-      ESP_LOGE(TAG, "bind socket failed, socketfd : %d, errno : %d", listenfd, errno);
-      goto exit;
-   }
-   ESP_LOGI(TAG, "bind socket success");
-
-   ret = listen(listenfd, 1);
-   if (ret < 0) {
-      ESP_LOGE(TAG, "listen socket failed, socketfd : %d, errno : %d", listenfd, errno);
-      goto exit;
-   }
-   ESP_LOGI(TAG, "listen socket success");
-
-   while (1) {
-      struct sockaddr_in source_addr;
-      socklen_t addr_len = sizeof(source_addr);
-      // 等待新的 TCP 连接建立成功，并返回与对端通信的套接字
-      int sock = accept(listenfd, (struct sockaddr *)&source_addr, &addr_len);
-      if (sock < 0) {
-         ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
-         break;
-      }
-
-      // 启动 TCP 保活 功能，防止僵尸客户端
-      setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(int));
-      setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepIdle, sizeof(int));
-      setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(int));
-      setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));
-
-      if (source_addr.sin_family == PF_INET) {
-         inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
-      }
-
-      ESP_LOGI(TAG, "Socket accepted ip address: %s", addr_str);
-
-      do {
-         len = recv(sock, rx_buffer, sizeof(rx_buffer) - 1, 0);
-         if (len < 0) {
-            ESP_LOGE(TAG, "Error occurred during receiving: errno %d", errno);
-         } else if (len == 0) {
-            ESP_LOGW(TAG, "Connection closed");
-         } else {
-            rx_buffer[len] = 0;
-            ESP_LOGI(TAG, "Received %d bytes: %s", len, rx_buffer);
-         }
-      } while (len > 0);
-
-      shutdown(sock, 0);
-      close(sock);
-   }
-exit:
-   close(listenfd);
-   return err;
-}
-
 static esp_err_t esp_create_tcp_client(void)
 {
    esp_err_t err = ESP_FAIL;
@@ -288,7 +199,8 @@ void app_main()
 #if LIGHT_TCP_CLIENT
     esp_create_tcp_client();
 #else
-    esp_create_tcp_server();
+    /* Control server for many local clients, see app_tcp_server.c for the commands */
+    app_tcp_server_start(PORT);
 #endif
 
     while (1) {
@@ -0,0 +1,549 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <fcntl.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+
+#include "lwip/sockets.h"
+#include "lwip/err.h"
+#include "lwip/sys.h"
+
+#include "light_driver.h"
+#include "light_protocol.h"
+#include "app_priv.h"
+
+#define APP_TCP_SERVER_CLIENT_MAX   8       /**< lwIP has CONFIG_LWIP_MAX_SOCKETS (10) sockets, one is the listener */
+#define APP_TCP_SERVER_RING_SIZE    512     /**< per connection and direction, a power of 2 */
+#define APP_TCP_SERVER_LINE_MAX     128     /**< longest command, with the '\n' */
+#define APP_TCP_SERVER_REPLY_MAX    96      /**< longest reply, a connection is only read with this much room to reply */
+#define APP_TCP_SERVER_STACK_SIZE   4096
+
+static const char *TAG = "tcp server";
+
+/**
+ * @brief Byte FIFO, head and tail run freely and wrap on the size
+ */
+typedef struct {
+    uint8_t data[APP_TCP_SERVER_RING_SIZE];
+    uint16_t head;      /**< next byte written */
+    uint16_t tail;      /**< next byte read */
+} app_ring_t;
+
+typedef struct {
+    int fd;
+    app_ring_t rx;
+    app_ring_t tx;
+    bool discard;       /**< in a line longer than APP_TCP_SERVER_LINE_MAX, dropped up to its end */
+    bool backlog;       /**< complete lines left in rx, waiting for room to reply */
+    uint32_t commands;
+    char addr[16];
+} app_tcp_conn_t;
+
+static app_tcp_conn_t g_conns[APP_TCP_SERVER_CLIENT_MAX];
+
+static inline uint16_t ring_used(const app_ring_t *ring)
+{
+    return (uint16_t)(ring->head - ring->tail);
+}
+
+static inline uint16_t ring_free(const app_ring_t *ring)
+{
+    return APP_TCP_SERVER_RING_SIZE - ring_used(ring);
+}
+
+/**
+ * @brief Contiguous room at the head, for recv() straight into the ring
+ */
+static inline uint16_t ring_write_span(const app_ring_t *ring, uint8_t **ptr)
+{
+    uint16_t offset = ring->head & (APP_TCP_SERVER_RING_SIZE - 1);
+    uint16_t span = APP_TCP_SERVER_RING_SIZE - offset;
+
+    *ptr = (uint8_t *)ring->data + offset;
+    return span < ring_free(ring) ? span : ring_free(ring);
+}
+
+/**
+ * @brief Contiguous data at the tail, for send() straight from the ring
+ */
+static inline uint16_t ring_read_span(const app_ring_t *ring, const uint8_t **ptr)
+{
+    uint16_t offset = ring->tail & (APP_TCP_SERVER_RING_SIZE - 1);
+    uint16_t span = APP_TCP_SERVER_RING_SIZE - offset;
+
+    *ptr = ring->data + offset;
+    return span < ring_used(ring) ? span : ring_used(ring);
+}
+
+static void ring_write(app_ring_t *ring, const void *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len && ring_free(ring); i++) {
+        ring->data[ring->head++ & (APP_TCP_SERVER_RING_SIZE - 1)] = ((const uint8_t *)data)[i];
+    }
+}
+
+static void ring_peek(const app_ring_t *ring, uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        data[i] = ring->data[(ring->tail + i) & (APP_TCP_SERVER_RING_SIZE - 1)];
+    }
+}
+
+/**
+ * @brief Take a '\n' terminated line out of the ring
+ *
+ * @return length of the line without the '\n', or
+ *         - RING_NO_LINE        no complete line yet
+ *         - RING_LINE_TOO_LONG  a line longer than size, consumed with its '\n'
+ *         - RING_LINE_PARTIAL   no '\n' in size bytes, the start of the line is consumed
+ */
+#define RING_NO_LINE        (-1)
+#define RING_LINE_TOO_LONG  (-2)
+#define RING_LINE_PARTIAL   (-3)
+
+static int ring_read_line(app_ring_t *ring, char *line, size_t size)
+{
+    uint16_t used = ring_used(ring);
+
+    for (uint16_t i = 0; i < used; i++) {
+        if (ring->data[(ring->tail + i) & (APP_TCP_SERVER_RING_SIZE - 1)] != '\n') {
+            continue;
+        }
+
+        if (i >= size) {
+            ring->tail += i + 1;
+            return RING_LINE_TOO_LONG;
+        }
+
+        for (uint16_t j = 0; j < i; j++) {
+            line[j] = ring->data[ring->tail++ & (APP_TCP_SERVER_RING_SIZE - 1)];
+        }
+
+        line[i] = '\0';
+        ring->tail++;
+
+        /**< Lines from telnet or Windows end with "\r\n" */
+        if (i && line[i - 1] == '\r') {
+            line[--i] = '\0';
+        }
+
+        return i;
+    }
+
+    if (used >= size) {
+        ring->tail += used;
+        return RING_LINE_PARTIAL;
+    }
+
+    return RING_NO_LINE;
+}
+
+static void app_tcp_reply(app_tcp_conn_t *conn, const char *fmt, ...)
+{
+    char reply[APP_TCP_SERVER_REPLY_MAX];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(reply, sizeof(reply) - 1, fmt, args);
+    va_end(args);
+
+    if (len < 0) {
+        return;
+    }
+
+    len = (len < (int)sizeof(reply) - 1) ? len : (int)sizeof(reply) - 2;
+    reply[len++] = '\n';
+    ring_write(&conn->tx, reply, len);
+}
+
+/**
+ * @brief Run one command of the text protocol and queue its reply
+ *
+ *   ping                   -> "ok pong"
+ *   get                    -> "ok <on> <mode> <hue> <saturation> <value> <temperature> <brightness>"
+ *   power <0|1>            -> "ok"
+ *   hsv <h> <s> <v>        -> "ok", h 0 ~ 360, s and v 0 ~ 100
+ *   ctb <temp> <bright>    -> "ok", both 0 ~ 100
+ *
+ * Errors are replied with "err <reason>", the connection stays open. The
+ * light_protocol packets can be sent on the same connection, between lines.
+ */
+static void app_tcp_dispatch(app_tcp_conn_t *conn, char *line)
+{
+    char *saveptr = NULL;
+    const char *cmd = strtok_r(line, " \t", &saveptr);
+    int args[3] = {0};
+    int argc = 0;
+
+    if (!cmd) {
+        return;
+    }
+
+    for (char *arg = strtok_r(NULL, " \t", &saveptr); arg && argc < 3; arg = strtok_r(NULL, " \t", &saveptr)) {
+        char *end = NULL;
+        args[argc++] = strtol(arg, &end, 10);
+
+        if (*end) {
+            app_tcp_reply(conn, "err bad argument %s", arg);
+            return;
+        }
+    }
+
+    conn->commands++;
+    esp_err_t ret = ESP_OK;
+
+    if (!strcmp(cmd, "ping")) {
+        app_tcp_reply(conn, "ok pong");
+        return;
+    } else if (!strcmp(cmd, "get")) {
+        app_tcp_reply(conn, "ok %d %d %d %d %d %d %d", light_driver_get_switch(), light_driver_get_mode(),
+                      light_driver_get_hue(), light_driver_get_saturation(), light_driver_get_value(),
+                      light_driver_get_color_temperature(), light_driver_get_brightness());
+        return;
+    } else if (!strcmp(cmd, "power")) {
+        ret = (argc != 1) ? ESP_ERR_INVALID_ARG : app_driver_set_state(args[0] != 0);
+    } else if (!strcmp(cmd, "hsv")) {
+        ret = (argc != 3 || args[0] < 0 || args[0] > 360 || args[1] < 0 || args[1] > 100 || args[2] < 0 || args[2] > 100)
+              ? ESP_ERR_INVALID_ARG : light_driver_set_hsv(args[0], args[1], args[2]);
+    } else if (!strcmp(cmd, "ctb")) {
+        ret = (argc != 2 || args[0] < 0 || args[0] > 100 || args[1] < 0 || args[1] > 100)
+              ? ESP_ERR_INVALID_ARG : light_driver_set_ctb(args[0], args[1]);
+    } else {
+        app_tcp_reply(conn, "err unknown command %s", cmd);
+        return;
+    }
+
+    if (ret == ESP_OK) {
+        app_tcp_reply(conn, "ok");
+    } else {
+        app_tcp_reply(conn, "err %s", esp_err_to_name(ret));
+    }
+}
+
+static void app_tcp_close(app_tcp_conn_t *conn, const char *reason)
+{
+    ESP_LOGI(TAG, "Connection %s closed, %s, commands: %d", conn->addr, reason, conn->commands);
+    shutdown(conn->fd, SHUT_RDWR);
+    close(conn->fd);
+    conn->fd = -1;
+}
+
+static void app_tcp_accept(int listenfd)
+{
+    int keepAlive = 1;
+    int keepIdle = 5;
+    int keepInterval = 5;
+    int keepCount = 3;
+    struct sockaddr_in source_addr;
+    socklen_t addr_len = sizeof(source_addr);
+    app_tcp_conn_t *conn = NULL;
+
+    int sock = accept(listenfd, (struct sockaddr *)&source_addr, &addr_len);
+
+    if (sock < 0) {
+        ESP_LOGW(TAG, "Unable to accept connection: errno %d", errno);
+        return;
+    }
+
+    for (int i = 0; i < APP_TCP_SERVER_CLIENT_MAX; i++) {
+        if (g_conns[i].fd < 0) {
+            conn = &g_conns[i];
+            break;
+        }
+    }
+
+    if (!conn) {
+        static const char busy[] = "err busy\n";
+        send(sock, busy, sizeof(busy) - 1, MSG_DONTWAIT);
+        close(sock);
+        ESP_LOGW(TAG, "Connection refused, %d clients already", APP_TCP_SERVER_CLIENT_MAX);
+        return;
+    }
+
+    // 启动 TCP 保活 功能，防止僵尸客户端
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepIdle, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(int));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    memset(conn, 0, sizeof(app_tcp_conn_t));
+    conn->fd = sock;
+    inet_ntoa_r(source_addr.sin_addr, conn->addr, sizeof(conn->addr) - 1);
+
+    ESP_LOGI(TAG, "Socket accepted ip address: %s", conn->addr);
+}
+
+/**
+ * @return false if the connection was closed
+ */
+static bool app_tcp_receive(app_tcp_conn_t *conn)
+{
+    uint8_t *ptr = NULL;
+    uint16_t span = ring_write_span(&conn->rx, &ptr);
+    int len = recv(conn->fd, ptr, span, 0);
+
+    if (len == 0) {
+        app_tcp_close(conn, "by the peer");
+        return false;
+    } else if (len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        }
+
+        app_tcp_close(conn, "receive error");
+        return false;
+    }
+
+    conn->rx.head += len;
+    return true;
+}
+
+/**
+ * @brief Run a light_protocol packet at the tail of rx, the binary counterpart of a line
+ *
+ * @return false if the packet is not complete yet, or the connection was closed
+ */
+static bool app_tcp_packet(app_tcp_conn_t *conn)
+{
+    uint8_t packet[APP_TCP_SERVER_LINE_MAX];
+    uint8_t reply[LIGHT_PROTOCOL_PACKET_MAX];
+    uint16_t used = ring_used(&conn->rx);
+    size_t packet_len = 0;
+    size_t reply_len = 0;
+
+    ring_peek(&conn->rx, packet, used < LIGHT_PROTOCOL_HEADER_SIZE ? used : LIGHT_PROTOCOL_HEADER_SIZE);
+
+    if (light_protocol_packet_len(packet, used, &packet_len) != ESP_OK) {
+        return false;
+    }
+
+    /**< The stream can't be resynchronized after a packet it can't hold */
+    if (packet_len > sizeof(packet)) {
+        app_tcp_close(conn, "packet too long");
+        return false;
+    }
+
+    if (used < packet_len) {
+        return false;
+    }
+
+    ring_peek(&conn->rx, packet, packet_len);
+    conn->rx.tail += packet_len;
+    conn->commands++;
+
+    if (light_protocol_handle(packet, packet_len, reply, sizeof(reply), &reply_len) == ESP_OK) {
+        ring_write(&conn->tx, reply, reply_len);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Run the complete lines and packets received, as long as there is room for their replies
+ */
+static void app_tcp_process(app_tcp_conn_t *conn)
+{
+    char line[APP_TCP_SERVER_LINE_MAX];
+
+    conn->backlog = false;
+
+    while (conn->fd >= 0 && ring_used(&conn->rx)) {
+        if (ring_free(&conn->tx) < APP_TCP_SERVER_REPLY_MAX) {
+            conn->backlog = true;
+            break;
+        }
+
+        /**< A packet never starts in the middle of a line */
+        if (!conn->discard && conn->rx.data[conn->rx.tail & (APP_TCP_SERVER_RING_SIZE - 1)] == LIGHT_PROTOCOL_MAGIC) {
+            if (!app_tcp_packet(conn)) {
+                break;
+            }
+
+            continue;
+        }
+
+        int len = ring_read_line(&conn->rx, line, sizeof(line));
+
+        if (len == RING_NO_LINE) {
+            break;
+        }
+
+        if (len == RING_LINE_TOO_LONG || len == RING_LINE_PARTIAL) {
+            if (!conn->discard) {
+                app_tcp_reply(conn, "err line too long");
+            }
+
+            /**< The end of a partial line is still to come */
+            conn->discard = (len == RING_LINE_PARTIAL);
+            continue;
+        }
+
+        if (conn->discard) {
+            conn->discard = false;
+            continue;
+        }
+
+        app_tcp_dispatch(conn, line);
+    }
+}
+
+/**
+ * @return false if the connection was closed
+ */
+static bool app_tcp_send(app_tcp_conn_t *conn)
+{
+    const uint8_t *ptr = NULL;
+    uint16_t span = ring_read_span(&conn->tx, &ptr);
+    int len = send(conn->fd, ptr, span, MSG_DONTWAIT);
+
+    if (len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        }
+
+        app_tcp_close(conn, "send error");
+        return false;
+    }
+
+    conn->tx.tail += len;
+    return true;
+}
+
+static void app_tcp_server_task(void *arg)
+{
+    int listenfd = (int)(intptr_t)arg;
+
+    ESP_LOGI(TAG, "Serving up to %d clients", APP_TCP_SERVER_CLIENT_MAX);
+
+    while (1) {
+        fd_set readfds;
+        fd_set writefds;
+        int maxfd = listenfd;
+        bool backlog = false;
+
+        FD_ZERO(&readfds);
+        FD_ZERO(&writefds);
+        FD_SET(listenfd, &readfds);
+
+        for (int i = 0; i < APP_TCP_SERVER_CLIENT_MAX; i++) {
+            app_tcp_conn_t *conn = &g_conns[i];
+
+            if (conn->fd < 0) {
+                continue;
+            }
+
+            if (ring_free(&conn->rx)) {
+                FD_SET(conn->fd, &readfds);
+            }
+
+            if (ring_used(&conn->tx)) {
+                FD_SET(conn->fd, &writefds);
+            }
+
+            /**< Lines left by a full reply ring run as soon as there is room again */
+            backlog |= conn->backlog && ring_free(&conn->tx) >= APP_TCP_SERVER_REPLY_MAX;
+            maxfd = conn->fd > maxfd ? conn->fd : maxfd;
+        }
+
+        struct timeval no_wait = {0};
+        int ready = select(maxfd + 1, &readfds, &writefds, NULL, backlog ? &no_wait : NULL);
+
+        if (ready < 0) {
+            ESP_LOGE(TAG, "select failed: errno %d", errno);
+            break;
+        }
+
+        for (int i = 0; i < APP_TCP_SERVER_CLIENT_MAX; i++) {
+            app_tcp_conn_t *conn = &g_conns[i];
+
+            if (conn->fd < 0 || (FD_ISSET(conn->fd, &readfds) && !app_tcp_receive(conn))) {
+                continue;
+            }
+
+            app_tcp_process(conn);
+
+            /**< Replies go out in the round of their command when the socket has room */
+            if (conn->fd >= 0 && ring_used(&conn->tx)) {
+                app_tcp_send(conn);
+            }
+        }
+
+        if (FD_ISSET(listenfd, &readfds)) {
+            app_tcp_accept(listenfd);
+        }
+    }
+
+    for (int i = 0; i < APP_TCP_SERVER_CLIENT_MAX; i++) {
+        if (g_conns[i].fd >= 0) {
+            app_tcp_close(&g_conns[i], "server stopped");
+        }
+    }
+
+    close(listenfd);
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_tcp_server_start(uint16_t port)
+{
+    struct sockaddr_in server_addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = INADDR_ANY,
+        .sin_port = htons(port),
+    };
+
+    // 创建 TCP 套接字
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenfd < 0) {
+        ESP_LOGE(TAG, "create socket error");
+        return ESP_FAIL;
+    }
+
+    // 启用 SO_REUSEADDR 选项， 允许服务器绑定当前已经存在已建立连接的地址
+    int opt = 1;
+    if (setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        ESP_LOGE(TAG, "Failed to set SO_REUSEADDR. Error %d", errno);
+        goto exit;
+    }
+
+    if (bind(listenfd, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0) {
+        ESP_LOGE(TAG, "bind socket failed, socketfd : %d, errno : %d", listenfd, errno);
+        goto exit;
+    }
+
+    // 连接请求排队，事件循环每轮接受一个
+    if (listen(listenfd, APP_TCP_SERVER_CLIENT_MAX) < 0) {
+        ESP_LOGE(TAG, "listen socket failed, socketfd : %d, errno : %d", listenfd, errno);
+        goto exit;
+    }
+
+    for (int i = 0; i < APP_TCP_SERVER_CLIENT_MAX; i++) {
+        g_conns[i].fd = -1;
+    }
+
+    if (xTaskCreate(app_tcp_server_task, "tcp_server", APP_TCP_SERVER_STACK_SIZE,
+                    (void *)(intptr_t)listenfd, 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "create task failed");
+        goto exit;
+    }
+
+    ESP_LOGI(TAG, "listen socket success, port: %d", port);
+    return ESP_OK;
+
+exit:
+    close(listenfd);
+    return ESP_FAIL;
+}
@@ -37,4 +37,12 @@ int app_driver_set_state(bool state);
  */
 bool app_driver_get_state(void);
 
+/**
+ * @brief Start the TCP control server, a single task serving all the clients with select()
+ *
+ * @param port TCP port to listen on
+ * @return esp_err_t
+ */
+esp_err_t app_tcp_server_start(uint16_t port);
+
 #endif /**< __APP_PRIVATE_H__ */
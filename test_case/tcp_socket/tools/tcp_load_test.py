@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+#
+# Unless required by applicable law or agreed to in writing, this
+# software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+# CONDITIONS OF ANY KIND, either express or implied.
+#
+# Load test of the TCP control server of tcp_socket, run on a Linux host:
+#
+#   python3 tcp_load_test.py 192.168.3.119 --clients 8 --rate 20 --duration 30
+#
+# Every client holds its connection open and sends commands at a fixed rate,
+# at most --window commands waiting for their reply. The round-trip times are
+# reported per client and for all of them. The exit status is 1 if a reply
+# was wrong or missing.
+
+import argparse
+import asyncio
+import random
+import statistics
+import sys
+import time
+
+COMMANDS = ['ping', 'get', 'hsv', 'ctb', 'power']
+
+
+def make_command(kind):
+    if kind == 'hsv':
+        return 'hsv %d %d %d' % (random.randint(0, 360), random.randint(0, 100), random.randint(1, 100))
+    if kind == 'ctb':
+        return 'ctb %d %d' % (random.randint(0, 100), random.randint(1, 100))
+    if kind == 'power':
+        return 'power 1'
+    return kind
+
+
+class Client(object):
+    def __init__(self, index, args):
+        self.index = index
+        self.args = args
+        self.rtt = []
+        self.errors = []
+        self.sent = 0
+
+    async def run(self):
+        reader, writer = await asyncio.open_connection(self.args.host, self.args.port)
+        pending = asyncio.Queue()
+        window = asyncio.Semaphore(self.args.window)
+
+        async def receive():
+            while True:
+                try:
+                    line = await asyncio.wait_for(reader.readline(), self.args.timeout)
+                except asyncio.TimeoutError:
+                    self.errors.append('timeout, %d replies missing' % pending.qsize())
+                    return
+                if not line:
+                    self.errors.append('connection closed by the server')
+                    return
+                command, start = pending.get_nowait()
+                self.rtt.append(time.monotonic() - start)
+                reply = line.decode(errors='replace').strip()
+                if not reply.startswith('ok'):
+                    self.errors.append('%s -> %s' % (command, reply))
+                window.release()
+
+        receiver = asyncio.ensure_future(receive())
+        period = 1.0 / self.args.rate
+        end = time.monotonic() + self.args.duration
+        next_send = time.monotonic() + random.uniform(0, period)
+
+        while time.monotonic() < end and not receiver.done():
+            await asyncio.sleep(max(0, next_send - time.monotonic()))
+            next_send += period
+            await window.acquire()
+            command = make_command(random.choice(self.args.commands))
+            pending.put_nowait((command, time.monotonic()))
+            writer.write((command + '\n').encode())
+            await writer.drain()
+            self.sent += 1
+
+        # All the window back means all the replies received
+        try:
+            for _ in range(self.args.window):
+                if receiver.done():
+                    break
+                await asyncio.wait_for(window.acquire(), self.args.timeout)
+        except asyncio.TimeoutError:
+            self.errors.append('timeout, %d replies missing' % pending.qsize())
+
+        receiver.cancel()
+        writer.close()
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def report(name, rtt):
+    if not rtt:
+        return '%-8s no reply' % name
+    ms = [v * 1000 for v in rtt]
+    return '%-8s replies: %6d  mean: %7.2f ms  p50: %7.2f ms  p99: %7.2f ms  max: %7.2f ms' % (
+        name, len(ms), statistics.mean(ms), percentile(ms, 50), percentile(ms, 99), max(ms))
+
+
+async def main(args):
+    clients = [Client(i, args) for i in range(args.clients)]
+    start = time.monotonic()
+    results = await asyncio.gather(*[c.run() for c in clients], return_exceptions=True)
+    elapsed = time.monotonic() - start
+    failed = False
+
+    for client, result in zip(clients, results):
+        if isinstance(result, Exception):
+            client.errors.append('%s: %s' % (type(result).__name__, result))
+        print(report('client%d' % client.index, client.rtt))
+        for error in client.errors[:5]:
+            print('         error: %s' % error)
+        failed |= bool(client.errors) or len(client.rtt) != client.sent
+
+    all_rtt = [v for c in clients for v in c.rtt]
+    print(report('all', all_rtt))
+    print('%d clients, %.1f commands/s in total' % (args.clients, len(all_rtt) / elapsed))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Load test of the tcp_socket control server')
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=3333)
+    parser.add_argument('--clients', type=int, default=8, help='connections held open at the same time')
+    parser.add_argument('--rate', type=float, default=10, help='commands per second of each client')
+    parser.add_argument('--window', type=int, default=4, help='commands of a client waiting for their reply')
+    parser.add_argument('--duration', type=float, default=10, help='seconds')
+    parser.add_argument('--timeout', type=float, default=5, help='seconds without reply before a client fails')
+    parser.add_argument('--commands', nargs='+', choices=COMMANDS, default=['ping', 'get'],
+                        help='commands picked at random, hsv, ctb and power write the light status to the flash')
+    args = parser.parse_args()
+    sys.exit(asyncio.get_event_loop().run_until_complete(main(args)))
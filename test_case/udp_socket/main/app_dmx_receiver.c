@@ -0,0 +1,572 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_netif.h"
+
+#include "lwip/sockets.h"
+#include "lwip/err.h"
+#include "lwip/sys.h"
+
+#include "light_driver.h"
+#include "app_priv.h"
+
+#define APP_DMX_E131_PORT           5568
+#define APP_DMX_ARTNET_PORT         6454
+#define APP_DMX_FOOTPRINT           LIGHT_DRIVER_CHANNEL_NUM    /**< slots of the light: red, green, blue, warm, cold */
+#define APP_DMX_JITTER_SLOTS        4       /**< frames held to put them back in order */
+#define APP_DMX_JITTER_DELAY_MS     40      /**< longest wait for a missing frame before skipping it */
+#define APP_DMX_SOURCE_TIMEOUT_MS   2500    /**< E1.31 network data loss timeout, the last frame is held */
+#define APP_DMX_FADE_MIN_MS         10
+#define APP_DMX_FADE_MAX_MS         100     /**< sources slower than 10 Hz step instead of fading */
+#define APP_DMX_PACKET_MAX          638     /**< E1.31 with 512 slots, an Art-Net packet is shorter */
+#define APP_DMX_STACK_SIZE          4096
+
+static const char *TAG = "dmx";
+
+typedef enum {
+    APP_DMX_E131,
+    APP_DMX_ARTNET,
+} app_dmx_protocol_t;
+
+/**
+ * @brief Frame of the light, its slots cut out of a universe
+ */
+typedef struct {
+    bool used;
+    uint8_t seq;
+    int64_t arrival_us;
+    uint8_t slots[APP_DMX_FOOTPRINT];
+} app_dmx_frame_t;
+
+/**
+ * @brief Sender of the frames played, a single one at a time
+ */
+typedef struct {
+    bool active;
+    app_dmx_protocol_t protocol;
+    uint8_t id[16];         /**< CID of E1.31, IPv4 address of Art-Net */
+    uint8_t priority;       /**< 100, the default of E1.31, for Art-Net */
+    bool sequenced;         /**< Art-Net sequence 0 disables the reordering */
+    int64_t last_us;
+} app_dmx_source_t;
+
+static struct {
+    uint16_t universe;
+    uint16_t start_address;
+    int e131_sock;
+    int artnet_sock;
+    app_dmx_source_t source;
+    app_dmx_frame_t jitter[APP_DMX_JITTER_SLOTS];
+    bool played;
+    uint8_t last_seq;
+    int64_t last_play_us;
+    uint32_t period_us;     /**< average time between two frames, the fade time of each frame */
+    app_dmx_stats_t stats;
+    uint32_t poll_replies;
+} g_dmx;
+
+static inline uint16_t get_u16_be(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint16_t get_u16_le(const uint8_t *p)
+{
+    return (uint16_t)(p[1] << 8 | p[0]);
+}
+
+/**
+ * @brief Slots of the light in the DMX data of a universe, missing slots are 0
+ */
+static void app_dmx_cut_slots(const uint8_t *data, uint16_t count, uint8_t slots[APP_DMX_FOOTPRINT])
+{
+    for (int i = 0; i < APP_DMX_FOOTPRINT; i++) {
+        uint16_t slot = g_dmx.start_address - 1 + i;
+        slots[i] = slot < count ? data[slot] : 0;
+    }
+}
+
+/**
+ * @brief Parse an E1.31 data packet of the universe, ANSI E1.31-2016 section 4
+ *
+ * @return true if it holds DMX data for the light
+ */
+static bool app_dmx_parse_e131(const uint8_t *buf, int len, app_dmx_source_t *source, app_dmx_frame_t *frame,
+                               bool *terminated)
+{
+    static const uint8_t acn_id[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+
+    if (len < 126 || get_u16_be(buf) != 0x0010 || get_u16_be(buf + 2) != 0x0000 || memcmp(buf + 4, acn_id, 12)) {
+        return false;
+    }
+
+    /**< Root vector VECTOR_ROOT_E131_DATA, framing vector VECTOR_E131_DATA_PACKET */
+    if (get_u16_be(buf + 18) != 0x0000 || get_u16_be(buf + 20) != 0x0004
+            || get_u16_be(buf + 40) != 0x0000 || get_u16_be(buf + 42) != 0x0002) {
+        return false;
+    }
+
+    uint8_t options = buf[112];
+
+    if (get_u16_be(buf + 113) != g_dmx.universe || (options & 0x80)) {
+        return false;   /**< another universe, or preview data */
+    }
+
+    /**< DMP layer: set property, address and data type 0xa1, first address 0, increment 1 */
+    if (buf[117] != 0x02 || buf[118] != 0xa1 || get_u16_be(buf + 119) != 0 || get_u16_be(buf + 121) != 1) {
+        return false;
+    }
+
+    uint16_t count = get_u16_be(buf + 123);
+
+    if (count < 1 || count > 513 || 125 + count > len || buf[125] != 0x00) {
+        return false;   /**< not null start code data, e.g. a per-slot priority packet */
+    }
+
+    memset(source, 0, sizeof(app_dmx_source_t));
+    source->protocol  = APP_DMX_E131;
+    source->priority  = buf[108];
+    source->sequenced = true;
+    memcpy(source->id, buf + 22, 16);
+
+    frame->seq = buf[111];
+    *terminated = options & 0x40;
+    app_dmx_cut_slots(buf + 126, count - 1, frame->slots);
+
+    return true;
+}
+
+/**
+ * @brief Parse an ArtDmx packet of the universe, Art-Net 4
+ *
+ * @note  The Art-Net port-address is the E1.31 universe - 1, as most consoles map them
+ */
+static bool app_dmx_parse_artnet(const uint8_t *buf, int len, const struct sockaddr_in *from,
+                                 app_dmx_source_t *source, app_dmx_frame_t *frame)
+{
+    if (len < 18 || memcmp(buf, "Art-Net", 8) || get_u16_le(buf + 8) != 0x5000 || get_u16_be(buf + 10) < 14) {
+        return false;
+    }
+
+    uint16_t port_address = (buf[15] & 0x7f) << 8 | buf[14];
+    uint16_t count = get_u16_be(buf + 16);
+
+    if (port_address != g_dmx.universe - 1 || count < 2 || count > 512 || 18 + count > len) {
+        return false;
+    }
+
+    memset(source, 0, sizeof(app_dmx_source_t));
+    source->protocol  = APP_DMX_ARTNET;
+    source->priority  = 100;
+    source->sequenced = buf[12] != 0;
+    memcpy(source->id, &from->sin_addr, sizeof(from->sin_addr));
+
+    frame->seq = buf[12];
+    app_dmx_cut_slots(buf + 18, count, frame->slots);
+
+    return true;
+}
+
+/**
+ * @brief Frames missing between the last one played and seq, Art-Net counts 1 ~ 255 and skips 0
+ */
+static uint8_t app_dmx_missing(uint8_t seq)
+{
+    if (!g_dmx.played) {
+        return 0;
+    }
+
+    uint8_t missing = seq - g_dmx.last_seq - 1;
+
+    return (g_dmx.source.protocol == APP_DMX_ARTNET && seq < g_dmx.last_seq && missing) ? missing - 1 : missing;
+}
+
+static void app_dmx_play(app_dmx_frame_t *frame, int64_t now)
+{
+    /**< Each frame fades over the time to the next one, the output never stops between frames */
+    uint32_t fade_ms = g_dmx.period_us / 1000;
+
+    fade_ms = fade_ms < APP_DMX_FADE_MIN_MS ? APP_DMX_FADE_MIN_MS : fade_ms > APP_DMX_FADE_MAX_MS ? 0 : fade_ms;
+    light_driver_set_channels(frame->slots, fade_ms);
+
+    g_dmx.played   = true;
+    g_dmx.last_seq = frame->seq;
+    g_dmx.last_play_us = now;
+    g_dmx.stats.played++;
+    frame->used = false;
+}
+
+/**
+ * @brief Play the buffered frames in order, a missing frame is waited for at most APP_DMX_JITTER_DELAY_MS
+ *
+ * @return time until a frame is to be played, -1 if none is buffered
+ */
+static int64_t app_dmx_playout(int64_t now)
+{
+    while (1) {
+        app_dmx_frame_t *oldest = NULL;
+
+        for (int i = 0; i < APP_DMX_JITTER_SLOTS; i++) {
+            app_dmx_frame_t *frame = &g_dmx.jitter[i];
+
+            if (frame->used && (!oldest || (int8_t)(frame->seq - oldest->seq) < 0)) {
+                oldest = frame;
+            }
+        }
+
+        if (!oldest) {
+            return -1;
+        }
+
+        uint8_t missing = app_dmx_missing(oldest->seq);
+        int64_t deadline = oldest->arrival_us + APP_DMX_JITTER_DELAY_MS * 1000;
+
+        if (missing && now < deadline) {
+            return deadline - now;
+        }
+
+        g_dmx.stats.lost += missing;
+        app_dmx_play(oldest, now);
+    }
+}
+
+/**
+ * @brief Put a frame in the jitter buffer, E1.31-2016 section 6.7.2 for the sequence numbers
+ */
+static void app_dmx_receive_frame(const app_dmx_source_t *source, const app_dmx_frame_t *frame, int64_t now)
+{
+    g_dmx.stats.received++;
+
+    if (!source->sequenced) {
+        /**< Nothing to reorder, the buffer is bypassed */
+        app_dmx_frame_t unsequenced = *frame;
+        app_dmx_play(&unsequenced, now);
+        return;
+    }
+
+    /**< A frame older than the last one played, by less than 20, is late. Further back, the source restarted */
+    if (g_dmx.played) {
+        int8_t diff = (int8_t)(frame->seq - g_dmx.last_seq);
+
+        if (diff <= 0 && diff > -20) {
+            g_dmx.stats.late++;
+            return;
+        }
+
+        if (diff <= -20) {
+            g_dmx.played = false;
+        }
+    }
+
+    app_dmx_frame_t *slot = NULL;
+
+    for (int i = 0; i < APP_DMX_JITTER_SLOTS; i++) {
+        if (g_dmx.jitter[i].used && g_dmx.jitter[i].seq == frame->seq) {
+            g_dmx.stats.late++;
+            return;
+        }
+
+        slot = (!slot && !g_dmx.jitter[i].used) ? &g_dmx.jitter[i] : slot;
+    }
+
+    app_dmx_frame_t incoming = *frame;
+
+    incoming.used = true;
+    incoming.arrival_us = now;
+
+    /**< Full of frames waiting for a missing one, the oldest of them and the new one is played */
+    if (!slot) {
+        app_dmx_frame_t *oldest = &g_dmx.jitter[0];
+
+        for (int i = 1; i < APP_DMX_JITTER_SLOTS; i++) {
+            if ((int8_t)(g_dmx.jitter[i].seq - oldest->seq) < 0) {
+                oldest = &g_dmx.jitter[i];
+            }
+        }
+
+        if ((int8_t)(incoming.seq - oldest->seq) < 0) {
+            oldest = &incoming;
+        }
+
+        g_dmx.stats.lost += app_dmx_missing(oldest->seq);
+        app_dmx_play(oldest, now);
+
+        if (oldest == &incoming) {
+            return;
+        }
+
+        slot = oldest;
+    }
+
+    *slot = incoming;
+}
+
+/**
+ * @brief Keep the frames of the active source, or of a new one with a higher or the same priority once it timed out
+ */
+static bool app_dmx_select_source(const app_dmx_source_t *source, bool terminated, int64_t now)
+{
+    bool same = g_dmx.source.active && g_dmx.source.protocol == source->protocol
+                && !memcmp(g_dmx.source.id, source->id, sizeof(source->id));
+
+    if (!same) {
+        bool timeout = now - g_dmx.source.last_us > APP_DMX_SOURCE_TIMEOUT_MS * 1000LL;
+
+        if (g_dmx.source.active && !timeout && source->priority <= g_dmx.source.priority) {
+            return false;
+        }
+
+        ESP_LOGI(TAG, "Source %s, priority %d", source->protocol == APP_DMX_E131 ? "E1.31" : "Art-Net",
+                 source->priority);
+
+        g_dmx.source = *source;
+        g_dmx.source.active = true;
+        g_dmx.played = false;
+        memset(g_dmx.jitter, 0, sizeof(g_dmx.jitter));
+    }
+
+    /**< The priority of an E1.31 source may change at any frame */
+    g_dmx.source.priority = source->priority;
+    g_dmx.source.last_us  = now;
+
+    if (terminated) {
+        ESP_LOGI(TAG, "Source terminated the stream");
+        g_dmx.source.active = false;
+        return false;
+    }
+
+    return true;
+}
+
+static void app_dmx_update_period(int64_t now)
+{
+    static int64_t last_us = 0;
+    int64_t interval = now - last_us;
+
+    last_us = now;
+
+    if (interval <= 0 || interval > APP_DMX_SOURCE_TIMEOUT_MS * 1000LL) {
+        return;
+    }
+
+    /**< Average over about 8 frames */
+    g_dmx.period_us = g_dmx.period_us ? g_dmx.period_us + (interval - (int64_t)g_dmx.period_us) / 8 : interval;
+}
+
+/**
+ * @brief Reply to an ArtPoll, the counters of the receiver are in the node report
+ */
+static void app_dmx_poll_reply(const struct sockaddr_in *from)
+{
+    uint8_t reply[239] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0, 0x00, 0x21 };
+    esp_netif_ip_info_t ip_info = {0};
+    uint16_t port_address = g_dmx.universe - 1;
+
+    esp_netif_get_ip_info(esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"), &ip_info);
+    memcpy(reply + 10, &ip_info.ip.addr, 4);
+    reply[14] = APP_DMX_ARTNET_PORT & 0xff;
+    reply[15] = APP_DMX_ARTNET_PORT >> 8;
+    reply[18] = (port_address >> 8) & 0x7f;     /**< NetSwitch */
+    reply[19] = (port_address >> 4) & 0x0f;     /**< SubSwitch */
+    strncpy((char *)reply + 26, "ESP32-C3 light", 17);
+    snprintf((char *)reply + 44, 64, "ESP32-C3 light, DMX address %d, sACN universe %d",
+             g_dmx.start_address, g_dmx.universe);
+    snprintf((char *)reply + 108, 64, "#0001 [%04" PRIu32 "] received %" PRIu32 " played %" PRIu32
+             " late %" PRIu32 " lost %" PRIu32, ++g_dmx.poll_replies % 10000, g_dmx.stats.received, g_dmx.stats.played,
+             g_dmx.stats.late, g_dmx.stats.lost);
+    reply[173] = 1;                             /**< NumPorts */
+    reply[174] = 0x80;                          /**< DMX512 output */
+    reply[182] = g_dmx.source.active ? 0x80 : 0x00;
+    reply[190] = port_address & 0x0f;           /**< SwOut */
+
+    sendto(g_dmx.artnet_sock, reply, sizeof(reply), 0, (const struct sockaddr *)from, sizeof(*from));
+}
+
+static void app_dmx_receive(int sock, int64_t now)
+{
+    uint8_t buf[APP_DMX_PACKET_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    app_dmx_source_t source;
+    app_dmx_frame_t frame = {0};
+    bool terminated = false;
+    bool valid = false;
+
+    int len = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len);
+
+    if (len <= 0) {
+        return;
+    }
+
+    if (sock == g_dmx.e131_sock) {
+        valid = app_dmx_parse_e131(buf, len, &source, &frame, &terminated);
+    } else if (len >= 10 && !memcmp(buf, "Art-Net", 8) && get_u16_le(buf + 8) == 0x2000) {
+        app_dmx_poll_reply(&from);
+        return;
+    } else {
+        valid = app_dmx_parse_artnet(buf, len, &from, &source, &frame);
+    }
+
+    if (!valid) {
+        g_dmx.stats.ignored++;
+        return;
+    }
+
+    if (app_dmx_select_source(&source, terminated, now)) {
+        app_dmx_update_period(now);
+        app_dmx_receive_frame(&source, &frame, now);
+    }
+}
+
+static int app_dmx_socket(uint16_t port)
+{
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port        = htons(port),
+    };
+    int opt = 1;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0) {
+        ESP_LOGE(TAG, "create socket error");
+        return -1;
+    }
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "bind socket failed, port: %d, errno : %d", port, errno);
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+static void app_dmx_task(void *arg)
+{
+    int64_t last_log_us = esp_timer_get_time();
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        int64_t wait_us = app_dmx_playout(now);
+        struct timeval timeout = { .tv_sec = 1 };
+        fd_set readfds;
+
+        if (wait_us >= 0) {
+            timeout.tv_sec  = wait_us / 1000000;
+            timeout.tv_usec = wait_us % 1000000;
+        }
+
+        FD_ZERO(&readfds);
+        FD_SET(g_dmx.e131_sock, &readfds);
+        FD_SET(g_dmx.artnet_sock, &readfds);
+
+        int maxfd = g_dmx.e131_sock > g_dmx.artnet_sock ? g_dmx.e131_sock : g_dmx.artnet_sock;
+        int ready = select(maxfd + 1, &readfds, NULL, NULL, &timeout);
+
+        if (ready < 0) {
+            ESP_LOGE(TAG, "select failed: errno %d", errno);
+            break;
+        }
+
+        now = esp_timer_get_time();
+
+        if (FD_ISSET(g_dmx.e131_sock, &readfds)) {
+            app_dmx_receive(g_dmx.e131_sock, now);
+        }
+
+        if (FD_ISSET(g_dmx.artnet_sock, &readfds)) {
+            app_dmx_receive(g_dmx.artnet_sock, now);
+        }
+
+        if (g_dmx.source.active && now - g_dmx.source.last_us > APP_DMX_SOURCE_TIMEOUT_MS * 1000LL) {
+            ESP_LOGW(TAG, "Source lost, the last frame is held");
+            g_dmx.source.active = false;
+        }
+
+        if (now - last_log_us > 10 * 1000000LL) {
+            last_log_us = now;
+            ESP_LOGI(TAG, "received: %" PRIu32 ", played: %" PRIu32 ", late: %" PRIu32 ", lost: %" PRIu32
+                     ", ignored: %" PRIu32 ", period: %" PRIu32 " us",
+                     g_dmx.stats.received, g_dmx.stats.played, g_dmx.stats.late,
+                     g_dmx.stats.lost, g_dmx.stats.ignored, g_dmx.period_us);
+        }
+    }
+
+    close(g_dmx.e131_sock);
+    close(g_dmx.artnet_sock);
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_dmx_receiver_start(uint16_t universe, uint16_t start_address)
+{
+    if (universe < 1 || universe > 63999 || start_address < 1 || start_address + APP_DMX_FOOTPRINT - 1 > 512) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(&g_dmx, 0, sizeof(g_dmx));
+    g_dmx.universe      = universe;
+    g_dmx.start_address = start_address;
+    g_dmx.e131_sock     = app_dmx_socket(APP_DMX_E131_PORT);
+    g_dmx.artnet_sock   = app_dmx_socket(APP_DMX_ARTNET_PORT);
+
+    if (g_dmx.e131_sock < 0 || g_dmx.artnet_sock < 0) {
+        goto exit;
+    }
+
+    /**< E1.31 universes are sent to 239.255.<universe high byte>.<universe low byte> */
+    struct ip_mreq mreq = {
+        .imr_multiaddr.s_addr = htonl(0xefff0000 | universe),
+        .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+
+    if (setsockopt(g_dmx.e131_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        ESP_LOGW(TAG, "Failed to join the multicast group of the universe, only unicast E1.31 is received");
+    }
+
+    if (xTaskCreate(app_dmx_task, "dmx", APP_DMX_STACK_SIZE, NULL, 6, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "create task failed");
+        goto exit;
+    }
+
+    ESP_LOGI(TAG, "sACN universe %d, Art-Net port-address %d, DMX address %d ~ %d",
+             universe, universe - 1, start_address, start_address + APP_DMX_FOOTPRINT - 1);
+    return ESP_OK;
+
+exit:
+    if (g_dmx.e131_sock >= 0) {
+        close(g_dmx.e131_sock);
+    }
+
+    if (g_dmx.artnet_sock >= 0) {
+        close(g_dmx.artnet_sock);
+    }
+
+    return ESP_FAIL;
+}
+
+esp_err_t app_dmx_receiver_get_stats(app_dmx_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = g_dmx.stats;
+    return ESP_OK;
+}
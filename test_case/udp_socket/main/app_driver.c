@@ -25,6 +25,8 @@ static bool g_output_state = true;
 
 static void push_btn_cb(void *arg)
 {
+    /**< The light may have been switched by a light_protocol packet */
+    g_output_state = light_driver_get_switch();
     app_driver_set_state(!g_output_state);
 }
 
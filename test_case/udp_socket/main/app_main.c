@@ -25,9 +25,13 @@
 #include "lwip/sys.h"
 
 #include "app_storage.h"
+#include "light_protocol.h"
 #include "app_priv.h"
 
 #define LIGHT_UDP_CLIENT        1
+#define LIGHT_DMX_RECEIVER      0       /**< the server receives sACN (E1.31) and Art-Net instead */
+#define LIGHT_DMX_UNIVERSE      1
+#define LIGHT_DMX_START_ADDRESS 1
 #define LIGHT_ESP_WIFI_SSID     "YOUR-SSID"
 #define LIGHT_ESP_WIFI_PASS     "YOUR-PASS"
 #define LIGHT_ESP_MAXIMUM_RETRY 5
@@ -176,6 +180,16 @@ static esp_err_t esp_create_udp_server(void)
             if (source_addr.sin_family == PF_INET) {
                 inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
             }
+            uint8_t reply[LIGHT_PROTOCOL_PACKET_MAX];
+            size_t reply_len = 0;
+
+            // 灯控制协议的数据包，执行后回复灯的状态
+            if (light_protocol_handle((uint8_t *)rx_buffer, len, reply, sizeof(reply), &reply_len) == ESP_OK) {
+                ESP_LOGI(TAG, "Received light_protocol packet of %d bytes from %s", len, addr_str);
+                sendto(sock, reply, reply_len, 0, (struct sockaddr *)&source_addr, addr_len);
+                continue;
+            }
+
             // 字符串以 NULL 结尾
             rx_buffer[len] = 0;
             ESP_LOGI(TAG, "Received %d bytes from %s:", len, addr_str);
@@ -190,8 +204,20 @@ exit:
 static esp_err_t esp_create_udp_client(void)
 {
     esp_err_t err = ESP_FAIL;
-    char *payload = "Open the light";
+    uint8_t payload[LIGHT_PROTOCOL_PACKET_MAX];
+    size_t payload_len = 0;
+    struct timeval timeout = { .tv_sec = 1 };
     struct sockaddr_in dest_addr;
+
+    // 开灯命令，服务端回复灯的状态
+    light_protocol_msg_t msg = {
+        .type   = LIGHT_PROTOCOL_MSG_SET,
+        .seq    = esp_random(),
+        .fields = LIGHT_PROTOCOL_FIELD(LIGHT_PROTOCOL_TAG_POWER),
+        .on     = true,
+    };
+    ESP_ERROR_CHECK(light_protocol_encode(&msg, payload, sizeof(payload), &payload_len));
+
     dest_addr.sin_addr.s_addr = inet_addr(HOST_IP);
     dest_addr.sin_family = AF_INET;
     dest_addr.sin_port = htons(PORT);
@@ -204,13 +230,29 @@ static esp_err_t esp_create_udp_client(void)
     }
 
     // 发送数据
-    int ret = sendto(sock, payload, strlen(payload), 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    int ret = sendto(sock, payload, payload_len, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
     if (ret < 0) {
         ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
         goto exit;
     }
     ESP_LOGI(TAG, "Message send successfully");
-    err = ESP_OK;
+
+    // 等待服务端回复，UDP 不保证送达，超时后放弃
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ret = recv(sock, payload, sizeof(payload), 0);
+    if (ret < 0) {
+        ESP_LOGW(TAG, "No reply from the server: errno %d", errno);
+        goto exit;
+    }
+
+    light_protocol_msg_t state;
+    if (light_protocol_decode(payload, ret, &state) != ESP_OK || state.seq != msg.seq) {
+        ESP_LOGW(TAG, "Unexpected reply of %d bytes", ret);
+        goto exit;
+    }
+
+    ESP_LOGI(TAG, "Light %s, result: %s", state.on ? "on" : "off", esp_err_to_name(state.result));
+    err = state.result;
 
 exit:
    close(sock);
@@ -248,6 +290,8 @@ void app_main()
 
 #if LIGHT_UDP_CLIENT
     esp_create_udp_client();
+#elif LIGHT_DMX_RECEIVER
+    app_dmx_receiver_start(LIGHT_DMX_UNIVERSE, LIGHT_DMX_START_ADDRESS);
 #else
     esp_create_udp_server();
 #endif
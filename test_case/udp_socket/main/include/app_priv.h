@@ -37,4 +37,35 @@ int app_driver_set_state(bool state);
  */
 bool app_driver_get_state(void);
 
+/**
+ * @brief Counters of the DMX receiver
+ */
+typedef struct {
+    uint32_t received;  /**< frames of the universe from the source played */
+    uint32_t played;    /**< frames output to the light */
+    uint32_t late;      /**< frames arrived after a newer one was played, or twice */
+    uint32_t lost;      /**< frames skipped, never arrived in time */
+    uint32_t ignored;   /**< packets of other universes, preview data or not DMX */
+} app_dmx_stats_t;
+
+/**
+ * @brief Start the sACN (E1.31) and Art-Net receiver, the light follows the DMX slots of the universe
+ *
+ * @note Five slots from start_address: red, green, blue, warm white and cold white. The frames are
+ *       output with the fade engine of the light driver and are never saved to the flash.
+ *
+ * @param universe      sACN universe 1 ~ 63999, the Art-Net port-address is universe - 1
+ * @param start_address DMX address of the first slot, 1 ~ 508
+ * @return esp_err_t
+ */
+esp_err_t app_dmx_receiver_start(uint16_t universe, uint16_t start_address);
+
+/**
+ * @brief Counters of the DMX receiver since it started
+ *
+ * @param stats Output
+ * @return esp_err_t
+ */
+esp_err_t app_dmx_receiver_get_stats(app_dmx_stats_t *stats);
+
 #endif /**< __APP_PRIVATE_H__ */
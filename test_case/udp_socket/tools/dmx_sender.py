@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+#
+# This example code is in the Public Domain (or CC0 licensed, at your option.)
+#
+# Unless required by applicable law or agreed to in writing, this
+# software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+# CONDITIONS OF ANY KIND, either express or implied.
+#
+# DMX source for the sACN (E1.31) and Art-Net receiver of udp_socket, run on a Linux host:
+#
+#   python3 dmx_sender.py 192.168.3.119 --rate 44 --duration 30
+#   python3 dmx_sender.py 192.168.3.119 --protocol artnet --jitter 30 --loss 0.01
+#   python3 dmx_sender.py 192.168.3.119 --multicast       # E1.31 to 239.255.0.1 for universe 1
+#
+# A color fade is sent at --rate frames per second. Wi-Fi is imitated with a
+# random delay of up to --jitter ms per frame, which reorders frames once it
+# exceeds the frame period, and with --reorder and --loss probabilities. The
+# counters of the receiver are read with an ArtPoll before and after; the exit
+# status is 1 if fewer frames were played than the ones sent and not dropped.
+
+import argparse
+import colorsys
+import random
+import re
+import socket
+import struct
+import sys
+import time
+import uuid
+
+E131_PORT = 5568
+ARTNET_PORT = 6454
+
+
+def e131_packet(cid, universe, seq, slots, priority=100, options=0):
+    count = len(slots) + 1
+    dmp = struct.pack('>HBBHHHB', 0x7000 | (10 + count), 0x02, 0xa1, 0, 1, count, 0) + bytes(slots)
+    framing = struct.pack('>HI64sBHBBH', 0x7000 | (77 + len(dmp)), 0x00000002, b'dmx_sender',
+                          priority, 0, seq, options, universe) + dmp
+    root = struct.pack('>HI16s', 0x7000 | (22 + len(framing)), 0x00000004, cid) + framing
+    return struct.pack('>HH12s', 0x0010, 0x0000, b'ASC-E1.17') + root
+
+
+def artnet_packet(universe, seq, slots):
+    port_address = universe - 1
+    slots = bytes(slots) + b'\0' * (len(slots) & 1)
+    return (b'Art-Net\0' + struct.pack('<H', 0x5000) + struct.pack('>HBBBBH', 14, seq, 0, port_address & 0xff,
+            port_address >> 8, len(slots)) + slots)
+
+
+def artpoll(host, timeout):
+    """Counters of the receiver from the node report of its ArtPollReply"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(timeout)
+    sock.sendto(b'Art-Net\0' + struct.pack('<H', 0x2000) + struct.pack('>HBB', 14, 0, 0), (host, ARTNET_PORT))
+    try:
+        while True:
+            reply = sock.recv(512)
+            if len(reply) >= 172 and reply[:10] == b'Art-Net\0' + struct.pack('<H', 0x2100):
+                break
+    finally:
+        sock.close()
+    report = reply[108:172].split(b'\0')[0].decode()
+    return {k: int(v) for k, v in re.findall(r'(\w+) (\d+)', report)}
+
+
+def frames(args, start_address):
+    """(time, seq, slots) of every frame, in the order they are sent"""
+    queue = []
+    period = 1.0 / args.rate
+    count = int(args.duration * args.rate)
+    dropped = 0
+
+    for i in range(count):
+        if random.random() < args.loss:
+            dropped += 1
+            continue
+        r, g, b = colorsys.hsv_to_rgb((i * period / 5) % 1, 1, 1)
+        slots = [0] * (start_address - 1) + [int(r * 255), int(g * 255), int(b * 255), 0, 0]
+        at = i * period + random.uniform(0, args.jitter / 1000)
+        if queue and random.random() < args.reorder:
+            at = queue[-1][0]
+            queue[-1] = (at + period / 10,) + queue[-1][1:]
+        queue.append((at, i, slots))
+
+    queue.sort()
+    return queue, count, dropped
+
+
+def main():
+    parser = argparse.ArgumentParser(description='DMX source for the udp_socket sACN and Art-Net receiver')
+    parser.add_argument('host')
+    parser.add_argument('--protocol', choices=['e131', 'artnet'], default='e131')
+    parser.add_argument('--multicast', action='store_true', help='send E1.31 to the multicast group of the universe')
+    parser.add_argument('--universe', type=int, default=1, help='sACN universe, the Art-Net port-address is one less')
+    parser.add_argument('--address', type=int, default=1, help='DMX start address of the light')
+    parser.add_argument('--rate', type=float, default=44, help='frames per second')
+    parser.add_argument('--duration', type=float, default=10, help='seconds')
+    parser.add_argument('--jitter', type=float, default=0, help='random delay of each frame, ms')
+    parser.add_argument('--reorder', type=float, default=0, help='probability to swap a frame with the previous one')
+    parser.add_argument('--loss', type=float, default=0, help='probability to drop a frame')
+    parser.add_argument('--timeout', type=float, default=2, help='seconds to wait for the ArtPollReply')
+    args = parser.parse_args()
+
+    before = artpoll(args.host, args.timeout)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    cid = uuid.uuid4().bytes
+    if args.protocol == 'artnet':
+        dest = (args.host, ARTNET_PORT)
+    elif args.multicast:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 4)
+        dest = ('239.255.%d.%d' % (args.universe >> 8, args.universe & 0xff), E131_PORT)
+    else:
+        dest = (args.host, E131_PORT)
+
+    queue, count, dropped = frames(args, args.address)
+    start = time.monotonic()
+    for at, index, slots in queue:
+        delay = start + at - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+        if args.protocol == 'artnet':
+            packet = artnet_packet(args.universe, index % 255 + 1, slots)
+        else:
+            packet = e131_packet(cid, args.universe, index % 256, slots)
+        sock.sendto(packet, dest)
+
+    if args.protocol == 'e131':
+        sock.sendto(e131_packet(cid, args.universe, count % 256, [0] * 5, options=0x40), dest)
+    sock.close()
+    elapsed = time.monotonic() - start
+
+    # Frames still in the jitter buffer are played within its delay
+    time.sleep(0.2)
+    after = artpoll(args.host, args.timeout)
+    delta = {k: after.get(k, 0) - before.get(k, 0) for k in ('received', 'played', 'late', 'lost')}
+    expected = count - dropped
+
+    print('sent %d frames in %.1f s (%.1f/s), %d dropped on purpose' % (expected, elapsed, expected / elapsed, dropped))
+    print('receiver: received %(received)d, played %(played)d, late %(late)d, lost %(lost)d' % delta)
+    print('played %.1f frames/s' % (delta['played'] / elapsed))
+    return 0 if delta['played'] >= expected - delta['late'] and delta['played'] >= expected * 0.95 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())